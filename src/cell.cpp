@@ -17,6 +17,7 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
 #include "2d_vec.h"
 
 //! Constructor with initialization list
@@ -24,6 +25,7 @@ CCell::CCell(void)
 :
    m_bHadHeadcutRetreat(false),
    m_nEdgeCell(DIRECTION_NONE),
+   m_nGridIndex(0),
    m_dBasementElev(NODATA),
    m_dInitialSoilSurfaceElev(NODATA)
 {
@@ -44,6 +46,18 @@ CCell::~CCell(void)
 {
 }
 
+//! Sets this cell's index in the grid store
+void CCell::SetGridIndex(int const nIndex)
+{
+   m_nGridIndex = nIndex;
+}
+
+//! Returns this cell's index in the grid store
+int CCell::nGetGridIndex(void) const
+{
+   return m_nGridIndex;
+}
+
 //! Set this cell's edge cell value
 void CCell::SetEdgeCell(int const nDirection)
 {
@@ -62,13 +76,10 @@ bool CCell::bIsEdgeCell(void) const
    return (m_nEdgeCell != DIRECTION_NONE);
 }
 
-//! Return true if this cell's elevation is a missing value. This is needed for irregularly-shaped DEMs
+//! Return true if this cell's elevation is a missing value. This is needed for irregularly-shaped DEMs. Is looked up in the active-cell mask, which is set when the DEM is read
 bool CCell::bIsMissingValue(void) const
 {
-   if (bFpEQ(m_dInitialSoilSurfaceElev, m_pSim->dGetMissingValue(), TOLERANCE))
-      return true;
-
-   return false;
+   return m_pGrid->bIsMissing(m_nGridIndex);
 }
 
 // //! Return true if this cell's elevation is a missing value or if this is an edge cell
@@ -80,10 +91,11 @@ bool CCell::bIsMissingValue(void) const
 //    return false;
 // }
 
-//! Sets this cell's basement elevation
+//! Sets this cell's basement elevation, this also changes the elevation of the soil surface
 void CCell::SetBasementElevation(double const dElev)
 {
    m_dBasementElev = dElev;
+   m_Soil.UpdateSoilSurfaceElevation();
 }
 
 //! Returns this cell's basement elevation
@@ -107,7 +119,14 @@ double CCell::dGetInitialSoilSurfaceElevation(void) const
 //! Returns the elevation of this cell's top surface, which could be the water surface if the cell is wet, or the soil surface if dry
 double CCell::dGetTopElevation(void) const
 {
-   return (m_Soil.dGetSoilSurfaceElevation() + m_SurfaceWater.dGetSurfaceWaterDepth());
+   double dElev = m_pGrid->dGetTopElevation(m_nGridIndex);
+
+#if defined _DEBUG
+   // Check that the stored value has been kept up to date
+   assert(bFpEQ(dElev, m_Soil.dCalcSoilSurfaceElevation() + m_SurfaceWater.dGetSurfaceWaterDepth(), TOLERANCE));
+#endif
+
+   return dElev;
 }
 
 // //! Sets this cell's retreat for one of the eight directions
@@ -188,83 +207,100 @@ void CCell::AddToPreSimulationValues(void) const
    m_pSim->GetPreSimulationValues(m_Soil.dGetSoilSurfaceElevation(), m_SoilWater.dGetAllSoilWater());
 }
 
-//! Gets this cell's values for end-of-iteration totals
-void CCell::GetEndOfIterValues(void) const
+//! Zeros this cell's this-iteration values for rain and runon, flow, infiltration, detachment and deposition, and sediment load, ready for the next iteration. If there is slumping this iteration, the slumping and toppling values are zeroed too
+void CCell::InitializeThisIter(bool const bSlump)
 {
-   // Add to these whole-grid values for water
-   m_pSim->AddToEndOfIterRain(m_RainAndRunOn.dGetRain());
-   m_pSim->AddToEndOfIterRunon(m_RainAndRunOn.dGetRunOn());
+   m_RainAndRunOn.InitializeRainAndRunon();
+   m_SurfaceWater.InitializeFlow();
+   m_SoilWater.InitializeInfiltration();
+   m_Soil.InitializeDetachAndDeposit(bSlump);
+   m_SedLoad.ResetSedLoad();
+}
 
-   m_pSim->AddToEndOfIterStoredSoilWater(m_SoilWater.dGetAllSoilWater());
-   m_pSim->AddToEndOfIterInfiltration(m_SoilWater.dGetThisIterInfiltration());
-   m_pSim->AddToEndOfIterExfiltration(m_SoilWater.dGetExfiltration());
-   m_pSim->AddToEndOfIterSurfaceWaterLost(m_SurfaceWater.dGetSurfaceWaterLost());
+//! Fills pdValue (which has EOI_NUM_TOTALS slots) with this cell's contributions to the end-of-iteration totals, and returns true if the cell is wet
+bool CCell::bGetEndOfIterValues(double* const pdValue)
+{
+   // Values for water
+   pdValue[EOI_RAIN] = m_RainAndRunOn.dGetRain();
+   pdValue[EOI_RUNON] = m_RainAndRunOn.dGetRunOn();
 
-   if (m_SurfaceWater.bIsWet())
-   {
-      // Increment the whole-grid count of wet cells
-      m_pSim->IncrNumWetCells();
+   pdValue[EOI_SOIL_WATER] = m_SoilWater.dGetAllSoilWater();
+   pdValue[EOI_INFILT] = m_SoilWater.dGetThisIterInfiltration();
+   pdValue[EOI_EXFILT] = m_SoilWater.dGetExfiltration();
+   pdValue[EOI_SURFACE_WATER_OFF_EDGE] = m_SurfaceWater.dGetSurfaceWaterLost();
 
-      // Add to the whole-grid stored surface water value
+   bool bWet = m_SurfaceWater.bIsWet();
+   if (bWet)
+   {
+      // Stored surface water, this is also added to this cell's cumulative value
       double dWaterDepth = m_SurfaceWater.dGetSurfaceWaterDepth();
-      m_pSim->AddToEndOfIterStoredSurfaceWater(dWaterDepth);
+      pdValue[EOI_SURFACE_WATER] = dWaterDepth;
+      m_SurfaceWater.AddToCumulSurfaceWater(dWaterDepth);
 
-      // Not sure why we have to cast away constness here...
-      const_cast<CCell*>(this)->pGetSurfaceWater()->AddToCumulSurfaceWater(dWaterDepth);
+      // This-iteration sediment load values
+      pdValue[EOI_CLAY_SED_LOAD] = m_SedLoad.dGetLastIterClaySedLoad() + m_SedLoad.dGetClaySplashSedLoad() + m_SedLoad.dGetClayFlowSedLoad() + m_SedLoad.dGetClaySlumpSedLoad() + m_SedLoad.dGetClayToppleSedLoad() + m_SedLoad.dGetClayHeadcutRetreatSedLoad() - m_SedLoad.dGetClaySedLoadRemoved();
 
-      // Add to the whole-grid this-iteration sediment load values
-      m_pSim->AddToEndOfIterClaySedLoad(m_SedLoad.dGetLastIterClaySedLoad() + m_SedLoad.dGetClaySplashSedLoad() + m_SedLoad.dGetClayFlowSedLoad() + m_SedLoad.dGetClaySlumpSedLoad() + m_SedLoad.dGetClayToppleSedLoad() + m_SedLoad.dGetClayHeadcutRetreatSedLoad() - m_SedLoad.dGetClaySedLoadRemoved());
+      pdValue[EOI_SILT_SED_LOAD] = m_SedLoad.dGetLastIterSiltSedLoad() + m_SedLoad.dGetSiltSplashSedLoad() + m_SedLoad.dGetSiltFlowSedLoad() + m_SedLoad.dGetSiltSlumpSedLoad() + m_SedLoad.dGetSiltToppleSedLoad() + m_SedLoad.dGetSiltHeadcutRetreatSedLoad() - m_SedLoad.dGetSiltSedLoadRemoved();
 
-      m_pSim->AddToEndOfIterSiltSedLoad(m_SedLoad.dGetLastIterSiltSedLoad() + m_SedLoad.dGetSiltSplashSedLoad() + m_SedLoad.dGetSiltFlowSedLoad() + m_SedLoad.dGetSiltSlumpSedLoad() + m_SedLoad.dGetSiltToppleSedLoad() + m_SedLoad.dGetSiltHeadcutRetreatSedLoad() - m_SedLoad.dGetSiltSedLoadRemoved());
-
-      m_pSim->AddToEndOfIterSandSedLoad(m_SedLoad.dGetLastIterSandSedLoad() + m_SedLoad.dGetSandSplashSedLoad() + m_SedLoad.dGetSandFlowSedLoad() + m_SedLoad.dGetSandSlumpSedLoad() + m_SedLoad.dGetSandToppleSedLoad() + m_SedLoad.dGetSandHeadcutRetreatSedLoad() - m_SedLoad.dGetSandSedLoadRemoved());
+      pdValue[EOI_SAND_SED_LOAD] = m_SedLoad.dGetLastIterSandSedLoad() + m_SedLoad.dGetSandSplashSedLoad() + m_SedLoad.dGetSandFlowSedLoad() + m_SedLoad.dGetSandSlumpSedLoad() + m_SedLoad.dGetSandToppleSedLoad() + m_SedLoad.dGetSandHeadcutRetreatSedLoad() - m_SedLoad.dGetSandSedLoadRemoved();
+   }
+   else
+   {
+      pdValue[EOI_SURFACE_WATER] =
+      pdValue[EOI_CLAY_SED_LOAD] =
+      pdValue[EOI_SILT_SED_LOAD] =
+      pdValue[EOI_SAND_SED_LOAD] = 0;
    }
 
-   // Add to this whole-grid value for elevation
-   m_pSim->AddToEndOfIterTotalElev(m_Soil.dGetSoilSurfaceElevation());
+   // Value for elevation
+   pdValue[EOI_ELEV] = m_Soil.dGetSoilSurfaceElevation();
+
+   // Values for sediment detachment
+   pdValue[EOI_CLAY_FLOW_DETACH] = m_Soil.dGetClayFlowDetach();
+   pdValue[EOI_CLAY_FLOW_DETACH + EOI_SILT] = m_Soil.dGetSiltFlowDetach();
+   pdValue[EOI_CLAY_FLOW_DETACH + EOI_SAND] = m_Soil.dGetSandFlowDetach();
 
-   // Add to these whole-grid values for sediment detachment
-   m_pSim->AddToEndOfIterClayFlowDetach(m_Soil.dGetClayFlowDetach());
-   m_pSim->AddToEndOfIterSiltFlowDetach(m_Soil.dGetSiltFlowDetach());
-   m_pSim->AddToEndOfIterSandFlowDetach(m_Soil.dGetSandFlowDetach());
+   pdValue[EOI_CLAY_SPLASH_DETACH] = m_Soil.dGetClaySplashDetach();
+   pdValue[EOI_CLAY_SPLASH_DETACH + EOI_SILT] = m_Soil.dGetSiltSplashDetach();
+   pdValue[EOI_CLAY_SPLASH_DETACH + EOI_SAND] = m_Soil.dGetSandSplashDetach();
 
-   m_pSim->AddToEndOfIterClaySplashDetach(m_Soil.dGetClaySplashDetach());
-   m_pSim->AddToEndOfIterSiltSplashDetach(m_Soil.dGetSiltSplashDetach());
-   m_pSim->AddToEndOfIterSandSplashDetach(m_Soil.dGetSandSplashDetach());
+   pdValue[EOI_CLAY_SLUMP_DETACH] = m_Soil.dGetClaySlumpDetach();
+   pdValue[EOI_CLAY_SLUMP_DETACH + EOI_SILT] = m_Soil.dGetSiltSlumpDetach();
+   pdValue[EOI_CLAY_SLUMP_DETACH + EOI_SAND] = m_Soil.dGetSandSlumpDetach();
 
-   m_pSim->AddToEndOfIterClaySlumpDetach(m_Soil.dGetClaySlumpDetach());
-   m_pSim->AddToEndOfIterSiltSlumpDetach(m_Soil.dGetSiltSlumpDetach());
-   m_pSim->AddToEndOfIterSandSlumpDetach(m_Soil.dGetSandSlumpDetach());
+   pdValue[EOI_CLAY_TOPPLE_DETACH] = m_Soil.dGetClayToppleDetach();
+   pdValue[EOI_CLAY_TOPPLE_DETACH + EOI_SILT] = m_Soil.dGetSiltToppleDetach();
+   pdValue[EOI_CLAY_TOPPLE_DETACH + EOI_SAND] = m_Soil.dGetSandToppleDetach();
 
-   m_pSim->AddToEndOfIterClayToppleDetach(m_Soil.dGetClayToppleDetach());
-   m_pSim->AddToEndOfIterSiltToppleDetach(m_Soil.dGetSiltToppleDetach());
-   m_pSim->AddToEndOfIterSandToppleDetach(m_Soil.dGetSandToppleDetach());
+   // Values for sediment deposition
+   pdValue[EOI_CLAY_FLOW_DEPOSIT] = m_Soil.dGetClayFlowDeposit();
+   pdValue[EOI_CLAY_FLOW_DEPOSIT + EOI_SILT] = m_Soil.dGetSiltFlowDeposit();
+   pdValue[EOI_CLAY_FLOW_DEPOSIT + EOI_SAND] = m_Soil.dGetSandFlowDeposit();
 
-   // Add to these whole-grid values for sediment deposition
-   m_pSim->AddToEndOfIterClayFlowDeposit(m_Soil.dGetClayFlowDeposit());
-   m_pSim->AddToEndOfIterSiltFlowDeposit(m_Soil.dGetSiltFlowDeposit());
-   m_pSim->AddToEndOfIterSandFlowDeposit(m_Soil.dGetSandFlowDeposit());
+   pdValue[EOI_CLAY_SPLASH_DEPOSIT] = m_Soil.dGetClaySplashDeposit();
+   pdValue[EOI_CLAY_SPLASH_DEPOSIT + EOI_SILT] = m_Soil.dGetSiltSplashDeposit();
+   pdValue[EOI_CLAY_SPLASH_DEPOSIT + EOI_SAND] = m_Soil.dGetSandSplashDeposit();
 
-   m_pSim->AddToEndOfIterClaySplashDeposit(m_Soil.dGetClaySplashDeposit());
-   m_pSim->AddToEndOfIterSiltSplashDeposit(m_Soil.dGetSiltSplashDeposit());
-   m_pSim->AddToEndOfIterSandSplashDeposit(m_Soil.dGetSandSplashDeposit());
+   pdValue[EOI_CLAY_SLUMP_DEPOSIT] = m_Soil.dGetClaySlumpDeposit();
+   pdValue[EOI_CLAY_SLUMP_DEPOSIT + EOI_SILT] = m_Soil.dGetSiltSlumpDeposit();
+   pdValue[EOI_CLAY_SLUMP_DEPOSIT + EOI_SAND] = m_Soil.dGetSandSlumpDeposit();
 
-   m_pSim->AddToEndOfIterClaySlumpDeposit(m_Soil.dGetClaySlumpDeposit());
-   m_pSim->AddToEndOfIterSiltSlumpDeposit(m_Soil.dGetSiltSlumpDeposit());
-   m_pSim->AddToEndOfIterSandSlumpDeposit(m_Soil.dGetSandSlumpDeposit());
+   pdValue[EOI_CLAY_TOPPLE_DEPOSIT] = m_Soil.dGetClayToppleDeposit();
+   pdValue[EOI_CLAY_TOPPLE_DEPOSIT + EOI_SILT] = m_Soil.dGetSiltToppleDeposit();
+   pdValue[EOI_CLAY_TOPPLE_DEPOSIT + EOI_SAND] = m_Soil.dGetSandToppleDeposit();
 
-   m_pSim->AddToEndOfIterClayToppleDeposit(m_Soil.dGetClayToppleDeposit());
-   m_pSim->AddToEndOfIterSiltToppleDeposit(m_Soil.dGetSiltToppleDeposit());
-   m_pSim->AddToEndOfIterSandToppleDeposit(m_Soil.dGetSandToppleDeposit());
+   pdValue[EOI_CLAY_INFILT_DEPOSIT] = m_Soil.dGetClayInfiltDeposit();
+   pdValue[EOI_CLAY_INFILT_DEPOSIT + EOI_SILT] = m_Soil.dGetSiltInfiltDeposit();
+   pdValue[EOI_CLAY_INFILT_DEPOSIT + EOI_SAND] = m_Soil.dGetSandInfiltDeposit();
 
-   m_pSim->AddToEndOfIterClayInfiltDeposit(m_Soil.dGetClayInfiltDeposit());
-   m_pSim->AddToEndOfIterSiltInfiltDeposit(m_Soil.dGetSiltInfiltDeposit());
-   m_pSim->AddToEndOfIterSandInfiltDeposit(m_Soil.dGetSandInfiltDeposit());
+   // Values for sediment lost from the grid
+   pdValue[EOI_CLAY_SED_OFF_EDGE] = m_SedLoad.dGetClaySedOffEdge();
+   pdValue[EOI_CLAY_SED_OFF_EDGE + EOI_SILT] = m_SedLoad.dGetSiltSedOffEdge();
+   pdValue[EOI_CLAY_SED_OFF_EDGE + EOI_SAND] = m_SedLoad.dGetSandSedOffEdge();
 
-   m_pSim->AddToEndOfIterSedimentOffEdge(m_SedLoad.dGetClaySedOffEdge(), m_SedLoad.dGetSiltSedOffEdge(), m_SedLoad.dGetSandSedOffEdge());
-   m_pSim->AddToEndOfIterClaySplashOffEdge(m_Soil.dGetClaySplashOffEdge());
-   m_pSim->AddToEndOfIterSiltSplashOffEdge(m_Soil.dGetSiltSplashOffEdge());
-   m_pSim->AddToEndOfIterSandSplashOffEdge(m_Soil.dGetSandSplashOffEdge());
+   pdValue[EOI_CLAY_SPLASH_OFF_EDGE] = m_Soil.dGetClaySplashOffEdge();
+   pdValue[EOI_CLAY_SPLASH_OFF_EDGE + EOI_SILT] = m_Soil.dGetSiltSplashOffEdge();
+   pdValue[EOI_CLAY_SPLASH_OFF_EDGE + EOI_SAND] = m_Soil.dGetSandSplashOffEdge();
 
    // Calculate detachment due to all processes, for each size class, for this cell
    double dTotClayDetach = m_Soil.dGetClayFlowDetach() + m_Soil.dGetClaySplashDetach() + m_Soil.dGetClaySlumpDetach() + m_Soil.dGetClayToppleDetach() + m_Soil.dGetClayHeadcutRetreatDetach();
@@ -277,12 +313,10 @@ void CCell::GetEndOfIterValues(void) const
    double dTotSandDeposit = m_Soil.dGetSandFlowDeposit() + m_Soil.dGetSandSplashDeposit() + m_Soil.dGetSandSlumpDeposit() + m_Soil.dGetSandToppleDeposit() + m_Soil.dGetSandHeadcutRetreatDeposit() + m_Soil.dGetSandInfiltDeposit();
 
    // Now calculate net detachment (i.e. detachment - deposition) for this cell
-   double dNetClayDetach = dTotClayDetach - dTotClayDeposit;
-   double dNetSiltDetach = dTotSiltDetach - dTotSiltDeposit;
-   double dNetSandDetach = dTotSandDetach - dTotSandDeposit;
+   pdValue[EOI_CLAY_NET_DETACH] = dTotClayDetach - dTotClayDeposit;
+   pdValue[EOI_CLAY_NET_DETACH + EOI_SILT] = dTotSiltDetach - dTotSiltDeposit;
+   pdValue[EOI_CLAY_NET_DETACH + EOI_SAND] = dTotSandDetach - dTotSandDeposit;
 
-   m_pSim->AddToEndOfIterNetClayDetach(dNetClayDetach);
-   m_pSim->AddToEndOfIterNetSiltDetach(dNetSiltDetach);
-   m_pSim->AddToEndOfIterNetSandDetach(dNetSandDetach);
+   return bWet;
 }
 
@@ -16,6 +16,7 @@ You should have received a copy of the GNU General Public License along with thi
 
 =========================================================================================================================================*/
 class CSimulation;                                 // Forward declaration
+class CGridStore;                                  // Ditto
 
 #include "cell_soil.h"
 #include "cell_rain_and_runon.h"
@@ -29,12 +30,18 @@ public:
    //! Pointer to the simulation object
    static CSimulation* m_pSim;
 
+   //! Pointer to the grid store, which holds the frequently-accessed per-cell fields
+   static CGridStore* m_pGrid;
+
 private:
    //! Switch to show if this cell had headcut retreat this iteration
    bool m_bHadHeadcutRetreat;
    
    //! Edge cell code
    int m_nEdgeCell;
+
+   //! Index of this cell in the grid store
+   int m_nGridIndex;
    
    //! Elevation of bottom of lowest soil layer, in mm. Only unerodible material below this
    double m_dBasementElev;
@@ -65,6 +72,9 @@ public:
    CCell(void);
    ~CCell(void);
 
+   void SetGridIndex(int const);
+   int nGetGridIndex(void) const;
+
    void SetEdgeCell(int const);
    int nGetEdge(void) const;
    bool bIsEdgeCell(void) const;
@@ -93,6 +103,7 @@ public:
    CCellSedimentLoad* pGetSedLoad(void);
    CCellSubsurfaceWater* pGetSoilWater(void);
 
-   void GetEndOfIterValues(void) const;
+   void InitializeThisIter(bool const);
+   bool bGetEndOfIterValues(double* const);
 };
 #endif         // __CELL_H__
@@ -59,7 +59,7 @@ void CCellRainAndRunon::AddRain(double const dRain)
    if (! pCell->pGetSurfaceWater()->bIsWet())
    {
       // It was, so initialize flow velocities on this cell
-      pCell->pGetSurfaceWater()->InitializeAllFlowVelocity();
+      pCell->pGetSurfaceWater()->InitializeAllFlowVelocity(RAND_STREAM_WETTING_VELOCITY);
 
       // Initialize sediment load
       pCell->pGetSedLoad()->InitializeAllSizeSedLoad();
@@ -103,7 +103,7 @@ void CCellRainAndRunon::AddRunOn(double const dRunOn)
    if (! pCell->pGetSurfaceWater()->bIsWet())
    {
       // It was, so initialize flow velocities for this cell
-      pCell->pGetSurfaceWater()->InitializeAllFlowVelocity();
+      pCell->pGetSurfaceWater()->InitializeAllFlowVelocity(RAND_STREAM_WETTING_VELOCITY);
 
       // Initialize sediment load
       pCell->pGetSedLoad()->InitializeAllSizeSedLoad();
@@ -15,14 +15,12 @@ You should have received a copy of the GNU General Public License along with thi
 =========================================================================================================================================*/
 #include "rg.h"
 #include "cell.h"
+#include "grid_store.h"
 #include "cell_sediment.h"
 
 //! Constructor with initialization list
 CCellSedimentLoad::CCellSedimentLoad(void)
 :
-   m_dLastIterClaySedLoad(0),
-   m_dLastIterSiltSedLoad(0),
-   m_dLastIterSandSedLoad(0),
    m_dCumulClaySedLoad(0),
    m_dCumulSiltSedLoad(0),
    m_dCumulSandSedLoad(0),
@@ -65,9 +63,7 @@ void CCellSedimentLoad::SetParent(CCell* const pParent)
 //! Initializes all sediment load size classes
 void CCellSedimentLoad::InitializeAllSizeSedLoad(void)
 {
-   m_dLastIterClaySedLoad = 0;
-   m_dLastIterSiltSedLoad = 0;
-   m_dLastIterSandSedLoad = 0;
+   CCell::m_pGrid->SetSedLoad(pCell->nGetGridIndex(), 0, 0, 0);
    m_dThisIterFlowClaySedLoad = 0;
    m_dThisIterFlowSiltSedLoad = 0;
    m_dThisIterFlowSandSedLoad = 0;
@@ -91,6 +87,12 @@ void CCellSedimentLoad::InitializeAllSizeSedLoad(void)
 //! Resets all sediment load size classes
 void CCellSedimentLoad::ResetSedLoad(void)
 {
+   int n = pCell->nGetGridIndex();
+   double
+      dLastIterClaySedLoad = CCell::m_pGrid->dGetClaySedLoad(n),
+      dLastIterSiltSedLoad = CCell::m_pGrid->dGetSiltSedLoad(n),
+      dLastIterSandSedLoad = CCell::m_pGrid->dGetSandSedLoad(n);
+
    // assert(m_dThisIterFlowClaySedLoad >= 0);
    // assert(m_dThisIterSplashClaySedLoad >= 0);
    // assert(m_dThisIterSlumpClaySedLoad >= 0);
@@ -100,16 +102,16 @@ void CCellSedimentLoad::ResetSedLoad(void)
 
    // TEST
    // cout << std::fixed << setprecision(20);
-   // if (m_dThisIterClaySedRemoved > m_dLastIterClaySedLoad)
-   //    cout << "ERROR: m_dThisIterClaySedRemoved = " << m_dThisIterClaySedRemoved << " m_dLastIterClaySedLoad = " << m_dLastIterClaySedLoad << endl;
+   // if (m_dThisIterClaySedRemoved > dLastIterClaySedLoad)
+   //    cout << "ERROR: m_dThisIterClaySedRemoved = " << m_dThisIterClaySedRemoved << " dLastIterClaySedLoad = " << dLastIterClaySedLoad << endl;
 
-   m_dLastIterClaySedLoad += (m_dThisIterFlowClaySedLoad + m_dThisIterSplashClaySedLoad + m_dThisIterSlumpClaySedLoad + m_dThisIterTopplingClaySedLoad + m_dThisIterHeadcutRetreatClaySedLoad - m_dThisIterClaySedRemoved);
+   dLastIterClaySedLoad += (m_dThisIterFlowClaySedLoad + m_dThisIterSplashClaySedLoad + m_dThisIterSlumpClaySedLoad + m_dThisIterTopplingClaySedLoad + m_dThisIterHeadcutRetreatClaySedLoad - m_dThisIterClaySedRemoved);
 
    // TEST
-   if (m_dLastIterClaySedLoad < 0)
-      m_dLastIterClaySedLoad = 0;
+   if (dLastIterClaySedLoad < 0)
+      dLastIterClaySedLoad = 0;
 
-   // assert(m_dLastIterClaySedLoad >= 0);
+   // assert(dLastIterClaySedLoad >= 0);
 
    // assert(m_dThisIterFlowSiltSedLoad >= 0);
    // assert(m_dThisIterSplashSiltSedLoad >= 0);
@@ -119,16 +121,16 @@ void CCellSedimentLoad::ResetSedLoad(void)
    // assert(m_dThisIterSiltSedRemoved >= 0);
 
    // TEST
-   // if (m_dThisIterSiltSedRemoved > m_dLastIterSiltSedLoad)
-   //    cout << "ERROR: m_dThisIterSiltSedRemoved = " << m_dThisIterSiltSedRemoved << " m_dLastIterSiltSedLoad = " << m_dLastIterSiltSedLoad << endl;
+   // if (m_dThisIterSiltSedRemoved > dLastIterSiltSedLoad)
+   //    cout << "ERROR: m_dThisIterSiltSedRemoved = " << m_dThisIterSiltSedRemoved << " dLastIterSiltSedLoad = " << dLastIterSiltSedLoad << endl;
 
-   m_dLastIterSiltSedLoad += (m_dThisIterFlowSiltSedLoad + m_dThisIterSplashSiltSedLoad + m_dThisIterSlumpSiltSedLoad + m_dThisIterTopplingSiltSedLoad + m_dThisIterHeadcutRetreatSiltSedLoad - m_dThisIterSiltSedRemoved);
+   dLastIterSiltSedLoad += (m_dThisIterFlowSiltSedLoad + m_dThisIterSplashSiltSedLoad + m_dThisIterSlumpSiltSedLoad + m_dThisIterTopplingSiltSedLoad + m_dThisIterHeadcutRetreatSiltSedLoad - m_dThisIterSiltSedRemoved);
 
    // TEST
-   if (m_dLastIterSiltSedLoad < 0)
-      m_dLastIterSiltSedLoad = 0;
+   if (dLastIterSiltSedLoad < 0)
+      dLastIterSiltSedLoad = 0;
 
-   // assert(m_dLastIterSiltSedLoad >= 0);
+   // assert(dLastIterSiltSedLoad >= 0);
 
    // assert(m_dThisIterFlowSandSedLoad >= 0);
    // assert(m_dThisIterSplashSandSedLoad >= 0);
@@ -138,16 +140,18 @@ void CCellSedimentLoad::ResetSedLoad(void)
    // assert(m_dThisIterSandSedRemoved >= 0);
 
    // TEST
-   // if (m_dThisIterSandSedRemoved > m_dLastIterSandSedLoad)
-   //    cout << "ERROR: m_dThisIterSandSedRemoved = " << m_dThisIterSandSedRemoved << " m_dLastIterSandSedLoad = " << m_dLastIterSandSedLoad << endl;
+   // if (m_dThisIterSandSedRemoved > dLastIterSandSedLoad)
+   //    cout << "ERROR: m_dThisIterSandSedRemoved = " << m_dThisIterSandSedRemoved << " dLastIterSandSedLoad = " << dLastIterSandSedLoad << endl;
 
-   m_dLastIterSandSedLoad += (m_dThisIterFlowSandSedLoad + m_dThisIterSplashSandSedLoad + m_dThisIterSlumpSandSedLoad + m_dThisIterTopplingSandSedLoad + m_dThisIterHeadcutRetreatSandSedLoad - m_dThisIterSandSedRemoved);
+   dLastIterSandSedLoad += (m_dThisIterFlowSandSedLoad + m_dThisIterSplashSandSedLoad + m_dThisIterSlumpSandSedLoad + m_dThisIterTopplingSandSedLoad + m_dThisIterHeadcutRetreatSandSedLoad - m_dThisIterSandSedRemoved);
 
    // TEST
-   if (m_dLastIterSandSedLoad < 0)
-      m_dLastIterSandSedLoad = 0;
+   if (dLastIterSandSedLoad < 0)
+      dLastIterSandSedLoad = 0;
+
+   // assert(dLastIterSandSedLoad >= 0);
 
-   // assert(m_dLastIterSandSedLoad >= 0);
+   CCell::m_pGrid->SetSedLoad(n, dLastIterClaySedLoad, dLastIterSiltSedLoad, dLastIterSandSedLoad);
 
    m_dThisIterFlowClaySedLoad = 0;
    m_dThisIterFlowSiltSedLoad = 0;
@@ -205,7 +209,7 @@ void CCellSedimentLoad::AddToSandFlowSedLoad(const double dAddSandDepth)
 //! Adds to this cell's total of clay-sized sediment removed, considering supply limitation. The parameter is set to the value actually removed
 void CCellSedimentLoad::AddToClaySedLoadRemoved(double& dRemoveDepth)
 {
-   dRemoveDepth = tMin(m_dLastIterClaySedLoad - m_dThisIterClaySedRemoved, dRemoveDepth);
+   dRemoveDepth = tMin(CCell::m_pGrid->dGetClaySedLoad(pCell->nGetGridIndex()) - m_dThisIterClaySedRemoved, dRemoveDepth);
 
    m_dThisIterClaySedRemoved += dRemoveDepth;
 }
@@ -213,7 +217,7 @@ void CCellSedimentLoad::AddToClaySedLoadRemoved(double& dRemoveDepth)
 //! Adds to this cell's total of silt-sized sediment removed, considering supply limitation. The parameter is set to the value actually removed
 void CCellSedimentLoad::AddToSiltSedLoadRemoved(double& dRemoveDepth)
 {
-   dRemoveDepth = tMin(m_dLastIterSiltSedLoad - m_dThisIterSiltSedRemoved, dRemoveDepth);
+   dRemoveDepth = tMin(CCell::m_pGrid->dGetSiltSedLoad(pCell->nGetGridIndex()) - m_dThisIterSiltSedRemoved, dRemoveDepth);
 
    m_dThisIterSiltSedRemoved += dRemoveDepth;
 }
@@ -221,7 +225,7 @@ void CCellSedimentLoad::AddToSiltSedLoadRemoved(double& dRemoveDepth)
 //! Adds to this cell's total of sand-sized sediment removed, considering supply limitation. The parameter is set to the value actually removed
 void CCellSedimentLoad::AddToSandSedLoadRemoved(double& dRemoveDepth)
 {
-   dRemoveDepth = tMin(m_dLastIterSandSedLoad - m_dThisIterSandSedRemoved, dRemoveDepth);
+   dRemoveDepth = tMin(CCell::m_pGrid->dGetSandSedLoad(pCell->nGetGridIndex()) - m_dThisIterSandSedRemoved, dRemoveDepth);
 
    m_dThisIterSandSedRemoved += dRemoveDepth;
 }
@@ -253,7 +257,7 @@ double CCellSedimentLoad::dGetSandFlowSedLoad(void) const
 //! Returns last-iteration sediment load for this cell (total for all size classes)
 double CCellSedimentLoad::dGetLastIterAllSizeSedLoad(void) const
 {
-   return (m_dLastIterClaySedLoad + m_dLastIterSiltSedLoad + m_dLastIterSandSedLoad);
+   return CCell::m_pGrid->dGetAllSizeSedLoad(pCell->nGetGridIndex());
 }
 
 //! Returns this-iteration sediment load for this cell (total for all size classes)
@@ -271,19 +275,19 @@ double CCellSedimentLoad::dGetThisIterAllSizeSedLoad(void) const
 //! Gets the last-iteration clay sediment load for this cell
 double CCellSedimentLoad::dGetLastIterClaySedLoad(void) const
 {
-   return m_dLastIterClaySedLoad;
+   return CCell::m_pGrid->dGetClaySedLoad(pCell->nGetGridIndex());
 }
 
 //! Gets the last-iteration silt sediment load for this cell
 double CCellSedimentLoad::dGetLastIterSiltSedLoad(void) const
 {
-   return m_dLastIterSiltSedLoad;
+   return CCell::m_pGrid->dGetSiltSedLoad(pCell->nGetGridIndex());
 }
 
 //! Gets the last-iteration sand sediment load for this cell
 double CCellSedimentLoad::dGetLastIterSandSedLoad(void) const
 {
-   return m_dLastIterSandSedLoad;
+   return CCell::m_pGrid->dGetSandSedLoad(pCell->nGetGridIndex());
 }
 
 //! Returns this-iteration percentage sediment concentration (all sediment size classes)
@@ -25,14 +25,7 @@ public:
    static CSimulation* m_pSim;
 
 private:
-   //! This-iteration clay sediment load (mm depth)
-   double m_dLastIterClaySedLoad;
-
-   //! This-iteration silt sediment load (mm depth)
-   double m_dLastIterSiltSedLoad;
-
-   //! This-iteration sand sediment load (mm depth)
-   double m_dLastIterSandSedLoad;
+   // Note that the last-iteration sediment load for each size class is held in the grid store, not here
 
    //! Cumulative clay sediment load (mm depth, used to calculate average)
    double m_dCumulClaySedLoad;
@@ -16,6 +16,7 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "cell.h"
 #include "cell_soil.h"
+#include "grid_store.h"
 
 //! Constructor with initialization list
 CCellSoil::CCellSoil(void)
@@ -83,7 +84,6 @@ CCellSoil::CCellSoil(void)
    m_dCumulSandInfiltDeposit(0),
    m_dShearStress(0),
    m_dCumulShearStress(0),
-   m_dLaplacian(0),
    m_dClayHeadcutRetreatDetach(0),
    m_dSiltHeadcutRetreatDetach(0),
    m_dSandHeadcutRetreatDetach(0),
@@ -180,6 +180,9 @@ void CCellSoil::SetSoilLayers(double const dTotalDepth, int const nLayers, vecto
       pVdInfiltCPHWF->push_back(0);
       pVdInfiltChiPart->push_back(0);
    }
+
+   // Now that the soil layers exist, store the elevation of the soil surface
+   UpdateSoilSurfaceElevation();
 }
 
 //! Copy every soil layer's thickness to that layer's temporary thickness, for all size classes
@@ -204,9 +207,13 @@ void CCellSoil::FinishTmpLayerThicknesses(void)
       pLayer->SetSiltThickness(pLayer->dGetTmpSiltThickness());
       pLayer->SetSandThickness(pLayer->dGetTmpSandThickness());
    }
+
+   // The layer thicknesses may have changed, so update the stored elevation of the soil surface
+   UpdateSoilSurfaceElevation();
 }
 
-double CCellSoil::dGetSoilSurfaceElevation(void) const
+//! Calculates the elevation of this cell's soil surface by summing the thickness of every soil layer. This is slow, so is only done when a layer's thickness changes
+double CCellSoil::dCalcSoilSurfaceElevation(void) const
 {
    double dSoilSurfaceTop = pCell->dGetBasementElevation();
 
@@ -216,6 +223,36 @@ double CCellSoil::dGetSoilSurfaceElevation(void) const
    return dSoilSurfaceTop;
 }
 
+//! Recalculates the elevation of this cell's soil surface and writes it, and the thickness of each soil layer, to the grid store. Must be called whenever the basement elevation, or the (non-temporary) thickness of any soil layer, changes
+void CCellSoil::UpdateSoilSurfaceElevation(void)
+{
+   int n = pCell->nGetGridIndex();
+   double dSoilSurfaceTop = pCell->dGetBasementElevation();
+
+   // Sum the layer thicknesses in the same order as dCalcSoilSurfaceElevation(), so that the result is identical
+   for (unsigned int nLay = 0; nLay < m_VLayer.size(); nLay++)
+   {
+      double dLayerThickness = m_VLayer[nLay].dGetLayerThickness();
+      CCell::m_pGrid->SetLayerThickness(nLay, n, dLayerThickness);
+      dSoilSurfaceTop += dLayerThickness;
+   }
+
+   CCell::m_pGrid->SetSoilSurfaceElevation(n, dSoilSurfaceTop);
+}
+
+//! Returns the elevation of this cell's soil surface, as stored in the grid store
+double CCellSoil::dGetSoilSurfaceElevation(void) const
+{
+   double dElev = CCell::m_pGrid->dGetSoilSurfaceElevation(pCell->nGetGridIndex());
+
+#if defined _DEBUG
+   // Check that the stored value has been kept up to date
+   assert(bFpEQ(dElev, dCalcSoilSurfaceElevation(), TOLERANCE));
+#endif
+
+   return dElev;
+}
+
 //! Returns the bulk density (in kg/m**3) of the topmost layer with non-zero thickness. If there are no layers with non-zero thickness (i.e. we are down to unerodible basement) returns -1
 double CCellSoil::dGetBulkDensityOfTopNonZeroLayer(void)
 {
@@ -478,6 +515,9 @@ void CCellSoil::DoSplashDetach(double const dThickness, double& dTotClayEroded,
    m_dCumulClaySplashDetach += dTotClayEroded;
    m_dCumulSiltSplashDetach += dTotSiltEroded;
    m_dCumulSandSplashDetach += dTotSandEroded;
+
+   // The soil surface has changed, so update the stored elevation
+   UpdateSoilSurfaceElevation();
 }
 
 //! Set the temporary splash deposition field for this cell
@@ -514,6 +554,9 @@ void CCellSoil::DoSplashToSedLoadOrDeposit(double const dClayChangeDepth, double
       m_dSandSplashDeposit      += dSandChangeDepth;
       m_dCumulSandSplashDeposit += dSandChangeDepth;
       bToSedLoad = false;
+
+      // The soil surface has changed, so update the stored elevation
+      UpdateSoilSurfaceElevation();
    }
 }
 
@@ -702,6 +745,9 @@ void CCellSoil::DoSlumpDetach(double const dThickness, double& dTotClayDetached,
    m_dCumulClaySlumpDetach += dTotClayDetached;
    m_dCumulSiltSlumpDetach += dTotSiltDetached;
    m_dCumulSandSlumpDetach += dTotSandDetached;
+
+   // The soil surface has changed, so update the stored elevation
+   UpdateSoilSurfaceElevation();
 }
 
 //! Adds sediment to this cell as a result of slump: to the top layer of the soil if dry, or to the sediment load if wet
@@ -732,6 +778,9 @@ void CCellSoil::DoSlumpDepositOrToSedLoad(double const dClayChngElev, double con
       dClayDeposit = dClayChngElev;
       dSiltDeposit = dSiltChngElev;
       dSandDeposit = dSandChngElev;
+
+      // The soil surface has changed, so update the stored elevation
+      UpdateSoilSurfaceElevation();
    }
 }
 
@@ -864,6 +913,9 @@ void CCellSoil::DoToppleDetach(double const dThickness, double& dTotClayDetached
    m_dCumulClayToppleDetach += dTotClayDetached;
    m_dCumulSiltToppleDetach += dTotSiltDetached;
    m_dCumulSandToppleDetach += dTotSandDetached;
+
+   // The soil surface has changed, so update the stored elevation
+   UpdateSoilSurfaceElevation();
 }
 
 //! Adds sediment to this cell as a result of toppling. If the cell is wet, the sediment goes to the cell's sediment load
@@ -894,6 +946,9 @@ void CCellSoil::DoToppleDepositOrToSedLoad(double const dClayChngElev, double co
       dClayDeposited = dClayChngElev;
       dSiltDeposited = dSiltChngElev;
       dSandDeposited = dSandChngElev;
+
+      // The soil surface has changed, so update the stored elevation
+      UpdateSoilSurfaceElevation();
    }
 }
 
@@ -994,20 +1049,6 @@ double CCellSoil::dGetCumulAllSizeToppleDeposit(void) const
    return m_dCumulClayToppleDeposit + m_dCumulSiltToppleDeposit + m_dCumulSandToppleDeposit;
 }
 
-//! Zeros the this-iteration (actually they are kept over several iterations) values for slumping, toppling and shear stress
-void CCellSoil::ZeroThisOperationSlump(void)
-{
-   m_dClaySlumpDetach   =
-   m_dSiltSlumpDetach   =
-   m_dSandSlumpDetach   =
-   m_dClayToppleDetach  =
-   m_dSiltToppleDetach  =
-   m_dSandToppleDetach  =
-   m_dClayToppleDeposit =
-   m_dSiltToppleDeposit =
-   m_dSandToppleDeposit = 0;
-}
-
 void CCellSoil::DoInfiltrationDeposit(double const dClayDeposit, double const dSiltDeposit, double const dSandDeposit)
 {
    // Do the deposition (always deposit to the top layer, even if the top layer has previously been eroded to zero thickness)
@@ -1017,6 +1058,9 @@ void CCellSoil::DoInfiltrationDeposit(double const dClayDeposit, double const dS
    m_dClayInfiltDeposit += dClayDeposit;
    m_dSiltInfiltDeposit += dSiltDeposit;
    m_dSandInfiltDeposit += dSandDeposit;
+
+   // The soil surface has changed, so update the stored elevation
+   UpdateSoilSurfaceElevation();
 }
 
 void CCellSoil::SetInfiltrationDepositionZero(void)
@@ -1140,6 +1184,9 @@ void CCellSoil::DoHeadcutRetreatDetach(double const dThickness, double& dTotClay
    m_dCumulClayHeadcutRetreatDetach += dTotClayDetached;
    m_dCumulSiltHeadcutRetreatDetach += dTotSiltDetached;
    m_dCumulSandHeadcutRetreatDetach += dTotSandDetached;
+
+   // The soil surface has changed, so update the stored elevation
+   UpdateSoilSurfaceElevation();
 }
 
 //! Adds sediment to this cell as a result of headcut retreat. If the cell is wet, the sediment is added to sediment load
@@ -1170,6 +1217,9 @@ void CCellSoil::DoHeadcutRetreatDepositOrToSedLoad(double const dClayChngElev, d
       dClayDeposited = dClayChngElev;
       dSiltDeposited = dSiltChngElev;
       dSandDeposited = dSandChngElev;
+
+      // The soil surface has changed, so update the stored elevation
+      UpdateSoilSurfaceElevation();
    }
 }
 
@@ -1263,19 +1313,6 @@ double  CCellSoil::dGetCumulAllSizeHeadcutRetreatDeposit(void) const
    return m_dCumulClayHeadcutRetreatDeposit + m_dCumulSiltHeadcutRetreatDeposit + m_dCumulSandHeadcutRetreatDeposit;
 }
 
-// ============================================================== m_dLaplacian =========================================================
-//! Sets the Laplacian value for this cell
-void CCellSoil::SetLaplacian(double const dNewLapl)
-{
-   m_dLaplacian = dNewLapl;
-}
-
-//! Returns the Laplacian value for this cell
-double CCellSoil::dGetLaplacian(void) const
-{
-   return (m_dLaplacian);
-}
-
 //! Sets the detachment and deposition values, and the splash off-edge values, for this cell to zero. if there is slumping this iteration, it also zeroes the slumping and toppling values for the cell
 void CCellSoil::InitializeDetachAndDeposit(bool const bSlump)
 {
@@ -1291,7 +1328,6 @@ void CCellSoil::InitializeDetachAndDeposit(bool const bSlump)
    m_dClaySplashDeposit =
    m_dSiltSplashDeposit =
    m_dSandSplashDeposit =
-   m_dLaplacian         =
    m_dTempSplashDeposit =
    m_dClaySplashOffEdge =
    m_dSiltSplashOffEdge =
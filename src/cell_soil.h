@@ -219,9 +219,6 @@ private:
    //! Cumulative shear stress in kg/m s**2 (Pa)
    double m_dCumulShearStress;
 
-   //! For Planchon splash calcs
-   double m_dLaplacian;
-
    //! This-iteration clay-sized detachment (mm) due to headcut retreat
    double m_dClayHeadcutRetreatDetach;
 
@@ -278,6 +275,8 @@ public:
 
    void FinishTmpLayerThicknesses(void);
 
+   double dCalcSoilSurfaceElevation(void) const;
+   void UpdateSoilSurfaceElevation(void);
    double dGetSoilSurfaceElevation(void) const;
 
    double dGetBulkDensityOfTopNonZeroLayer(void);
@@ -308,8 +307,6 @@ public:
    void DoSplashDetach(double const, double&, double&, double&);
    void SetSplashDepositTemp(double const);
    double dGetSplashDepositTemp(void) const;
-   void SetLaplacian(double const);
-   double dGetLaplacian(void) const;
    void DoSplashToSedLoadOrDeposit(double const, double const, double const, bool&);
    double dGetClaySplashDetach(void) const;
    double dGetSiltSplashDetach(void) const;
@@ -343,7 +340,6 @@ public:
 
    void DoSlumpDetach(double const, double&, double&, double&);
    void DoSlumpDepositOrToSedLoad(double const, double const, double const, double&, double&, double&, double&, double&, double&);
-   void ZeroThisOperationSlump(void);
    double dGetClaySlumpDetach(void) const;
    double dGetSiltSlumpDetach(void) const;
    double dGetSandSlumpDetach(void) const;
@@ -34,8 +34,7 @@ CCellSoilLayer::CCellSoilLayer(void)
    m_dSandSplashErodibility(0),
    m_dClaySlumpErodibility(0),
    m_dSiltSlumpErodibility(0),
-   m_dSandSlumpErodibility(0),
-   m_dSoilWater(0)
+   m_dSandSlumpErodibility(0)
 {
 }
 
@@ -490,24 +489,6 @@ void CCellSoilLayer::DoTmpLayerDeposition(double const dClayDepth, double const
    m_dTmpSandThickness += dSandDepth;
 }
 
-//! Sets the soil water content for this soil layer
-void CCellSoilLayer::SetSoilWater(double const dWater)
-{
-   m_dSoilWater = dWater;
-}
-
-//! Changes the soil water content for this soil layer
-void CCellSoilLayer::ChangeSoilWater(double const dWater)
-{
-   m_dSoilWater += dWater;
-}
-
-//! Gets the soil water content for this soil layer
-double CCellSoilLayer::dGetSoilWater(void) const
-{
-   return m_dSoilWater;
-}
-
 //! Does headcut erosion for this soil layer
 void CCellSoilLayer::DoLayerHeadcutRetreatErosion(double const dToErode, double& dClayEroded, double& dSiltEroded, double& dSandEroded)
 {
@@ -72,9 +72,6 @@ private:
    //! The slumping erodibility of sand in this soil layer, a normalized (0-1) value
    double m_dSandSlumpErodibility;
 
-   //! The layer's soil water content
-   double m_dSoilWater;
-
 public:
    CCellSoilLayer(void);
    ~CCellSoilLayer(void);
@@ -131,10 +128,6 @@ public:
    void DoTmpLayerDeposition(double const, double const, double const);
    void DoLayerDeposition(double const, double const, double const);
 
-   void SetSoilWater(double const);
-   void ChangeSoilWater(double const);
-   double dGetSoilWater(void) const;
-
    // void ChangeThickness(double const);
 
    void DoLayerHeadcutRetreatErosion(double const, double&, double&, double&);
@@ -16,6 +16,7 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "cell.h"
 #include "cell_subsurface_water.h"
+#include "grid_store.h"
 
 //! Constructor with initialization list
 CCellSubsurfaceWater::CCellSubsurfaceWater(void)
@@ -44,11 +45,8 @@ void CCellSubsurfaceWater::DoInfiltration(double& dInfilt)
 {
    m_pCell->pGetSurfaceWater()->RemoveSurfaceWater(dInfilt);
 
-   // Get a pointer to the top layer
-   CCellSoilLayer* pLayer = m_pCell->pGetSoil()->pLayerGetLayer(0);
-
-   // And add water to this layer
-   pLayer->ChangeSoilWater(dInfilt);
+   // And add water to the top layer
+   CCell::m_pGrid->ChangeLayerSoilWater(0, m_pCell->nGetGridIndex(), dInfilt);
 
    m_dEndOfIterInfiltWater += dInfilt;
    m_dCumulInfiltWater += dInfilt;
@@ -66,11 +64,8 @@ void CCellSubsurfaceWater::InfiltrateAndMakeDry(double& dClaySediment, double& d
    // First remove the surface water (also decrements the surface water total, and count of wet cells)
    m_pCell->pGetSurfaceWater()->SetSurfaceWaterZero();
 
-   // Get a pointer to the top layer
-   CCellSoilLayer* pLayer = m_pCell->pGetSoil()->pLayerGetLayer(0);
-
-   // And add water to this layer
-   pLayer->ChangeSoilWater(dWaterDepth);
+   // And add water to the top layer
+   CCell::m_pGrid->ChangeLayerSoilWater(0, m_pCell->nGetGridIndex(), dWaterDepth);
 
    m_dEndOfIterInfiltWater += dWaterDepth;
    m_dCumulInfiltWater += dWaterDepth;
@@ -102,10 +97,8 @@ double CCellSubsurfaceWater::dGetCumulInfiltration(void) const
 //! Exfiltrates i.e. sends soil water out of the top soil layer, to become overland flow
 void CCellSubsurfaceWater::DoExfiltration(double const dExcess)
 {
-   // Get a pointer to the top layer
-   CCellSoilLayer* pLayer = m_pCell->pGetSoil()->pLayerGetLayer(0);
-
-   pLayer->ChangeSoilWater(-dExcess);
+   // Remove water from the top layer and add it to the surface water
+   CCell::m_pGrid->ChangeLayerSoilWater(0, m_pCell->nGetGridIndex(), -dExcess);
    m_pCell->pGetSurfaceWater()->AddSurfaceWater(dExcess);
 }
 
@@ -124,25 +117,19 @@ double CCellSubsurfaceWater::dGetCumulExfiltration(void) const
 //! Returns the depth of soil water in the top soil layer
 double CCellSubsurfaceWater::dGetTopLayerSoilWater(void)
 {
-   // Get a pointer to the top layer
-   CCellSoilLayer const* pLayer = m_pCell->pGetSoil()->pLayerGetLayer(0);
-
-   return pLayer->dGetSoilWater();
+   return CCell::m_pGrid->dGetLayerSoilWater(0, m_pCell->nGetGridIndex());
 }
 
 //! Returns the total depth of water in all soil layers
 double CCellSubsurfaceWater::dGetAllSoilWater(void) const
 {
-   int nLayer = m_pCell->pGetSoil()->nGetNumLayers();
+   int
+      nLayers = m_pCell->pGetSoil()->nGetNumLayers(),
+      n = m_pCell->nGetGridIndex();
 
    double dTotSoilWater = 0;
-   for (int n = 0; n < nLayer; n++)
-   {
-      // Get a pointer to this layer
-      CCellSoilLayer const* pLayer = m_pCell->pGetSoil()->pLayerGetLayer(n);
-
-      dTotSoilWater += pLayer->dGetSoilWater();
-   }
+   for (int nLayer = 0; nLayer < nLayers; nLayer++)
+      dTotSoilWater += CCell::m_pGrid->dGetLayerSoilWater(nLayer, n);
 
    return dTotSoilWater;
 }
@@ -16,14 +16,12 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "cell.h"
 #include "cell_surface_water.h"
+#include "grid_store.h"
 
 //! Constructor with initialization list
 CCellSurfaceWater::CCellSurfaceWater(void)
 :
-   m_nFlowDirection(DIRECTION_NONE),
    m_nInundationClass(NO_FLOW),
-   m_dSurfaceWaterDepth(0),
-   m_dTmpSurfaceWaterDepth(0),
    m_dCumulSurfaceWaterDepth(0),
    m_dSurfaceWaterDepthLost(0),
    m_dCumulSurfaceWaterDepthLost(0),
@@ -50,7 +48,7 @@ void CCellSurfaceWater::InitializeFlow(void)
 {
    // m_bFlowThisIter = false;
 
-   m_nFlowDirection = DIRECTION_NONE;
+   CCell::m_pGrid->SetFlowDirection(pCell->nGetGridIndex(), DIRECTION_NONE);
    m_nInundationClass = NO_FLOW;
 
    m_dSurfaceWaterDepthLost =
@@ -73,52 +71,55 @@ int CCellSurfaceWater::nGetInundation(void) const
 //! Sets the surface water direction
 void CCellSurfaceWater::SetFlowDirection(int nNewFlowDir)
 {
-   m_nFlowDirection = nNewFlowDir;
+   CCell::m_pGrid->SetFlowDirection(pCell->nGetGridIndex(), nNewFlowDir);
 }
 
 //! Returns the surface water direction
 int CCellSurfaceWater::nGetFlowDirection(void) const
 {
-   return m_nFlowDirection;
+   return CCell::m_pGrid->nGetFlowDirection(pCell->nGetGridIndex());
 }
 
 //! Adds to this cell's surface water depth
 void CCellSurfaceWater::AddSurfaceWater(double const dAddDepth)
 {
-   m_dSurfaceWaterDepth += dAddDepth;
+   int n = pCell->nGetGridIndex();
+   CCell::m_pGrid->SetSurfaceWaterDepth(n, CCell::m_pGrid->dGetSurfaceWaterDepth(n) + dAddDepth);
 }
 
 //! Removes from this cell's surface water depth; if there is insufficient water, then the function returns false and sets the parameter to the depth actually removed
 void CCellSurfaceWater::RemoveSurfaceWater(double& dRemoveDepth)
 {
-   if (dRemoveDepth > m_dSurfaceWaterDepth)
+   int n = pCell->nGetGridIndex();
+   double dDepth = CCell::m_pGrid->dGetSurfaceWaterDepth(n);
+   if (dRemoveDepth > dDepth)
    {
-      dRemoveDepth = m_dSurfaceWaterDepth;
+      dRemoveDepth = dDepth;
       this->SetSurfaceWaterZero();
    }
    else
    {
-      m_dSurfaceWaterDepth -= dRemoveDepth;
+      CCell::m_pGrid->SetSurfaceWaterDepth(n, dDepth - dRemoveDepth);
    }
 }
 
 //! Sets this cell's surface water depth to zero, also zeros flow velocities
 void CCellSurfaceWater::SetSurfaceWaterZero(void)
 {
-   m_dSurfaceWaterDepth = 0;
+   CCell::m_pGrid->SetSurfaceWaterDepth(pCell->nGetGridIndex(), 0);
    this->ZeroAllFlowVelocity();
 }
 
 //! Returns the depth of surface water (in mm) on this cell
 double CCellSurfaceWater::dGetSurfaceWaterDepth(void) const
 {
-   return m_dSurfaceWaterDepth;
+   return CCell::m_pGrid->dGetSurfaceWaterDepth(pCell->nGetGridIndex());
 }
 
 //! Returns true if surface water depth > 0, false otherwise
 bool CCellSurfaceWater::bIsWet(void) const
 {
-   return ((m_dSurfaceWaterDepth > 0) ? true : false);
+   return CCell::m_pGrid->bIsWet(pCell->nGetGridIndex());
 }
 
 //! Gets the cumulative surface water depth
@@ -136,28 +137,33 @@ void CCellSurfaceWater::AddToCumulSurfaceWater(double const dWaterDepth)
 //! Initializes the temporary surface water depth value
 void CCellSurfaceWater::InitTmpSurfaceWater(void)
 {
-   m_dTmpSurfaceWaterDepth = m_dSurfaceWaterDepth;
+   int n = pCell->nGetGridIndex();
+   CCell::m_pGrid->SetTmpSurfaceWaterDepth(n, CCell::m_pGrid->dGetSurfaceWaterDepth(n));
 }
 
 //! Adds to the temporary surface water depth value
 void CCellSurfaceWater::AddTmpSurfaceWater(double const dAddDepth)
 {
-   m_dTmpSurfaceWaterDepth += dAddDepth;
+   int n = pCell->nGetGridIndex();
+   CCell::m_pGrid->SetTmpSurfaceWaterDepth(n, CCell::m_pGrid->dGetTmpSurfaceWaterDepth(n) + dAddDepth);
 }
 
 //! Removes from this cell's temporary surface water depth; if there is insufficient water, then the parameter is set to the depth actually removed
 void CCellSurfaceWater::RemoveTmpSurfaceWater(double& dRemoveDepth)
 {
-   if (dRemoveDepth > m_dSurfaceWaterDepth)
-      dRemoveDepth = m_dSurfaceWaterDepth;      // Since always, m_dTmpSurfaceWaterDepth >= m_dSurfaceWaterDepth here
+   int n = pCell->nGetGridIndex();
+   double dDepth = CCell::m_pGrid->dGetSurfaceWaterDepth(n);
+   if (dRemoveDepth > dDepth)
+      dRemoveDepth = dDepth;      // Since always, the temporary depth >= the surface water depth here
 
-   m_dTmpSurfaceWaterDepth -= dRemoveDepth;
+   CCell::m_pGrid->SetTmpSurfaceWaterDepth(n, CCell::m_pGrid->dGetTmpSurfaceWaterDepth(n) - dRemoveDepth);
 }
 
 //! Copies the from the temporary surface water depth value
 void CCellSurfaceWater::FinishTmpSurfaceWater(void)
 {
-   m_dSurfaceWaterDepth = m_dTmpSurfaceWaterDepth;
+   int n = pCell->nGetGridIndex();
+   CCell::m_pGrid->SetSurfaceWaterDepth(n, CCell::m_pGrid->dGetTmpSurfaceWaterDepth(n));
 }
 
 //! Increments the total depth of water lost from the grid via this cell (only meaningful for edge cells)
@@ -179,12 +185,14 @@ double CCellSurfaceWater::dGetCumulSurfaceWaterLost(void) const
    return m_dCumulSurfaceWaterDepthLost;
 }
 
-//! Initializes overland flow velocities
-void CCellSurfaceWater::InitializeAllFlowVelocity(void)
+//! Initializes overland flow velocities, nProcess is the RAND_STREAM constant for the process which calls this
+void CCellSurfaceWater::InitializeAllFlowVelocity(int const nProcess)
 {
-   // Need to make this small +ve or -ve random to seed Reynolds' number calculations if using Darcy-Weisbach/Reynolds' flow speed calcs. Could be zero for other approaches, but does no harm
-   m_vFlowVelocity.x = m_pSim->dGetRandGaussian() * INIT_MAX_SPEED_GUESS;
-   m_vFlowVelocity.y = m_pSim->dGetRandGaussian() * INIT_MAX_SPEED_GUESS;
+   // Need to make this small +ve or -ve random to seed Reynolds' number calculations if using Darcy-Weisbach/Reynolds' flow speed calcs. Could be zero for other approaches, but does no harm. The stream is chosen by the cell's number within the grid, not its store index, so the random numbers do not depend on the layout of the store
+   double dRandX, dRandY;
+   m_pSim->GetRandGaussianPair(nProcess, CCell::m_pGrid->nGetCellNumber(pCell->nGetGridIndex()), dRandX, dRandY);
+   m_vFlowVelocity.x = dRandX * INIT_MAX_SPEED_GUESS;
+   m_vFlowVelocity.y = dRandY * INIT_MAX_SPEED_GUESS;
 
    // Set these to zero
    m_vDWFlowVelocity.x =
@@ -354,5 +362,6 @@ double CCellSurfaceWater::dGetFrictionFactor(void) const
 double CCellSurfaceWater::dGetFroude(double const dG) const
 {
    // Divide by 1e3 in each case because in mm/sec and mm, need them in m/sec and m
-   return ((m_dSurfaceWaterDepth > 0) ? m_vFlowVelocity.dToScalar() * 1e-3 / sqrt(m_dSurfaceWaterDepth * dG * 1e-3) : 0);
+   double dDepth = CCell::m_pGrid->dGetSurfaceWaterDepth(pCell->nGetGridIndex());
+   return ((dDepth > 0) ? m_vFlowVelocity.dToScalar() * 1e-3 / sqrt(dDepth * dG * 1e-3) : 0);
 }
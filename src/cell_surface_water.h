@@ -27,17 +27,10 @@ public:
    static CSimulation* m_pSim;
 
 private:
-   //! Flow direction
-   int m_nFlowDirection;
-   
    //! For Lawrence friction factor approach: 0 = dry, 1 = shallow flow, 2 = marginally inundated, 3 = well inundated
    int m_nInundationClass;                          
 
-   //! Water on soil surface as a depth (mm)
-   double m_dSurfaceWaterDepth;    
-   
-   //! Temporary depth of water (mm) on soil surface, is a transaction field used during rill erosion calculations
-   double m_dTmpSurfaceWaterDepth;
+   // Note that flow direction, surface water depth and temporary surface water depth are held in the grid store, not here
 
    //! Cumulative depth of water on soil surface (mm)
    double m_dCumulSurfaceWaterDepth;                 
@@ -106,7 +99,7 @@ public:
    double dGetSurfaceWaterLost(void) const;
    double dGetCumulSurfaceWaterLost(void) const;
 
-   void InitializeAllFlowVelocity(void);
+   void InitializeAllFlowVelocity(int const);
    void ZeroAllFlowVelocity(void);
    void SetFlowVelocity(const C2DVec&);
    void SetFlowVelocity(const C2DVec*);
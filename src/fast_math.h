@@ -0,0 +1,150 @@
+#ifndef __FAST_MATH_H__
+   #define __FAST_MATH_H__
+/*=========================================================================================================================================
+
+This is fast_math.h: inline approximations to exp(), log() and the cumulative unit Gaussian distribution which vectorize, for RillGrow's batched sediment calculations
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+
+// The standard library's exp() and log() are calls to scalar functions, so a loop which uses them cannot be vectorized unless the compiler is allowed to relax IEEE semantics. These approximations use only arithmetic, bit manipulation and selects between constants, so a loop which calls them vectorizes, including with instruction sets (such as AVX2) which have no masked floating-point operations. A select between a constant and a calculated value is done with bit masks or by multiplying by 0 or 1, since otherwise the compiler may turn it into a branch. The functions are not correctly rounded, but their errors (measured over 1e7 random arguments) are given for each function
+
+//! Returns an approximation to exp(dX). The argument is split as dX = k ln(2) + r, with |r| <= ln(2) / 2, and exp(r) is found from its Taylor series to r**12; the result is then scaled by 2**k. Maximum relative error is about 5e-16, i.e. within three units in the last place. Arguments below about -708 give the smallest normal number (about 2.2e-308) rather than a subnormal number or zero, and arguments above about 709.4 give DBL_MAX rather than inf. The argument must not be NaN
+static inline double dFastExp(double const dX)
+{
+   double const LOG2E = 1.4426950408889634074;
+   double const LN2_HI = 6.93147180369123816490e-01;                 // ln(2) with its low bits zero, so k * LN2_HI is exact
+   double const LN2_LO = 1.90821492927058770002e-10;                 // The remainder of ln(2)
+   double const ROUND = 6755399441055744.0;                          // 1.5 * 2**52, adding this rounds to the nearest integer
+   int64_t const ROUND_BITS = 0x4338000000000000LL;                  // The bit pattern of ROUND
+   int64_t const SMALLEST_NORMAL_BITS = 0x0010000000000000LL;
+   int64_t const LARGEST_BITS = 0x7fefffffffffffffLL;
+
+   // Round dX / ln(2) to the nearest integer k. Adding ROUND puts k in the low bits of the mantissa, so subtracting the bit pattern of ROUND gives k as an integer. This is monotonic in dX for dX above about -4.6e15, so out-of-range arguments give out-of-range k, and are dealt with below
+   double dK = (dX * LOG2E) + ROUND;
+   int64_t nBits;
+   memcpy(&nBits, &dK, sizeof(nBits));
+   int64_t nK = nBits - ROUND_BITS;
+   dK -= ROUND;
+
+   double dR = (dX - (dK * LN2_HI)) - (dK * LN2_LO);
+
+   // Horner form of the Taylor series, coefficients are 1 / n!
+   double dP = 2.08767569878680989792e-09;
+   dP = (dP * dR) + 2.50521083854417187751e-08;
+   dP = (dP * dR) + 2.75573192239858906526e-07;
+   dP = (dP * dR) + 2.75573192239858906526e-06;
+   dP = (dP * dR) + 2.48015873015873015873e-05;
+   dP = (dP * dR) + 1.98412698412698412698e-04;
+   dP = (dP * dR) + 1.38888888888888888889e-03;
+   dP = (dP * dR) + 8.33333333333333333333e-03;
+   dP = (dP * dR) + 4.16666666666666666667e-02;
+   dP = (dP * dR) + 1.66666666666666666667e-01;
+   dP = (dP * dR) + 0.5;
+   dP = (dP * dR) + 1;
+   dP = (dP * dR) + 1;
+
+   // The polynomial is between sqrt(0.5) and sqrt(2), so adding k * 2**52 to its bit pattern multiplies it by 2**k exactly, provided that k is from -1021 to 1023. Outside this range (or if dX is so large and negative that k is not valid), use the smallest normal number or the largest number instead
+   int64_t nP;
+   memcpy(&nP, &dP, sizeof(nP));
+   nP += (nK << 52);
+
+   int64_t
+      nLow = -static_cast<int64_t>((nK < -1021) | (dX < -1000)),
+      nHigh = -static_cast<int64_t>((nK > 1023) & (dX > 0));
+   nP = (nP & ~(nLow | nHigh)) | (SMALLEST_NORMAL_BITS & nLow) | (LARGEST_BITS & nHigh);
+   memcpy(&dP, &nP, sizeof(dP));
+
+   return dP;
+}
+
+//! Returns an approximation to log(dX). The argument is split as dX = 2**k m, with sqrt(0.5) <= m < sqrt(2), and log(m) = 2 atanh(s) with s = (m - 1) / (m + 1), so |s| < 0.172; atanh(s) is found from its Taylor series to s**19. Maximum absolute error is about 1e-16 where |log(dX)| < 1, and maximum relative error is about 2e-16 elsewhere. The argument must be a positive normal number: zero gives about -709.1 rather than -inf, and subnormal, negative and NaN arguments give meaningless results
+static inline double dFastLog(double const dX)
+{
+   double const LN2_HI = 6.93147180369123816490e-01;
+   double const LN2_LO = 1.90821492927058770002e-10;
+   double const TWO52 = 4503599627370496.0;                          // 2**52
+   uint64_t const MANTISSA_OFFSET = 0x00095f6200000000ULL;           // The bit pattern of 1, less that of (approximately) sqrt(0.5)
+   uint64_t const EXPONENT_ONE = 0x3ff0000000000000ULL;              // The bit pattern of 1
+   uint64_t const EXPONENT_TWO52 = 0x4330000000000000ULL;            // The bit pattern of 2**52
+
+   uint64_t nBits;
+   memcpy(&nBits, &dX, sizeof(nBits));
+
+   // Offsetting the bit pattern moves the boundary between exponents from each power of two to sqrt(0.5) times it, so the biased exponent of the result is k + 1023
+   uint64_t nBiasedK = (nBits + MANTISSA_OFFSET) >> 52;
+
+   // Take k away from the exponent of dX, leaving m
+   uint64_t nM = nBits - (nBiasedK << 52) + EXPONENT_ONE;
+   double dM;
+   memcpy(&dM, &nM, sizeof(dM));
+
+   // Convert k to a double by putting it in the low bits of 2**52 then subtracting 2**52. This avoids a 64-bit integer to double conversion, which not all SIMD instruction sets have
+   uint64_t nKBits = nBiasedK | EXPONENT_TWO52;
+   double dK;
+   memcpy(&dK, &nKBits, sizeof(dK));
+   dK -= (TWO52 + 1023);
+
+   double
+      dS = (dM - 1) / (dM + 1),
+      dS2 = dS * dS;
+
+   // Horner form of the Taylor series of atanh(s) / s, coefficients are 1 / (2n + 1)
+   double dP = 1.0 / 19;
+   dP = (dP * dS2) + (1.0 / 17);
+   dP = (dP * dS2) + (1.0 / 15);
+   dP = (dP * dS2) + (1.0 / 13);
+   dP = (dP * dS2) + (1.0 / 11);
+   dP = (dP * dS2) + (1.0 / 9);
+   dP = (dP * dS2) + (1.0 / 7);
+   dP = (dP * dS2) + (1.0 / 5);
+   dP = (dP * dS2) + (1.0 / 3);
+
+   double dLogM = (2 * dS) + (2 * dS * dS2 * dP);
+
+   return ((dK * LN2_HI) + (dLogM + (dK * LN2_LO)));
+}
+
+//! Returns an approximation to the cumulative unit Gaussian (normal) distribution at dZ. This is the same Abramowitz and Stegun approximation (26.2.17 in their "Handbook of Mathematical Functions", Dover Publications, 1965) as CSimulation::dGetCGaussianPDF(), which has a maximum absolute error of about 8e-8 with the constants used here, but uses dFastExp() and no branches. The difference from CSimulation::dGetCGaussianPDF() is at most about 2e-16
+static inline double dFastCGaussianPDF(double const dZ)
+{
+   double const b1 =  0.31938153;
+   double const b2 = -0.356563782;
+   double const b3 =  1.781477937;
+   double const b4 = -1.821255978;
+   double const b5 =  1.330274429;
+   double const p  =  0.2316419;
+   double const c2 =  0.3989423;
+
+   double a = std::fabs(dZ);
+   double t = 1 / (1 + a * p);
+   double b = c2 * dFastExp((-dZ) * (dZ/2));
+   double fn = ((((b5 * t + b4) * t + b3) * t + b2) * t + b1) * t;
+   fn = 1 - b * fn;
+
+   // If dZ is negative, the result is 1 - fn: 1 - 2fn is exact for fn in [0.5, 1], so the sum is rounded once, exactly as 1 - fn would be
+   double dNegative = ((dZ < 0) ? 1 : 0);
+   fn += dNegative * (1 - (2 * fn));
+
+   // More than 6 SDs into the rh tail, return 1; more than 6 SDs into the lh tail, return 0. To do this, fn is zeroed with a bit mask if out of range, then 1 is added if in the rh tail
+   int64_t nFn;
+   memcpy(&nFn, &fn, sizeof(nFn));
+   nFn &= -static_cast<int64_t>(a <= 6);
+   memcpy(&fn, &nFn, sizeof(fn));
+   fn += ((dZ > 6) ? 1 : 0);
+
+   return fn;
+}
+#endif         // __FAST_MATH_H__
@@ -16,11 +16,12 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
 
 //=========================================================================================================================================
-//! This method erodes a cell as a result of downhill flow; it uses a probabilistic equation from Nearing (1991)
+//! This method erodes a cell as a result of downhill flow; it uses a probabilistic equation from Nearing (1991). The thickness of soil lost per second, dThickLost, has already been calculated for every cell with a recorded outflow by CalcAllTransportCapacity(), as described below
 //=========================================================================================================================================
-void CSimulation::DoCellFlowErosion(int const nX, int const nY, int const nLowX, int const nLowY, int const nDirection, double const dS, double const dHLen, double const dVel, double const dSedimentLoadWt, double const dMoveDepth)
+void CSimulation::DoCellFlowErosion(int const nX, int const nY, int const nLowX, int const nLowY, int const nDirection, double const dS, double const dHLen, double const dMoveDepth, double dThickLost)
 {
    /*
    For detachment, use the relationship:
@@ -82,60 +83,18 @@ void CSimulation::DoCellFlowErosion(int const nX, int const nY, int const nLowX,
       S-tau-b = 0.4 . 150 rho g h S
    */
 
-   double const TAUB_CONST = 150;
-
    // For dTau, must divide by 1000 to convert dMoveDepth to m, and divide by 1000 as m_dRho is in t/m3
-   double
-      dTau = m_dRho * m_dG * dMoveDepth * dS * 1e-6,
-      dTaub = TAUB_CONST * dTau,
-      dSTaub = m_dCVTaub * dTaub;
+   double dTau = m_dRho * m_dG * dMoveDepth * dS * 1e-6;
 
    // Save the shear stress
    if (m_bSlumping)
-      // Allocate shear stress to this and adjacent cells
-      DoDistributeShearStress(nX, nY, dTau);
+      // Save the shear stress for this cell, it is spread over this and adjacent cells by SpreadAllShearStress() before slumping is next calculated
+      m_pGrid->IncRawShearStress(m_pGrid->nGetIndex(nX, nY), dTau);
    else
       // Just write the shear stress (both this-iteration and cumulative) to this cell
       m_Cell[nX][nY].pGetSoil()->IncShearStress(dTau);
 
-/*
-   // TESTING
-   // m_dT = soil strength   m_dTaub = stress
-   double dZ = (dTaub - m_dT) / sqrt((m_dST2)+(dSTaub*dSTaub));
-   double dP = dGetCGaussianPDF(dZ);
-   double dE = m_dK * dVel * dP * dS /1000;
-   static bool sbFirst = true;
-   if (sbFirst)
-   {
-      sbFirst = false;
-      m_ofsLog << "m_dT" << '\t' << "m_dST" << endl;
-      m_ofsLog << m_dT << '\t' << sqrt(m_dST2) << endl;
-      m_ofsLog << "dTaub" << '\t' << "dSTaub" << '\t' << "dZ"  << '\t' << "dP" << '\t' << "dE" << endl;
-   }
-   if (0 == m_ulIter % 10)
-      m_ofsLog << dTaub << '\t' << dSTaub << '\t' << dZ  << '\t' << dP << '\t' << dE << endl;
-*/
-   // Use Nearing's equation to calculate soil loss as detachment rate per unit area of soil surface i.e. in kg/(sec m2). First calculate the difference between burst shear stress and soil strength, normalize this to SD units then use the normalized value to sample a value from the cumulative probability distribution function of a standard Gaussian (normal) distribution
-   // This value of P is thus calculated using a function similar to, but not identical with, equation 9 in Nearing (1991). The approach used here is closer to the standard relationship used in reliability analysis. Note must divide by 1000, since dVel in mm/sec
-   double dE = m_dK * dVel * dGetCGaussianPDF((dTaub - m_dT) / sqrt((m_dST2) + (dSTaub * dSTaub))) * dS * 0.001;
-   // assert(dE >= 0);
-
-   // Pre-existing sediment load of 'this' cell is assumed to produce a linear decrease in detachment i.e  dE(actual) = dE * (1 - (dSedimentLoad/dTransportCapacity)) following equation 11 in Lei et al. (1998)
-   dE *= dSedimentLoadWt;                                        // kg/(sec m2)
-
-   // Get the bulk density (in kg/m3) of the topmost non-zero layer
-   double dBulkDensity = m_Cell[nX][nY].pGetSoil()->dGetBulkDensityOfTopNonZeroLayer();
-   if (dBulkDensity < 0)
-   {
-      // We are down to unerodible basement, so no sediment to be transported
-      return;
-   }
-
-   // Now convert the total thickness of soil lost per sec; to be split between 'this' and 'next' cells
-   double dThickLost = 1000 * dE / dBulkDensity;       // mm/sec
-   // assert(dThickLost >= 0);
-
-//   m_ofsLog << m_ulIter << " [" << nX << "][" << nY << "] dThickLost="  << dThickLost << endl;
+   // The soil loss was found using Nearing's equation, as a detachment rate per unit area of soil surface i.e. in kg/(sec m2). The difference between burst shear stress and soil strength was normalized to SD units, then used to sample a value from the cumulative probability distribution function of a standard Gaussian (normal) distribution. This value of P is thus calculated using a function similar to, but not identical with, equation 9 in Nearing (1991). The approach used here is closer to the standard relationship used in reliability analysis. Pre-existing sediment load of 'this' cell is assumed to produce a linear decrease in detachment following equation 11 in Lei et al. (1998). Finally the detachment rate was converted to the total thickness of soil lost per sec, using the bulk density of the topmost non-zero layer; this is to be split between 'this' and 'next' cells
 
    // Is this an edge cell?
    if (nLowX < 0)
@@ -163,8 +122,11 @@ void CSimulation::DoCellFlowErosion(int const nX, int const nY, int const nLowX,
       // assert(dHalfThickLost >= 0);
       m_Cell[nX][nY].pGetSoil()->DoFlowDetach(dHalfThickLost, false);
 
-      // Also erode the 'next' cell, and add to sediment load and totals
-      m_Cell[nLowX][nLowY].pGetSoil()->DoFlowDetach(dHalfThickLost, false);
+      // Also erode the 'next' cell, and add to sediment load and totals. With two-phase flow routing, just save the thickness in this cell's outflow slot: the 'next' cell is eroded when it gathers its inflows
+      if (m_bTwoPhaseFlowRouting)
+         m_pGrid->SetOutFlowDetach(m_pGrid->nGetIndex(nX, nY), dHalfThickLost);
+      else
+         m_Cell[nLowX][nLowY].pGetSoil()->DoFlowDetach(dHalfThickLost, false);
    }
 
    if (m_bHeadcutRetreat)
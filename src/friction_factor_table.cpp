@@ -0,0 +1,350 @@
+/*=========================================================================================================================================
+
+This is friction_factor_table.cpp: implementations of the RillGrow class which provides lookup tables of Darcy-Weisbach friction factors
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <cmath>
+
+#include "rg.h"
+#include "friction_factor_table.h"
+
+/*=========================================================================================================================================
+
+The Cheng (2008) friction factor needs five pow() and two log() calls, and the deep-flow Lawrence (1997) friction factor needs a pow() and a log(). Here these are instead found by linear interpolation in tables which are made once, at the start of the run. The Cheng table is 2-D, in Reynolds' number and relative roughness (hydraulic diameter / roughness height); the Lawrence table is 1-D, in lambda (depth / roughness).
+
+The nodes of each table are evenly spaced in an approximation of log2, which is exact at powers of two and linear in between: this spreads nodes evenly over many orders of magnitude, but finding the position of a value needs only frexp(), i.e. no logarithms. The number of nodes per octave starts small and is doubled until the largest relative error of interpolated values, measured half way between every pair of adjacent nodes, is no more than that asked for by the user.
+
+Values which are outside a table (e.g. near the singularity in the Cheng formula when the hydraulic diameter is about a quarter of the roughness height, and at very small Reynolds' numbers) are calculated using the exact formula.
+
+=========================================================================================================================================*/
+
+//! Constructor
+CFrictionFactorTable::CFrictionFactorTable(void)
+:
+   m_bCheng(false),
+   m_nChengNodesPerOctave(0),
+   m_nChengReNodes(0),
+   m_nChengRelRoughNodes(0),
+   m_dChengReAxisMin(0),
+   m_dChengRelRoughAxisMin(0),
+   m_dChengMeasuredErr(0),
+   m_bLawrence(false),
+   m_nLawrenceNodesPerOctave(0),
+   m_nLawrenceNodes(0),
+   m_dLawrenceAxisMin(0),
+   m_dLawrenceMeasuredErr(0)
+{
+}
+
+//! Returns the position of a value on a table axis. This is an approximation of log2 which is exact when the value is a power of two, and linear in between
+double CFrictionFactorTable::dGetAxis(double const dValue)
+{
+   int nExp;
+   double dMantissa = frexp(dValue, &nExp);         // dValue = dMantissa * 2**nExp, with dMantissa in [0.5, 1)
+
+   return ((nExp - 2) + (2 * dMantissa));
+}
+
+//! Returns the value at this position on a table axis, i.e. is the inverse of dGetAxis()
+double CFrictionFactorTable::dGetFromAxis(double const dAxis)
+{
+   double dFloor = floor(dAxis);
+
+   return ldexp(1 + (dAxis - dFloor), static_cast<int>(dFloor));
+}
+
+//! Calculates the Cheng friction factor using the exact formula, given the Reynolds' number, the hydraulic diameter (m) and the effective roughness height (m). The result may be NaN
+double CFrictionFactorTable::dCalcChengFrictionFactor(double const dRe, double const dD, double const dEps)
+{
+   // From Cheng, Nian-Sheng (September 2008). "Formulas for Friction Factor in Transitional Regimes". Journal of Hydraulic Engineering. 134 (9): 1357–1362. doi:10.1061/(asce)0733-9429(2008)134:9(1357). hdl:10220/7647. ISSN 0733-9429.
+
+   // See also https://en.wikipedia.org/wiki/Talk%3ADarcy_friction_factor_formulae " I feel like it's overstating that the equation from Bellos et al., 2018 is the only one formula, among others in this wiki article, works for open-channel flow. The most naive way to work with open-channel flow is to use the hydraulic diameter of an open channel in formulas of closed pipe flows. As no validation (i.e., against experimental data) is available, no one can really say the most naive approach is not working, In this sense, it may be too much to say Bellos et al., 2018 is the only one working with open channels."
+   double dParamA = 1 / (1 + pow((dRe / 2720), 9));
+   double dParamB = 1 / (1 + pow((dRe / (160 * (dD / dEps) )  ), 2));
+
+   double dTerm1 = pow((dRe / 64), dParamA);
+   double dTerm2 = pow((1.8 * log(dRe / 6.8)), (2 * (1 - dParamA) * dParamB));
+   double dTerm3 = pow((2.0 * log((3.7 * dD) / dEps)), (2 * (1 - dParamA) * (1 - dParamB)));
+
+   // Safety check
+   if (isnan(dTerm3))
+   {
+      // This is the most common value of dTerm3 TODO improve this
+      dTerm3 = 1;
+   }
+
+   return (1 / (dTerm1 * dTerm2 * dTerm3));
+}
+
+//! Calculates the Lawrence friction factor for well-inundated flow using the exact formula, given lambda (depth / roughness). This is equation 12 in Lawrence (1997)
+double CFrictionFactorTable::dCalcLawrenceDeepFrictionFactor(double const dLambda)
+{
+   double const
+      DEEP_FLOW_CONST_A = 1.64,
+      DEEP_FLOW_CONST_B = 0.803;
+
+   return pow(DEEP_FLOW_CONST_A + (DEEP_FLOW_CONST_B * log(dLambda)), 2);
+}
+
+//! Interpolates in the Cheng table, given positions along each axis (in nodes from the first node)
+double CFrictionFactorTable::dInterpolateCheng(double const dRePos, double const dRelRoughPos) const
+{
+   int
+      i = tMin(static_cast<int>(dRePos), m_nChengReNodes - 2),
+      j = tMin(static_cast<int>(dRelRoughPos), m_nChengRelRoughNodes - 2);
+   double
+      dFracRe = dRePos - i,
+      dFracRelRough = dRelRoughPos - j;
+
+   double const* pdLow = &m_VdCheng[(i * m_nChengRelRoughNodes) + j];
+   double const* pdHigh = pdLow + m_nChengRelRoughNodes;
+
+   double
+      dLow = pdLow[0] + (dFracRelRough * (pdLow[1] - pdLow[0])),
+      dHigh = pdHigh[0] + (dFracRelRough * (pdHigh[1] - pdHigh[0]));
+
+   return (dLow + (dFracRe * (dHigh - dLow)));
+}
+
+//! Interpolates in the Lawrence table, given a position along the axis (in nodes from the first node)
+double CFrictionFactorTable::dInterpolateLawrence(double const dPos) const
+{
+   int i = tMin(static_cast<int>(dPos), m_nLawrenceNodes - 2);
+   double dFrac = dPos - i;
+
+   return (m_VdLawrence[i] + (dFrac * (m_VdLawrence[i+1] - m_VdLawrence[i])));
+}
+
+//! Makes the Cheng table, for Reynolds' numbers from FF_TABLE_CHENG_RE_MIN to dReMax and relative roughnesses from FF_TABLE_CHENG_REL_ROUGHNESS_MIN to dRelRoughMax. Returns false if the maximum relative error cannot be achieved within FF_TABLE_MAX_NODES nodes, in which case the exact formula is always used
+bool CFrictionFactorTable::bInitCheng(double const dReMax, double const dRelRoughMax, double const dMaxRelErr)
+{
+   m_bCheng = false;
+   m_VdCheng.clear();
+
+   m_dChengReAxisMin = floor(dGetAxis(FF_TABLE_CHENG_RE_MIN));
+   m_dChengRelRoughAxisMin = floor(dGetAxis(FF_TABLE_CHENG_REL_ROUGHNESS_MIN));
+
+   int
+      nReOctaves = tMax(static_cast<int>(ceil(dGetAxis(dReMax)) - m_dChengReAxisMin), 1),
+      nRelRoughOctaves = tMax(static_cast<int>(ceil(dGetAxis(dRelRoughMax)) - m_dChengRelRoughAxisMin), 1);
+
+   for (int nNodesPerOctave = FF_TABLE_MIN_NODES_PER_OCTAVE; ; nNodesPerOctave *= 2)
+   {
+      m_nChengNodesPerOctave = nNodesPerOctave;
+      m_nChengReNodes = (nReOctaves * nNodesPerOctave) + 1;
+      m_nChengRelRoughNodes = (nRelRoughOctaves * nNodesPerOctave) + 1;
+
+      if ((static_cast<double>(m_nChengReNodes) * m_nChengRelRoughNodes) > FF_TABLE_MAX_NODES)
+      {
+         m_VdCheng.clear();
+         return false;
+      }
+
+      // Calculate the friction factor at every node
+      m_VdCheng.resize(m_nChengReNodes * m_nChengRelRoughNodes);
+      double const dStep = 1.0 / nNodesPerOctave;
+      bool bOK = true;
+
+#if defined _OPENMP
+      #pragma omp parallel for schedule(static) reduction(&& : bOK)
+#endif
+      for (int i = 0; i < m_nChengReNodes; i++)
+      {
+         double dRe = dGetFromAxis(m_dChengReAxisMin + (i * dStep));
+         for (int j = 0; j < m_nChengRelRoughNodes; j++)
+         {
+            double dFF = dCalcChengFrictionFactor(dRe, dGetFromAxis(m_dChengRelRoughAxisMin + (j * dStep)), 1);
+            m_VdCheng[(i * m_nChengRelRoughNodes) + j] = dFF;
+
+            if (! std::isfinite(dFF))
+               bOK = false;
+         }
+      }
+
+      if (! bOK)
+      {
+         m_VdCheng.clear();
+         return false;
+      }
+
+      // Now measure the largest relative error, half way between adjacent nodes along each axis, and at the centre of each square of four nodes
+      double dMeasuredErr = 0;
+
+#if defined _OPENMP
+      #pragma omp parallel for schedule(static) reduction(max : dMeasuredErr)
+#endif
+      for (int i = 0; i < (2 * m_nChengReNodes) - 1; i++)
+      {
+         double
+            dRePos = 0.5 * i,
+            dRe = dGetFromAxis(m_dChengReAxisMin + (dRePos * dStep));
+
+         for (int j = 0; j < (2 * m_nChengRelRoughNodes) - 1; j++)
+         {
+            // Values at the nodes are exact
+            if ((i % 2 == 0) && (j % 2 == 0))
+               continue;
+
+            double
+               dRelRoughPos = 0.5 * j,
+               dExact = dCalcChengFrictionFactor(dRe, dGetFromAxis(m_dChengRelRoughAxisMin + (dRelRoughPos * dStep)), 1),
+               dErr = fabs(dInterpolateCheng(dRePos, dRelRoughPos) - dExact) / dExact;
+
+            dMeasuredErr = tMax(dMeasuredErr, dErr);
+         }
+      }
+
+      if (dMeasuredErr <= dMaxRelErr)
+      {
+         m_dChengMeasuredErr = dMeasuredErr;
+         m_bCheng = true;
+         return true;
+      }
+   }
+}
+
+//! Makes the Lawrence table, for lambda from FF_TABLE_LAWRENCE_LAMBDA_MIN to dLambdaMax. Returns false if the maximum relative error cannot be achieved within FF_TABLE_MAX_NODES nodes, in which case the exact formula is always used
+bool CFrictionFactorTable::bInitLawrence(double const dLambdaMax, double const dMaxRelErr)
+{
+   m_bLawrence = false;
+   m_VdLawrence.clear();
+
+   m_dLawrenceAxisMin = floor(dGetAxis(FF_TABLE_LAWRENCE_LAMBDA_MIN));
+   int nOctaves = tMax(static_cast<int>(ceil(dGetAxis(dLambdaMax)) - m_dLawrenceAxisMin), 1);
+
+   for (int nNodesPerOctave = FF_TABLE_MIN_NODES_PER_OCTAVE; ; nNodesPerOctave *= 2)
+   {
+      m_nLawrenceNodesPerOctave = nNodesPerOctave;
+      m_nLawrenceNodes = (nOctaves * nNodesPerOctave) + 1;
+
+      if (m_nLawrenceNodes > FF_TABLE_MAX_NODES)
+      {
+         m_VdLawrence.clear();
+         return false;
+      }
+
+      // Calculate the friction factor at every node
+      m_VdLawrence.resize(m_nLawrenceNodes);
+      double const dStep = 1.0 / nNodesPerOctave;
+
+      for (int i = 0; i < m_nLawrenceNodes; i++)
+      {
+         double dFF = dCalcLawrenceDeepFrictionFactor(dGetFromAxis(m_dLawrenceAxisMin + (i * dStep)));
+         if (! std::isfinite(dFF))
+         {
+            m_VdLawrence.clear();
+            return false;
+         }
+
+         m_VdLawrence[i] = dFF;
+      }
+
+      // Now measure the largest relative error, half way between adjacent nodes
+      double dMeasuredErr = 0;
+      for (int i = 0; i < m_nLawrenceNodes - 1; i++)
+      {
+         double
+            dPos = i + 0.5,
+            dExact = dCalcLawrenceDeepFrictionFactor(dGetFromAxis(m_dLawrenceAxisMin + (dPos * dStep))),
+            dErr = fabs(dInterpolateLawrence(dPos) - dExact) / dExact;
+
+         dMeasuredErr = tMax(dMeasuredErr, dErr);
+      }
+
+      if (dMeasuredErr <= dMaxRelErr)
+      {
+         m_dLawrenceMeasuredErr = dMeasuredErr;
+         m_bLawrence = true;
+         return true;
+      }
+   }
+}
+
+//! Returns the Cheng friction factor, given the Reynolds' number, the hydraulic diameter (m) and the effective roughness height (m). This is from the table if there is one and the values are within it, otherwise it is calculated using the exact formula
+double CFrictionFactorTable::dGetChengFrictionFactor(double const dRe, double const dD, double const dEps) const
+{
+   if (m_bCheng)
+   {
+      // Note that these comparisons are false if either value is NaN, so then the exact formula is used
+      double
+         dRePos = (dGetAxis(dRe) - m_dChengReAxisMin) * m_nChengNodesPerOctave,
+         dRelRoughPos = (dGetAxis(dD / dEps) - m_dChengRelRoughAxisMin) * m_nChengNodesPerOctave;
+
+      if ((dRePos >= 0) && (dRePos <= m_nChengReNodes - 1) && (dRelRoughPos >= 0) && (dRelRoughPos <= m_nChengRelRoughNodes - 1))
+         return dInterpolateCheng(dRePos, dRelRoughPos);
+   }
+
+   return dCalcChengFrictionFactor(dRe, dD, dEps);
+}
+
+//! Returns the Lawrence friction factor for well-inundated flow, given lambda. This is from the table if there is one and lambda is within it, otherwise it is calculated using the exact formula
+double CFrictionFactorTable::dGetLawrenceDeepFrictionFactor(double const dLambda) const
+{
+   if (m_bLawrence)
+   {
+      double dPos = (dGetAxis(dLambda) - m_dLawrenceAxisMin) * m_nLawrenceNodesPerOctave;
+
+      if ((dPos >= 0) && (dPos <= m_nLawrenceNodes - 1))
+         return dInterpolateLawrence(dPos);
+   }
+
+   return dCalcLawrenceDeepFrictionFactor(dLambda);
+}
+
+//! Returns true if the Cheng table is in use
+bool CFrictionFactorTable::bIsChengTable(void) const
+{
+   return m_bCheng;
+}
+
+//! Returns the number of nodes per octave of the Cheng table
+int CFrictionFactorTable::nGetChengNodesPerOctave(void) const
+{
+   return m_nChengNodesPerOctave;
+}
+
+//! Returns the total number of nodes in the Cheng table
+int CFrictionFactorTable::nGetChengTableSize(void) const
+{
+   return static_cast<int>(m_VdCheng.size());
+}
+
+//! Returns the maximum relative error of values interpolated in the Cheng table, as measured when the table was made
+double CFrictionFactorTable::dGetChengMeasuredErr(void) const
+{
+   return m_dChengMeasuredErr;
+}
+
+//! Returns true if the Lawrence table is in use
+bool CFrictionFactorTable::bIsLawrenceTable(void) const
+{
+   return m_bLawrence;
+}
+
+//! Returns the number of nodes per octave of the Lawrence table
+int CFrictionFactorTable::nGetLawrenceNodesPerOctave(void) const
+{
+   return m_nLawrenceNodesPerOctave;
+}
+
+//! Returns the total number of nodes in the Lawrence table
+int CFrictionFactorTable::nGetLawrenceTableSize(void) const
+{
+   return static_cast<int>(m_VdLawrence.size());
+}
+
+//! Returns the maximum relative error of values interpolated in the Lawrence table, as measured when the table was made
+double CFrictionFactorTable::dGetLawrenceMeasuredErr(void) const
+{
+   return m_dLawrenceMeasuredErr;
+}
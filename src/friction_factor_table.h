@@ -0,0 +1,92 @@
+#ifndef __FRICTION_FACTOR_TABLE_H__
+   #define __FRICTION_FACTOR_TABLE_H__
+/*=========================================================================================================================================
+
+This is friction_factor_table.h: declaration for the RillGrow class which provides lookup tables of Darcy-Weisbach friction factors
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <vector>
+using std::vector;
+
+class CFrictionFactorTable
+{
+private:
+   //! Cheng: true if the lookup table is in use
+   bool m_bCheng;
+
+   //! Cheng: the number of nodes per octave, on both axes
+   int m_nChengNodesPerOctave;
+
+   //! Cheng: the number of nodes on the Reynolds' number axis
+   int m_nChengReNodes;
+
+   //! Cheng: the number of nodes on the relative roughness axis
+   int m_nChengRelRoughNodes;
+
+   //! Cheng: the axis position (see dGetAxis()) of the first node on the Reynolds' number axis
+   double m_dChengReAxisMin;
+
+   //! Cheng: the axis position of the first node on the relative roughness axis
+   double m_dChengRelRoughAxisMin;
+
+   //! Cheng: the maximum relative error of interpolated values, as measured when the table was made
+   double m_dChengMeasuredErr;
+
+   //! Cheng: the friction factor at each node. This is Reynolds' number-major, i.e. all nodes for the first Reynolds' number, then all nodes for the next, etc.
+   vector<double> m_VdCheng;
+
+   //! Lawrence: true if the lookup table is in use
+   bool m_bLawrence;
+
+   //! Lawrence: the number of nodes per octave
+   int m_nLawrenceNodesPerOctave;
+
+   //! Lawrence: the number of nodes on the lambda axis
+   int m_nLawrenceNodes;
+
+   //! Lawrence: the axis position of the first node
+   double m_dLawrenceAxisMin;
+
+   //! Lawrence: the maximum relative error of interpolated values, as measured when the table was made
+   double m_dLawrenceMeasuredErr;
+
+   //! Lawrence: the friction factor at each node
+   vector<double> m_VdLawrence;
+
+   static double dGetAxis(double const);
+   static double dGetFromAxis(double const);
+   double dInterpolateCheng(double const, double const) const;
+   double dInterpolateLawrence(double const) const;
+
+public:
+   CFrictionFactorTable(void);
+
+   static double dCalcChengFrictionFactor(double const, double const, double const);
+   static double dCalcLawrenceDeepFrictionFactor(double const);
+
+   bool bInitCheng(double const, double const, double const);
+   bool bInitLawrence(double const, double const);
+
+   double dGetChengFrictionFactor(double const, double const, double const) const;
+   double dGetLawrenceDeepFrictionFactor(double const) const;
+
+   bool bIsChengTable(void) const;
+   int nGetChengNodesPerOctave(void) const;
+   int nGetChengTableSize(void) const;
+   double dGetChengMeasuredErr(void) const;
+   bool bIsLawrenceTable(void) const;
+   int nGetLawrenceNodesPerOctave(void) const;
+   int nGetLawrenceTableSize(void) const;
+   double dGetLawrenceMeasuredErr(void) const;
+};
+#endif         // __FRICTION_FACTOR_TABLE_H__
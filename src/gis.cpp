@@ -19,7 +19,9 @@ using std::stringstream;
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
 #include "2d_vec.h"
+#include "gis_writer.h"
 
 //=========================================================================================================================================
 //! Reads the microtopgraphy DEM data to the cell array, also set each cell's basement elevation
@@ -212,6 +214,25 @@ int CSimulation::nReadMicrotopographyDEMData(void)
       }
    }
 
+   // Now create the grid store, this holds the frequently-accessed per-cell fields as contiguous arrays
+   m_pGrid = new CGridStore;
+   if ((NULL == m_pGrid) || (! m_pGrid->bAllocate(m_nXGridMax, m_nYGridMax)))
+   {
+      // Error, can't allocate memory
+      cerr << ERR << "cannot allocate memory for " << m_nXGridMax << " x " << m_nYGridMax << " grid store" << endl;
+      return (RTN_ERR_MEMALLOC);
+   }
+
+   // Set the shared pointer to the grid store, then tell each cell object where its fields are in the grid store
+   CCell::m_pGrid = m_pGrid;
+   for (int nX = 0; nX < m_nXGridMax; nX++)
+   {
+      for (int nY = 0; nY < m_nYGridMax; nY++)
+      {
+         m_Cell[nX][nY].SetGridIndex(m_pGrid->nGetIndex(nX, nY));
+      }
+   }
+
    // Allocate memory for a 1D floating-point array, to hold the scan line for GDAL
    float* pfScanline;
    pfScanline = new float[m_nXGridMax];
@@ -271,12 +292,18 @@ int CSimulation::nReadMicrotopographyDEMData(void)
 
          // Also set the per-cell basement elevation. At this stage it is the same for every cell. But if the user has specified an overall gradient, then we will impose this overall gradient on the per-cell values
          m_Cell[i][j].SetBasementElevation(m_dBasementElevation);
+
+         // And flag missing values in the grid store
+         m_pGrid->SetMissing(m_pGrid->nGetIndex(i, j), bFpEQ(dElev, m_dMissingValue, TOLERANCE));
       }
    }
 
    // Get rid of memory allocated to this array
    delete [] pfScanline;
 
+   // The active-cell mask is now complete, so build the list of spans of active cells which the per-iteration sweeps use
+   m_pGrid->BuildActiveSpans();
+
    // Calculate average elevation
    m_dAvgElev /= nRead;
 
@@ -601,6 +628,13 @@ bool CSimulation::bCheckGISOutputFormat(void)
       return (false);
    }
 
+   // Check the creation options, if any, against the options which this driver accepts
+   if (! bCheckGISCreationOptions(pDriver, m_VstrGISCreationOptions, false))
+   {
+      cerr << ERR << "Cannot write GIS files using GDAL driver '" << m_strGISOutFormat << "' with the GIS creation options given. Check the options which this driver accepts using 'gdalinfo --format " << m_strGISOutFormat << "'." << endl;
+      return (false);
+   }
+
    // This driver is OK, so store its longname and the default file extension
    m_strGDALOutputDriverLongname = CSLFetchNameValue(papszMetadata, "DMD_LONGNAME");
    m_strGDALOutputDriverExtension = CSLFetchNameValue(papszMetadata, "DMD_EXTENSION");
@@ -609,171 +643,227 @@ bool CSimulation::bCheckGISOutputFormat(void)
 }
 
 //=========================================================================================================================================
-//! Writes floating point GIS files using GDAL, using data from the cell array
+//! Checks that each of the GDAL creation options in VstrOptions is NAME=VALUE, and that this GDAL driver accepts it (i.e. it is in the driver's DMD_CREATIONOPTIONLIST, with a valid value). If bQuiet is false, the reasons for rejecting any option are written to cerr
 //=========================================================================================================================================
-bool CSimulation::bWriteGISFileFloat(int const nDataItem, string const* pstrPlotTitle)
+bool CSimulation::bCheckGISCreationOptions(GDALDriver* pDriver, vector<string> const& VstrOptions, bool const bQuiet)
 {
-   // Increment file number when soil loss file is written (this is done first, and is always saved)
-   if (GIS_CUMUL_ALL_SIZE_FLOW_DETACH == nDataItem)
-      m_nGISSave++;
+   if (VstrOptions.empty())
+      return true;
 
-   // Now begin constructing the file name for this save
-   string strFilDat = m_strOutputPath;
+   for (unsigned int n = 0; n < VstrOptions.size(); n++)
+   {
+      size_t nPos = VstrOptions[n].find('=');
+      if ((nPos == string::npos) || (0 == nPos))
+      {
+         if (! bQuiet)
+            cerr << ERR << "GIS creation option '" << VstrOptions[n] << "' is not of the form NAME=VALUE" << endl;
+         return false;
+      }
+   }
+
+   if (NULL == pDriver->GetMetadataItem(GDAL_DMD_CREATIONOPTIONLIST))
+   {
+      if (! bQuiet)
+         cerr << ERR << "GDAL driver '" << pDriver->GetDescription() << "' does not accept any creation options" << endl;
+      return false;
+   }
+
+   // GDAL reports the reason for rejecting any option as a warning
+   char** papszOptions = CGISWriter::papszGetGDALOptions(VstrOptions);
+   if (bQuiet)
+      CPLPushErrorHandler(CPLQuietErrorHandler);
+   bool bOK = (FALSE != GDALValidateCreationOptions(static_cast<GDALDriverH>(pDriver), papszOptions));
+   if (bQuiet)
+      CPLPopErrorHandler();
+   CSLDestroy(papszOptions);
+
+   return bOK;
+}
+
+//=========================================================================================================================================
+//! Returns the short name of this data item, this begins the names of its GIS files
+//=========================================================================================================================================
+string CSimulation::strGetGISItemName(int const nDataItem)
+{
+   string strName;
 
    switch (nDataItem)
    {
       case (GIS_CUMUL_RAIN) :
-         strFilDat.append(GIS_CUMUL_RAIN_FILENAME);
+         strName = GIS_CUMUL_RAIN_FILENAME;
          break;
 
       case (GIS_RAIN_SPATIAL_VARIATION) :
-         strFilDat.append(GIS_RAIN_SPATIAL_VARIATION_FILENAME);
+         strName = GIS_RAIN_SPATIAL_VARIATION_FILENAME;
          break;
 
       case (GIS_CUMUL_RUNON) :
-         strFilDat.append(GIS_CUMUL_RUNON_FILENAME);
+         strName = GIS_CUMUL_RUNON_FILENAME;
          break;
 
       case (GIS_ELEVATION) :
-         strFilDat.append(GIS_ELEVATION_FILENAME);
+         strName = GIS_ELEVATION_FILENAME;
          break;
 
       case (GIS_DETREND_ELEVATION) :
-         strFilDat.append(GIS_DETREND_ELEVATION_FILENAME);
+         strName = GIS_DETREND_ELEVATION_FILENAME;
          break;
 
       case (GIS_SURFACE_WATER_DEPTH) :
-         strFilDat.append(GIS_SURFACE_WATER_DEPTH_FILENAME);
+         strName = GIS_SURFACE_WATER_DEPTH_FILENAME;
          break;
 
       case (GIS_ALL_SIZE_FLOW_DETACH) :
-         strFilDat.append(GIS_ALL_SIZE_FLOW_DETACH_FILENAME);
+         strName = GIS_ALL_SIZE_FLOW_DETACH_FILENAME;
          break;
 
       case (GIS_INFILT) :
-         strFilDat.append(GIS_INFILT_FILENAME);
+         strName = GIS_INFILT_FILENAME;
          break;
 
       case (GIS_CUMUL_INFILT) :
-         strFilDat.append(GIS_CUMUL_INFILT_FILENAME);
+         strName = GIS_CUMUL_INFILT_FILENAME;
          break;
 
       case (GIS_SOIL_WATER) :
-         strFilDat.append(GIS_SOIL_WATER_FILENAME);
+         strName = GIS_SOIL_WATER_FILENAME;
          break;
 
       case (GIS_INFILT_DEPOSIT) :
-         strFilDat.append(GIS_INFILT_DEPOSIT_FILENAME);
+         strName = GIS_INFILT_DEPOSIT_FILENAME;
          break;
 
       case (GIS_CUMUL_INFILT_DEPOSIT) :
-         strFilDat.append(GIS_CUMUL_INFILT_DEPOSIT_FILENAME);
+         strName = GIS_CUMUL_INFILT_DEPOSIT_FILENAME;
          break;
 
       case (GIS_TOP_SURFACE_DETREND) :
-         strFilDat.append(GIS_TOP_SURFACE_DETREND_FILENAME);
+         strName = GIS_TOP_SURFACE_DETREND_FILENAME;
          break;
 
       case (GIS_SPLASH) :
-         strFilDat.append(GIS_SPLASH_FILENAME);
+         strName = GIS_SPLASH_FILENAME;
          break;
 
       case (GIS_CUMUL_SPLASH) :
-         strFilDat.append(GIS_CUMUL_SPLASH_FILENAME);
+         strName = GIS_CUMUL_SPLASH_FILENAME;
          break;
 
       case (GIS_SURFACE_WATER_SPEED) :
-         strFilDat.append(GIS_SURFACE_WATER_SPEED_FILENAME);
+         strName = GIS_SURFACE_WATER_SPEED_FILENAME;
          break;
 
       case (GIS_SURFACE_WATER_DW_SPEED) :
-         strFilDat.append(GIS_SURFACE_WATER_DW_SPEED_FILENAME);
+         strName = GIS_SURFACE_WATER_DW_SPEED_FILENAME;
          break;
 
       case (GIS_AVG_SURFACE_WATER_FROM_EDGES) :
-         strFilDat.append(GIS_AVG_SURFACE_WATER_FROM_EDGES_FILENAME);
+         strName = GIS_AVG_SURFACE_WATER_FROM_EDGES_FILENAME;
          break;
 
       case (GIS_STREAMPOWER) :
-         strFilDat.append(GIS_STREAMPOWER_FILENAME);
+         strName = GIS_STREAMPOWER_FILENAME;
          break;
 
       case (GIS_SHEAR_STRESS) :
-         strFilDat.append(GIS_SHEAR_STRESS_FILENAME);
+         strName = GIS_SHEAR_STRESS_FILENAME;
          break;
 
       case (GIS_FRICTION_FACTOR) :
-         strFilDat.append(GIS_FRICTION_FACTOR_FILENAME);
+         strName = GIS_FRICTION_FACTOR_FILENAME;
          break;
 
       case (GIS_AVG_SHEAR_STRESS) :
-         strFilDat.append(GIS_AVG_SHEAR_STRESS_FILENAME);
+         strName = GIS_AVG_SHEAR_STRESS_FILENAME;
          break;
 
       case (GIS_REYNOLDS_NUMBER) :
-         strFilDat.append(GIS_REYNOLDS_NUMBER_FILENAME);
+         strName = GIS_REYNOLDS_NUMBER_FILENAME;
          break;
 
       case (GIS_FROUDE_NUMBER) :
-         strFilDat.append(GIS_FROUDE_NUMBER_FILENAME);
+         strName = GIS_FROUDE_NUMBER_FILENAME;
          break;
 
       case (GIS_TRANSPORT_CAPACITY) :
-         strFilDat.append(GIS_TRANSPORT_CAPACITY_FILENAME);
+         strName = GIS_TRANSPORT_CAPACITY_FILENAME;
          break;
 
       case (GIS_AVG_SURFACE_WATER_DEPTH) :
-         strFilDat.append(GIS_AVG_SURFACE_WATER_DEPTH_FILENAME);
+         strName = GIS_AVG_SURFACE_WATER_DEPTH_FILENAME;
          break;
 
       case (GIS_AVG_SURFACE_WATER_SPEED) :
-         strFilDat.append(GIS_AVG_SURFACE_WATER_SPEED_FILENAME);
+         strName = GIS_AVG_SURFACE_WATER_SPEED_FILENAME;
          break;
 
       case (GIS_AVG_SURFACE_WATER_DW_SPEED) :
-         strFilDat.append(GIS_AVG_SURFACE_WATER_DW_SPEED_FILENAME);
+         strName = GIS_AVG_SURFACE_WATER_DW_SPEED_FILENAME;
          break;
 
       case (GIS_CUMUL_ALL_SIZE_FLOW_DETACH) :
-         strFilDat.append(GIS_CUMUL_ALL_SIZE_FLOW_DETACH_FILENAME);
+         strName = GIS_CUMUL_ALL_SIZE_FLOW_DETACH_FILENAME;
          break;
 
       case (GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT) :
-         strFilDat.append(GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT_FILENAME);
+         strName = GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT_FILENAME;
          break;
 
       case (GIS_SEDIMENT_CONCENTRATION) :
-         strFilDat.append(GIS_SEDIMENT_CONCENTRATION_FILENAME);
+         strName = GIS_SEDIMENT_CONCENTRATION_FILENAME;
          break;
 
       case (GIS_SEDIMENT_LOAD) :
-         strFilDat.append(GIS_SEDIMENT_LOAD_FILENAME);
+         strName = GIS_SEDIMENT_LOAD_FILENAME;
          break;
 
       case (GIS_AVG_SEDIMENT_LOAD) :
-         strFilDat.append(GIS_AVG_SEDIMENT_LOAD_FILENAME);
+         strName = GIS_AVG_SEDIMENT_LOAD_FILENAME;
          break;
 
       case (GIS_CUMUL_SLUMP_DETACH) :
-         strFilDat.append(GIS_CUMUL_SLUMP_DETACH_FILENAME);
+         strName = GIS_CUMUL_SLUMP_DETACH_FILENAME;
          break;
 
       case (GIS_CUMUL_SLUMP_DEPOSIT) :
-         strFilDat.append(GIS_CUMUL_SLUMP_DEPOSIT_FILENAME);
+         strName = GIS_CUMUL_SLUMP_DEPOSIT_FILENAME;
          break;
 
       case (GIS_CUMUL_TOPPLE_DETACH) :
-         strFilDat.append(GIS_CUMUL_TOPPLE_DETACH_FILENAME);
+         strName = GIS_CUMUL_TOPPLE_DETACH_FILENAME;
          break;
 
       case (GIS_CUMUL_TOPPLE_DEPOSIT) :
-         strFilDat.append(GIS_CUMUL_TOPPLE_DEPOSIT_FILENAME);
+         strName = GIS_CUMUL_TOPPLE_DEPOSIT_FILENAME;
          break;
 
       case (GIS_CUMUL_ALL_PROC_SURF_LOWER) :
-         strFilDat.append(GIS_CUMUL_ALL_PROC_SURF_LOWER_FILENAME);
+         strName = GIS_CUMUL_ALL_PROC_SURF_LOWER_FILENAME;
+         break;
+
+      case (GIS_INUNDATION_REGIME) :
+         strName = GIS_INUNDATION_REGIME_FILENAME;
+         break;
+
+      case (GIS_SURFACE_WATER_DIRECTION) :
+         strName = GIS_SURFACE_WATER_DIRECTION_FILENAME;
+         break;
+
+      case (GIS_CUMUL_BINARY_HEADCUT_RETREAT) :
+         strName = GIS_CUMUL_BINARY_HEADCUT_RETREAT_FILENAME;
    }
 
+   return strName;
+}
+
+//=========================================================================================================================================
+//! Returns the name of a GIS file for this save, which begins with strName
+//=========================================================================================================================================
+string CSimulation::strGetGISFileName(string const& strName) const
+{
+   string strFilDat = m_strOutputPath;
+   strFilDat.append(strName);
+
    // Append the 'save number' to the filename, and prepend zeros to the save number
    strFilDat.append("_");
    stringstream ststrTmp;
@@ -787,539 +877,696 @@ bool CSimulation::bWriteGISFileFloat(int const nDataItem, string const* pstrPlot
       strFilDat.append(m_strGDALOutputDriverExtension);
    }
 
-   GDALDriver* pDriver;
-   pDriver = GetGDALDriverManager()->GetDriverByName(m_strGISOutFormat.c_str());
-   GDALDataset* pOutDataSet;
-   char** papszOptions = NULL;                                          // For driver-specific options
-   // TODO Get error message here from GDAL 3.0.4 "ERROR 1: Too large for int: 126327496704.000000" when opening for GIS_FRICTION_FACTOR, no idea why. Pushing and popping the error handler hides this message. Try removing with later version of GDAL
-   //CPLPushErrorHandler(CPLQuietErrorHandler);                  // needed to get next line to fail silently, if it fails
-   pOutDataSet = pDriver->Create(strFilDat.c_str(), m_nXGridMax, m_nYGridMax, 1, GDT_Float32, papszOptions);
-   //CPLPopErrorHandler();
-   if (NULL == pOutDataSet)
-   {
-      // Couldn't create file
-      cerr << ERR << "cannot create " << m_strGISOutFormat << " file named " << strFilDat << "\n" << CPLGetLastErrorMsg() << endl;
-      return false;
-   }
-
-   // Set projection info for output dataset (will be same as was read in from DEM)
-   CPLPushErrorHandler(CPLQuietErrorHandler);                           // Needed to get next line to fail silently, if it fails
-   pOutDataSet->SetProjection(m_strGDALDEMProjection.c_str());          // Will fail for some formats
-   CPLPopErrorHandler();
+   return strFilDat;
+}
 
-   // Set geotransformation info for output dataset (will be same as was read in from DEM)
-   if (CE_Failure == pOutDataSet->SetGeoTransform(m_dGeoTransform))
-      cerr << WARN << "cannot write geotransformation information to " << m_strGISOutFormat << " file named " << strFilDat << "\n" << CPLGetLastErrorMsg() << endl;
+//=========================================================================================================================================
+//! Returns the value units of the GIS file for this data item
+//=========================================================================================================================================
+string CSimulation::strGetGISUnits(int const nDataItem)
+{
+   string strUnits;
 
-   // Allocate memory for a 1D array, to hold the floating point raster band data for GDAL
-   float* pfRaster;
-   pfRaster = new float[m_nXGridMax * m_nYGridMax];
-   if (NULL == pfRaster)
+   switch (nDataItem)
    {
-      // Error, can't allocate memory
-      cerr << ERR << "cannot allocate memory for " << m_nXGridMax * m_nYGridMax << " x 1D floating-point array for " << m_strGISOutFormat << " file named " << strFilDat << endl;
-      return false;
+      case (GIS_ELEVATION) :
+      case (GIS_DETREND_ELEVATION) :
+      case (GIS_CUMUL_RAIN) :
+      case (GIS_CUMUL_RUNON) :
+      case (GIS_SURFACE_WATER_DEPTH) :
+      case (GIS_AVG_SURFACE_WATER_DEPTH) :
+      case (GIS_INFILT) :
+      case (GIS_CUMUL_INFILT) :
+      case (GIS_SOIL_WATER) :
+      case (GIS_INFILT_DEPOSIT) :
+      case (GIS_CUMUL_INFILT_DEPOSIT) :
+      case (GIS_TOP_SURFACE_DETREND) :
+      case (GIS_SEDIMENT_LOAD) :
+      case (GIS_AVG_SEDIMENT_LOAD) :
+      case (GIS_SPLASH) :
+      case (GIS_CUMUL_SPLASH) :
+      case (GIS_ALL_SIZE_FLOW_DETACH) :
+      case (GIS_TRANSPORT_CAPACITY) :
+      case (GIS_CUMUL_SLUMP_DETACH) :
+      case (GIS_CUMUL_SLUMP_DEPOSIT) :
+      case (GIS_CUMUL_TOPPLE_DETACH) :
+      case (GIS_CUMUL_TOPPLE_DEPOSIT) :
+      case (GIS_CUMUL_ALL_SIZE_FLOW_DETACH) :
+      case (GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT) :
+      case (GIS_CUMUL_ALL_PROC_SURF_LOWER) :
+      case (GIS_AVG_SURFACE_WATER_FROM_EDGES) :
+         strUnits = "mm";
+         break;
+
+      case (GIS_SURFACE_WATER_SPEED) :
+      case (GIS_AVG_SURFACE_WATER_SPEED) :
+      case (GIS_SURFACE_WATER_DW_SPEED) :
+      case (GIS_AVG_SURFACE_WATER_DW_SPEED) :
+         strUnits = "m/s";
+         break;
+
+      case (GIS_STREAMPOWER) :
+         strUnits = "kg/s**3";
+         break;
+
+      case (GIS_SHEAR_STRESS) :
+      case (GIS_AVG_SHEAR_STRESS) :
+         strUnits = "kg/m s**2";
+         break;
+
+      case (GIS_SEDIMENT_CONCENTRATION) :
+         strUnits = "%";
+         break;
+
+      case (GIS_RAIN_SPATIAL_VARIATION) :
+      case (GIS_REYNOLDS_NUMBER) :
+      case (GIS_FROUDE_NUMBER) :
+      case (GIS_FRICTION_FACTOR) :
+         strUnits = "none";
+         break;
+
+      case (GIS_INUNDATION_REGIME):
+      case (GIS_SURFACE_WATER_DIRECTION):
+      case (GIS_CUMUL_BINARY_HEADCUT_RETREAT) :
+         strUnits = "none";
    }
 
-   int n = 0;
+   return strUnits;
+}
+
+//=========================================================================================================================================
+//! Returns true if the GIS file for this data item holds integers, false if it holds floating point values
+//=========================================================================================================================================
+bool CSimulation::bIsIntGISItem(int const nDataItem)
+{
+   return ((GIS_INUNDATION_REGIME == nDataItem) || (GIS_SURFACE_WATER_DIRECTION == nDataItem) || (GIS_CUMUL_BINARY_HEADCUT_RETREAT == nDataItem));
+}
+
+//=========================================================================================================================================
+//! Copies floating point values for data item N from row nY of the cell array to pfRow. Since N is a template parameter, the switch is resolved at compile time, so each data item has its own loop
+//=========================================================================================================================================
+template <int N>
+void CSimulation::ExtractGISFloatRow(int const nY, float* pfRow)
+{
    double
       dTmp = 0,
       dTmp1,
-      dDiff = 0;
+      dDiff = nY * m_dYInc;
 
-   // Fill the array
-   for (int nY = 0; nY < m_nYGridMax; nY++)
+   for (int nX = 0; nX < m_nXGridMax; nX++)
    {
-      for (int nX = 0; nX < m_nXGridMax; nX++)
+      switch (N)
       {
-         switch (nDataItem)
-         {
-            case (GIS_CUMUL_RAIN) :
-               dTmp = m_Cell[nX][nY].pGetRainAndRunon()->dGetCumulRain();
-               break;
-
-            case (GIS_RAIN_SPATIAL_VARIATION) :
-               dTmp = m_Cell[nX][nY].pGetRainAndRunon()->dGetRainVarM();
-               break;
-
-            case (GIS_CUMUL_RUNON) :
-               dTmp = m_Cell[nX][nY].pGetRainAndRunon()->dGetCumulRunOn();
-               break;
-
-            case (GIS_ELEVATION) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetSoilSurfaceElevation();
-               if (! bFpEQ(dTmp, m_dMissingValue, TOLERANCE))
+         case (GIS_CUMUL_RAIN) :
+            dTmp = m_Cell[nX][nY].pGetRainAndRunon()->dGetCumulRain();
+            break;
+
+         case (GIS_RAIN_SPATIAL_VARIATION) :
+            dTmp = m_Cell[nX][nY].pGetRainAndRunon()->dGetRainVarM();
+            break;
+
+         case (GIS_CUMUL_RUNON) :
+            dTmp = m_Cell[nX][nY].pGetRainAndRunon()->dGetCumulRunOn();
+            break;
+
+         case (GIS_ELEVATION) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetSoilSurfaceElevation();
+            if (! bFpEQ(dTmp, m_dMissingValue, TOLERANCE))
+            {
+               if (m_bOutDEMsUsingInputZUnits)
                {
-                  if (m_bOutDEMsUsingInputZUnits)
-                  {
-                     // The Z elevation is in mm or cm, but the user wants output DEMs with original Z units, so do some conversion if necessary
-                     if (m_nZUnits == Z_UNIT_M)
-                        dTmp /= 1e3;
-                     else if (m_nZUnits == Z_UNIT_CM)
-                        dTmp /= 1e2;
-                  }
+                  // The Z elevation is in mm or cm, but the user wants output DEMs with original Z units, so do some conversion if necessary
+                  if (m_nZUnits == Z_UNIT_M)
+                     dTmp /= 1e3;
+                  else if (m_nZUnits == Z_UNIT_CM)
+                     dTmp /= 1e2;
                }
-               break;
-
-            case (GIS_DETREND_ELEVATION) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetSoilSurfaceElevation();
-               if (! bFpEQ(dTmp, m_dMissingValue, TOLERANCE))
+            }
+            break;
+
+         case (GIS_DETREND_ELEVATION) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetSoilSurfaceElevation();
+            if (! bFpEQ(dTmp, m_dMissingValue, TOLERANCE))
+            {
+               if (m_bOutDEMsUsingInputZUnits)
                {
-                  if (m_bOutDEMsUsingInputZUnits)
-                  {
-                     // The Z elevation is in mm or cm, but the user wants output DEMs with original Z units, so do some conversion if necessary
-                     if (m_nZUnits == Z_UNIT_M)
-                        dTmp /= 1e3;
-                     else if (m_nZUnits == Z_UNIT_CM)
-                        dTmp /= 1e2;
-                  }
-
-                  dTmp += dDiff;
+                  // The Z elevation is in mm or cm, but the user wants output DEMs with original Z units, so do some conversion if necessary
+                  if (m_nZUnits == Z_UNIT_M)
+                     dTmp /= 1e3;
+                  else if (m_nZUnits == Z_UNIT_CM)
+                     dTmp /= 1e2;
                }
-               break;
 
-            case (GIS_SURFACE_WATER_DEPTH) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetSurfaceWaterDepth();
-               break;
+               dTmp += dDiff;
+            }
+            break;
+
+         case (GIS_SURFACE_WATER_DEPTH) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetSurfaceWaterDepth();
+            break;
 
-            case (GIS_ALL_SIZE_FLOW_DETACH) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetAllSizeFlowDetach();
-               break;
+         case (GIS_ALL_SIZE_FLOW_DETACH) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetAllSizeFlowDetach();
+            break;
 
-            case (GIS_INFILT) :
-               dTmp = m_Cell[nX][nY].pGetSoilWater()->dGetThisIterInfiltration();
-               break;
+         case (GIS_INFILT) :
+            dTmp = m_Cell[nX][nY].pGetSoilWater()->dGetThisIterInfiltration();
+            break;
 
-            case (GIS_CUMUL_INFILT) :
-               dTmp = m_Cell[nX][nY].pGetSoilWater()->dGetCumulInfiltration();
-               break;
+         case (GIS_CUMUL_INFILT) :
+            dTmp = m_Cell[nX][nY].pGetSoilWater()->dGetCumulInfiltration();
+            break;
 
-            case (GIS_SOIL_WATER) :
-               dTmp = m_Cell[nX][nY].pGetSoilWater()->dGetTopLayerSoilWater();
-               break;
+         case (GIS_SOIL_WATER) :
+            dTmp = m_Cell[nX][nY].pGetSoilWater()->dGetTopLayerSoilWater();
+            break;
 
-            case (GIS_INFILT_DEPOSIT) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetAllSizeInfiltDeposit();
-               break;
+         case (GIS_INFILT_DEPOSIT) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetAllSizeInfiltDeposit();
+            break;
 
-            case (GIS_CUMUL_INFILT_DEPOSIT) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeInfiltDeposit();
-               break;
+         case (GIS_CUMUL_INFILT_DEPOSIT) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeInfiltDeposit();
+            break;
 
-            case (GIS_TOP_SURFACE_DETREND):
-               dTmp = m_Cell[nX][nY].dGetTopElevation();
-               if (! bFpEQ(dTmp, m_dMissingValue, TOLERANCE))
+         case (GIS_TOP_SURFACE_DETREND):
+            dTmp = m_Cell[nX][nY].dGetTopElevation();
+            if (! bFpEQ(dTmp, m_dMissingValue, TOLERANCE))
+            {
+               if (m_bOutDEMsUsingInputZUnits)
                {
-                  if (m_bOutDEMsUsingInputZUnits)
-                  {
-                     // The Z elevation is in mm or cm, but the user wants output DEMs with original Z units, so do some conversion if necessary
-                     if (m_nZUnits == Z_UNIT_M)
-                        dTmp /= 1e3;
-                     else if (m_nZUnits == Z_UNIT_CM)
-                        dTmp /= 1e2;
-                  }
-
-                  dTmp += dDiff;
+                  // The Z elevation is in mm or cm, but the user wants output DEMs with original Z units, so do some conversion if necessary
+                  if (m_nZUnits == Z_UNIT_M)
+                     dTmp /= 1e3;
+                  else if (m_nZUnits == Z_UNIT_CM)
+                     dTmp /= 1e2;
                }
 
-               break;
+               dTmp += dDiff;
+            }
 
-            case (GIS_SPLASH) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetAllSizeSplashDetach() - m_Cell[nX][nY].pGetSoil()->dGetAllSizeSplashDeposit();
-               break;
+            break;
 
-            case (GIS_CUMUL_SPLASH) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeSplashDetach() - m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeSplashDeposit();
-               break;
-
-            case (GIS_SURFACE_WATER_SPEED) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetFlowSpd();
-               dTmp /= 1000;             // Convert from mm/s to m/s
-               break;
-
-            case (GIS_SURFACE_WATER_DW_SPEED) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetDWFlowSpd();
-               dTmp /= 1000;             // Convert from mm/s to m/s
-               break;
-
-            case (GIS_AVG_SURFACE_WATER_FROM_EDGES) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetCumulSurfaceWaterLost() / static_cast<double>(m_ulIter);
-               break;
-
-            case (GIS_STREAMPOWER) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetStreamPower();
-               break;
-
-            case GIS_SHEAR_STRESS:
-               dTmp1 = m_dSimulatedTimeElapsed - m_dLastSlumpCalcTime;
-               if (dTmp1 > 0)
-                  dTmp = m_Cell[nX][nY].pGetSoil()->dGetShearStress() / (m_dSimulatedTimeElapsed - m_dLastSlumpCalcTime);
-               else
-                  dTmp = 0;
-               break;
-
-            case (GIS_FRICTION_FACTOR) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetFrictionFactor();
-               break;
-
-            case (GIS_AVG_SHEAR_STRESS) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulShearStress() / m_dSimulatedTimeElapsed;
-               break;
-
-            case (GIS_REYNOLDS_NUMBER) :
-               dTmp = dGetReynolds(nX, nY);
-               break;
-
-            case (GIS_FROUDE_NUMBER) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetFroude(m_dG);
-               break;
-
-            case (GIS_TRANSPORT_CAPACITY) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetTransportCapacity();
-               break;
-
-            case (GIS_AVG_SURFACE_WATER_DEPTH) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetCumulSurfaceWater() / static_cast<double>(m_ulIter);
-               break;
-
-            case (GIS_AVG_SURFACE_WATER_SPEED) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dCumulFlowSpeed() / (m_dSimulatedTimeElapsed * 1000);       // Convert from mm/s to m/s
-               break;
-
-            case (GIS_AVG_SURFACE_WATER_DW_SPEED) :
-               dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetCumulDWFlowSpd() / (m_dSimulatedTimeElapsed * 1000);    // Convert from mm/s to m/s
-               break;
-
-            case (GIS_CUMUL_ALL_SIZE_FLOW_DETACH) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeFlowDetach();
-               break;
-
-            case (GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeFlowDeposit();
-               break;
-
-            case (GIS_SEDIMENT_CONCENTRATION) :
-               dTmp = m_Cell[nX][nY].pGetSedLoad()->dGetAllSizeSedConcentration();
-               break;
-
-            case (GIS_SEDIMENT_LOAD) :
-               dTmp = m_Cell[nX][nY].pGetSedLoad()->dGetThisIterAllSizeSedLoad();
-               break;
-
-            case (GIS_AVG_SEDIMENT_LOAD) :
-               dTmp = m_Cell[nX][nY].pGetSedLoad()->dGetCumulAllSizeSedLoad() / static_cast<double>(m_ulIter);
-               break;
-
-            case (GIS_CUMUL_SLUMP_DETACH) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeSlumpDetach();
-               break;
-
-            case (GIS_CUMUL_SLUMP_DEPOSIT) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeSlumpDeposit();
-               break;
-
-            case (GIS_CUMUL_TOPPLE_DETACH) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeToppleDetach();
-               break;
-
-            case (GIS_CUMUL_TOPPLE_DEPOSIT) :
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeToppleDeposit();
-               break;
-
-            case (GIS_CUMUL_ALL_PROC_SURF_LOWER):
-               // Detachment is +ve, deposition is -ve
-               dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeLowering();
-         }
+         case (GIS_SPLASH) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetAllSizeSplashDetach() - m_Cell[nX][nY].pGetSoil()->dGetAllSizeSplashDeposit();
+            break;
+
+         case (GIS_CUMUL_SPLASH) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeSplashDetach() - m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeSplashDeposit();
+            break;
+
+         case (GIS_SURFACE_WATER_SPEED) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetFlowSpd();
+            dTmp /= 1000;             // Convert from mm/s to m/s
+            break;
+
+         case (GIS_SURFACE_WATER_DW_SPEED) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetDWFlowSpd();
+            dTmp /= 1000;             // Convert from mm/s to m/s
+            break;
+
+         case (GIS_AVG_SURFACE_WATER_FROM_EDGES) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetCumulSurfaceWaterLost() / static_cast<double>(m_ulIter);
+            break;
+
+         case (GIS_STREAMPOWER) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetStreamPower();
+            break;
+
+         case GIS_SHEAR_STRESS:
+            dTmp1 = m_dSimulatedTimeElapsed - m_dLastSlumpCalcTime;
+            if (dTmp1 > 0)
+               dTmp = m_Cell[nX][nY].pGetSoil()->dGetShearStress() / (m_dSimulatedTimeElapsed - m_dLastSlumpCalcTime);
+            else
+               dTmp = 0;
+            break;
+
+         case (GIS_FRICTION_FACTOR) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetFrictionFactor();
+            break;
+
+         case (GIS_AVG_SHEAR_STRESS) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulShearStress() / m_dSimulatedTimeElapsed;
+            break;
+
+         case (GIS_REYNOLDS_NUMBER) :
+            dTmp = dGetReynolds(nX, nY);
+            break;
+
+         case (GIS_FROUDE_NUMBER) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetFroude(m_dG);
+            break;
+
+         case (GIS_TRANSPORT_CAPACITY) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetTransportCapacity();
+            break;
+
+         case (GIS_AVG_SURFACE_WATER_DEPTH) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetCumulSurfaceWater() / static_cast<double>(m_ulIter);
+            break;
+
+         case (GIS_AVG_SURFACE_WATER_SPEED) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dCumulFlowSpeed() / (m_dSimulatedTimeElapsed * 1000);       // Convert from mm/s to m/s
+            break;
+
+         case (GIS_AVG_SURFACE_WATER_DW_SPEED) :
+            dTmp = m_Cell[nX][nY].pGetSurfaceWater()->dGetCumulDWFlowSpd() / (m_dSimulatedTimeElapsed * 1000);    // Convert from mm/s to m/s
+            break;
+
+         case (GIS_CUMUL_ALL_SIZE_FLOW_DETACH) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeFlowDetach();
+            break;
+
+         case (GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeFlowDeposit();
+            break;
+
+         case (GIS_SEDIMENT_CONCENTRATION) :
+            dTmp = m_Cell[nX][nY].pGetSedLoad()->dGetAllSizeSedConcentration();
+            break;
+
+         case (GIS_SEDIMENT_LOAD) :
+            dTmp = m_Cell[nX][nY].pGetSedLoad()->dGetThisIterAllSizeSedLoad();
+            break;
+
+         case (GIS_AVG_SEDIMENT_LOAD) :
+            dTmp = m_Cell[nX][nY].pGetSedLoad()->dGetCumulAllSizeSedLoad() / static_cast<double>(m_ulIter);
+            break;
 
-         // Write this value to the array
-         pfRaster[n++] = static_cast<float>(dTmp);
+         case (GIS_CUMUL_SLUMP_DETACH) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeSlumpDetach();
+            break;
+
+         case (GIS_CUMUL_SLUMP_DEPOSIT) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeSlumpDeposit();
+            break;
+
+         case (GIS_CUMUL_TOPPLE_DETACH) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeToppleDetach();
+            break;
+
+         case (GIS_CUMUL_TOPPLE_DEPOSIT) :
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeToppleDeposit();
+            break;
+
+         case (GIS_CUMUL_ALL_PROC_SURF_LOWER):
+            // Detachment is +ve, deposition is -ve
+            dTmp = m_Cell[nX][nY].pGetSoil()->dGetCumulAllSizeLowering();
       }
 
-      dDiff += m_dYInc;
+      // Write this value to the array
+      pfRow[nX] = static_cast<float>(dTmp);
    }
+}
+
+//=========================================================================================================================================
+//! Copies integer values for data item N from row nY of the cell array to pnRow, in the same way as ExtractGISFloatRow()
+//=========================================================================================================================================
+template <int N>
+void CSimulation::ExtractGISIntRow(int const nY, int* pnRow)
+{
+   int nTmp = 0;
 
-   // Now write the data. Create a single raster band
-   GDALRasterBand* pBand;
-   pBand = pOutDataSet->GetRasterBand(1);
-   if (pBand->RasterIO(GF_Write, 0, 0, m_nXGridMax, m_nYGridMax, pfRaster, m_nXGridMax, m_nYGridMax, GDT_Float32, 0, 0) == CE_Failure)
+   for (int nX = 0; nX < m_nXGridMax; nX++)
    {
-      // Write error, better error message
-      cerr << ERR << "cannot write data for " << m_strGISOutFormat << " file named " << strFilDat << "\n" << CPLGetLastErrorMsg() << endl;
-      delete[] pfRaster;
-      return false;
-   }
+      switch (N)
+      {
+         case (GIS_INUNDATION_REGIME) :
+            nTmp = m_Cell[nX][nY].pGetSurfaceWater()->nGetInundation();
+            break;
 
-   // Calculate statistics for this band
-   double dMin, dMax, dMean, dStdDev;
-   if (pBand->ComputeStatistics(false, &dMin, &dMax, &dMean, &dStdDev, NULL, NULL) == CE_Failure)
-      cerr << ERR << CPLGetLastErrorMsg() << endl;
+         case (GIS_SURFACE_WATER_DIRECTION) :
+            nTmp = m_Cell[nX][nY].pGetSurfaceWater()->nGetFlowDirection();
+            break;
 
-   // And then write the statistics, fail silently if not supported by this format
-   pBand->SetStatistics(dMin, dMax, dMean, dStdDev);
+         case (GIS_CUMUL_BINARY_HEADCUT_RETREAT):
+            nTmp = (m_Cell[nX][nY].bHasHadHeadcutRetreat() ? 1 : 0);
+      }
 
-   // Set value units for this band
-   string strUnits;
+      // Write this value to the array
+      pnRow[nX] = nTmp;
+   }
+}
 
+//=========================================================================================================================================
+//! Returns the function which copies floating point values for this data item from a row of the cell array
+//=========================================================================================================================================
+CSimulation::GISFloatRowExtractor CSimulation::pGetGISFloatRowExtractor(int const nDataItem)
+{
    switch (nDataItem)
    {
-      case (GIS_ELEVATION) :
-      case (GIS_DETREND_ELEVATION) :
       case (GIS_CUMUL_RAIN) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_RAIN>;
+
+      case (GIS_RAIN_SPATIAL_VARIATION) :
+         return &CSimulation::ExtractGISFloatRow<GIS_RAIN_SPATIAL_VARIATION>;
+
       case (GIS_CUMUL_RUNON) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_RUNON>;
+
+      case (GIS_ELEVATION) :
+         return &CSimulation::ExtractGISFloatRow<GIS_ELEVATION>;
+
+      case (GIS_DETREND_ELEVATION) :
+         return &CSimulation::ExtractGISFloatRow<GIS_DETREND_ELEVATION>;
+
       case (GIS_SURFACE_WATER_DEPTH) :
-      case (GIS_AVG_SURFACE_WATER_DEPTH) :
+         return &CSimulation::ExtractGISFloatRow<GIS_SURFACE_WATER_DEPTH>;
+
+      case (GIS_ALL_SIZE_FLOW_DETACH) :
+         return &CSimulation::ExtractGISFloatRow<GIS_ALL_SIZE_FLOW_DETACH>;
+
       case (GIS_INFILT) :
+         return &CSimulation::ExtractGISFloatRow<GIS_INFILT>;
+
       case (GIS_CUMUL_INFILT) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_INFILT>;
+
       case (GIS_SOIL_WATER) :
+         return &CSimulation::ExtractGISFloatRow<GIS_SOIL_WATER>;
+
       case (GIS_INFILT_DEPOSIT) :
+         return &CSimulation::ExtractGISFloatRow<GIS_INFILT_DEPOSIT>;
+
       case (GIS_CUMUL_INFILT_DEPOSIT) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_INFILT_DEPOSIT>;
+
       case (GIS_TOP_SURFACE_DETREND) :
-      case (GIS_SEDIMENT_LOAD) :
-      case (GIS_AVG_SEDIMENT_LOAD) :
+         return &CSimulation::ExtractGISFloatRow<GIS_TOP_SURFACE_DETREND>;
+
       case (GIS_SPLASH) :
+         return &CSimulation::ExtractGISFloatRow<GIS_SPLASH>;
+
       case (GIS_CUMUL_SPLASH) :
-      case (GIS_ALL_SIZE_FLOW_DETACH) :
-      case (GIS_TRANSPORT_CAPACITY) :
-      case (GIS_CUMUL_SLUMP_DETACH) :
-      case (GIS_CUMUL_SLUMP_DEPOSIT) :
-      case (GIS_CUMUL_TOPPLE_DETACH) :
-      case (GIS_CUMUL_TOPPLE_DEPOSIT) :
-      case (GIS_CUMUL_ALL_SIZE_FLOW_DETACH) :
-      case (GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT) :
-      case (GIS_CUMUL_ALL_PROC_SURF_LOWER) :
-      case (GIS_AVG_SURFACE_WATER_FROM_EDGES) :
-         strUnits = "mm";
-         break;
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_SPLASH>;
 
       case (GIS_SURFACE_WATER_SPEED) :
-      case (GIS_AVG_SURFACE_WATER_SPEED) :
+         return &CSimulation::ExtractGISFloatRow<GIS_SURFACE_WATER_SPEED>;
+
       case (GIS_SURFACE_WATER_DW_SPEED) :
-      case (GIS_AVG_SURFACE_WATER_DW_SPEED) :
-         strUnits = "m/s";
-         break;
+         return &CSimulation::ExtractGISFloatRow<GIS_SURFACE_WATER_DW_SPEED>;
+
+      case (GIS_AVG_SURFACE_WATER_FROM_EDGES) :
+         return &CSimulation::ExtractGISFloatRow<GIS_AVG_SURFACE_WATER_FROM_EDGES>;
 
       case (GIS_STREAMPOWER) :
-         strUnits = "kg/s**3";
-         break;
+         return &CSimulation::ExtractGISFloatRow<GIS_STREAMPOWER>;
 
       case (GIS_SHEAR_STRESS) :
-      case (GIS_AVG_SHEAR_STRESS) :
-         strUnits = "kg/m s**2";
-         break;
+         return &CSimulation::ExtractGISFloatRow<GIS_SHEAR_STRESS>;
 
-      case (GIS_SEDIMENT_CONCENTRATION) :
-         strUnits = "%";
-         break;
+      case (GIS_FRICTION_FACTOR) :
+         return &CSimulation::ExtractGISFloatRow<GIS_FRICTION_FACTOR>;
+
+      case (GIS_AVG_SHEAR_STRESS) :
+         return &CSimulation::ExtractGISFloatRow<GIS_AVG_SHEAR_STRESS>;
 
-      case (GIS_RAIN_SPATIAL_VARIATION) :
       case (GIS_REYNOLDS_NUMBER) :
+         return &CSimulation::ExtractGISFloatRow<GIS_REYNOLDS_NUMBER>;
+
       case (GIS_FROUDE_NUMBER) :
-      case (GIS_FRICTION_FACTOR) :
-         strUnits = "none";
-   }
+         return &CSimulation::ExtractGISFloatRow<GIS_FROUDE_NUMBER>;
 
-   CPLPushErrorHandler(CPLQuietErrorHandler);                  // Needed to get next line to fail silently, if it fails
-   pBand->SetUnitType(strUnits.c_str());                       // Not supported for some GIS formats
-   CPLPopErrorHandler();
+      case (GIS_TRANSPORT_CAPACITY) :
+         return &CSimulation::ExtractGISFloatRow<GIS_TRANSPORT_CAPACITY>;
 
-   // Tell the output dataset about missing values
-   CPLPushErrorHandler(CPLQuietErrorHandler);                  // Needed to get next line to fail silently, if it fails
-   pBand->SetNoDataValue(m_dMissingValue);                     // Will fail for some formats
-   CPLPopErrorHandler();
+      case (GIS_AVG_SURFACE_WATER_DEPTH) :
+         return &CSimulation::ExtractGISFloatRow<GIS_AVG_SURFACE_WATER_DEPTH>;
 
-   // Construct the description
-   string strDesc = *pstrPlotTitle;
-   strDesc.append(" at ");
-   strDesc.append(strDispTime(m_dSimulatedTimeElapsed, true, false));
+      case (GIS_AVG_SURFACE_WATER_SPEED) :
+         return &CSimulation::ExtractGISFloatRow<GIS_AVG_SURFACE_WATER_SPEED>;
 
-   // Set the GDAL description
-   pBand->SetDescription(strDesc.c_str());
+      case (GIS_AVG_SURFACE_WATER_DW_SPEED) :
+         return &CSimulation::ExtractGISFloatRow<GIS_AVG_SURFACE_WATER_DW_SPEED>;
 
-   // Finished, so get rid of dataset object
-   delete pOutDataSet;
+      case (GIS_CUMUL_ALL_SIZE_FLOW_DETACH) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_ALL_SIZE_FLOW_DETACH>;
 
-   // Also get rid of memory allocated to this array
-   delete[] pfRaster;
+      case (GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT>;
 
-   return true;
+      case (GIS_SEDIMENT_CONCENTRATION) :
+         return &CSimulation::ExtractGISFloatRow<GIS_SEDIMENT_CONCENTRATION>;
+
+      case (GIS_SEDIMENT_LOAD) :
+         return &CSimulation::ExtractGISFloatRow<GIS_SEDIMENT_LOAD>;
+
+      case (GIS_AVG_SEDIMENT_LOAD) :
+         return &CSimulation::ExtractGISFloatRow<GIS_AVG_SEDIMENT_LOAD>;
+
+      case (GIS_CUMUL_SLUMP_DETACH) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_SLUMP_DETACH>;
+
+      case (GIS_CUMUL_SLUMP_DEPOSIT) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_SLUMP_DEPOSIT>;
+
+      case (GIS_CUMUL_TOPPLE_DETACH) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_TOPPLE_DETACH>;
+
+      case (GIS_CUMUL_TOPPLE_DEPOSIT) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_TOPPLE_DEPOSIT>;
+
+      case (GIS_CUMUL_ALL_PROC_SURF_LOWER) :
+         return &CSimulation::ExtractGISFloatRow<GIS_CUMUL_ALL_PROC_SURF_LOWER>;
+
+   }
+
+   return NULL;
 }
 
 //=========================================================================================================================================
-//! Writes integer GIS files using GDAL, using data from the cell array
+//! Returns the function which copies integer values for this data item from a row of the cell array
 //=========================================================================================================================================
-bool CSimulation::bWriteGISFileInt(int const nDataItem, string const* pstrPlotTitle)
+CSimulation::GISIntRowExtractor CSimulation::pGetGISIntRowExtractor(int const nDataItem)
 {
-   // Begin constructing the file name for this save
-   string strFilDat = m_strOutputPath;
-
    switch (nDataItem)
    {
       case (GIS_INUNDATION_REGIME) :
-         strFilDat.append(GIS_INUNDATION_REGIME_FILENAME);
-         break;
+         return &CSimulation::ExtractGISIntRow<GIS_INUNDATION_REGIME>;
 
       case (GIS_SURFACE_WATER_DIRECTION) :
-         strFilDat.append(GIS_SURFACE_WATER_DIRECTION_FILENAME);
-         break;
+         return &CSimulation::ExtractGISIntRow<GIS_SURFACE_WATER_DIRECTION>;
 
       case (GIS_CUMUL_BINARY_HEADCUT_RETREAT) :
-         strFilDat.append(GIS_CUMUL_BINARY_HEADCUT_RETREAT_FILENAME);
+         return &CSimulation::ExtractGISIntRow<GIS_CUMUL_BINARY_HEADCUT_RETREAT>;
+
    }
 
-   // Append the 'save number' to the filename, and prepend zeros to the save number
-   strFilDat.append("_");
-   stringstream ststrTmp;
-   ststrTmp << setfill('0') << setw(MAX_GIS_FILENAME_SAVE_DIGITS) << m_nGISSave;
-   strFilDat.append(ststrTmp.str());
+   return NULL;
+}
 
-   // Finally, maybe append the extension
-   if (! m_strGDALOutputDriverExtension.empty())
+//=========================================================================================================================================
+//! Writes GIS files using GDAL, using data from the cell array. The values of all data items in VnDataItem are copied from the cell array in one pass over the grid, then handed to the GIS writer
+//=========================================================================================================================================
+bool CSimulation::bWriteGISFiles(vector<int> const& VnDataItem, vector<string const*> const& VpstrPlotTitle)
+{
+   int nItems = static_cast<int>(VnDataItem.size());
+
+   // Increment file number when soil loss file is written (this is done first, and is always saved)
+   for (int n = 0; n < nItems; n++)
    {
-      strFilDat.append(".");
-      strFilDat.append(m_strGDALOutputDriverExtension);
+      if (GIS_CUMUL_ALL_SIZE_FLOW_DETACH == VnDataItem[n])
+         m_nGISSave++;
    }
 
-   GDALDriver* pDriver;
-   pDriver = GetGDALDriverManager()->GetDriverByName(m_strGISOutFormat.c_str());
-   GDALDataset* pOutDataSet;
-   char** papszOptions = NULL;      // driver-specific options
-   pOutDataSet = pDriver->Create(strFilDat.c_str(), m_nXGridMax, m_nYGridMax, 1, GDT_Float32, papszOptions);
-   if (NULL == pOutDataSet)
+   // Choose the function which copies the values of each data item, once for the whole grid
+   vector<bool> VbInt(nItems);
+   vector<GISFloatRowExtractor> VpFloatExtractor(nItems, NULL);
+   vector<GISIntRowExtractor> VpIntExtractor(nItems, NULL);
+   for (int n = 0; n < nItems; n++)
    {
-      // Couldn't create file
-      cerr << ERR << "cannot create " << m_strGISOutFormat << " file named " << strFilDat << "\n" << CPLGetLastErrorMsg() << endl;
-      return false;
+      VbInt[n] = bIsIntGISItem(VnDataItem[n]);
+      if (VbInt[n])
+         VpIntExtractor[n] = pGetGISIntRowExtractor(VnDataItem[n]);
+      else
+         VpFloatExtractor[n] = pGetGISFloatRowExtractor(VnDataItem[n]);
    }
 
-   // Set projection info for output dataset (will be same as was read in from DEM)
-   CPLPushErrorHandler(CPLQuietErrorHandler);                  // needed to get next line to fail silently, if it fails
-   pOutDataSet->SetProjection(m_strGDALDEMProjection.c_str()); // will fail for some formats
-   CPLPopErrorHandler();
-
-   // Set geotransformation info for output dataset (will be same as was read in from DEM)
-   if (CE_Failure == pOutDataSet->SetGeoTransform(m_dGeoTransform))
-      cerr << WARN << "cannot write geotransformation information to " << m_strGISOutFormat << " file named " << strFilDat << "\n" << CPLGetLastErrorMsg() << endl;
+   // The end of the description is the same for every data item
+   string strAt = " at ";
+   strAt.append(strDispTime(m_dSimulatedTimeElapsed, true, false));
 
-   // Allocate memory for a 1D array, to hold the integer raster band data for GDAL
-   int* pnRaster;
-   pnRaster = new int[m_nXGridMax * m_nYGridMax];
-   if (NULL == pnRaster)
+   // There is a pooled buffer for each data item. Get one to hold a snapshot of each data item, this waits if buffers are still waiting to be written
+   if (nItems > m_pGISWriter->nGetNumBuffers())
    {
-      // Error, can't allocate memory
-      cerr << ERR << "cannot allocate memory for " << m_nXGridMax * m_nYGridMax << " x 1D floating-point array for " << m_strGISOutFormat << " file named " << strFilDat << endl;
+      cerr << ERR << "too many GIS data items (" << nItems << ") for " << m_pGISWriter->nGetNumBuffers() << " GIS buffers" << endl;
       return false;
    }
 
-   // Fill the array
-   int
-      nTmp  = 0,
-      n = 0;
+   vector<int> VnBuffer(nItems);
+   vector<float*> VpfRaster(nItems, NULL);
+   vector<int*> VpnRaster(nItems, NULL);
+   for (int n = 0; n < nItems; n++)
+   {
+      if (VbInt[n])
+         VpnRaster[n] = m_pGISWriter->pnGetIntBuffer(VnBuffer[n]);
+      else
+         VpfRaster[n] = m_pGISWriter->pfGetFloatBuffer(VnBuffer[n]);
+   }
+
+   // Fill the buffers row by row, all data items together. The statistics of each row are found while the row is still in cache, so the buffers need not be read again to find them
+   float fMissing = static_cast<float>(m_dMissingValue);
+   vector<CGISWriter::CStats> VRowStats(nItems * m_nYGridMax);
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
    for (int nY = 0; nY < m_nYGridMax; nY++)
    {
-      for (int nX = 0; nX < m_nXGridMax; nX++)
+      for (int n = 0; n < nItems; n++)
       {
-         switch (nDataItem)
+         CGISWriter::CStats* pRowStats = &VRowStats[(nY * nItems) + n];
+         if (VbInt[n])
          {
-            case (GIS_INUNDATION_REGIME) :
-               nTmp = m_Cell[nX][nY].pGetSurfaceWater()->nGetInundation();
-               break;
-
-            case (GIS_SURFACE_WATER_DIRECTION) :
-               nTmp = m_Cell[nX][nY].pGetSurfaceWater()->nGetFlowDirection();
-               break;
-
-            case (GIS_CUMUL_BINARY_HEADCUT_RETREAT):
-               nTmp = (m_Cell[nX][nY].bHasHadHeadcutRetreat() ? 1 : 0);
+            int* pnRow = VpnRaster[n] + (nY * m_nXGridMax);
+            (this->*VpIntExtractor[n])(nY, pnRow);
+            pRowStats->AddRow(pnRow, m_nXGridMax, fMissing);
+         }
+         else
+         {
+            float* pfRow = VpfRaster[n] + (nY * m_nXGridMax);
+            (this->*VpFloatExtractor[n])(nY, pfRow);
+            pRowStats->AddRow(pfRow, m_nXGridMax, fMissing);
          }
-
-         // Write this value to the array
-         pnRaster[n++] = nTmp;
       }
    }
 
-   // Now write the data. Create a single raster band
-   GDALRasterBand* pBand;
-   pBand = pOutDataSet->GetRasterBand(1);
-   if (CE_Failure == pBand->RasterIO(GF_Write, 0, 0, m_nXGridMax, m_nYGridMax, pnRaster, m_nXGridMax, m_nYGridMax, GDT_Int32, 0, 0))
+   // Now combine the statistics of the rows, in order, so that the result does not depend on the number of threads
+   vector<CGISWriter::CStats> VStats(nItems);
+   for (int nY = 0; nY < m_nYGridMax; nY++)
    {
-      // Write error, better error message
-      cerr << ERR << "cannot write data for " << m_strGISOutFormat << " file named " << strFilDat << "\n" << CPLGetLastErrorMsg() << endl;
-      delete[] pnRaster;
-      return false;
+      for (int n = 0; n < nItems; n++)
+         VStats[n].Add(VRowStats[(nY * nItems) + n]);
    }
 
-   // Calculate statistics for this band
-   double dMin, dMax, dMean, dStdDev;
-   if (CE_Failure == pBand->ComputeStatistics(false, &dMin, &dMax, &dMean, &dStdDev, NULL, NULL))
-      cerr << ERR << CPLGetLastErrorMsg() << endl;
+   // Hand the snapshots over to be written (in the background, if there are GIS writer threads)
+   for (int n = 0; n < nItems; n++)
+   {
+      int nDataItem = VnDataItem[n];
 
-   // And then write the statistics, fail silently if not supported by this format
-   pBand->SetStatistics(dMin, dMax, dMean, dStdDev);
+      // Construct the description
+      string strDesc = *VpstrPlotTitle[n];
+      strDesc.append(strAt);
 
-   // Set value units for this band
-   string strUnits;
+      // Set raster category names
+      vector<string> VstrCategoryNames;
 
-   switch (nDataItem)
-   {
-      case (GIS_INUNDATION_REGIME):
-      case (GIS_SURFACE_WATER_DIRECTION):
-      case (GIS_CUMUL_BINARY_HEADCUT_RETREAT) :
-         strUnits = "none";
+      switch (nDataItem)
+      {
+         case (GIS_INUNDATION_REGIME) :
+            VstrCategoryNames.push_back("Dry");
+            VstrCategoryNames.push_back("Shallow");
+            VstrCategoryNames.push_back("Marginally inundated");
+            VstrCategoryNames.push_back("Well inundated");
+            break;
+
+         case (GIS_SURFACE_WATER_DIRECTION) :
+            VstrCategoryNames.push_back("None");
+            VstrCategoryNames.push_back("Top");
+            VstrCategoryNames.push_back("Top right");
+            VstrCategoryNames.push_back("Right");
+            VstrCategoryNames.push_back("Bottom right");
+            VstrCategoryNames.push_back("Bottom");
+            VstrCategoryNames.push_back("Bottom left");
+            VstrCategoryNames.push_back("Left");
+            VstrCategoryNames.push_back("Top left");
+            break;
+      }
+
+      string strName = strGetGISItemName(nDataItem);
+      m_pGISWriter->AddBand(VnBuffer[n], VbInt[n], strName, strDesc, strGetGISUnits(nDataItem), VstrCategoryNames, VStats[n]);
+
+      // Unless the bands are to be kept together, each is a separate file
+      if (GIS_LAYOUT_SEPARATE == m_nGISOutputLayout)
+         m_pGISWriter->SubmitFile(strGetGISFileName(strName), m_dSimulatedTimeElapsed, m_nGISSave);
    }
 
-   CPLPushErrorHandler(CPLQuietErrorHandler);                  // Needed to get next line to fail silently, if it fails
-   pBand->SetUnitType(strUnits.c_str());                       // Not supported for some GIS formats
-   CPLPopErrorHandler();
+   if (GIS_LAYOUT_MULTIBAND == m_nGISOutputLayout)
+      m_pGISWriter->SubmitFile(strGetGISFileName(GIS_MULTIBAND_FILENAME), m_dSimulatedTimeElapsed, m_nGISSave);
+   else if (GIS_LAYOUT_TIME_STACK == m_nGISOutputLayout)
+      m_pGISWriter->SubmitToTimeStack(m_dSimulatedTimeElapsed, m_nGISSave);
 
-   // Tell the output dataset about missing values
-   CPLPushErrorHandler(CPLQuietErrorHandler);                  // Needed to get next line to fail silently, if it fails
-   pBand->SetNoDataValue(m_dMissingValue);                     // Will fail for some formats
-   CPLPopErrorHandler();
+   return true;
+}
 
-   // Construct the description
-   string strDesc = *pstrPlotTitle;
-   strDesc.append(" at ");
-   strDesc.append(strDispTime(m_dSimulatedTimeElapsed, true, false));
+//=========================================================================================================================================
+//! Passes on any errors and warnings from GIS files which have been written in the background, after first waiting for all files to be written if bWaitForAll is true. Returns false if any of these files could not be written
+//=========================================================================================================================================
+bool CSimulation::bCheckGISWrites(bool const bWaitForAll)
+{
+   if (NULL == m_pGISWriter)
+      return true;
 
-   // Set the GDAL description
-   pBand->SetDescription(strDesc.c_str());
+   if (bWaitForAll)
+      m_pGISWriter->WaitForAll();
 
-   // Set raster category names
-   char** papszCategoryNames = NULL;
+   vector<string> VstrMessage;
+   bool bOK = m_pGISWriter->bGetMessages(VstrMessage);
+   for (unsigned int n = 0; n < VstrMessage.size(); n++)
+      cerr << VstrMessage[n] << endl;
 
-   switch (nDataItem)
+   return bOK;
+}
+
+//=========================================================================================================================================
+//! In benchmark mode, writes the elevation grid using each of several sets of GDAL creation options: the user's options, the driver's defaults, and those of the alternatives in GIS_BENCHMARK_CREATION_OPTIONS which this driver accepts. The bytes written and the time taken for each are kept, to be reported at the end of the run. The files are deleted
+//=========================================================================================================================================
+void CSimulation::BenchmarkGISFormats(void)
+{
+   GDALDriver* pDriver = GetGDALDriverManager()->GetDriverByName(m_strGISOutFormat.c_str());
+
+   vector<vector<string> > VVstrOptions;
+   VVstrOptions.push_back(m_VstrGISCreationOptions);
+   if (! m_VstrGISCreationOptions.empty())
+      VVstrOptions.push_back(vector<string>());
+
+   vector<string> VstrSet = VstrSplit(&GIS_BENCHMARK_CREATION_OPTIONS, ';');
+   for (unsigned int n = 0; n < VstrSet.size(); n++)
    {
-      case (GIS_INUNDATION_REGIME) :
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Dry");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Shallow");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Marginally inundated");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Well inundated");
-         break;
+      vector<string> VstrOptions = VstrSplit(&VstrSet[n], SPACE);
+      if ((VstrOptions != m_VstrGISCreationOptions) && bCheckGISCreationOptions(pDriver, VstrOptions, true))
+         VVstrOptions.push_back(VstrOptions);
+   }
 
-      case (GIS_SURFACE_WATER_DIRECTION) :
-         papszCategoryNames = CSLAddString(papszCategoryNames, "None");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Top");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Top right");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Right");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Bottom right");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Bottom");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Bottom left");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Left");
-         papszCategoryNames = CSLAddString(papszCategoryNames, "Top left");
-         break;
+   // Take a snapshot of the elevation grid
+   int nBuffer;
+   float* pfRaster = m_pGISWriter->pfGetFloatBuffer(nBuffer);
+   CGISWriter::CStats Stats;
+   for (int nY = 0; nY < m_nYGridMax; nY++)
+   {
+      ExtractGISFloatRow<GIS_ELEVATION>(nY, pfRaster + (nY * m_nXGridMax));
+      Stats.AddRow(pfRaster + (nY * m_nXGridMax), m_nXGridMax, static_cast<float>(m_dMissingValue));
    }
 
-   CPLPushErrorHandler(CPLQuietErrorHandler);        // Needed to get next line to fail silently, if it fails
-   pBand->SetCategoryNames(papszCategoryNames);      // Not supported for some GIS formats
-   CPLPopErrorHandler();
+   m_pGISWriter->AddBand(nBuffer, false, GIS_ELEVATION_FILENAME, GIS_ELEVATION_TITLE, strGetGISUnits(GIS_ELEVATION), vector<string>(), Stats);
 
-   // Finished, so get rid of dataset object
-   delete pOutDataSet;
+   // Now write it with each set of options
+   string strFileName = m_strOutputPath;
+   strFileName.append(GIS_BENCHMARK_FILENAME);
+   if (! m_strGDALOutputDriverExtension.empty())
+   {
+      strFileName.append(".");
+      strFileName.append(m_strGDALOutputDriverExtension);
+   }
 
-   // Also get rid of memory allocated to this array
-   delete[] pnRaster;
+   vector<string> VstrMessage;
+   if (! m_pGISWriter->bBenchmark(strFileName, VVstrOptions, m_VdGISBenchmarkSeconds, m_VllGISBenchmarkBytes, VstrMessage))
+   {
+      for (unsigned int n = 0; n < VstrMessage.size(); n++)
+         m_ofsLog << VstrMessage[n] << endl;
+   }
 
-   return true;
+   for (unsigned int n = 0; n < VVstrOptions.size(); n++)
+   {
+      string strOptions;
+      for (unsigned int m = 0; m < VVstrOptions[n].size(); m++)
+      {
+         if (m > 0)
+            strOptions.append(" ");
+         strOptions.append(VVstrOptions[n][m]);
+      }
+
+      m_VstrGISBenchmarkOptions.push_back(strOptions.empty() ? "driver defaults" : strOptions);
+   }
 }
 
 //=========================================================================================================================================
@@ -1333,231 +1580,240 @@ bool CSimulation::bSaveGISFiles(void)
    else
       m_nThisSave = tMin(++m_nThisSave, m_nUSave);
 
-   // These are always written. Note must write GIS_CUMUL_ALL_SIZE_FLOW_DETACH first, to increment save number
-   if (! bWriteGISFileFloat(GIS_CUMUL_ALL_SIZE_FLOW_DETACH, &GIS_CUMUL_ALL_SIZE_FLOW_DETACH_TITLE))      // Increments filename count
-      return (false);
+   // Shear stress is only spread over the surrounding patches of cells when slumping is calculated, so spread any shear stress since then before saving
+   if (m_bSlumping && (m_bShearStressSave || m_bCumulAvgShearStressSave))
+      SpreadAllShearStress();
 
-   if (! bWriteGISFileFloat(GIS_CUMUL_RAIN, &GIS_CUMUL_RAIN_TITLE))
-      return (false);
+   // Make a list of the data items to save, then copy them all from the cell array in one pass
+   vector<int> VnDataItem;
+   vector<string const*> VpstrTitle;
+   GetGISSaveItems(VnDataItem, VpstrTitle);
 
-   if (! bWriteGISFileFloat(GIS_CUMUL_SPLASH, &GIS_CUMUL_SPLASH_TITLE))
-      return (false);
+   return bWriteGISFiles(VnDataItem, VpstrTitle);
+}
 
-   if (! bWriteGISFileFloat(GIS_SURFACE_WATER_DEPTH, &GIS_SURFACE_WATER_DEPTH_TITLE))
-      return (false);
+//=========================================================================================================================================
+//! Makes a list of the data items which are saved as GIS files during the simulation, with their titles
+//=========================================================================================================================================
+void CSimulation::GetGISSaveItems(vector<int>& VnDataItem, vector<string const*>& VpstrTitle) const
+{
+   // These are always written
+   VnDataItem.push_back(GIS_CUMUL_ALL_SIZE_FLOW_DETACH);      // Increments filename count
+   VpstrTitle.push_back(&GIS_CUMUL_ALL_SIZE_FLOW_DETACH_TITLE);
 
-   if (! bWriteGISFileFloat(GIS_SURFACE_WATER_SPEED, &GIS_SURFACE_WATER_SPEED_TITLE))
-      return (false);
+   VnDataItem.push_back(GIS_CUMUL_RAIN);
+   VpstrTitle.push_back(&GIS_CUMUL_RAIN_TITLE);
 
-   if (! bWriteGISFileFloat(GIS_SURFACE_WATER_DW_SPEED, &GIS_SURFACE_WATER_DW_SPEED_TITLE))
-      return (false);
+   VnDataItem.push_back(GIS_CUMUL_SPLASH);
+   VpstrTitle.push_back(&GIS_CUMUL_SPLASH_TITLE);
+
+   VnDataItem.push_back(GIS_SURFACE_WATER_DEPTH);
+   VpstrTitle.push_back(&GIS_SURFACE_WATER_DEPTH_TITLE);
+
+   VnDataItem.push_back(GIS_SURFACE_WATER_SPEED);
+   VpstrTitle.push_back(&GIS_SURFACE_WATER_SPEED_TITLE);
+
+   VnDataItem.push_back(GIS_SURFACE_WATER_DW_SPEED);
+   VpstrTitle.push_back(&GIS_SURFACE_WATER_DW_SPEED_TITLE);
 
    // These are optional
    if (m_bElevSave)
    {
-      if (! bWriteGISFileFloat(GIS_ELEVATION, &GIS_ELEVATION_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_ELEVATION);
+      VpstrTitle.push_back(&GIS_ELEVATION_TITLE);
    }
 
    if (m_bDetrendElevSave)
    {
-      if (! bWriteGISFileFloat(GIS_DETREND_ELEVATION, &GIS_DETREND_ELEVATION_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_DETREND_ELEVATION);
+      VpstrTitle.push_back(&GIS_DETREND_ELEVATION_TITLE);
    }
 
    if (m_bRunOn)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_RUNON, &GIS_CUMUL_RUNON_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_RUNON);
+      VpstrTitle.push_back(&GIS_CUMUL_RUNON_TITLE);
    }
 
    if (m_bSplashSave)
    {
-      if (! bWriteGISFileFloat(GIS_SPLASH, &GIS_SPLASH_TITLE))
-         return (false);
-   }
-
-   if (m_bCumulSplashSave)
-   {
-      if (! bWriteGISFileFloat(GIS_CUMUL_SPLASH, &GIS_CUMUL_SPLASH_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_SPLASH);
+      VpstrTitle.push_back(&GIS_SPLASH_TITLE);
    }
 
    if (m_bFlowDetachSave)
    {
-      if (! bWriteGISFileFloat(GIS_ALL_SIZE_FLOW_DETACH, &GIS_CUMUL_ALL_SIZE_FLOW_DETACH_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_ALL_SIZE_FLOW_DETACH);
+      VpstrTitle.push_back(&GIS_CUMUL_ALL_SIZE_FLOW_DETACH_TITLE);
    }
 
    if (m_bInundationSave)
    {
-      if (! bWriteGISFileInt(GIS_INUNDATION_REGIME, &GIS_INUNDATION_REGIME_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_INUNDATION_REGIME);
+      VpstrTitle.push_back(&GIS_INUNDATION_REGIME_TITLE);
    }
 
    if (m_bFlowDirSave)
    {
-      if (! bWriteGISFileInt(GIS_SURFACE_WATER_DIRECTION, &GIS_SURFACE_WATER_DIRECTION_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_SURFACE_WATER_DIRECTION);
+      VpstrTitle.push_back(&GIS_SURFACE_WATER_DIRECTION_TITLE);
    }
 
    if (m_bInfiltSave)
    {
-      if (! bWriteGISFileFloat(GIS_INFILT, &GIS_INFILT_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_INFILT);
+      VpstrTitle.push_back(&GIS_INFILT_TITLE);
    }
 
    if (m_bCumulInfiltSave)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_INFILT, &GIS_CUMUL_INFILT_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_INFILT);
+      VpstrTitle.push_back(&GIS_CUMUL_INFILT_TITLE);
    }
 
    if (m_bSoilWaterSave)
    {
-      if (! bWriteGISFileFloat(GIS_SOIL_WATER, &GIS_SOIL_WATER_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_SOIL_WATER);
+      VpstrTitle.push_back(&GIS_SOIL_WATER_TITLE);
    }
 
    if (m_bInfiltDepositSave)
    {
-      if (! bWriteGISFileFloat(GIS_INFILT_DEPOSIT, &GIS_INFILT_DEPOSIT_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_INFILT_DEPOSIT);
+      VpstrTitle.push_back(&GIS_INFILT_DEPOSIT_TITLE);
    }
 
    if (m_bCumulInfiltDepositSave)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_INFILT_DEPOSIT, &GIS_CUMUL_INFILT_DEPOSIT_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_INFILT_DEPOSIT);
+      VpstrTitle.push_back(&GIS_CUMUL_INFILT_DEPOSIT_TITLE);
    }
 
    if (m_bTopSurfaceSave)
    {
-      if (! bWriteGISFileFloat(GIS_TOP_SURFACE_DETREND, &GIS_TOP_SURFACE_DETREND_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_TOP_SURFACE_DETREND);
+      VpstrTitle.push_back(&GIS_TOP_SURFACE_DETREND_TITLE);
    }
 
    if (m_bLostSave)
    {
-      if (! bWriteGISFileFloat(GIS_AVG_SURFACE_WATER_FROM_EDGES, &GIS_AVG_SURFACE_WATER_FROM_EDGES_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_AVG_SURFACE_WATER_FROM_EDGES);
+      VpstrTitle.push_back(&GIS_AVG_SURFACE_WATER_FROM_EDGES_TITLE);
    }
 
    if (m_bStreamPowerSave)
    {
-      if (! bWriteGISFileFloat(GIS_STREAMPOWER, &GIS_STREAMPOWER_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_STREAMPOWER);
+      VpstrTitle.push_back(&GIS_STREAMPOWER_TITLE);
    }
 
    if (m_bShearStressSave)
    {
-      if (! bWriteGISFileFloat(GIS_SHEAR_STRESS, &GIS_SHEAR_STRESS_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_SHEAR_STRESS);
+      VpstrTitle.push_back(&GIS_SHEAR_STRESS_TITLE);
    }
 
    if (m_bFrictionFactorSave)
    {
-      if (! bWriteGISFileFloat(GIS_FRICTION_FACTOR, &GIS_FRICTION_FACTOR_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_FRICTION_FACTOR);
+      VpstrTitle.push_back(&GIS_FRICTION_FACTOR_TITLE);
    }
 
    if (m_bCumulAvgShearStressSave)
    {
-      if (! bWriteGISFileFloat(GIS_AVG_SHEAR_STRESS, &GIS_AVG_SHEAR_STRESS_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_AVG_SHEAR_STRESS);
+      VpstrTitle.push_back(&GIS_AVG_SHEAR_STRESS_TITLE);
    }
 
    if (m_bReynoldsSave)
    {
-      if (! bWriteGISFileFloat(GIS_REYNOLDS_NUMBER, &GIS_REYNOLDS_NUMBER_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_REYNOLDS_NUMBER);
+      VpstrTitle.push_back(&GIS_REYNOLDS_NUMBER_TITLE);
    }
 
    if (m_bFroudeSave)
    {
-      if (! bWriteGISFileFloat(GIS_FROUDE_NUMBER, &GIS_FROUDE_NUMBER_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_FROUDE_NUMBER);
+      VpstrTitle.push_back(&GIS_FROUDE_NUMBER_TITLE);
    }
 
    if (m_bTCSave)
    {
-      if (! bWriteGISFileFloat(GIS_TRANSPORT_CAPACITY, &GIS_TRANSPORT_CAPACITY_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_TRANSPORT_CAPACITY);
+      VpstrTitle.push_back(&GIS_TRANSPORT_CAPACITY_TITLE);
    }
 
    if (m_bCumulAvgDepthSave)
    {
-      if (! bWriteGISFileFloat(GIS_AVG_SURFACE_WATER_DEPTH, &GIS_AVG_SURFACE_WATER_DEPTH_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_AVG_SURFACE_WATER_DEPTH);
+      VpstrTitle.push_back(&GIS_AVG_SURFACE_WATER_DEPTH_TITLE);
    }
 
    if (m_bCumulAvgSpdSave)
    {
-      if (! bWriteGISFileFloat(GIS_AVG_SURFACE_WATER_SPEED, &GIS_AVG_SURFACE_WATER_SPEED_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_AVG_SURFACE_WATER_SPEED);
+      VpstrTitle.push_back(&GIS_AVG_SURFACE_WATER_SPEED_TITLE);
    }
 
    if (m_bCumulAvgDWSpdSave)
    {
-      if (! bWriteGISFileFloat(GIS_AVG_SURFACE_WATER_DW_SPEED, &GIS_AVG_SURFACE_WATER_DW_SPEED_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_AVG_SURFACE_WATER_DW_SPEED);
+      VpstrTitle.push_back(&GIS_AVG_SURFACE_WATER_DW_SPEED_TITLE);
    }
 
    if (m_bSedConcSave)
    {
-      if (! bWriteGISFileFloat(GIS_SEDIMENT_CONCENTRATION, &GIS_SEDIMENT_CONCENTRATION_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_SEDIMENT_CONCENTRATION);
+      VpstrTitle.push_back(&GIS_SEDIMENT_CONCENTRATION_TITLE);
    }
 
    if (m_bSedLoadSave)
    {
-      if (! bWriteGISFileFloat(GIS_SEDIMENT_LOAD, &GIS_SEDIMENT_LOAD_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_SEDIMENT_LOAD);
+      VpstrTitle.push_back(&GIS_SEDIMENT_LOAD_TITLE);
    }
 
    if (m_bAvgSedLoadSave)
    {
-      if (! bWriteGISFileFloat(GIS_AVG_SEDIMENT_LOAD, &GIS_AVG_SEDIMENT_LOAD_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_AVG_SEDIMENT_LOAD);
+      VpstrTitle.push_back(&GIS_AVG_SEDIMENT_LOAD_TITLE);
    }
 
    if (m_bCumulFlowDepositSave)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT, &GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT);
+      VpstrTitle.push_back(&GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT_TITLE);
    }
 
    if (m_bSlumpSave)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_SLUMP_DETACH, &GIS_CUMUL_SLUMP_DETACH_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_SLUMP_DETACH);
+      VpstrTitle.push_back(&GIS_CUMUL_SLUMP_DETACH_TITLE);
 
-      if (! bWriteGISFileFloat(GIS_CUMUL_SLUMP_DEPOSIT, &GIS_CUMUL_SLUMP_DEPOSIT_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_SLUMP_DEPOSIT);
+      VpstrTitle.push_back(&GIS_CUMUL_SLUMP_DEPOSIT_TITLE);
    }
 
    if (m_bToppleSave)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_TOPPLE_DETACH, &GIS_CUMUL_TOPPLE_DETACH_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_TOPPLE_DETACH);
+      VpstrTitle.push_back(&GIS_CUMUL_TOPPLE_DETACH_TITLE);
 
-      if (! bWriteGISFileFloat(GIS_CUMUL_TOPPLE_DEPOSIT, &GIS_CUMUL_TOPPLE_DEPOSIT_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_TOPPLE_DEPOSIT);
+      VpstrTitle.push_back(&GIS_CUMUL_TOPPLE_DEPOSIT_TITLE);
    }
 
    if (m_bCumulLoweringSave)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_ALL_PROC_SURF_LOWER, &GIS_CUMUL_ALL_PROC_SURF_LOWER_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_ALL_PROC_SURF_LOWER);
+      VpstrTitle.push_back(&GIS_CUMUL_ALL_PROC_SURF_LOWER_TITLE);
    }
 
    if (m_bHeadcutRetreat)
    {
-      if (! bWriteGISFileInt(GIS_CUMUL_BINARY_HEADCUT_RETREAT, &GIS_CUMUL_BINARY_HEADCUT_RETREAT_TITLE))
-         return (false);
+      VnDataItem.push_back(GIS_CUMUL_BINARY_HEADCUT_RETREAT);
+      VpstrTitle.push_back(&GIS_CUMUL_BINARY_HEADCUT_RETREAT_TITLE);
    }
-
-   return (true);
 }
 
 //=========================================================================================================================================
@@ -0,0 +1,729 @@
+/*=========================================================================================================================================
+
+This is gis_writer.cpp: the RillGrow class which writes GIS files in the background, while the simulation continues
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <stdint.h>
+
+#include <chrono>
+
+#include <gdal_priv.h>
+#include <cpl_string.h>
+
+#include "rg.h"
+#include "gis_writer.h"
+
+/*=========================================================================================================================================
+
+At each GIS save, the simulation fills a pooled buffer with a snapshot of each field which is to be saved, then hands it to this class, and carries on. The GDAL work (creating the file, writing the data, calculating statistics, and closing the file) is done by one or more writer threads. There is a fixed number of buffers: when all of them are waiting to be written, getting another one blocks until a writer thread has finished with one, so the simulation can never run too far ahead of the output. The writer threads do not write to cerr, instead errors and warnings are kept and passed on to the simulation's thread by bGetMessages(). With no writer threads, each file is written as soon as it is submitted.
+
+The bands of a file are added one at a time, then the file is submitted. A GDAL file may have one band, or (for a multi-band file) all data items in a save. Alternatively, the bands may be appended to the time stack instead: this is a single raw file of 32-bit floating point values, band after band, with an ENVI header (so that GDAL and other tools can read it as one multi-band raster) and a CSV index which gives the save number, time, data item and units of each band. Each band is at a fixed place in the raw file, so a subset of bands can be read without reading the rest. Since the place of each band is fixed when it is submitted, saves may be written by different writer threads in any order.
+
+The statistics of each band are found by the simulation as it fills the band's buffer, and are handed over with the band, so neither GDAL nor the writer threads need to read the data again to find them. After each job is done, a line for each band, with its statistics, is written to the index file, so the results can be monitored without opening the GIS files.
+
+GDAL files are created with the user's creation options (e.g. for tiling and compression), if any. The writer threads keep a count of the files written, the bytes written, and the time taken, so that the cost of the GIS output can be reported at the end of the run.
+
+=========================================================================================================================================*/
+
+//! Constructor for the statistics of a band, with no values
+CGISWriter::CStats::CStats(void)
+:
+   llN(0),
+   dMean(0),
+   dM2(0),
+   dMin(0),
+   dMax(0)
+{
+}
+
+//! Adds nValues values (e.g. a row of a band), ignoring those equal to the missing value fMissing. The values are rounded to 32-bit floats, since this is how they are written
+template <typename T> void CGISWriter::CStats::AddValues(T const* pValue, int const nValues, float const fMissing)
+{
+   double dMissing = fMissing;
+
+   // Sums are of the differences from the first value which is not missing, so that the sum of squares does not lose precision when the mean is large compared to the spread
+   int nFirst = 0;
+   while ((nFirst < nValues) && bFpEQ(static_cast<double>(static_cast<float>(pValue[nFirst])), dMissing, TOLERANCE))
+      nFirst++;
+
+   if (nFirst == nValues)
+      return;
+
+   double
+      dShift = static_cast<float>(pValue[nFirst]),
+      dSum = 0,
+      dSumSq = 0,
+      dRowMin = dShift,
+      dRowMax = dShift;
+   long long llRowN = 0;
+
+#if defined _OPENMP
+   #pragma omp simd reduction(+:llRowN,dSum,dSumSq) reduction(min:dRowMin) reduction(max:dRowMax)
+#endif
+   for (int n = nFirst; n < nValues; n++)
+   {
+      double dX = static_cast<float>(pValue[n]);
+      bool bValid = (! bFpEQ(dX, dMissing, TOLERANCE));
+      double dDiff = (bValid ? dX - dShift : 0);
+
+      llRowN += (bValid ? 1 : 0);
+      dSum += dDiff;
+      dSumSq += dDiff * dDiff;
+      dRowMin = ((bValid && (dX < dRowMin)) ? dX : dRowMin);
+      dRowMax = ((bValid && (dX > dRowMax)) ? dX : dRowMax);
+   }
+
+   CStats Row;
+   Row.llN = llRowN;
+   Row.dMean = dShift + dSum / static_cast<double>(llRowN);
+   Row.dM2 = dSumSq - (dSum * dSum / static_cast<double>(llRowN));
+   if (Row.dM2 < 0)
+      Row.dM2 = 0;
+   Row.dMin = dRowMin;
+   Row.dMax = dRowMax;
+
+   Add(Row);
+}
+
+//! Adds a row of floating-point values, ignoring missing values
+void CGISWriter::CStats::AddRow(float const* pfValue, int const nValues, float const fMissing)
+{
+   AddValues(pfValue, nValues, fMissing);
+}
+
+//! Adds a row of integer values, ignoring missing values
+void CGISWriter::CStats::AddRow(int const* pnValue, int const nValues, float const fMissing)
+{
+   AddValues(pnValue, nValues, fMissing);
+}
+
+//! Combines the statistics of another set of values with these (Chan et al.'s pairwise method)
+void CGISWriter::CStats::Add(CStats const& Other)
+{
+   if (0 == Other.llN)
+      return;
+
+   if (0 == llN)
+   {
+      *this = Other;
+      return;
+   }
+
+   double
+      dN = static_cast<double>(llN),
+      dOtherN = static_cast<double>(Other.llN),
+      dTotN = dN + dOtherN,
+      dDelta = Other.dMean - dMean;
+
+   dMean += dDelta * dOtherN / dTotN;
+   dM2 += Other.dM2 + (dDelta * dDelta * dN * dOtherN / dTotN);
+   if (Other.dMin < dMin)
+      dMin = Other.dMin;
+   if (Other.dMax > dMax)
+      dMax = Other.dMax;
+   llN += Other.llN;
+}
+
+//! Returns the (population) standard deviation, as GDAL does
+double CGISWriter::CStats::dGetStdDev(void) const
+{
+   if (0 == llN)
+      return 0;
+
+   return sqrt(dM2 / static_cast<double>(llN));
+}
+
+//! Constructor
+CGISWriter::CGISWriter(void)
+:
+   m_bStop(false),
+   m_bFailed(false),
+   m_nThreads(0),
+   m_nXGridMax(0),
+   m_nYGridMax(0),
+   m_nWriting(0),
+   m_nStackBands(0),
+   m_nFilesWritten(0),
+   m_llBytesWritten(0),
+   m_dWriteSeconds(0),
+   m_dMissingValue(0)
+{
+   for (int n = 0; n < 6; n++)
+      m_dGeoTransform[n] = 0;
+}
+
+//! Destructor, writes any files which are still waiting then finishes the writer threads
+CGISWriter::~CGISWriter(void)
+{
+   {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      m_bStop = true;
+   }
+   m_CVJobQueued.notify_all();
+
+   for (unsigned int n = 0; n < m_VThread.size(); n++)
+      m_VThread[n].join();
+}
+
+//! Stores the GDAL creation options, each NAME=VALUE, with which every GDAL file is created. Must be called before Start()
+void CGISWriter::SetCreationOptions(vector<string> const& VstrOptions)
+{
+   m_VstrCreationOptions = VstrOptions;
+}
+
+//! Stores the GDAL settings which are the same for every file, makes the pool of nBuffers buffers (which are not allocated until first used), and starts nThreads writer threads
+void CGISWriter::Start(string const& strDriverCode, string const& strProjection, double const* pdGeoTransform, int const nXMax, int const nYMax, double const dMissingValue, int const nThreads, int const nBuffers)
+{
+   m_strDriverCode = strDriverCode;
+   m_strProjection = strProjection;
+   for (int n = 0; n < 6; n++)
+      m_dGeoTransform[n] = pdGeoTransform[n];
+   m_nXGridMax = nXMax;
+   m_nYGridMax = nYMax;
+   m_dMissingValue = dMissingValue;
+   m_nThreads = nThreads;
+
+   // The bands of a multi-band file are written one at a time, which is slow if the file is compressed and the bands are interleaved pixel by pixel. So if the driver can store the bands one after another, and the user has not said otherwise, do this
+   m_VstrMultiBandCreationOptions = m_VstrCreationOptions;
+   GDALDriver* pDriver = GetGDALDriverManager()->GetDriverByName(m_strDriverCode.c_str());
+   char const* pszOptionList = ((NULL == pDriver) ? NULL : pDriver->GetMetadataItem(GDAL_DMD_CREATIONOPTIONLIST));
+   if ((NULL != pszOptionList) && (NULL != strstr(pszOptionList, "name='INTERLEAVE'")) && (NULL != strstr(pszOptionList, "<Value>BAND</Value>")))
+   {
+      char** papszOptions = papszGetGDALOptions(m_VstrCreationOptions);
+      if (NULL == CSLFetchNameValue(papszOptions, "INTERLEAVE"))
+         m_VstrMultiBandCreationOptions.push_back("INTERLEAVE=BAND");
+      CSLDestroy(papszOptions);
+   }
+
+   m_VVfBuffer.resize(nBuffers);
+   m_VVnBuffer.resize(nBuffers);
+   for (int n = nBuffers-1; n >= 0; n--)
+      m_VnFreeBuffer.push_back(n);
+
+   for (int n = 0; n < m_nThreads; n++)
+      m_VThread.push_back(std::thread(&CGISWriter::WriterThread, this));
+}
+
+//! Returns the index of a buffer which is not in use, waiting until a writer thread has finished with one if necessary
+int CGISWriter::nGetFreeBuffer(void)
+{
+   std::unique_lock<std::mutex> Lock(m_Mutex);
+   while (m_VnFreeBuffer.empty())
+      m_CVJobDone.wait(Lock);
+
+   int nBuffer = m_VnFreeBuffer.back();
+   m_VnFreeBuffer.pop_back();
+
+   return nBuffer;
+}
+
+//! Returns a floating-point buffer of m_nXGridMax x m_nYGridMax values (row by row) to be filled, and its index in nBuffer. Waits if all buffers are in use
+float* CGISWriter::pfGetFloatBuffer(int& nBuffer)
+{
+   nBuffer = nGetFreeBuffer();
+   m_VVfBuffer[nBuffer].resize(m_nXGridMax * m_nYGridMax);
+
+   return &m_VVfBuffer[nBuffer][0];
+}
+
+//! Returns an integer buffer of m_nXGridMax x m_nYGridMax values (row by row) to be filled, and its index in nBuffer. Waits if all buffers are in use
+int* CGISWriter::pnGetIntBuffer(int& nBuffer)
+{
+   nBuffer = nGetFreeBuffer();
+   m_VVnBuffer[nBuffer].resize(m_nXGridMax * m_nYGridMax);
+
+   return &m_VVnBuffer[nBuffer][0];
+}
+
+//! Returns the number of pooled buffers
+int CGISWriter::nGetNumBuffers(void) const
+{
+   return static_cast<int>(m_VVfBuffer.size());
+}
+
+//! Adds a filled buffer, with the statistics of its values, as the next band of the file which is to be submitted next
+void CGISWriter::AddBand(int const nBuffer, bool const bInt, string const& strName, string const& strDesc, string const& strUnits, vector<string> const& VstrCategoryNames, CStats const& Stats)
+{
+   CBand Band;
+   Band.bInt = bInt;
+   Band.nBuffer = nBuffer;
+   Band.strName = strName;
+   Band.strDesc = strDesc;
+   Band.strUnits = strUnits;
+   Band.VstrCategoryNames = VstrCategoryNames;
+   Band.Stats = Stats;
+
+   m_VPendingBand.push_back(Band);
+}
+
+//! Hands over the bands added since the last submission, to be written to the GDAL file strFileName as save nSave at simulated time dTime
+void CGISWriter::SubmitFile(string const& strFileName, double const dTime, int const nSave)
+{
+   CJob Job;
+   Job.bTimeStack = false;
+   Job.nFirstBand = 0;
+   Job.nSave = nSave;
+   Job.dTime = dTime;
+   Job.strFileName = strFileName;
+   Job.VBand.swap(m_VPendingBand);
+
+   Queue(Job);
+}
+
+//! Hands over the bands added since the last submission, to be appended to the time stack as save nSave at simulated time dTime
+void CGISWriter::SubmitToTimeStack(double const dTime, int const nSave)
+{
+   CJob Job;
+   Job.bTimeStack = true;
+   Job.nFirstBand = m_nStackBands;
+   Job.nSave = nSave;
+   Job.dTime = dTime;
+   Job.VBand.swap(m_VPendingBand);
+
+   m_nStackBands += static_cast<int>(Job.VBand.size());
+
+   Queue(Job);
+}
+
+//! Writes the bands added since the last submission to the GDAL file strFileName, once with each set of creation options in VVstrOptions, and deletes the file after each write. The time taken and the bytes written are returned in VdSeconds and VllBytes, these are negative if the file could not be written. This is done by the calling thread, and is not counted in the totals. Returns false if any write failed, with the errors in VstrMessage
+bool CGISWriter::bBenchmark(string const& strFileName, vector<vector<string> > const& VVstrOptions, vector<double>& VdSeconds, vector<long long>& VllBytes, vector<string>& VstrMessage)
+{
+   CJob Job;
+   Job.bTimeStack = false;
+   Job.nFirstBand = 0;
+   Job.nSave = 0;
+   Job.dTime = 0;
+   Job.strFileName = strFileName;
+   Job.VBand.swap(m_VPendingBand);
+
+   GDALDriver* pDriver = GetGDALDriverManager()->GetDriverByName(m_strDriverCode.c_str());
+
+   bool bOK = true;
+   for (unsigned int n = 0; n < VVstrOptions.size(); n++)
+   {
+      long long llBytes = 0;
+      std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+      if (bWriteFile(&Job, &VVstrOptions[n], &VstrMessage, &llBytes))
+      {
+         VdSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count());
+         VllBytes.push_back(llBytes);
+      }
+      else
+      {
+         VdSeconds.push_back(-1);
+         VllBytes.push_back(-1);
+         bOK = false;
+      }
+
+      CPLPushErrorHandler(CPLQuietErrorHandler);                        // Needed to get next line to fail silently, if it fails
+      pDriver->Delete(strFileName.c_str());
+      CPLPopErrorHandler();
+   }
+
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   for (unsigned int n = 0; n < Job.VBand.size(); n++)
+      m_VnFreeBuffer.push_back(Job.VBand[n].nBuffer);
+
+   return bOK;
+}
+
+//! Queues a job for the writer threads, this returns at once. With no writer threads, the job is done before this returns
+void CGISWriter::Queue(CJob const& Job)
+{
+   if (0 == m_nThreads)
+   {
+      vector<string> VstrMessage;
+      bool bOK = bWrite(&Job, &VstrMessage);
+
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      m_VstrMessage.insert(m_VstrMessage.end(), VstrMessage.begin(), VstrMessage.end());
+      if (! bOK)
+         m_bFailed = true;
+      for (unsigned int n = 0; n < Job.VBand.size(); n++)
+         m_VnFreeBuffer.push_back(Job.VBand[n].nBuffer);
+
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      m_DJob.push_back(Job);
+   }
+   m_CVJobQueued.notify_one();
+}
+
+//! Waits until every file which has been submitted is written
+void CGISWriter::WaitForAll(void)
+{
+   std::unique_lock<std::mutex> Lock(m_Mutex);
+   while ((! m_DJob.empty()) || (m_nWriting > 0))
+      m_CVJobDone.wait(Lock);
+}
+
+//! Moves the errors and warnings from files written since the last call into VstrMessage, returns false if any of these files could not be written
+bool CGISWriter::bGetMessages(vector<string>& VstrMessage)
+{
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   VstrMessage.swap(m_VstrMessage);
+   m_VstrMessage.clear();
+
+   bool bOK = (! m_bFailed);
+   m_bFailed = false;
+
+   return bOK;
+}
+
+//! The body of each writer thread: takes files from the queue and writes them, until told to stop and the queue is empty
+void CGISWriter::WriterThread(void)
+{
+   while (true)
+   {
+      CJob Job;
+      {
+         std::unique_lock<std::mutex> Lock(m_Mutex);
+         while ((! m_bStop) && m_DJob.empty())
+            m_CVJobQueued.wait(Lock);
+
+         if (m_DJob.empty())
+            return;
+
+         Job = m_DJob.front();
+         m_DJob.pop_front();
+         m_nWriting++;
+      }
+
+      vector<string> VstrMessage;
+      bool bOK = bWrite(&Job, &VstrMessage);
+
+      {
+         std::lock_guard<std::mutex> Lock(m_Mutex);
+         m_VstrMessage.insert(m_VstrMessage.end(), VstrMessage.begin(), VstrMessage.end());
+         if (! bOK)
+            m_bFailed = true;
+         for (unsigned int n = 0; n < Job.VBand.size(); n++)
+            m_VnFreeBuffer.push_back(Job.VBand[n].nBuffer);
+         m_nWriting--;
+      }
+      m_CVJobDone.notify_all();
+   }
+}
+
+//! Returns the number of GDAL files and time stack saves written so far, the bytes written, and the time (in sec, summed over all writer threads) taken to write them
+void CGISWriter::GetWriteTotals(int& nFiles, long long& llBytes, double& dSeconds)
+{
+   std::lock_guard<std::mutex> Lock(m_Mutex);
+   nFiles = m_nFilesWritten;
+   llBytes = m_llBytesWritten;
+   dSeconds = m_dWriteSeconds;
+}
+
+//! Does one job, i.e. writes a GDAL file or appends a save to the time stack. Errors and warnings are appended to pVstrMessage rather than written to cerr, since this may not be the main thread. Returns false if the job could not be done
+bool CGISWriter::bWrite(CJob const* pJob, vector<string>* pVstrMessage)
+{
+   std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+   bool bOK;
+   long long llBytes = 0;
+   if (pJob->bTimeStack)
+   {
+      bOK = bAppendToTimeStack(pJob, pVstrMessage);
+      llBytes = static_cast<long long>(pJob->VBand.size()) * m_nXGridMax * m_nYGridMax * static_cast<long long>(sizeof(float));
+   }
+   else
+      bOK = bWriteFile(pJob, ((pJob->VBand.size() > 1) ? &m_VstrMultiBandCreationOptions : &m_VstrCreationOptions), pVstrMessage, &llBytes);
+
+   double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+   if (bOK)
+   {
+      WriteIndex(pJob, pVstrMessage);
+
+      std::lock_guard<std::mutex> Lock(m_Mutex);
+      m_nFilesWritten++;
+      m_llBytesWritten += llBytes;
+      m_dWriteSeconds += dSeconds;
+   }
+
+   return bOK;
+}
+
+//! Writes one GIS file, with one or more bands, using GDAL with the creation options in pVstrOptions. The size of the file, including any auxiliary files, is returned in pllBytes. Returns false if the file could not be written
+bool CGISWriter::bWriteFile(CJob const* pJob, vector<string> const* pVstrOptions, vector<string>* pVstrMessage, long long* pllBytes)
+{
+   GDALDriver* pDriver;
+   pDriver = GetGDALDriverManager()->GetDriverByName(m_strDriverCode.c_str());
+   GDALDataset* pOutDataSet;
+   char** papszOptions = papszGetGDALOptions(*pVstrOptions);            // For driver-specific options
+   int nBands = static_cast<int>(pJob->VBand.size());
+   pOutDataSet = pDriver->Create(pJob->strFileName.c_str(), m_nXGridMax, m_nYGridMax, nBands, GDT_Float32, papszOptions);
+   CSLDestroy(papszOptions);
+   if (NULL == pOutDataSet)
+   {
+      // Couldn't create file
+      pVstrMessage->push_back(ERR + "cannot create " + m_strDriverCode + " file named " + pJob->strFileName + "\n" + CPLGetLastErrorMsg());
+      return false;
+   }
+
+   // Set projection info for output dataset (will be same as was read in from DEM)
+   CPLPushErrorHandler(CPLQuietErrorHandler);                           // Needed to get next line to fail silently, if it fails
+   pOutDataSet->SetProjection(m_strProjection.c_str());                 // Will fail for some formats
+   CPLPopErrorHandler();
+
+   // Set geotransformation info for output dataset (will be same as was read in from DEM)
+   if (CE_Failure == pOutDataSet->SetGeoTransform(m_dGeoTransform))
+      pVstrMessage->push_back(WARN + "cannot write geotransformation information to " + m_strDriverCode + " file named " + pJob->strFileName + "\n" + CPLGetLastErrorMsg());
+
+   for (int nBand = 0; nBand < nBands; nBand++)
+   {
+      CBand const* pJobBand = &pJob->VBand[nBand];
+
+      // Now write the data for this band
+      GDALRasterBand* pBand;
+      pBand = pOutDataSet->GetRasterBand(nBand + 1);
+      CPLErr eErr;
+      if (pJobBand->bInt)
+         eErr = pBand->RasterIO(GF_Write, 0, 0, m_nXGridMax, m_nYGridMax, &m_VVnBuffer[pJobBand->nBuffer][0], m_nXGridMax, m_nYGridMax, GDT_Int32, 0, 0);
+      else
+         eErr = pBand->RasterIO(GF_Write, 0, 0, m_nXGridMax, m_nYGridMax, &m_VVfBuffer[pJobBand->nBuffer][0], m_nXGridMax, m_nYGridMax, GDT_Float32, 0, 0);
+
+      if (CE_Failure == eErr)
+      {
+         // Write error, better error message
+         pVstrMessage->push_back(ERR + "cannot write data for " + m_strDriverCode + " file named " + pJob->strFileName + "\n" + CPLGetLastErrorMsg());
+         delete pOutDataSet;
+         return false;
+      }
+
+      // Write the statistics, which were found as the buffer was filled, fail silently if not supported by this format. There are none if every value is missing
+      CStats const* pStats = &pJobBand->Stats;
+      if (pStats->llN > 0)
+      {
+         CPLPushErrorHandler(CPLQuietErrorHandler);                     // Needed to get next line to fail silently, if it fails
+         pBand->SetStatistics(pStats->dMin, pStats->dMax, pStats->dMean, pStats->dGetStdDev());
+         CPLPopErrorHandler();
+      }
+
+      CPLPushErrorHandler(CPLQuietErrorHandler);                        // Needed to get next line to fail silently, if it fails
+      pBand->SetUnitType(pJobBand->strUnits.c_str());                   // Not supported for some GIS formats
+      CPLPopErrorHandler();
+
+      // Tell the output dataset about missing values
+      CPLPushErrorHandler(CPLQuietErrorHandler);                        // Needed to get next line to fail silently, if it fails
+      pBand->SetNoDataValue(m_dMissingValue);                           // Will fail for some formats
+      CPLPopErrorHandler();
+
+      // Set the GDAL description
+      pBand->SetDescription(pJobBand->strDesc.c_str());
+
+      // Set raster category names, if any
+      if (! pJobBand->VstrCategoryNames.empty())
+      {
+         char** papszCategoryNames = NULL;
+         for (unsigned int n = 0; n < pJobBand->VstrCategoryNames.size(); n++)
+            papszCategoryNames = CSLAddString(papszCategoryNames, pJobBand->VstrCategoryNames[n].c_str());
+
+         CPLPushErrorHandler(CPLQuietErrorHandler);                     // Needed to get next line to fail silently, if it fails
+         pBand->SetCategoryNames(papszCategoryNames);                   // Not supported for some GIS formats
+         CPLPopErrorHandler();
+
+         CSLDestroy(papszCategoryNames);
+      }
+   }
+
+   // Finished, so get rid of dataset object, this is when most formats finish writing (and compressing) the data
+   char** papszFiles = pOutDataSet->GetFileList();
+   delete pOutDataSet;
+
+   // Now add up the size of the file, and of any auxiliary files
+   *pllBytes = 0;
+   for (int n = 0; n < CSLCount(papszFiles); n++)
+   {
+      VSIStatBufL sStat;
+      if (0 == VSIStatL(papszFiles[n], &sStat))
+         *pllBytes += static_cast<long long>(sStat.st_size);
+   }
+   CSLDestroy(papszFiles);
+
+   return true;
+}
+
+//! Returns a GDAL string list made from the strings in VstrOptions, each NAME=VALUE. The caller must free this using CSLDestroy()
+char** CGISWriter::papszGetGDALOptions(vector<string> const& VstrOptions)
+{
+   char** papszOptions = NULL;
+   for (unsigned int n = 0; n < VstrOptions.size(); n++)
+      papszOptions = CSLAddString(papszOptions, VstrOptions[n].c_str());
+
+   return papszOptions;
+}
+
+//! Creates the time stack's raw data file strStackFile. The ENVI header strHeaderFile is written after each save is appended. Must be called before any saves are submitted to the time stack. Returns false if the file cannot be created
+bool CGISWriter::bOpenTimeStack(string const& strStackFile, string const& strHeaderFile)
+{
+   m_strStackFile = strStackFile;
+   m_strStackHeaderFile = strHeaderFile;
+
+   m_ofsStack.open(m_strStackFile.c_str(), ios::out | ios::binary | ios::trunc);
+   if (! m_ofsStack)
+      return false;
+
+   vector<string> VstrMessage;
+   return bWriteTimeStackHeader(&VstrMessage);
+}
+
+//! Creates the index file strIndexFile, this is a CSV file with one line for each band written. Must be called before any files are submitted. Returns false if the file cannot be created
+bool CGISWriter::bOpenIndex(string const& strIndexFile)
+{
+   m_strIndexFile = strIndexFile;
+
+   m_ofsIndex.open(m_strIndexFile.c_str(), ios::out | ios::trunc);
+   if (! m_ofsIndex)
+      return false;
+
+   m_ofsIndex << "Save,Time (sec),Data item,File,Band,Description,Units,Valid cells,Min,Max,Mean,Std dev" << endl;
+
+   return true;
+}
+
+//! Writes a line to the index file for each band of a job which has been done, giving where the band is, and its statistics
+void CGISWriter::WriteIndex(CJob const* pJob, vector<string>* pVstrMessage)
+{
+   std::lock_guard<std::mutex> Lock(m_IndexMutex);
+
+   if (! m_ofsIndex.is_open())
+      return;
+
+   // The files are in the same directory as the index, so leave out the path
+   string strFile = (pJob->bTimeStack ? m_strStackFile : pJob->strFileName);
+   size_t nPos = strFile.find_last_of("/\\");
+   if (nPos != string::npos)
+      strFile = strFile.substr(nPos + 1);
+
+   for (unsigned int n = 0; n < pJob->VBand.size(); n++)
+   {
+      CBand const* pJobBand = &pJob->VBand[n];
+      int nBand = (pJob->bTimeStack ? pJob->nFirstBand : 0) + static_cast<int>(n) + 1;
+
+      m_ofsIndex << pJob->nSave << "," << std::fixed << setprecision(3) << pJob->dTime << "," << pJobBand->strName << "," << strFile << "," << nBand << ",\"" << pJobBand->strDesc << "\"," << pJobBand->strUnits << "," << pJobBand->Stats.llN;
+      if (pJobBand->Stats.llN > 0)
+         m_ofsIndex << std::resetiosflags(ios::floatfield) << setprecision(10) << "," << pJobBand->Stats.dMin << "," << pJobBand->Stats.dMax << "," << pJobBand->Stats.dMean << "," << pJobBand->Stats.dGetStdDev();
+      else
+         m_ofsIndex << ",,,,";
+      m_ofsIndex << endl;
+   }
+
+   if (! m_ofsIndex)
+      pVstrMessage->push_back(WARN + "cannot write to GIS index file " + m_strIndexFile);
+}
+
+//! Appends the bands of one save to the time stack, then rewrites the ENVI header so that the stack can be read at any time. Returns false if the bands could not be written
+bool CGISWriter::bAppendToTimeStack(CJob const* pJob, vector<string>* pVstrMessage)
+{
+   std::lock_guard<std::mutex> Lock(m_StackMutex);
+
+   int
+      nBands = static_cast<int>(pJob->VBand.size()),
+      nCells = m_nXGridMax * m_nYGridMax;
+   vector<float> VfInt;
+
+   for (int nBand = 0; nBand < nBands; nBand++)
+   {
+      CBand const* pJobBand = &pJob->VBand[nBand];
+
+      // Everything in the stack is floating point, so convert any integer data
+      float const* pfData;
+      if (pJobBand->bInt)
+      {
+         vector<int> const* pVnData = &m_VVnBuffer[pJobBand->nBuffer];
+         VfInt.resize(nCells);
+         for (int n = 0; n < nCells; n++)
+            VfInt[n] = static_cast<float>((*pVnData)[n]);
+         pfData = &VfInt[0];
+      }
+      else
+         pfData = &m_VVfBuffer[pJobBand->nBuffer][0];
+
+      // Each band has a fixed place in the file
+      int nStackBand = pJob->nFirstBand + nBand;
+      m_ofsStack.seekp(static_cast<std::streamoff>(nStackBand) * nCells * static_cast<std::streamoff>(sizeof(float)));
+      m_ofsStack.write(reinterpret_cast<char const*>(pfData), static_cast<std::streamsize>(nCells * sizeof(float)));
+      if (! m_ofsStack)
+      {
+         pVstrMessage->push_back(ERR + "cannot write data for save " + to_string(pJob->nSave) + " to " + m_strStackFile);
+         return false;
+      }
+
+      // ENVI band names are separated by commas, so must not contain them
+      string strBandName = pJobBand->strDesc;
+      for (unsigned int n = 0; n < strBandName.size(); n++)
+      {
+         if ((',' == strBandName[n]) || ('{' == strBandName[n]) || ('}' == strBandName[n]))
+            strBandName[n] = ' ';
+      }
+
+      if (nStackBand >= static_cast<int>(m_VstrStackBandName.size()))
+         m_VstrStackBandName.resize(nStackBand + 1);
+      m_VstrStackBandName[nStackBand] = strBandName;
+   }
+
+   m_ofsStack.flush();
+
+   return bWriteTimeStackHeader(pVstrMessage);
+}
+
+//! Writes the ENVI header of the time stack, for all bands which have been appended so far. Returns false if the header could not be written
+bool CGISWriter::bWriteTimeStackHeader(vector<string>* pVstrMessage)
+{
+   ofstream ofsHeader(m_strStackHeaderFile.c_str(), ios::out | ios::trunc);
+   if (! ofsHeader)
+   {
+      pVstrMessage->push_back(ERR + "cannot write ENVI header file " + m_strStackHeaderFile);
+      return false;
+   }
+
+   // ENVI byte order 0 is little-endian, 1 is big-endian
+   uint16_t const nOne = 1;
+   int nByteOrder = ((1 == *reinterpret_cast<unsigned char const*>(&nOne)) ? 0 : 1);
+
+   ofsHeader << "ENVI" << endl;
+   ofsHeader << "description = {RillGrow GIS saves, stacked in time}" << endl;
+   ofsHeader << "samples = " << m_nXGridMax << endl;
+   ofsHeader << "lines = " << m_nYGridMax << endl;
+   ofsHeader << "bands = " << m_VstrStackBandName.size() << endl;
+   ofsHeader << "header offset = 0" << endl;
+   ofsHeader << "file type = ENVI Standard" << endl;
+   ofsHeader << "data type = 4" << endl;                           // 32-bit floating point
+   ofsHeader << "interleave = bsq" << endl;
+   ofsHeader << "byte order = " << nByteOrder << endl;
+   ofsHeader << setprecision(15) << "data ignore value = " << m_dMissingValue << endl;
+
+   // The geotransformation can only be given if the grid is not rotated
+   if (bFpEQ(m_dGeoTransform[2], 0.0, TOLERANCE) && bFpEQ(m_dGeoTransform[4], 0.0, TOLERANCE))
+      ofsHeader << "map info = {Arbitrary, 1, 1, " << m_dGeoTransform[0] << ", " << m_dGeoTransform[3] << ", " << m_dGeoTransform[1] << ", " << -m_dGeoTransform[5] << "}" << endl;
+
+   if (! m_strProjection.empty())
+      ofsHeader << "coordinate system string = {" << m_strProjection << "}" << endl;
+
+   ofsHeader << "band names = {";
+   for (unsigned int n = 0; n < m_VstrStackBandName.size(); n++)
+      ofsHeader << (n > 0 ? ",\n " : "\n ") << m_VstrStackBandName[n];
+   ofsHeader << "}" << endl;
+
+   if (! ofsHeader)
+   {
+      pVstrMessage->push_back(ERR + "cannot write ENVI header file " + m_strStackHeaderFile);
+      return false;
+   }
+
+   return true;
+}
@@ -0,0 +1,252 @@
+#ifndef __GIS_WRITER_H__
+   #define __GIS_WRITER_H__
+/*=========================================================================================================================================
+
+This is gis_writer.h: declaration for the RillGrow class which writes GIS files in the background, while the simulation continues
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <deque>
+using std::deque;
+
+#include <fstream>
+using std::ofstream;
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class CGISWriter
+{
+public:
+   //! Statistics of the values in a band, ignoring missing values. These are accumulated row by row as the band's buffer is filled, so that the buffer need not be read again to find them
+   class CStats
+   {
+   private:
+      template <typename T> void AddValues(T const*, int const, float const);
+
+   public:
+      //! The number of values which are not missing
+      long long llN;
+
+      //! The mean
+      double dMean;
+
+      //! The sum of the squared differences from the mean
+      double dM2;
+
+      //! The minimum
+      double dMin;
+
+      //! The maximum
+      double dMax;
+
+      CStats(void);
+      void AddRow(float const*, int const, float const);
+      void AddRow(int const*, int const, float const);
+      void Add(CStats const&);
+      double dGetStdDev(void) const;
+   };
+
+private:
+   //! One band of a GIS file, i.e. the values of one data item
+   class CBand
+   {
+   public:
+      //! Is the data integer, rather than floating point?
+      bool bInt;
+
+      //! The pooled buffer which holds the data
+      int nBuffer;
+
+      //! The short name of the data item
+      string strName;
+
+      //! The GDAL description of the band
+      string strDesc;
+
+      //! The value units of the band
+      string strUnits;
+
+      //! The GDAL category names of the band, empty if none
+      vector<string> VstrCategoryNames;
+
+      //! The statistics of the band
+      CStats Stats;
+   };
+
+   //! A GIS file, or a save to be appended to the time stack, which has been filled and is waiting to be written
+   class CJob
+   {
+   public:
+      //! Is this a save to be appended to the time stack, rather than a GDAL file?
+      bool bTimeStack;
+
+      //! For the time stack, the index of the first band of this save in the stack
+      int nFirstBand;
+
+      //! The save number
+      int nSave;
+
+      //! The simulated time of the save
+      double dTime;
+
+      //! For a GDAL file, the name of the file
+      string strFileName;
+
+      //! The bands, in order
+      vector<CBand> VBand;
+   };
+
+   //! Set when the writer threads must finish
+   bool m_bStop;
+
+   //! Set when the writing of any file has failed
+   bool m_bFailed;
+
+   //! The number of background writer threads, zero if files are written by the thread which submits them
+   int m_nThreads;
+
+   //! The number of columns in the grid
+   int m_nXGridMax;
+
+   //! The number of rows in the grid
+   int m_nYGridMax;
+
+   //! The number of files which have been taken from the queue by a writer thread, but not yet written
+   int m_nWriting;
+
+   //! The number of bands which have been submitted to the time stack
+   int m_nStackBands;
+
+   //! The number of GDAL files, and saves appended to the time stack, which have been written
+   int m_nFilesWritten;
+
+   //! The number of bytes written to GDAL files and the time stack
+   long long m_llBytesWritten;
+
+   //! The total time (in sec) taken by the writer threads to write, and in most formats encode, the GDAL files and the time stack
+   double m_dWriteSeconds;
+
+   //! The GDAL missing value
+   double m_dMissingValue;
+
+   //! The GDAL geotransformation information (same as for the DEM)
+   double m_dGeoTransform[6];
+
+   //! The GDAL code of the output format
+   string m_strDriverCode;
+
+   //! The GDAL projection (same as for the DEM)
+   string m_strProjection;
+
+   //! The GDAL creation options, each NAME=VALUE, for single-band files
+   vector<string> m_VstrCreationOptions;
+
+   //! The GDAL creation options for multi-band files, these may also ask for the bands to be stored one after another
+   vector<string> m_VstrMultiBandCreationOptions;
+
+   //! The pooled floating-point buffers, each is allocated when first used
+   vector<vector<float> > m_VVfBuffer;
+
+   //! The pooled integer buffers, each is allocated when first used
+   vector<vector<int> > m_VVnBuffer;
+
+   //! The indices of the pooled buffers which are not in use
+   vector<int> m_VnFreeBuffer;
+
+   //! Errors and warnings from the writer threads, not yet passed on
+   vector<string> m_VstrMessage;
+
+   //! The files waiting to be written
+   deque<CJob> m_DJob;
+
+   //! The bands added since the last file was submitted, only used by the thread which submits files
+   vector<CBand> m_VPendingBand;
+
+   //! The name of the time stack's raw data file, empty if there is no time stack
+   string m_strStackFile;
+
+   //! The name of the time stack's ENVI header file
+   string m_strStackHeaderFile;
+
+   //! The time stack's raw data file
+   ofstream m_ofsStack;
+
+   //! The name of the index file
+   string m_strIndexFile;
+
+   //! The index file, one line per band written, with its statistics. Not used if empty
+   ofstream m_ofsIndex;
+
+   //! The ENVI band name of each band in the time stack
+   vector<string> m_VstrStackBandName;
+
+   //! Protects the time stack, so that only one writer thread appends to it at a time
+   std::mutex m_StackMutex;
+
+   //! Protects the index file, so that only one writer thread writes to it at a time
+   std::mutex m_IndexMutex;
+
+   //! The writer threads
+   vector<std::thread> m_VThread;
+
+   //! Protects everything above which is shared between threads
+   std::mutex m_Mutex;
+
+   //! Signalled when a file is added to the queue, or the writer threads must finish
+   std::condition_variable m_CVJobQueued;
+
+   //! Signalled when a file has been written, so its buffer is free
+   std::condition_variable m_CVJobDone;
+
+   void WriterThread(void);
+   bool bWrite(CJob const*, vector<string>*);
+   bool bWriteFile(CJob const*, vector<string> const*, vector<string>*, long long*);
+   bool bAppendToTimeStack(CJob const*, vector<string>*);
+   bool bWriteTimeStackHeader(vector<string>*);
+   void WriteIndex(CJob const*, vector<string>*);
+   void Queue(CJob const&);
+   int nGetFreeBuffer(void);
+
+public:
+   CGISWriter(void);
+   ~CGISWriter(void);
+
+   void SetCreationOptions(vector<string> const&);
+   void Start(string const&, string const&, double const*, int const, int const, double const, int const, int const);
+
+   float* pfGetFloatBuffer(int&);
+   int* pnGetIntBuffer(int&);
+   int nGetNumBuffers(void) const;
+   bool bOpenTimeStack(string const&, string const&);
+   bool bOpenIndex(string const&);
+
+   void AddBand(int const, bool const, string const&, string const&, string const&, vector<string> const&, CStats const&);
+   void SubmitFile(string const&, double const, int const);
+   void SubmitToTimeStack(double const, int const);
+
+   bool bBenchmark(string const&, vector<vector<string> > const&, vector<double>&, vector<long long>&, vector<string>&);
+
+   void WaitForAll(void);
+   bool bGetMessages(vector<string>&);
+   void GetWriteTotals(int&, long long&, double&);
+
+   static char** papszGetGDALOptions(vector<string> const&);
+};
+#endif         // __GIS_WRITER_H__
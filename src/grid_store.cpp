@@ -0,0 +1,665 @@
+/*=========================================================================================================================================
+
+This is grid_store.cpp: implementations of the RillGrow class which holds the frequently-accessed per-cell fields as one contiguous array per field
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#if defined _WIN32
+   #include <malloc.h>
+#endif
+
+#include <algorithm>
+using std::sort;
+using std::inplace_merge;
+
+#include "rg.h"
+#include "grid_store.h"
+
+//! Allocates an array of nNum elements of type T, aligned on a GRID_STORE_ALIGNMENT boundary. Returns NULL if the allocation fails
+template <class T> static T* pAlignedAlloc(int const nNum)
+{
+   void* pMem = NULL;
+   size_t nBytes = static_cast<size_t>(nNum) * sizeof(T);
+
+#if defined _WIN32
+   pMem = _aligned_malloc(nBytes, GRID_STORE_ALIGNMENT);
+#else
+   if (posix_memalign(&pMem, GRID_STORE_ALIGNMENT, nBytes) != 0)
+      pMem = NULL;
+#endif
+
+   return static_cast<T*>(pMem);
+}
+
+//! Frees an array which was allocated by pAlignedAlloc()
+static void AlignedFree(void* pMem)
+{
+   if (pMem == NULL)
+      return;
+
+#if defined _WIN32
+   _aligned_free(pMem);
+#else
+   free(pMem);
+#endif
+}
+
+//! Constructor with initialization list
+CGridStore::CGridStore(void)
+:
+   m_nXGridMax(0),
+   m_nYGridMax(0),
+   m_nCells(0),
+   m_nActiveMaskWords(0),
+   m_nActiveCells(0),
+   m_nPadYGridMax(0),
+   m_nLayers(0),
+   m_pnFlowDirection(NULL),
+   m_puActiveMask(NULL),
+   m_pdSurfaceWaterDepth(NULL),
+   m_pdTmpSurfaceWaterDepth(NULL),
+   m_pdSoilSurfaceElev(NULL),
+   m_pdTopElev(NULL),
+   m_pdClaySedLoad(NULL),
+   m_pdSiltSedLoad(NULL),
+   m_pdSandSedLoad(NULL),
+   m_pnOutFlowTo(NULL),
+   m_pdOutFlowWater(NULL),
+   m_pdOutFlowClaySed(NULL),
+   m_pdOutFlowSiltSed(NULL),
+   m_pdOutFlowSandSed(NULL),
+   m_pdOutFlowDetach(NULL),
+   m_pdOutFlowHead(NULL),
+   m_pdOutFlowSpeed(NULL),
+   m_pucOutFlowInitVelocity(NULL),
+   m_pucOffGrid(NULL),
+   m_pdActiveWeight(NULL),
+   m_pdSentinelTopElev(NULL),
+   m_pnSteepestDirection(NULL),
+   m_pdSteepestTopDiff(NULL),
+   m_pdSteepestTopSlope(NULL),
+   m_pdSteepestHLen(NULL),
+   m_pucWetSideNeighbours(NULL),
+   m_pdHydraulicRadius(NULL),
+   m_pdReynolds(NULL),
+   m_pucSedFlow(NULL),
+   m_pnSedFlowTo(NULL),
+   m_pnSedFlowDirection(NULL),
+   m_pdSedFlowWaterDepth(NULL),
+   m_pdSedFlowHead(NULL),
+   m_pdSedFlowTopSlope(NULL),
+   m_pdSedFlowHLen(NULL),
+   m_pdSedFlowSpeed(NULL),
+   m_pdSedFlowMoveDepth(NULL),
+   m_pdSedFlowBulkDensity(NULL),
+   m_pdSedFlowStreamPower(NULL),
+   m_pdSedFlowTransportCapacity(NULL),
+   m_pdSedFlowLoadWt(NULL),
+   m_pdSedFlowThickLost(NULL),
+   m_pdLaplacian(NULL),
+   m_pdRawShearStress(NULL),
+   m_pdLayerSoilWater(NULL),
+   m_pdLayerThickness(NULL),
+   m_pucWetActive(NULL),
+   m_pucRainHit(NULL)
+{
+   for (int n = 0; n < 8; n++)
+      m_nNeighbourOffset[n] = 0;
+}
+
+//! Destructor
+CGridStore::~CGridStore(void)
+{
+   AlignedFree(m_pnFlowDirection);
+   AlignedFree(m_puActiveMask);
+   AlignedFree(m_pdSurfaceWaterDepth);
+   AlignedFree(m_pdTmpSurfaceWaterDepth);
+   AlignedFree(m_pdSoilSurfaceElev);
+   AlignedFree(m_pdTopElev);
+   AlignedFree(m_pdClaySedLoad);
+   AlignedFree(m_pdSiltSedLoad);
+   AlignedFree(m_pdSandSedLoad);
+   AlignedFree(m_pnOutFlowTo);
+   AlignedFree(m_pdOutFlowWater);
+   AlignedFree(m_pdOutFlowClaySed);
+   AlignedFree(m_pdOutFlowSiltSed);
+   AlignedFree(m_pdOutFlowSandSed);
+   AlignedFree(m_pdOutFlowDetach);
+   AlignedFree(m_pdOutFlowHead);
+   AlignedFree(m_pdOutFlowSpeed);
+   AlignedFree(m_pucOutFlowInitVelocity);
+   AlignedFree(m_pucOffGrid);
+   AlignedFree(m_pdActiveWeight);
+   AlignedFree(m_pdSentinelTopElev);
+   AlignedFree(m_pnSteepestDirection);
+   AlignedFree(m_pdSteepestTopDiff);
+   AlignedFree(m_pdSteepestTopSlope);
+   AlignedFree(m_pdSteepestHLen);
+   AlignedFree(m_pucWetSideNeighbours);
+   AlignedFree(m_pdHydraulicRadius);
+   AlignedFree(m_pdReynolds);
+   AlignedFree(m_pucSedFlow);
+   AlignedFree(m_pnSedFlowTo);
+   AlignedFree(m_pnSedFlowDirection);
+   AlignedFree(m_pdSedFlowWaterDepth);
+   AlignedFree(m_pdSedFlowHead);
+   AlignedFree(m_pdSedFlowTopSlope);
+   AlignedFree(m_pdSedFlowHLen);
+   AlignedFree(m_pdSedFlowSpeed);
+   AlignedFree(m_pdSedFlowMoveDepth);
+   AlignedFree(m_pdSedFlowBulkDensity);
+   AlignedFree(m_pdSedFlowStreamPower);
+   AlignedFree(m_pdSedFlowTransportCapacity);
+   AlignedFree(m_pdSedFlowLoadWt);
+   AlignedFree(m_pdSedFlowThickLost);
+   AlignedFree(m_pdLaplacian);
+   AlignedFree(m_pdRawShearStress);
+   AlignedFree(m_pdLayerSoilWater);
+   AlignedFree(m_pdLayerThickness);
+   AlignedFree(m_pucWetActive);
+   AlignedFree(m_pucRainHit);
+}
+
+//! Allocates and initializes the per-field arrays for a grid of nXMax x nYMax cells, surrounded by a one-cell halo. Returns false if memory cannot be allocated
+bool CGridStore::bAllocate(int const nXMax, int const nYMax)
+{
+   m_nXGridMax = nXMax;
+   m_nYGridMax = nYMax;
+   m_nPadYGridMax = nYMax + 2;
+   m_nCells = (nXMax + 2) * m_nPadYGridMax;
+   m_nActiveMaskWords = (m_nCells + 31) / 32;
+
+   m_nNeighbourOffset[DIRECTION_TOP] = -1;
+   m_nNeighbourOffset[DIRECTION_TOP_RIGHT] = m_nPadYGridMax - 1;
+   m_nNeighbourOffset[DIRECTION_RIGHT] = m_nPadYGridMax;
+   m_nNeighbourOffset[DIRECTION_BOTTOM_RIGHT] = m_nPadYGridMax + 1;
+   m_nNeighbourOffset[DIRECTION_BOTTOM] = 1;
+   m_nNeighbourOffset[DIRECTION_BOTTOM_LEFT] = -m_nPadYGridMax + 1;
+   m_nNeighbourOffset[DIRECTION_LEFT] = -m_nPadYGridMax;
+   m_nNeighbourOffset[DIRECTION_TOP_LEFT] = -m_nPadYGridMax - 1;
+
+   m_pnFlowDirection = pAlignedAlloc<int>(m_nCells);
+   m_puActiveMask = pAlignedAlloc<unsigned int>(m_nActiveMaskWords);
+   m_pdSurfaceWaterDepth = pAlignedAlloc<double>(m_nCells);
+   m_pdTmpSurfaceWaterDepth = pAlignedAlloc<double>(m_nCells);
+   m_pdSoilSurfaceElev = pAlignedAlloc<double>(m_nCells);
+   m_pdTopElev = pAlignedAlloc<double>(m_nCells);
+   m_pdClaySedLoad = pAlignedAlloc<double>(m_nCells);
+   m_pdSiltSedLoad = pAlignedAlloc<double>(m_nCells);
+   m_pdSandSedLoad = pAlignedAlloc<double>(m_nCells);
+   m_pnOutFlowTo = pAlignedAlloc<int>(m_nCells);
+   m_pdOutFlowWater = pAlignedAlloc<double>(m_nCells);
+   m_pdOutFlowClaySed = pAlignedAlloc<double>(m_nCells);
+   m_pdOutFlowSiltSed = pAlignedAlloc<double>(m_nCells);
+   m_pdOutFlowSandSed = pAlignedAlloc<double>(m_nCells);
+   m_pdOutFlowDetach = pAlignedAlloc<double>(m_nCells);
+   m_pdOutFlowHead = pAlignedAlloc<double>(m_nCells);
+   m_pdOutFlowSpeed = pAlignedAlloc<double>(m_nCells);
+   m_pucOutFlowInitVelocity = pAlignedAlloc<unsigned char>(m_nCells);
+   m_pucOffGrid = pAlignedAlloc<unsigned char>(m_nCells);
+   m_pdActiveWeight = pAlignedAlloc<double>(m_nCells);
+   m_pdSentinelTopElev = pAlignedAlloc<double>(m_nCells);
+   m_pnSteepestDirection = pAlignedAlloc<int>(m_nCells);
+   m_pdSteepestTopDiff = pAlignedAlloc<double>(m_nCells);
+   m_pdSteepestTopSlope = pAlignedAlloc<double>(m_nCells);
+   m_pdSteepestHLen = pAlignedAlloc<double>(m_nCells);
+   m_pucWetSideNeighbours = pAlignedAlloc<unsigned char>(m_nCells);
+   m_pdHydraulicRadius = pAlignedAlloc<double>(m_nCells);
+   m_pdReynolds = pAlignedAlloc<double>(m_nCells);
+   m_pucSedFlow = pAlignedAlloc<unsigned char>(m_nCells);
+   m_pnSedFlowTo = pAlignedAlloc<int>(m_nCells);
+   m_pnSedFlowDirection = pAlignedAlloc<int>(m_nCells);
+   m_pdSedFlowWaterDepth = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowHead = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowTopSlope = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowHLen = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowSpeed = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowMoveDepth = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowBulkDensity = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowStreamPower = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowTransportCapacity = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowLoadWt = pAlignedAlloc<double>(m_nCells);
+   m_pdSedFlowThickLost = pAlignedAlloc<double>(m_nCells);
+   m_pdLaplacian = pAlignedAlloc<double>(m_nCells);
+   m_pdRawShearStress = pAlignedAlloc<double>(m_nCells);
+   m_pucWetActive = pAlignedAlloc<unsigned char>(m_nCells);
+   m_pucRainHit = pAlignedAlloc<unsigned char>(m_nCells);
+
+   if ((NULL == m_pnFlowDirection) || (NULL == m_puActiveMask) || (NULL == m_pdSurfaceWaterDepth) || (NULL == m_pdTmpSurfaceWaterDepth) || (NULL == m_pdSoilSurfaceElev) || (NULL == m_pdTopElev) || (NULL == m_pdClaySedLoad) || (NULL == m_pdSiltSedLoad) || (NULL == m_pdSandSedLoad))
+      return false;
+
+   if ((NULL == m_pnOutFlowTo) || (NULL == m_pdOutFlowWater) || (NULL == m_pdOutFlowClaySed) || (NULL == m_pdOutFlowSiltSed) || (NULL == m_pdOutFlowSandSed) || (NULL == m_pdOutFlowDetach) || (NULL == m_pdOutFlowHead) || (NULL == m_pdOutFlowSpeed) || (NULL == m_pucOutFlowInitVelocity))
+      return false;
+
+   if ((NULL == m_pucOffGrid) || (NULL == m_pdActiveWeight) || (NULL == m_pdLaplacian) || (NULL == m_pdRawShearStress) || (NULL == m_pucWetActive) || (NULL == m_pucRainHit))
+      return false;
+
+   if ((NULL == m_pdSentinelTopElev) || (NULL == m_pnSteepestDirection) || (NULL == m_pdSteepestTopDiff) || (NULL == m_pdSteepestTopSlope) || (NULL == m_pdSteepestHLen))
+      return false;
+
+   if ((NULL == m_pucWetSideNeighbours) || (NULL == m_pdHydraulicRadius) || (NULL == m_pdReynolds))
+      return false;
+
+   if ((NULL == m_pucSedFlow) || (NULL == m_pnSedFlowTo) || (NULL == m_pnSedFlowDirection) || (NULL == m_pdSedFlowWaterDepth) || (NULL == m_pdSedFlowHead) || (NULL == m_pdSedFlowTopSlope) || (NULL == m_pdSedFlowHLen) || (NULL == m_pdSedFlowSpeed) || (NULL == m_pdSedFlowMoveDepth) || (NULL == m_pdSedFlowBulkDensity))
+      return false;
+
+   if ((NULL == m_pdSedFlowStreamPower) || (NULL == m_pdSedFlowTransportCapacity) || (NULL == m_pdSedFlowLoadWt) || (NULL == m_pdSedFlowThickLost))
+      return false;
+
+   // These are the same initial values as were set by the constructors of the cell's surface water and sediment load objects. Cells in the halo keep these values: they have no surface water, and their outflow slot is clear
+   for (int n = 0; n < m_nCells; n++)
+   {
+      m_pnFlowDirection[n] = DIRECTION_NONE;
+      m_pdSurfaceWaterDepth[n] =
+      m_pdTmpSurfaceWaterDepth[n] =
+      m_pdSoilSurfaceElev[n] =
+      m_pdTopElev[n] =
+      m_pdClaySedLoad[n] =
+      m_pdSiltSedLoad[n] =
+      m_pdSandSedLoad[n] =
+      m_pdLaplacian[n] =
+      m_pdRawShearStress[n] =
+      m_pdSteepestTopDiff[n] =
+      m_pdSteepestTopSlope[n] =
+      m_pdSteepestHLen[n] =
+      m_pdHydraulicRadius[n] =
+      m_pdReynolds[n] = 0;
+      m_pnSteepestDirection[n] = DIRECTION_NONE;
+      m_pucWetSideNeighbours[n] = 0;
+
+      // There is no surface water yet, so no cell is in the wet-cell activity list. Nor has any rain fallen
+      m_pucWetActive[n] = 0;
+      m_pucRainHit[n] = 0;
+
+      ClearOutFlow(n);
+      ClearSedFlow(n);
+
+      // No cell is active until the DEM has been read. Only active cells are ever given a real top elevation in the sentinel copy, so halo and missing-value cells keep this value
+      m_pdActiveWeight[n] = 0;
+      m_pdSentinelTopElev[n] = SENTINEL_TOP_ELEV;
+
+      int
+         nPadX = n / m_nPadYGridMax,
+         nPadY = n % m_nPadYGridMax;
+      m_pucOffGrid[n] = (((nPadX == 0) || (nPadX == m_nXGridMax+1) || (nPadY == 0) || (nPadY == m_nYGridMax+1)) ? 1 : 0);
+   }
+
+   // No cell is active until the DEM has been read, and cells in the halo never are
+   for (int n = 0; n < m_nActiveMaskWords; n++)
+      m_puActiveMask[n] = 0;
+
+   return true;
+}
+
+//! Allocates and initializes the per-layer arrays for nLayers soil layers. Must be called after bAllocate(), and before the soil layers are created. Returns false if memory cannot be allocated
+bool CGridStore::bAllocateLayers(int const nLayers)
+{
+   m_nLayers = nLayers;
+
+   int nLayerCells = m_nLayers * m_nCells;
+   m_pdLayerSoilWater = pAlignedAlloc<double>(nLayerCells);
+   m_pdLayerThickness = pAlignedAlloc<double>(nLayerCells);
+
+   if ((NULL == m_pdLayerSoilWater) || (NULL == m_pdLayerThickness))
+      return false;
+
+   for (int n = 0; n < nLayerCells; n++)
+      m_pdLayerSoilWater[n] =
+      m_pdLayerThickness[n] = 0;
+
+   return true;
+}
+
+//! Returns the total number of cells in the store
+int CGridStore::nGetNumCells(void) const
+{
+   return m_nCells;
+}
+
+//! Builds the list of spans of consecutive active cells, and the list of active cells, from the active-cell mask, and sets the weight of each active cell. Must be called once the mask has been set. The spans are in the same order as the nX-outer, nY-inner loops used everywhere else
+void CGridStore::BuildActiveSpans(void)
+{
+   m_nActiveCells = 0;
+   m_VnActiveSpanX.clear();
+   m_VnActiveSpanFirstY.clear();
+   m_VnActiveSpanLastY.clear();
+   m_VnActiveCell.clear();
+
+   for (int nX = 0; nX < m_nXGridMax; nX++)
+   {
+      int nFirstY = -1;
+      for (int nY = 0; nY < m_nYGridMax; nY++)
+      {
+         bool bMissing = bIsMissing(nGetIndex(nX, nY));
+         m_pdActiveWeight[nGetIndex(nX, nY)] = (bMissing ? 0 : 1);
+
+         if (bMissing)
+         {
+            if (nFirstY >= 0)
+            {
+               // This is the end of a span
+               m_VnActiveSpanX.push_back(nX);
+               m_VnActiveSpanFirstY.push_back(nFirstY);
+               m_VnActiveSpanLastY.push_back(nY-1);
+               nFirstY = -1;
+            }
+         }
+         else
+         {
+            m_nActiveCells++;
+            m_VnActiveCell.push_back(nGetIndex(nX, nY));
+            if (nFirstY < 0)
+               // This is the start of a span
+               nFirstY = nY;
+         }
+      }
+
+      if (nFirstY >= 0)
+      {
+         // This span runs to the end of the column
+         m_VnActiveSpanX.push_back(nX);
+         m_VnActiveSpanFirstY.push_back(nFirstY);
+         m_VnActiveSpanLastY.push_back(m_nYGridMax-1);
+      }
+   }
+}
+
+//! Returns the number of active (i.e. not missing-value) cells
+int CGridStore::nGetNumActiveCells(void) const
+{
+   return m_nActiveCells;
+}
+
+//! Calculates the Laplacian of the soil surface elevation for every cell, multiplied by dKC which is the Planchon grid-size correction. Every cell in the grid has four neighbours in the store, so the five-point stencil needs no bounds or missing-value checks: halo and missing-value neighbours are given a weight of zero. For each active cell, the result is identical to that of the original per-cell calculation, since neighbours are summed in the same order and a zero-weighted neighbour adds exactly zero (the soil surface elevation of every cell, including halo and missing-value cells, is finite). Missing-value cells also get a (meaningless) value
+void CGridStore::CalcAllLaplacian(double const dKC)
+{
+   int const nStride = m_nPadYGridMax;
+
+   // Apply the stencil one column at a time. Within a column, all the neighbours are at fixed offsets so the inner loop vectorizes
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int nX = 0; nX < m_nXGridMax; nX++)
+   {
+      double const* pdElev = m_pdSoilSurfaceElev + nGetIndex(nX, 0);
+      double const* pdActive = m_pdActiveWeight + nGetIndex(nX, 0);
+      double* pdLaplacian = m_pdLaplacian + nGetIndex(nX, 0);
+
+#if defined _OPENMP
+      #pragma omp simd
+#endif
+      for (int nY = 0; nY < m_nYGridMax; nY++)
+      {
+         double
+            dWLeft = pdActive[nY - nStride],
+            dWRight = pdActive[nY + nStride],
+            dWTop = pdActive[nY - 1],
+            dWBottom = pdActive[nY + 1];
+
+         double dLaplacian = dWLeft * pdElev[nY - nStride];
+         dLaplacian += dWRight * pdElev[nY + nStride];
+         dLaplacian += dWTop * pdElev[nY - 1];
+         dLaplacian += dWBottom * pdElev[nY + 1];
+         dLaplacian -= ((dWLeft + dWRight + dWTop + dWBottom) * pdElev[nY]);
+
+         pdLaplacian[nY] = dLaplacian * dKC;
+      }
+   }
+}
+
+//! One step of the steepest top-slope search, for a single lane: if the neighbour is downhill, and its top-surface gradient is steeper than the steepest so far, then it becomes the steepest. This is written as selects rather than branches, so that a loop which calls it vectorizes
+static inline void SteepestTopSlopeStep(double const dThisTop, double const dNeighbourTop, double const dHLen, double const dInvHLen, int const nDir, double& dTopDiff, double& dTopSlope, double& dTopHLen, int& nTopDir)
+{
+   double
+      dDiff = dThisTop - dNeighbourTop,
+      dTan = dDiff * dInvHLen;
+   bool bSteeper = ((dDiff > 0) && (dTan > dTopSlope));
+
+   dTopDiff = (bSteeper ? dDiff : dTopDiff);
+   dTopSlope = (bSteeper ? dTan : dTopSlope);
+   dTopHLen = (bSteeper ? dHLen : dTopHLen);
+   nTopDir = (bSteeper ? nDir : nTopDir);
+}
+
+//! For every cell in the wet-cell activity list, finds the adjacent cell with the steepest downhill top-surface gradient, and saves its direction, the top-surface elevation difference, the tangent of the gradient, and the horizontal distance. This must be called before flow routing begins: flow routing only changes the temporary surface water and soil layer fields, so top elevations do not change until routing is finished. The results are identical to those of CSimulation::nFindSteepestEnergySlope(), since neighbours are checked in the same order with the same comparisons: the planview bottom neighbour is accepted if it is downhill, after that a neighbour is only accepted if it is downhill and strictly steeper. The top elevations of the listed cells are first copied into an array in which halo and missing-value cells hold a sentinel value which is never downhill. Every neighbour of a wet cell is itself in the list, so the neighbours of wet cells need no bounds or missing-value checks. Results for listed cells which are not wet are not used
+void CGridStore::CalcAllSteepestTopSlopes(double const dCellSide, double const dCellDiag, double const dInvCellSide, double const dInvCellDiag)
+{
+   int const nStride = m_nPadYGridMax;
+   int nWetActive = static_cast<int>(m_VnWetActive.size());
+
+   // First refresh the sentinel copy of the top elevations of the listed cells
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int i = 0; i < nWetActive; i++)
+   {
+      int n = m_VnWetActive[i];
+      m_pdSentinelTopElev[n] = m_pdTopElev[n];
+   }
+
+   // Now split the list into chunks. Within a chunk, each run of consecutive listed cells is dealt with together: consecutive store indices are always in the same column (the halo separates columns), and all the neighbours are at fixed offsets, so the inner loop vectorizes
+   int nChunks = (nWetActive + ACTIVE_LIST_CHUNK - 1) / ACTIVE_LIST_CHUNK;
+
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int nChunk = 0; nChunk < nChunks; nChunk++)
+   {
+      int
+         nLast = tMin((nChunk+1) * ACTIVE_LIST_CHUNK, nWetActive),
+         i = nChunk * ACTIVE_LIST_CHUNK;
+
+      while (i < nLast)
+      {
+         int
+            nFirst = m_VnWetActive[i],
+            nLen = 1;
+
+         while ((i + nLen < nLast) && (m_VnWetActive[i + nLen] == nFirst + nLen))
+            nLen++;
+
+         double const* pdTop = m_pdSentinelTopElev + nFirst;
+         int* pnDir = m_pnSteepestDirection + nFirst;
+         double* pdDiff = m_pdSteepestTopDiff + nFirst;
+         double* pdSlope = m_pdSteepestTopSlope + nFirst;
+         double* pdHLen = m_pdSteepestHLen + nFirst;
+
+#if defined _OPENMP
+         #pragma omp simd
+#endif
+         for (int j = 0; j < nLen; j++)
+         {
+            double
+               dThisTop = pdTop[j],
+               dTopDiff = 0,
+               dTopSlope = 0,
+               dTopHLen = 0;
+            int nTopDir = DIRECTION_NONE;
+
+            // Planview bottom: if it is downhill, then being the first one checked it must be the steepest so far
+            double dDiff = dThisTop - pdTop[j + 1];
+            bool bDownhill = (dDiff > 0);
+            dTopDiff = (bDownhill ? dDiff : dTopDiff);
+            dTopSlope = (bDownhill ? dDiff * dInvCellSide : dTopSlope);
+            dTopHLen = (bDownhill ? dCellSide : dTopHLen);
+            nTopDir = (bDownhill ? DIRECTION_BOTTOM : nTopDir);
+
+            // Then the remaining neighbours, in the same order as nFindSteepestEnergySlope()
+            SteepestTopSlopeStep(dThisTop, pdTop[j + nStride + 1], dCellDiag, dInvCellDiag, DIRECTION_BOTTOM_RIGHT, dTopDiff, dTopSlope, dTopHLen, nTopDir);
+            SteepestTopSlopeStep(dThisTop, pdTop[j - nStride + 1], dCellDiag, dInvCellDiag, DIRECTION_BOTTOM_LEFT, dTopDiff, dTopSlope, dTopHLen, nTopDir);
+            SteepestTopSlopeStep(dThisTop, pdTop[j + nStride], dCellSide, dInvCellSide, DIRECTION_RIGHT, dTopDiff, dTopSlope, dTopHLen, nTopDir);
+            SteepestTopSlopeStep(dThisTop, pdTop[j - nStride], dCellSide, dInvCellSide, DIRECTION_LEFT, dTopDiff, dTopSlope, dTopHLen, nTopDir);
+            SteepestTopSlopeStep(dThisTop, pdTop[j + nStride - 1], dCellDiag, dInvCellDiag, DIRECTION_TOP_RIGHT, dTopDiff, dTopSlope, dTopHLen, nTopDir);
+            SteepestTopSlopeStep(dThisTop, pdTop[j - nStride - 1], dCellDiag, dInvCellDiag, DIRECTION_TOP_LEFT, dTopDiff, dTopSlope, dTopHLen, nTopDir);
+            SteepestTopSlopeStep(dThisTop, pdTop[j - 1], dCellSide, dInvCellSide, DIRECTION_TOP, dTopDiff, dTopSlope, dTopHLen, nTopDir);
+
+            pnDir[j] = nTopDir;
+            pdDiff[j] = dTopDiff;
+            pdSlope[j] = dTopSlope;
+            pdHLen[j] = dTopHLen;
+         }
+
+         i += nLen;
+      }
+   }
+}
+
+//! Returns the hydraulic radius (mm) of flow with this depth (mm), given the number of wet cells either side of the direction of flow. If both are wet, R = (w * d / w) = d; if one is wet, R = w * d / (w + d); if neither is wet, R = w * d / (w + 2d). If both are wet the width is taken as 1, so the same arithmetic gives exactly d. All the arithmetic is always done, and the only select is between two constants, so that a loop which calls this vectorizes
+static inline double dHydraulicRadiusFromWetSides(double const dCellSide, double const dDepth, int const nWetSides)
+{
+   double dWidth = ((nWetSides == 2) ? 1 : dCellSide);
+   double
+      dNumerator = dWidth * dDepth,
+      dDenominator = dWidth + ((2 - nWetSides) * dDepth);
+
+   return (dNumerator / dDenominator);
+}
+
+//! For every cell in the wet-cell activity list, counts the wet cells which are orthogonal to the direction of flow (i.e. two steps either side of it), and uses this to calculate the hydraulic radius. The direction of flow is the one found by CalcAllSteepestTopSlopes(), so this must be called after it, and before flow routing begins: like top elevations, surface water depths do not change until routing is finished. Neighbours in the halo are never wet, so need no bounds check. The orthogonal pair is the same for opposite directions, so depends only on the direction modulo four
+void CGridStore::CalcAllHydraulicRadii(double const dCellSide)
+{
+   int const nStride = m_nPadYGridMax;
+   int nWetActive = static_cast<int>(m_VnWetActive.size());
+   int nChunks = (nWetActive + ACTIVE_LIST_CHUNK - 1) / ACTIVE_LIST_CHUNK;
+
+   // As in CalcAllSteepestTopSlopes(), each run of consecutive listed cells within a chunk is dealt with together
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int nChunk = 0; nChunk < nChunks; nChunk++)
+   {
+      int
+         nLast = tMin((nChunk+1) * ACTIVE_LIST_CHUNK, nWetActive),
+         i = nChunk * ACTIVE_LIST_CHUNK;
+
+      while (i < nLast)
+      {
+         int
+            nFirst = m_VnWetActive[i],
+            nLen = 1;
+
+         while ((i + nLen < nLast) && (m_VnWetActive[i + nLen] == nFirst + nLen))
+            nLen++;
+
+         double const* pdDepth = m_pdSurfaceWaterDepth + nFirst;
+         int const* pnDir = m_pnSteepestDirection + nFirst;
+         unsigned char* pucWetSides = m_pucWetSideNeighbours + nFirst;
+         double* pdR = m_pdHydraulicRadius + nFirst;
+
+#if defined _OPENMP
+         #pragma omp simd
+#endif
+         for (int j = 0; j < nLen; j++)
+         {
+            int
+               nDir = pnDir[j],
+               nQuadrant = nDir & 3,
+               nWetLeftRight = (pdDepth[j - nStride] > 0) + (pdDepth[j + nStride] > 0),
+               nWetTopBottom = (pdDepth[j - 1] > 0) + (pdDepth[j + 1] > 0),
+               nWetTLBR = (pdDepth[j - nStride - 1] > 0) + (pdDepth[j + nStride + 1] > 0),
+               nWetTRBL = (pdDepth[j + nStride - 1] > 0) + (pdDepth[j - nStride + 1] > 0);
+
+            // Top or bottom: left and right. Top right or bottom left: top left and bottom right. Right or left: top and bottom. Bottom right or top left: top right and bottom left
+            int nWetSides = ((nQuadrant == 0) * nWetLeftRight) + ((nQuadrant == 1) * nWetTLBR) + ((nQuadrant == 2) * nWetTopBottom) + ((nQuadrant == 3) * nWetTRBL);
+            nWetSides *= (nDir != DIRECTION_NONE);
+
+            pucWetSides[j] = static_cast<unsigned char>(nWetSides);
+            pdR[j] = dHydraulicRadiusFromWetSides(dCellSide, pdDepth[j], nWetSides);
+         }
+
+         i += nLen;
+      }
+   }
+}
+
+//! Counts the wet cells either side of this direction of flow from the cell with this index, and uses this to calculate the cell's hydraulic radius. This is for cells whose flow does not follow the steepest top-surface gradient, i.e. flow off the edge of the grid
+void CGridStore::CalcHydraulicRadius(int const n, int const nDir, double const dCellSide)
+{
+   int nWetSides = 0;
+   if (nDir != DIRECTION_NONE)
+   {
+      if (bIsWet(nGetNeighbour(n, (nDir + 2) % 8)))
+         nWetSides++;
+
+      if (bIsWet(nGetNeighbour(n, (nDir + 6) % 8)))
+         nWetSides++;
+   }
+
+   m_pucWetSideNeighbours[n] = static_cast<unsigned char>(nWetSides);
+   m_pdHydraulicRadius[n] = dHydraulicRadiusFromWetSides(dCellSide, m_pdSurfaceWaterDepth[n], nWetSides);
+}
+
+//! Adds the cell with this index, and each of its active neighbours, to the wet-cell activity list if they are not already in it. The store indices of the newly-added cells are appended to VnList, which is left unsorted
+void CGridStore::AddWetNeighbourhood(int const n, vector<int>& VnList)
+{
+   // Neighbours which are in the halo are missing values, so need no bounds check
+   for (int nDir = DIRECTION_NONE; nDir <= DIRECTION_TOP_LEFT; nDir++)
+   {
+      int nTmp = (nDir == DIRECTION_NONE ? n : nGetNeighbour(n, nDir));
+      if (m_pucWetActive[nTmp] || bIsMissing(nTmp))
+         continue;
+
+      m_pucWetActive[nTmp] = 1;
+      VnList.push_back(nTmp);
+   }
+}
+
+//! Adds every candidate cell which is now wet, together with its neighbours, to the wet-cell activity list. Cells are not removed from the list, so cells which have dried since the last update (e.g. by infiltration) are kept until UpdateWetActive() is next called
+void CGridStore::GrowWetActive(void)
+{
+   size_t nOldSize = m_VnWetActive.size();
+
+   for (unsigned int i = 0; i < m_VnWetCandidate.size(); i++)
+   {
+      if (bIsWet(m_VnWetCandidate[i]))
+         AddWetNeighbourhood(m_VnWetCandidate[i], m_VnWetActive);
+   }
+
+   m_VnWetCandidate.clear();
+
+   if (m_VnWetActive.size() > nOldSize)
+   {
+      // Keep the list in ascending order
+      sort(m_VnWetActive.begin() + nOldSize, m_VnWetActive.end());
+      inplace_merge(m_VnWetActive.begin(), m_VnWetActive.begin() + nOldSize, m_VnWetActive.end());
+   }
+}
+
+//! Rebuilds the wet-cell activity list so that it holds exactly the cells which are now wet, and their neighbours. Every cell which can have become wet since the last update must already be in the list, or be a candidate; so this only needs to look at the cells in the list
+void CGridStore::UpdateWetActive(void)
+{
+   for (unsigned int i = 0; i < m_VnWetActive.size(); i++)
+      m_pucWetActive[m_VnWetActive[i]] = 0;
+
+   m_VnWetActiveTmp.clear();
+   for (unsigned int i = 0; i < m_VnWetActive.size(); i++)
+   {
+      if (bIsWet(m_VnWetActive[i]))
+         AddWetNeighbourhood(m_VnWetActive[i], m_VnWetActiveTmp);
+   }
+
+   // Clear the two-phase flow routing outflow slot of any cell which has left the list, since the slot will not be cleared again until the cell rejoins the list, and the cell's neighbours must not gather a stale outflow
+   for (unsigned int i = 0; i < m_VnWetActive.size(); i++)
+   {
+      if (! m_pucWetActive[m_VnWetActive[i]])
+         ClearOutFlow(m_VnWetActive[i]);
+   }
+
+   sort(m_VnWetActiveTmp.begin(), m_VnWetActiveTmp.end());
+   m_VnWetActive.swap(m_VnWetActiveTmp);
+}
+
+//! Sorts the rain-hit list into ascending order, i.e. the same order as the spans of active cells
+void CGridStore::SortRainHit(void)
+{
+   sort(m_VnRainHit.begin(), m_VnRainHit.end());
+}
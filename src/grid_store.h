@@ -0,0 +1,819 @@
+#ifndef __GRID_STORE_H__
+   #define __GRID_STORE_H__
+/*=========================================================================================================================================
+
+This is grid_store.h: declaration for the RillGrow class which holds the frequently-accessed per-cell fields as one contiguous array per field
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <vector>
+using std::vector;
+
+class CGridStore
+{
+private:
+   //! The number of cells in the x direction
+   int m_nXGridMax;
+
+   //! The number of cells in the y direction
+   int m_nYGridMax;
+
+   //! The total number of cells in the store, including the halo
+   int m_nCells;
+
+   //! The number of words in the active-cell mask
+   int m_nActiveMaskWords;
+
+   //! The number of active (i.e. not missing-value) cells
+   int m_nActiveCells;
+
+   //! The number of cells in the y direction of the store, i.e. including the halo at each end of a column. Is the distance between the store indices of horizontally adjacent cells
+   int m_nPadYGridMax;
+
+   //! The difference between the store index of a cell and the store index of its neighbour in each planview direction, indexed by the DIRECTION constants
+   int m_nNeighbourOffset[8];
+
+   //! The number of soil layers held in the per-layer arrays
+   int m_nLayers;
+
+   //! Flow direction
+   int* m_pnFlowDirection;
+
+   //! Bit-packed active-cell mask, one bit per cell. A set bit means that the cell is inside the area of measured elevations, a clear bit means that it is a missing value
+   unsigned int* m_puActiveMask;
+
+   //! The x coordinate of each span of consecutive active cells
+   vector<int> m_VnActiveSpanX;
+
+   //! The y coordinate of the first cell in each span of consecutive active cells
+   vector<int> m_VnActiveSpanFirstY;
+
+   //! The y coordinate of the last cell in each span of consecutive active cells
+   vector<int> m_VnActiveSpanLastY;
+
+   //! The store index of every active cell, in the same order as the spans
+   vector<int> m_VnActiveCell;
+
+   //! Water on soil surface as a depth (mm)
+   double* m_pdSurfaceWaterDepth;
+
+   //! Temporary depth of water on soil surface (mm), is a transaction field used during flow routing
+   double* m_pdTmpSurfaceWaterDepth;
+
+   //! Elevation of the soil surface (mm), i.e. basement elevation plus the summed thickness of all soil layers. Is updated whenever a layer thickness changes
+   double* m_pdSoilSurfaceElev;
+
+   //! Elevation of the top surface (mm), i.e. soil surface elevation plus surface water depth. Is updated whenever either of these changes
+   double* m_pdTopElev;
+
+   //! Last-iteration clay sediment load (mm depth)
+   double* m_pdClaySedLoad;
+
+   //! Last-iteration silt sediment load (mm depth)
+   double* m_pdSiltSedLoad;
+
+   //! Last-iteration sand sediment load (mm depth)
+   double* m_pdSandSedLoad;
+
+   //! Two-phase flow routing: the store index of the cell which receives this cell's outflow, or -1 if there is no on-grid outflow
+   int* m_pnOutFlowTo;
+
+   //! Two-phase flow routing: depth of water (mm) which flows out of this cell
+   double* m_pdOutFlowWater;
+
+   //! Two-phase flow routing: depth of clay sediment load (mm) which flows out of this cell
+   double* m_pdOutFlowClaySed;
+
+   //! Two-phase flow routing: depth of silt sediment load (mm) which flows out of this cell
+   double* m_pdOutFlowSiltSed;
+
+   //! Two-phase flow routing: depth of sand sediment load (mm) which flows out of this cell
+   double* m_pdOutFlowSandSed;
+
+   //! Two-phase flow routing: thickness of soil (mm) to be detached by flow from the cell which receives this cell's outflow
+   double* m_pdOutFlowDetach;
+
+   //! Two-phase flow routing: the head (mm) of this cell's outflow, or -1 if no head was calculated
+   double* m_pdOutFlowHead;
+
+   //! Two-phase flow routing: the flow speed (mm/sec) of this cell's outflow, or zero
+   double* m_pdOutFlowSpeed;
+
+   //! Two-phase flow routing: is non-zero if this cell's flow velocity needs to be re-initialized
+   unsigned char* m_pucOutFlowInitVelocity;
+
+   //! Is 1 for cells in the halo, 0 for cells in the grid
+   unsigned char* m_pucOffGrid;
+
+   //! Is 1 for active cells and 0 for halo and missing-value cells
+   double* m_pdActiveWeight;
+
+   //! Copy of the top surface elevation (mm) in which halo and missing-value cells hold SENTINEL_TOP_ELEV, so that they are never downhill. Only the cells in the wet-cell activity list are kept up to date
+   double* m_pdSentinelTopElev;
+
+   //! The direction of the adjacent cell with the steepest downhill top-surface gradient, or DIRECTION_NONE. Is calculated before flow routing, for the cells in the wet-cell activity list
+   int* m_pnSteepestDirection;
+
+   //! The top-surface elevation difference (mm) to the adjacent cell in m_pnSteepestDirection, or zero
+   double* m_pdSteepestTopDiff;
+
+   //! The tangent of the top-surface gradient to the adjacent cell in m_pnSteepestDirection, or zero
+   double* m_pdSteepestTopSlope;
+
+   //! The horizontal distance (mm) to the adjacent cell in m_pnSteepestDirection, or zero
+   double* m_pdSteepestHLen;
+
+   //! The number (0, 1 or 2) of wet cells which are orthogonal to the direction of flow, i.e. two steps either side of it. Is calculated before flow routing, for the cells in the wet-cell activity list
+   unsigned char* m_pucWetSideNeighbours;
+
+   //! The hydraulic radius (mm), calculated before flow routing for the cells in the wet-cell activity list
+   double* m_pdHydraulicRadius;
+
+   //! The Reynolds number, calculated before flow routing for the cells in the wet-cell activity list. It uses the previous iteration's flow speed
+   double* m_pdReynolds;
+
+   //! Is 1 if the outflow from the cell with this index was recorded during this iteration's flow routing, so that its sediment calculations (transport capacity, then flow erosion or deposition) are still to be done. Is 0 otherwise
+   unsigned char* m_pucSedFlow;
+
+   //! Sediment calculations: the store index of the cell which receives the outflow, or -1 if the outflow is off the edge of the grid
+   int* m_pnSedFlowTo;
+
+   //! Sediment calculations: the planview direction of the outflow
+   int* m_pnSedFlowDirection;
+
+   //! Sediment calculations: the pre-outflow surface water depth (mm)
+   double* m_pdSedFlowWaterDepth;
+
+   //! Sediment calculations: the head (mm) of the outflow
+   double* m_pdSedFlowHead;
+
+   //! Sediment calculations: the tangent of the top-surface gradient of the outflow
+   double* m_pdSedFlowTopSlope;
+
+   //! Sediment calculations: the horizontal distance (mm) travelled by the outflow
+   double* m_pdSedFlowHLen;
+
+   //! Sediment calculations: the flow speed (mm/sec) of the outflow
+   double* m_pdSedFlowSpeed;
+
+   //! Sediment calculations: the depth (mm) of water moved by the outflow
+   double* m_pdSedFlowMoveDepth;
+
+   //! Sediment calculations: the bulk density (kg/m**3) of the topmost non-zero soil layer, or -1 if there is none
+   double* m_pdSedFlowBulkDensity;
+
+   //! Sediment calculations: the stream power (g/s**3) of the outflow
+   double* m_pdSedFlowStreamPower;
+
+   //! Sediment calculations: the transport capacity (mm depth) of the outflow
+   double* m_pdSedFlowTransportCapacity;
+
+   //! Sediment calculations: the weight (0 to 1) by which the sediment load reduces flow erosion, i.e. 1 - (sediment load / transport capacity), or zero if this is negative
+   double* m_pdSedFlowLoadWt;
+
+   //! Sediment calculations: the thickness (mm) of soil lost per second by flow erosion, already weighted by m_pdSedFlowLoadWt
+   double* m_pdSedFlowThickLost;
+
+   //! Planchon splash: the Laplacian of the soil surface elevation
+   double* m_pdLaplacian;
+
+   //! Slumping: the shear stress of flow on this cell which has not yet been spread over the surrounding patch of cells
+   double* m_pdRawShearStress;
+
+   //! Soil water content (mm depth) of each soil layer. This is layer-major, i.e. all cells of the top layer, then all cells of the next layer down, etc.
+   double* m_pdLayerSoilWater;
+
+   //! Thickness (mm) of each soil layer, with the same layer-major layout as m_pdLayerSoilWater. Is updated whenever the soil surface elevation is updated
+   double* m_pdLayerThickness;
+
+   //! Is 1 if the cell with this index is in the wet-cell activity list, 0 otherwise
+   unsigned char* m_pucWetActive;
+
+   //! The wet-cell activity list: the store indices of every wet cell, and of every active cell which is adjacent to a wet cell. Is in ascending order, i.e. the same order as the spans of active cells
+   vector<int> m_VnWetActive;
+
+   //! Workspace used when the wet-cell activity list is updated
+   vector<int> m_VnWetActiveTmp;
+
+   //! The store indices of cells which may have become wet since the wet-cell activity list was last grown, e.g. by rain, run-on, or exfiltration
+   vector<int> m_VnWetCandidate;
+
+   //! Is 1 if the cell with this index is in the rain-hit list, 0 otherwise
+   unsigned char* m_pucRainHit;
+
+   //! The rain-hit list: the store indices of every cell which has received rain during this iteration. Is in ascending order once SortRainHit() has been called
+   vector<int> m_VnRainHit;
+
+   void AddWetNeighbourhood(int const, vector<int>&);
+
+public:
+   CGridStore(void);
+   ~CGridStore(void);
+
+   bool bAllocate(int const, int const);
+   bool bAllocateLayers(int const);
+   int nGetNumCells(void) const;
+   void BuildActiveSpans(void);
+   int nGetNumActiveCells(void) const;
+   void CalcAllLaplacian(double const);
+   void CalcAllSteepestTopSlopes(double const, double const, double const, double const);
+   void CalcAllHydraulicRadii(double const);
+   void CalcHydraulicRadius(int const, int const, double const);
+   void GrowWetActive(void);
+   void UpdateWetActive(void);
+   void SortRainHit(void);
+
+   //! Returns the store index of the cell at (nX, nY). The layout is column-major, to match the nX-outer, nY-inner loops used everywhere else. The grid is surrounded by a one-cell halo, so every cell in the grid has eight neighbours in the store
+   inline int nGetIndex(int const nX, int const nY) const
+   {
+      return ((nX+1) * m_nPadYGridMax) + nY+1;
+   }
+
+   //! Returns the x coordinate of the cell with this store index
+   inline int nGetXFromIndex(int const n) const
+   {
+      return (n / m_nPadYGridMax) - 1;
+   }
+
+   //! Returns the y coordinate of the cell with this store index
+   inline int nGetYFromIndex(int const n) const
+   {
+      return (n % m_nPadYGridMax) - 1;
+   }
+
+   //! Returns the store index of the neighbour, in planview direction nDir, of the cell with this index. Cells in the grid need no bounds check, since a neighbour which is off the grid is in the halo
+   inline int nGetNeighbour(int const n, int const nDir) const
+   {
+      return n + m_nNeighbourOffset[nDir];
+   }
+
+   //! Returns the number of the cell with this store index, counting cells within the grid only (i.e. not the halo) in the same column-major order. This does not depend on the layout of the store
+   inline int nGetCellNumber(int const n) const
+   {
+      return (nGetXFromIndex(n) * m_nYGridMax) + nGetYFromIndex(n);
+   }
+
+   //! Returns true if the cell with this index is in the halo. Cells in the halo are missing values, and are never wet
+   inline bool bIsOffGrid(int const n) const
+   {
+      return (m_pucOffGrid[n] != 0);
+   }
+
+   //! Sets whether the cell with this index is a missing value. Each word of the mask holds 32 cells
+   inline void SetMissing(int const n, bool const bMissing)
+   {
+      unsigned int uBit = 1u << (n & 31);
+      if (bMissing)
+         m_puActiveMask[n >> 5] &= ~uBit;
+      else
+         m_puActiveMask[n >> 5] |= uBit;
+   }
+
+   //! Returns true if the cell with this index is a missing value
+   inline bool bIsMissing(int const n) const
+   {
+      return ((m_puActiveMask[n >> 5] & (1u << (n & 31))) == 0);
+   }
+
+   //! Returns the number of spans of consecutive active cells. Each span lies within a single column of the grid
+   inline int nGetNumActiveSpans(void) const
+   {
+      return static_cast<int>(m_VnActiveSpanX.size());
+   }
+
+   //! Returns the store index of the nActive'th active cell
+   inline int nGetActiveCell(int const nActive) const
+   {
+      return m_VnActiveCell[nActive];
+   }
+
+   //! Returns the x coordinate of this span of active cells
+   inline int nGetActiveSpanX(int const nSpan) const
+   {
+      return m_VnActiveSpanX[nSpan];
+   }
+
+   //! Returns the y coordinate of the first cell in this span of active cells
+   inline int nGetActiveSpanFirstY(int const nSpan) const
+   {
+      return m_VnActiveSpanFirstY[nSpan];
+   }
+
+   //! Returns the y coordinate of the last cell in this span of active cells
+   inline int nGetActiveSpanLastY(int const nSpan) const
+   {
+      return m_VnActiveSpanLastY[nSpan];
+   }
+
+   //! Returns true if the cell with this index has surface water
+   inline bool bIsWet(int const n) const
+   {
+      return (m_pdSurfaceWaterDepth[n] > 0);
+   }
+
+   //! Returns the surface water depth (mm) of the cell with this index
+   inline double dGetSurfaceWaterDepth(int const n) const
+   {
+      return m_pdSurfaceWaterDepth[n];
+   }
+
+   //! Sets the surface water depth (mm) of the cell with this index, and updates its top surface elevation
+   inline void SetSurfaceWaterDepth(int const n, double const dDepth)
+   {
+      m_pdSurfaceWaterDepth[n] = dDepth;
+      m_pdTopElev[n] = m_pdSoilSurfaceElev[n] + dDepth;
+   }
+
+   //! Returns the soil surface elevation (mm) of the cell with this index
+   inline double dGetSoilSurfaceElevation(int const n) const
+   {
+      return m_pdSoilSurfaceElev[n];
+   }
+
+   //! Sets the soil surface elevation (mm) of the cell with this index, and updates its top surface elevation
+   inline void SetSoilSurfaceElevation(int const n, double const dElev)
+   {
+      m_pdSoilSurfaceElev[n] = dElev;
+      m_pdTopElev[n] = dElev + m_pdSurfaceWaterDepth[n];
+   }
+
+   //! Returns the top surface elevation (mm) of the cell with this index, this is the water surface if the cell is wet, or the soil surface if dry
+   inline double dGetTopElevation(int const n) const
+   {
+      return m_pdTopElev[n];
+   }
+
+   //! Returns the temporary surface water depth (mm) of the cell with this index
+   inline double dGetTmpSurfaceWaterDepth(int const n) const
+   {
+      return m_pdTmpSurfaceWaterDepth[n];
+   }
+
+   //! Sets the temporary surface water depth (mm) of the cell with this index
+   inline void SetTmpSurfaceWaterDepth(int const n, double const dDepth)
+   {
+      m_pdTmpSurfaceWaterDepth[n] = dDepth;
+   }
+
+   //! Returns the direction of the adjacent cell with the steepest downhill top-surface gradient from the cell with this index, as found by CalcAllSteepestTopSlopes()
+   inline int nGetSteepestDirection(int const n) const
+   {
+      return m_pnSteepestDirection[n];
+   }
+
+   //! Returns the top-surface elevation difference (mm) from the cell with this index to the adjacent cell with the steepest downhill top-surface gradient
+   inline double dGetSteepestTopDiff(int const n) const
+   {
+      return m_pdSteepestTopDiff[n];
+   }
+
+   //! Returns the tangent of the steepest downhill top-surface gradient from the cell with this index
+   inline double dGetSteepestTopSlope(int const n) const
+   {
+      return m_pdSteepestTopSlope[n];
+   }
+
+   //! Returns the horizontal distance (mm) from the cell with this index to the adjacent cell with the steepest downhill top-surface gradient
+   inline double dGetSteepestHLen(int const n) const
+   {
+      return m_pdSteepestHLen[n];
+   }
+
+   //! Returns the number of wet cells either side of the direction of flow from the cell with this index, as found by CalcAllHydraulicRadii() or CalcHydraulicRadius()
+   inline int nGetWetSideNeighbours(int const n) const
+   {
+      return m_pucWetSideNeighbours[n];
+   }
+
+   //! Returns the hydraulic radius (mm) of the cell with this index, as found by CalcAllHydraulicRadii() or CalcHydraulicRadius()
+   inline double dGetHydraulicRadius(int const n) const
+   {
+      return m_pdHydraulicRadius[n];
+   }
+
+   //! Returns the Reynolds number of the cell with this index
+   inline double dGetReynolds(int const n) const
+   {
+      return m_pdReynolds[n];
+   }
+
+   //! Sets the Reynolds number of the cell with this index
+   inline void SetReynolds(int const n, double const dRe)
+   {
+      m_pdReynolds[n] = dRe;
+   }
+
+   //! Records that the cell with this index has no outflow whose sediment calculations are still to be done. The other sediment calculation fields are zeroed too, so that a batched calculation never reads a value left over from an earlier iteration
+   inline void ClearSedFlow(int const n)
+   {
+      m_pucSedFlow[n] = 0;
+      m_pnSedFlowTo[n] = -1;
+      m_pnSedFlowDirection[n] = DIRECTION_NONE;
+      m_pdSedFlowWaterDepth[n] =
+      m_pdSedFlowHead[n] =
+      m_pdSedFlowTopSlope[n] =
+      m_pdSedFlowHLen[n] =
+      m_pdSedFlowSpeed[n] =
+      m_pdSedFlowMoveDepth[n] =
+      m_pdSedFlowBulkDensity[n] =
+      m_pdSedFlowStreamPower[n] =
+      m_pdSedFlowTransportCapacity[n] =
+      m_pdSedFlowLoadWt[n] =
+      m_pdSedFlowThickLost[n] = 0;
+   }
+
+   //! Records the outflow from the cell with this index, so that its sediment calculations can be done after flow routing. nTo is the store index of the cell which receives the outflow, or -1 if the outflow is off the edge of the grid
+   inline void SetSedFlow(int const n, int const nTo, int const nDir, double const dWaterDepth, double const dHead, double const dTopSlope, double const dHLen, double const dSpeed, double const dMoveDepth, double const dBulkDensity)
+   {
+      m_pucSedFlow[n] = 1;
+      m_pnSedFlowTo[n] = nTo;
+      m_pnSedFlowDirection[n] = nDir;
+      m_pdSedFlowWaterDepth[n] = dWaterDepth;
+      m_pdSedFlowHead[n] = dHead;
+      m_pdSedFlowTopSlope[n] = dTopSlope;
+      m_pdSedFlowHLen[n] = dHLen;
+      m_pdSedFlowSpeed[n] = dSpeed;
+      m_pdSedFlowMoveDepth[n] = dMoveDepth;
+      m_pdSedFlowBulkDensity[n] = dBulkDensity;
+   }
+
+   //! Returns true if the outflow from the cell with this index was recorded during this iteration's flow routing
+   inline bool bIsSedFlow(int const n) const
+   {
+      return (m_pucSedFlow[n] != 0);
+   }
+
+   //! Returns the store index of the cell which receives the recorded outflow from the cell with this index, or -1 if the outflow is off the edge of the grid
+   inline int nGetSedFlowTo(int const n) const
+   {
+      return m_pnSedFlowTo[n];
+   }
+
+   //! Returns the planview direction of the recorded outflow from the cell with this index
+   inline int nGetSedFlowDirection(int const n) const
+   {
+      return m_pnSedFlowDirection[n];
+   }
+
+   //! Returns the pre-outflow surface water depth (mm) of the cell with this index
+   inline double dGetSedFlowWaterDepth(int const n) const
+   {
+      return m_pdSedFlowWaterDepth[n];
+   }
+
+   //! Returns the head (mm) of the recorded outflow from the cell with this index
+   inline double dGetSedFlowHead(int const n) const
+   {
+      return m_pdSedFlowHead[n];
+   }
+
+   //! Returns the tangent of the top-surface gradient of the recorded outflow from the cell with this index
+   inline double dGetSedFlowTopSlope(int const n) const
+   {
+      return m_pdSedFlowTopSlope[n];
+   }
+
+   //! Returns the horizontal distance (mm) travelled by the recorded outflow from the cell with this index
+   inline double dGetSedFlowHLen(int const n) const
+   {
+      return m_pdSedFlowHLen[n];
+   }
+
+   //! Returns the flow speed (mm/sec) of the recorded outflow from the cell with this index
+   inline double dGetSedFlowSpeed(int const n) const
+   {
+      return m_pdSedFlowSpeed[n];
+   }
+
+   //! Returns the depth (mm) of water moved by the recorded outflow from the cell with this index
+   inline double dGetSedFlowMoveDepth(int const n) const
+   {
+      return m_pdSedFlowMoveDepth[n];
+   }
+
+   //! Returns the bulk density (kg/m**3) of the topmost non-zero soil layer of the cell with this index, as recorded with its outflow, or -1 if there is none
+   inline double dGetSedFlowBulkDensity(int const n) const
+   {
+      return m_pdSedFlowBulkDensity[n];
+   }
+
+   //! Sets the results of the batched sediment calculations for the cell with this index: stream power (g/s**3), transport capacity (mm depth), sediment load weight, and thickness (mm) of soil lost per second by flow erosion
+   inline void SetSedFlowResults(int const n, double const dStreamPower, double const dTransportCapacity, double const dLoadWt, double const dThickLost)
+   {
+      m_pdSedFlowStreamPower[n] = dStreamPower;
+      m_pdSedFlowTransportCapacity[n] = dTransportCapacity;
+      m_pdSedFlowLoadWt[n] = dLoadWt;
+      m_pdSedFlowThickLost[n] = dThickLost;
+   }
+
+   //! Returns the stream power (g/s**3) of the recorded outflow from the cell with this index
+   inline double dGetSedFlowStreamPower(int const n) const
+   {
+      return m_pdSedFlowStreamPower[n];
+   }
+
+   //! Returns the transport capacity (mm depth) of the recorded outflow from the cell with this index
+   inline double dGetSedFlowTransportCapacity(int const n) const
+   {
+      return m_pdSedFlowTransportCapacity[n];
+   }
+
+   //! Returns the weight (0 to 1) by which the sediment load of the cell with this index reduces flow erosion
+   inline double dGetSedFlowLoadWt(int const n) const
+   {
+      return m_pdSedFlowLoadWt[n];
+   }
+
+   //! Returns the thickness (mm) of soil lost per second by flow erosion from the cell with this index
+   inline double dGetSedFlowThickLost(int const n) const
+   {
+      return m_pdSedFlowThickLost[n];
+   }
+
+   //! Returns the flow direction of the cell with this index
+   inline int nGetFlowDirection(int const n) const
+   {
+      return m_pnFlowDirection[n];
+   }
+
+   //! Sets the flow direction of the cell with this index
+   inline void SetFlowDirection(int const n, int const nDir)
+   {
+      m_pnFlowDirection[n] = nDir;
+   }
+
+   //! Returns the last-iteration clay sediment load (mm) of the cell with this index
+   inline double dGetClaySedLoad(int const n) const
+   {
+      return m_pdClaySedLoad[n];
+   }
+
+   //! Returns the last-iteration silt sediment load (mm) of the cell with this index
+   inline double dGetSiltSedLoad(int const n) const
+   {
+      return m_pdSiltSedLoad[n];
+   }
+
+   //! Returns the last-iteration sand sediment load (mm) of the cell with this index
+   inline double dGetSandSedLoad(int const n) const
+   {
+      return m_pdSandSedLoad[n];
+   }
+
+   //! Returns the last-iteration sediment load (mm) for all size classes of the cell with this index
+   inline double dGetAllSizeSedLoad(int const n) const
+   {
+      return (m_pdClaySedLoad[n] + m_pdSiltSedLoad[n] + m_pdSandSedLoad[n]);
+   }
+
+   //! Sets the last-iteration sediment load (mm) for each size class of the cell with this index
+   inline void SetSedLoad(int const n, double const dClay, double const dSilt, double const dSand)
+   {
+      m_pdClaySedLoad[n] = dClay;
+      m_pdSiltSedLoad[n] = dSilt;
+      m_pdSandSedLoad[n] = dSand;
+   }
+
+   //! Clears the two-phase flow routing outflow slot of the cell with this index
+   inline void ClearOutFlow(int const n)
+   {
+      m_pnOutFlowTo[n] = -1;
+      m_pdOutFlowWater[n] =
+      m_pdOutFlowClaySed[n] =
+      m_pdOutFlowSiltSed[n] =
+      m_pdOutFlowSandSed[n] =
+      m_pdOutFlowDetach[n] =
+      m_pdOutFlowSpeed[n] = 0;
+      m_pdOutFlowHead[n] = -1;
+      m_pucOutFlowInitVelocity[n] = 0;
+   }
+
+   //! Records that a depth of water (mm) flows from the cell with index nFrom to the cell with index nTo
+   inline void SetOutFlowWater(int const nFrom, int const nTo, double const dDepth)
+   {
+      m_pnOutFlowTo[nFrom] = nTo;
+      m_pdOutFlowWater[nFrom] = dDepth;
+   }
+
+   //! Returns the store index of the cell which receives the outflow from the cell with this index, or -1 if there is no on-grid outflow
+   inline int nGetOutFlowTo(int const n) const
+   {
+      return m_pnOutFlowTo[n];
+   }
+
+   //! Returns the depth of water (mm) which flows out of the cell with this index
+   inline double dGetOutFlowWater(int const n) const
+   {
+      return m_pdOutFlowWater[n];
+   }
+
+   //! Sets the depth of clay sediment load (mm) which flows out of the cell with this index
+   inline void SetOutFlowClaySed(int const n, double const dDepth)
+   {
+      m_pdOutFlowClaySed[n] = dDepth;
+   }
+
+   //! Returns the depth of clay sediment load (mm) which flows out of the cell with this index
+   inline double dGetOutFlowClaySed(int const n) const
+   {
+      return m_pdOutFlowClaySed[n];
+   }
+
+   //! Sets the depth of silt sediment load (mm) which flows out of the cell with this index
+   inline void SetOutFlowSiltSed(int const n, double const dDepth)
+   {
+      m_pdOutFlowSiltSed[n] = dDepth;
+   }
+
+   //! Returns the depth of silt sediment load (mm) which flows out of the cell with this index
+   inline double dGetOutFlowSiltSed(int const n) const
+   {
+      return m_pdOutFlowSiltSed[n];
+   }
+
+   //! Sets the depth of sand sediment load (mm) which flows out of the cell with this index
+   inline void SetOutFlowSandSed(int const n, double const dDepth)
+   {
+      m_pdOutFlowSandSed[n] = dDepth;
+   }
+
+   //! Returns the depth of sand sediment load (mm) which flows out of the cell with this index
+   inline double dGetOutFlowSandSed(int const n) const
+   {
+      return m_pdOutFlowSandSed[n];
+   }
+
+   //! Sets the thickness of soil (mm) to be detached by flow from the cell which receives the outflow from the cell with this index
+   inline void SetOutFlowDetach(int const n, double const dThickness)
+   {
+      m_pdOutFlowDetach[n] = dThickness;
+   }
+
+   //! Returns the thickness of soil (mm) to be detached by flow from the cell which receives the outflow from the cell with this index
+   inline double dGetOutFlowDetach(int const n) const
+   {
+      return m_pdOutFlowDetach[n];
+   }
+
+   //! Sets the head (mm) of the outflow from the cell with this index
+   inline void SetOutFlowHead(int const n, double const dHead)
+   {
+      m_pdOutFlowHead[n] = dHead;
+   }
+
+   //! Returns the head (mm) of the outflow from the cell with this index, or -1 if no head was calculated
+   inline double dGetOutFlowHead(int const n) const
+   {
+      return m_pdOutFlowHead[n];
+   }
+
+   //! Sets the flow speed (mm/sec) of the outflow from the cell with this index
+   inline void SetOutFlowSpeed(int const n, double const dSpeed)
+   {
+      m_pdOutFlowSpeed[n] = dSpeed;
+   }
+
+   //! Returns the flow speed (mm/sec) of the outflow from the cell with this index
+   inline double dGetOutFlowSpeed(int const n) const
+   {
+      return m_pdOutFlowSpeed[n];
+   }
+
+   //! Records that the flow velocity of the cell with this index needs to be re-initialized
+   inline void SetOutFlowInitVelocity(int const n)
+   {
+      m_pucOutFlowInitVelocity[n] = 1;
+   }
+
+   //! Returns true if the flow velocity of the cell with this index needs to be re-initialized
+   inline bool bGetOutFlowInitVelocity(int const n) const
+   {
+      return (m_pucOutFlowInitVelocity[n] != 0);
+   }
+
+   //! Returns a pointer to the surface water depth (mm) of the cell with this index. The cells which follow it in the same column are contiguous
+   inline double const* pdGetSurfaceWaterDepth(int const n) const
+   {
+      return m_pdSurfaceWaterDepth + n;
+   }
+
+   //! Returns the soil water content (mm depth) of soil layer nLayer of the cell with this index
+   inline double dGetLayerSoilWater(int const nLayer, int const n) const
+   {
+      return m_pdLayerSoilWater[(nLayer * m_nCells) + n];
+   }
+
+   //! Sets the soil water content (mm depth) of soil layer nLayer of the cell with this index
+   inline void SetLayerSoilWater(int const nLayer, int const n, double const dWater)
+   {
+      m_pdLayerSoilWater[(nLayer * m_nCells) + n] = dWater;
+   }
+
+   //! Changes the soil water content (mm depth) of soil layer nLayer of the cell with this index
+   inline void ChangeLayerSoilWater(int const nLayer, int const n, double const dWater)
+   {
+      m_pdLayerSoilWater[(nLayer * m_nCells) + n] += dWater;
+   }
+
+   //! Returns a pointer to the soil water content (mm depth) of soil layer nLayer of the cell with this index. The cells which follow it in the same column are contiguous
+   inline double const* pdGetLayerSoilWater(int const nLayer, int const n) const
+   {
+      return m_pdLayerSoilWater + (nLayer * m_nCells) + n;
+   }
+
+   //! Returns the thickness (mm) of soil layer nLayer of the cell with this index
+   inline double dGetLayerThickness(int const nLayer, int const n) const
+   {
+      return m_pdLayerThickness[(nLayer * m_nCells) + n];
+   }
+
+   //! Sets the thickness (mm) of soil layer nLayer of the cell with this index
+   inline void SetLayerThickness(int const nLayer, int const n, double const dThickness)
+   {
+      m_pdLayerThickness[(nLayer * m_nCells) + n] = dThickness;
+   }
+
+   //! Returns the Laplacian of the soil surface elevation of the cell with this index, as last calculated by CalcAllLaplacian()
+   inline double dGetLaplacian(int const n) const
+   {
+      return m_pdLaplacian[n];
+   }
+
+   //! Adds to the shear stress of flow on the cell with this index which has not yet been spread over the surrounding patch of cells. Changes only this cell
+   inline void IncRawShearStress(int const n, double const dShearStress)
+   {
+      m_pdRawShearStress[n] += dShearStress;
+   }
+
+   //! Returns a pointer to the unspread shear stress of the cell with this index. The cells which follow it in the same column are contiguous
+   inline double const* pdGetRawShearStress(int const n) const
+   {
+      return m_pdRawShearStress + n;
+   }
+
+   //! Zeroes the unspread shear stress of the cell with this index, once it has been spread
+   inline void ClearRawShearStress(int const n)
+   {
+      m_pdRawShearStress[n] = 0;
+   }
+
+   //! Returns the number of cells in the wet-cell activity list
+   inline int nGetNumWetActive(void) const
+   {
+      return static_cast<int>(m_VnWetActive.size());
+   }
+
+   //! Returns the store index of the cell at position i in the wet-cell activity list
+   inline int nGetWetActive(int const i) const
+   {
+      return m_VnWetActive[i];
+   }
+
+   //! Records that the cell with this index may have become wet, it is added to the wet-cell activity list (with its neighbours) by the next call to GrowWetActive(). Is not thread-safe
+   inline void AddWetCandidate(int const n)
+   {
+      m_VnWetCandidate.push_back(n);
+   }
+
+   //! Empties the rain-hit list
+   inline void ClearRainHit(void)
+   {
+      for (unsigned int i = 0; i < m_VnRainHit.size(); i++)
+         m_pucRainHit[m_VnRainHit[i]] = 0;
+
+      m_VnRainHit.clear();
+   }
+
+   //! Adds the cell with this index to the rain-hit list, unless it is already there. Returns true if it was added, i.e. if this is the first rain to fall on the cell during this iteration. Is not thread-safe
+   inline bool bAddRainHit(int const n)
+   {
+      if (m_pucRainHit[n])
+         return false;
+
+      m_pucRainHit[n] = 1;
+      m_VnRainHit.push_back(n);
+      return true;
+   }
+
+   //! Returns the number of cells in the rain-hit list
+   inline int nGetNumRainHit(void) const
+   {
+      return static_cast<int>(m_VnRainHit.size());
+   }
+
+   //! Returns the store index of the cell at position i in the rain-hit list
+   inline int nGetRainHit(int const i) const
+   {
+      return m_VnRainHit[i];
+   }
+};
+#endif         // __GRID_STORE_H__
@@ -16,22 +16,18 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
 
 //=========================================================================================================================================
 //! This member function of CSimulation simulates headcut retreat on all cells
 //=========================================================================================================================================
 void CSimulation::DoAllHeadcutRetreat(void)
 {
-   for (int nX = 0; nX < m_nXGridMax; nX++)
+   for (int nSpan = 0; nSpan < m_pGrid->nGetNumActiveSpans(); nSpan++)
    {
-      for (int nY = 0; nY < m_nYGridMax; nY++)
+      int nX = m_pGrid->nGetActiveSpanX(nSpan);
+      for (int nY = m_pGrid->nGetActiveSpanFirstY(nSpan); nY <= m_pGrid->nGetActiveSpanLastY(nSpan); nY++)
       {
-         if (m_Cell[nX][nY].bIsMissingValue())
-         {
-            // Don't do headcut retreat on edge cells, this is to avoid edge effects TODO May be OK as long as retreat direction is not towards the edge
-            continue;
-         }
-
          // OK check to see if this cell is ready for headcut collapse
          for (int nDir = 0; nDir < 8; nDir++)
          {
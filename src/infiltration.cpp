@@ -16,6 +16,7 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
 
 //=========================================================================================================================================
 //! Sets an initial value for subsurface water for every cell
@@ -30,13 +31,13 @@ void CSimulation::InitSoilWater(void)
       {
          for (int nY = 0; nY < m_nYGridMax; nY++)
          {
-            CCellSoilLayer* pLayer = m_Cell[nX][nY].pGetSoil()->pLayerGetLayer(nLayer);
+            int n = m_pGrid->nGetIndex(nX, nY);
 
             double
-               dLayerThickness = pLayer->dGetLayerThickness(),
+               dLayerThickness = m_pGrid->dGetLayerThickness(nLayer, n),
                dInitialSoilWaterDepth = m_VdInputSoilLayerInfiltInitWater[nLayer] * dLayerThickness;       // in mm
 
-            pLayer->SetSoilWater(dInitialSoilWaterDepth);
+            m_pGrid->SetLayerSoilWater(nLayer, n, dInitialSoilWaterDepth);
          }
       }
 
@@ -52,105 +53,182 @@ void CSimulation::InitSoilWater(void)
 }
 
 //=========================================================================================================================================
-//! This calculates subsurface water movement for all cells
+//! This calculates subsurface water movement for all cells. It works one soil layer at a time, starting at the top soil layer and working downwards; within each layer, the spans of active cells are shared between threads. Since each cell's layers are still dealt with from the top down, and cells do not interact, the result for each cell is the same as if the cells were dealt with one at a time. The totals are first summed for each span, then the span totals are summed in span order, so that they do not depend on the number of threads
 //=========================================================================================================================================
 void CSimulation::DoAllInfiltration()
 {
-   for (int nX = 0; nX < m_nXGridMax; nX++)
+   int nSpans = m_pGrid->nGetNumActiveSpans();
+
+   vector<double> VdSpanInfilt(nSpans, 0);
+   vector<double> VdSpanExfilt(nSpans, 0);
+   vector<double> VdSpanClayDeposit(nSpans, 0);
+   vector<double> VdSpanSiltDeposit(nSpans, 0);
+   vector<double> VdSpanSandDeposit(nSpans, 0);
+   vector<double> VdSpanSoilWater(nSpans, 0);
+
+   // For each span, the cells which have exfiltrated to surface water, so may now be wet
+   vector<vector<int> > VVnSpanExfiltCell(nSpans);
+
+   for (int nLayer = 0; nLayer < m_nNumSoilLayers; nLayer++)
    {
-      for (int nY = 0; nY < m_nYGridMax; nY++)
+#if defined _OPENMP
+      #pragma omp parallel
+#endif
       {
-         // Start at the top soil layer and work downwards
-         for (int nLayer = 0; nLayer < m_nNumSoilLayers; nLayer++)
+         // The potential depth of infiltration for each cell in a span
+         vector<double> VdPotential(m_nYGridMax);
+
+#if defined _OPENMP
+         #pragma omp for schedule(dynamic)
+#endif
+         for (int nSpan = 0; nSpan < nSpans; nSpan++)
          {
-            CCellSoilLayer* pLayer = m_Cell[nX][nY].pGetSoil()->pLayerGetLayer(nLayer);
+            int
+               nX = m_pGrid->nGetActiveSpanX(nSpan),
+               nFirstY = m_pGrid->nGetActiveSpanFirstY(nSpan),
+               nLastY = m_pGrid->nGetActiveSpanLastY(nSpan);
 
-            // Get the subsurface water content (a depth equivalent) for this layer
-            double dLayerSoilWaterDepth = pLayer->dGetSoilWater();
+            // First calculate the potential infiltration for every cell in this span in one go. This is wasted for cells which turn out to be saturated (or dry, for the top layer) but it is much quicker than doing it cell by cell
+            CalcPotentialInfiltration(nLayer, m_pGrid->nGetIndex(nX, nFirstY), nLastY - nFirstY + 1, &VdPotential[0]);
 
-            // Now calculate the saturated (maximum) soil water content (also a depth equivalent) for this layer
-            double
-               dLayerThickness = pLayer->dGetLayerThickness(),
-               dLayerMaxSoilWaterDepth = m_VdInputSoilLayerInfiltSatWater[nLayer] * dLayerThickness,  // In mm
-               dDiff = dLayerMaxSoilWaterDepth - dLayerSoilWaterDepth;
+            VdSpanSoilWater[nSpan] = 0;
 
-            // Is this soil layer over-saturated?
-            if ((dDiff + TOLERANCE) < 0)
+            for (int nY = nFirstY; nY <= nLastY; nY++)
             {
-               // Yes, so do exfilt
-               DoCellExfiltration(nX, nY, nLayer, pLayer, -dDiff);
-
-               if (nLayer == 0)
-                  // This is the top layer
-                  m_dEndOfIterExfiltration += dDiff;
+               int n = m_pGrid->nGetIndex(nX, nY);
+
+               // Get the subsurface water content (a depth equivalent) for this layer
+               double dLayerSoilWaterDepth = m_pGrid->dGetLayerSoilWater(nLayer, n);
+
+               // Now calculate the saturated (maximum) soil water content (also a depth equivalent) for this layer
+               double
+                  dLayerThickness = m_pGrid->dGetLayerThickness(nLayer, n),
+                  dLayerMaxSoilWaterDepth = m_VdInputSoilLayerInfiltSatWater[nLayer] * dLayerThickness,  // In mm
+                  dDiff = dLayerMaxSoilWaterDepth - dLayerSoilWaterDepth;
+
+               // Is this soil layer over-saturated?
+               if ((dDiff + TOLERANCE) < 0)
+               {
+                  // Yes, so do exfilt
+                  DoCellExfiltration(nX, nY, nLayer, -dDiff);
+
+                  if (nLayer == 0)
+                  {
+                     // This is the top layer
+                     VdSpanExfilt[nSpan] += dDiff;
+                     VVnSpanExfiltCell[nSpan].push_back(n);
+                  }
+
+//                   m_ofsLog << m_ulIter << ": exfiltration " << -dDiff << " from layer " << nLayer << " at [" << nX << "][" << nY << "] since dLayerMaxSoilWaterDepth = " << dLayerMaxSoilWaterDepth << ", dLayerSoilWaterDepth = " << dLayerSoilWaterDepth << endl;
+
+                  continue;
+               }
+
+               // Is this soil layer under-saturated?
+               if ((dDiff - TOLERANCE) > 0)
+               {
+                  // Yes, so do infilt
+//                   m_ofsLog << m_ulIter << ": infiltration " << dDiff << " into layer " << nLayer << " at [" << nX << "][" << nY << "] since dLayerMaxSoilWaterDepth = " << dLayerMaxSoilWaterDepth << ", dLayerSoilWaterDepth = " << dLayerSoilWaterDepth << endl;
+
+                  DoCellInfiltration(nX, nY, nLayer, dDiff, VdPotential[nY - nFirstY], VdSpanClayDeposit[nSpan], VdSpanSiltDeposit[nSpan], VdSpanSandDeposit[nSpan]);
+
+                  if (nLayer == 0)
+                     // This is the top layer
+                     VdSpanInfilt[nSpan] += dDiff;
+               }
+
+               // Update this span's this-operation total
+               VdSpanSoilWater[nSpan] += m_pGrid->dGetLayerSoilWater(nLayer, n);
+            }
+         }
+      }
 
-//                m_ofsLog << m_ulIter << ": exfiltration " << -dDiff << " from layer " << nLayer << " at [" << nX << "][" << nY << "] since dLayerMaxSoilWaterDepth = " << dLayerMaxSoilWaterDepth << ", dLayerSoilWaterDepth = " << dLayerSoilWaterDepth << endl;
+      // Add this layer's span totals to the this-operation total, always in the same order
+      for (int nSpan = 0; nSpan < nSpans; nSpan++)
+         m_VdThisIterSoilWater[nLayer] += VdSpanSoilWater[nSpan];
+   }
 
-               continue;
-            }
+   // And add the other span totals to the this-iteration totals, again always in the same order
+   for (int nSpan = 0; nSpan < nSpans; nSpan++)
+   {
+      m_dEndOfIterExfiltration += VdSpanExfilt[nSpan];
+      m_dEndOfIterInfiltration += VdSpanInfilt[nSpan];
+      m_dEndOfIterClayInfiltDeposit += VdSpanClayDeposit[nSpan];
+      m_dEndOfIterSiltInfiltDeposit += VdSpanSiltDeposit[nSpan];
+      m_dEndOfIterSandInfiltDeposit += VdSpanSandDeposit[nSpan];
+
+      for (unsigned int i = 0; i < VVnSpanExfiltCell[nSpan].size(); i++)
+         m_pGrid->AddWetCandidate(VVnSpanExfiltCell[nSpan][i]);
+   }
+}
 
-            // Is this soil layer under-saturated?
-            if ((dDiff - TOLERANCE) > 0)
-            {
-               // Yes, so do infilt
-//                m_ofsLog << m_ulIter << ": infiltration " << dDiff << " into layer " << nLayer << " at [" << nX << "][" << nY << "] since dLayerMaxSoilWaterDepth = " << dLayerMaxSoilWaterDepth << ", dLayerSoilWaterDepth = " << dLayerSoilWaterDepth << endl;
+//=========================================================================================================================================
+//! This member function of CSimulation calculates the potential depth of infiltration into soil layer nLayer, using the EPA Explicit Green-Ampt Model (GAEXP), see https://www.epa.gov/water-research/infiltration-models#Explicitgreen. This is done for nNum cells which are contiguous in the grid store, starting with the cell with index nFirst; the results are written to pdPotential. The water above the layer is the surface water for the top layer, or the soil water of the layer above. There are no branches, so the loop vectorizes
+//=========================================================================================================================================
+void CSimulation::CalcPotentialInfiltration(int const nLayer, int const nFirst, int const nNum, double* pdPotential) const
+{
+   double const* pdWaterDepthAbove = (nLayer == 0 ? m_pGrid->pdGetSurfaceWaterDepth(nFirst) : m_pGrid->pdGetLayerSoilWater(nLayer-1, nFirst));
+
+   double
+      dCPHWF = m_VdInfiltCPHWF[nLayer],
+      dChiPart = m_VdInfiltChiPart[nLayer],
+      dKSat = m_VdInputSoilLayerInfiltKSat[nLayer],
+      dTimeElapsedinHours = m_dSimulatedTimeElapsed / 3600,           // in hours
+      dTimeStep = m_dTimeStep;
+
+   // Constants for equation 5
+   double const
+      dA = sqrt(2.0) / 2.0,
+      dB = 2.0 / 3.0,
+      dC = sqrt(2.0) / 6.0,
+      dD = (1.0 - sqrt(2.0)) / 3.0;
+
+#if defined _OPENMP
+   #pragma omp simd
+#endif
+   for (int n = 0; n < nNum; n++)
+   {
+      // Calculate the remaining part of equation 3
+      double dChi = (pdWaterDepthAbove[n] - dCPHWF) * dChiPart;
 
-               DoCellInfiltration(nX, nY, nLayer, pLayer, dDiff);
+      // Equation 4
+      double dTauT = dTimeElapsedinHours / (dTimeElapsedinHours + dChi);
 
-               if (nLayer == 0)
-                  // This is the top layer
-                  m_dEndOfIterInfiltration += dDiff;
-            }
+      // Equation 5, with pow(dTauT, 0.5) and pow(dTauT, -0.5) replaced by a single square root
+      double dSqrtTauT = sqrt(dTauT);
+      double dInfiltrationRate = ((dA / dSqrtTauT) + dB - (dC * dSqrtTauT) + (dD * dTauT)) * dKSat;
 
-            // Update the this-operation total
-            m_VdThisIterSoilWater[nLayer] += m_Cell[nX][nY].pGetSoil()->pLayerGetLayer(nLayer)->dGetSoilWater();
-         }
-      }
+      // Convert from cm/hr to mm/sec, and calculate the potential depth to try to infiltrate
+      pdPotential[n] = (dInfiltrationRate / 360.0) * dTimeStep;
    }
 }
 
 //=========================================================================================================================================
-//! This member function of CSimulation calculates water loss from infilt for one cell using the EPA Explicit Green-Ampt Model (GAEXP), see https://www.epa.gov/water-research/infiltration-models#Explicitgreen
+//! This member function of CSimulation calculates water loss from infiltration for one cell, given the potential depth to infiltrate as calculated by CalcPotentialInfiltration(). Any sediment deposited because of infiltration is added to dClayDeposited, dSiltDeposited and dSandDeposited
 //=========================================================================================================================================
-void CSimulation::DoCellInfiltration(int const nX, int const nY, int const nLayer, CCellSoilLayer* pLayer, double const dDeficit)
+void CSimulation::DoCellInfiltration(int const nX, int const nY, int const nLayer, double const dDeficit, double const dPotential, double& dClayDeposited, double& dSiltDeposited, double& dSandDeposited)
 {
+   int n = m_pGrid->nGetIndex(nX, nY);
+
    // The layer is not fully saturated, so maybe can get water from the layer above, or from surface water if this is the top layer
-   CCellSoilLayer* pLayerAbove = NULL;
    double dWaterDepthAbove = 0;
    if (nLayer == 0)
    {
       // This is the top layer
-      if (! m_Cell[nX][nY].pGetSurfaceWater()->bIsWet())
+      if (! m_pGrid->bIsWet(n))
          return;
 
       // The cell is wet, so get the depth of surface water
-      dWaterDepthAbove = m_Cell[nX][nY].pGetSurfaceWater()->dGetSurfaceWaterDepth();
+      dWaterDepthAbove = m_pGrid->dGetSurfaceWaterDepth(n);
    }
    else
    {
-      // This is not the top layer
-      pLayerAbove = m_Cell[nX][nY].pGetSoil()->pLayerGetLayer(nLayer-1);
-
-      // Get the depth of water in the soil layer above
-      dWaterDepthAbove = pLayerAbove->dGetSoilWater();
+      // This is not the top layer, so get the depth of water in the soil layer above
+      dWaterDepthAbove = m_pGrid->dGetLayerSoilWater(nLayer-1, n);
    }
 
-   // Calculate the remaining part of equation 3
-   double dChi = (dWaterDepthAbove - m_VdInfiltCPHWF[nLayer]) * m_VdInfiltChiPart[nLayer];
-
-   double dTimeElapsedinHours = m_dSimulatedTimeElapsed / 3600;           // in hours
-
-   // Equation 4
-   double dTauT = dTimeElapsedinHours / (dTimeElapsedinHours + dChi);
-
-   // Equation 5
-   double dInfiltrationRate = (((sqrt(2.0)/2.0) * pow(dTauT, -0.5)) + (2.0/3.0) - ((sqrt(2.0)/6.0) * pow(dTauT, 0.5)) + (((1.0-sqrt(2.0))/3.0) * dTauT)) * m_VdInputSoilLayerInfiltKSat[nLayer];
-
-   // Convert from cm/hr to mm/sec
-   dInfiltrationRate /= 360.0;
-
-   // And calculate the potential depth to try to infiltrate. However, this must not result in soil water being greater than the saturated maximum
-   double dPotentialDepthToInfiltrate = tMin(dInfiltrationRate * m_dTimeStep, dDeficit);
+   // The potential depth to try to infiltrate must not result in soil water being greater than the saturated maximum
+   double dPotentialDepthToInfiltrate = tMin(dPotential, dDeficit);
 
    double dDepthToInfiltrate = 0;
    if (dWaterDepthAbove > dPotentialDepthToInfiltrate)
@@ -166,8 +244,8 @@ void CSimulation::DoCellInfiltration(int const nX, int const nY, int const nLaye
       else
       {
          // This is not the top layer: remove water from the soil layer above and add to this layer
-         pLayerAbove->ChangeSoilWater(-dDepthToInfiltrate);
-         pLayer->ChangeSoilWater(dDepthToInfiltrate);
+         m_pGrid->ChangeLayerSoilWater(nLayer-1, n, -dDepthToInfiltrate);
+         m_pGrid->ChangeLayerSoilWater(nLayer, n, dDepthToInfiltrate);
       }
    }
    else
@@ -177,23 +255,23 @@ void CSimulation::DoCellInfiltration(int const nX, int const nY, int const nLaye
 
       if (nLayer == 0)
       {
-         // This is the top layer, so remove the water, update total infilt for this cell, assume that any in-transport sediment is deposited and add this to the per-iteration total of infitration-deposited sediment
+         // This is the top layer, so remove the water, update total infilt for this cell, assume that any in-transport sediment is deposited and add this to the totals of infitration-deposited sediment
          double
-            dClayDeposited = 0,
-            dSiltDeposited = 0,
-            dSandDeposited = 0;
+            dClay = 0,
+            dSilt = 0,
+            dSand = 0;
 
-         m_Cell[nX][nY].pGetSoilWater()->InfiltrateAndMakeDry(dClayDeposited, dSiltDeposited, dSandDeposited);
+         m_Cell[nX][nY].pGetSoilWater()->InfiltrateAndMakeDry(dClay, dSilt, dSand);
 
-         m_dEndOfIterClayInfiltDeposit += dClayDeposited;
-         m_dEndOfIterSiltInfiltDeposit += dSiltDeposited;
-         m_dEndOfIterSandInfiltDeposit += dSandDeposited;
+         dClayDeposited += dClay;
+         dSiltDeposited += dSilt;
+         dSandDeposited += dSand;
       }
       else
       {
          // This is not the top layer: remove water from the soil layer above and add to this layer
-         pLayerAbove->ChangeSoilWater(-dDepthToInfiltrate);
-         pLayer->ChangeSoilWater(dDepthToInfiltrate);
+         m_pGrid->ChangeLayerSoilWater(nLayer-1, n, -dDepthToInfiltrate);
+         m_pGrid->ChangeLayerSoilWater(nLayer, n, dDepthToInfiltrate);
       }
    }
 }
@@ -201,20 +279,19 @@ void CSimulation::DoCellInfiltration(int const nX, int const nY, int const nLaye
 //=========================================================================================================================================
 //! Calculates water loss from exfilt for one cell TODO this needs to be looked at
 //=========================================================================================================================================
-void CSimulation::DoCellExfiltration(int const nX, int const nY, int const nLayer, CCellSoilLayer* pLayer, double const dExcess)
+void CSimulation::DoCellExfiltration(int const nX, int const nY, int const nLayer, double const dExcess)
 {
+   int n = m_pGrid->nGetIndex(nX, nY);
+
    // The current soil layer is over-saturated, so we must try to get rid of some water from it. First try to move it downwards to the layer below
    if (nLayer < m_nNumSoilLayers-1)
    {
-      // We are not on the lowest (i.e. just above basement) layer, so get a pointer to the layer below
-      CCellSoilLayer* pLayerBelow = m_Cell[nX][nY].pGetSoil()->pLayerGetLayer(nLayer+1);
-
-      // Get the soil water content for the layer below
-      double dLayerBelowSoilWater = pLayerBelow->dGetSoilWater();
+      // We are not on the lowest (i.e. just above basement) layer, so get the soil water content for the layer below
+      double dLayerBelowSoilWater = m_pGrid->dGetLayerSoilWater(nLayer+1, n);
 
       // Now calculate the saturated (maximum) soil water content (a depth equivalent) for the layer below
       double
-         dLayerBelowThickness = pLayerBelow->dGetLayerThickness(),
+         dLayerBelowThickness = m_pGrid->dGetLayerThickness(nLayer+1, n),
          dLayerBelowMaxSoilWater = m_VdInputSoilLayerInfiltSatWater[nLayer+1] * dLayerBelowThickness,
          dLayerBelowDiff = dLayerBelowMaxSoilWater - dLayerBelowSoilWater;
 
@@ -224,8 +301,8 @@ void CSimulation::DoCellExfiltration(int const nX, int const nY, int const nLaye
          double dToMoveToLayerBelow = tMin(dExcess, dLayerBelowMaxSoilWater - dLayerBelowSoilWater);
 
          // Remove water from this layer and add to the layer below
-         pLayerBelow->ChangeSoilWater(dToMoveToLayerBelow);
-         pLayer->ChangeSoilWater(-dToMoveToLayerBelow);
+         m_pGrid->ChangeLayerSoilWater(nLayer+1, n, dToMoveToLayerBelow);
+         m_pGrid->ChangeLayerSoilWater(nLayer, n, -dToMoveToLayerBelow);
 
          return;
       }
@@ -248,10 +325,9 @@ void CSimulation::DoCellExfiltration(int const nX, int const nY, int const nLaye
 //       m_ofsLog << m_ulIter << " [" << nX << "][" << nY << "] exfilt from layer " << nLayer << " to " << nLayer-1 << " = " << dExcess << endl;
 
       // Remove water from this layer
-      pLayer->ChangeSoilWater(-dExcess);
+      m_pGrid->ChangeLayerSoilWater(nLayer, n, -dExcess);
 
       // And add it to the layer above
-      CCellSoilLayer* pLayerAbove = m_Cell[nX][nY].pGetSoil()->pLayerGetLayer(nLayer-1);
-      pLayerAbove->ChangeSoilWater(dExcess);
+      m_pGrid->ChangeLayerSoilWater(nLayer-1, n, dExcess);
    }
 }
@@ -16,147 +16,312 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
+#include "friction_factor_table.h"
 
 //=========================================================================================================================================
-//! This routes flow from all wet cells during one timestep
+//! This routes flow from all wet cells during one timestep. Only the cells in the wet-cell activity list are dealt with: water can only flow from a wet cell to one of its neighbours, so no other cell can change
 //=========================================================================================================================================
 void CSimulation::DoAllFlowRouting(void)
 {
-   // First copy the surface water and (if we are considering flow erosion) sediment load values TODO IS THIS CORRECT? for every cell to the temporary values
-   for (int nX = 0; nX < m_nXGridMax; nX++)
+   // Add any cells which have become wet since the last flow routing (e.g. by rain, run-on, or exfiltration) to the wet-cell activity list, along with their neighbours
+   m_pGrid->GrowWetActive();
+   int nWetActive = m_pGrid->nGetNumWetActive();
+
+   // Top elevations do not change until routing is finished, so find the steepest downhill top-surface gradient from every listed cell now
+   m_pGrid->CalcAllSteepestTopSlopes(m_dCellSide, m_dCellDiag, m_dInvCellSide, m_dInvCellDiag);
+
+   // Surface water depths do not change until routing is finished either, so also find the hydraulic radius and Reynolds number of every listed cell
+   CalcAllHydraulicState();
+
+#if defined _DEBUG
+   // Check that these are the same as the values found cell-by-cell
+   DEBUGCheckSteepestTopSlopes();
+   DEBUGCheckHydraulicState();
+#endif
+
+   // First copy the surface water and (if we are considering flow erosion) sediment load values TODO IS THIS CORRECT? for every listed cell to the temporary values. This only touches each cell's own fields, so can be done in parallel when doing two-phase routing
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static) if (m_bTwoPhaseFlowRouting)
+#endif
+   for (int i = 0; i < nWetActive; i++)
    {
-      for (int nY = 0; nY < m_nYGridMax; nY++)
-      {
-         m_Cell[nX][nY].pGetSoil()->InitTmpLayerThicknesses();
-         m_Cell[nX][nY].pGetSurfaceWater()->InitTmpSurfaceWater();
-      }
+      int
+         n = m_pGrid->nGetWetActive(i),
+         nX = m_pGrid->nGetXFromIndex(n),
+         nY = m_pGrid->nGetYFromIndex(n);
+
+      m_Cell[nX][nY].pGetSoil()->InitTmpLayerThicknesses();
+      m_Cell[nX][nY].pGetSurfaceWater()->InitTmpSurfaceWater();
+      m_pGrid->ClearSedFlow(n);
    }
 
    // DEBUG_SEDLOAD("in flow routing 1");
 
-   // Go through all cells in the cell array, and calculate the outflow from each cell. Write the results to the temporary fields in the cell objects
-   for (int nX = 0; nX < m_nXGridMax; nX++)
+   if (m_bTwoPhaseFlowRouting)
+   {
+      // Calculate each cell's outflow, then let each cell gather its inflows
+      DoTwoPhaseFlowRouting();
+   }
+   else
    {
-      for (int nY = 0; nY < m_nYGridMax; nY++)
+      // Go through the listed cells, in the same order as the spans of active cells, and calculate the outflow from each cell. Write the results to the temporary fields in the cell objects
+      for (int i = 0; i < nWetActive; i++)
       {
-         if (m_Cell[nX][nY].bIsMissingValue())
-            // Don't do cells outside the valid part of the grid
-            continue;
-
-         if (m_Cell[nX][nY].pGetSurfaceWater()->bIsWet())
-         {
-            // This is a wet cell, is an edge cell?
-            if (m_Cell[nX][nY].bIsEdgeCell())
-            {
-               // It is an edge cell, which edge?
-               int nEdge = m_Cell[nX][nY].nGetEdge();
-
-               if (nEdge == DIRECTION_TOP)
-               {
-                  // Top edge
-                  if (m_bClosedThisEdge[EDGE_TOP])
-                     // This edge is closed, so see if there is an adjacent cell in any of the non-edge directions to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
-                     TryCellOutFlow(nX, nY);
-                  else
-                     // This edge is not closed, so see if we can do some off-edge flow. If so, move the water and maybe do some erosion or deposition
-                     TryEdgeCellOutFlow(nX, nY, DIRECTION_TOP);
-               }
-
-               else if (nEdge == DIRECTION_RIGHT)
-               {
-                  // Right edge
-                  if (m_bClosedThisEdge[EDGE_RIGHT])
-                     // This edge is closed, so see if there is an adjacent cell in any of the non-edge directions to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
-                     TryCellOutFlow(nX, nY);
-                  else
-                     // This edge is not closed, so see if we can do some off-edge flow. If so, move the water and maybe do some erosion or deposition
-                     TryEdgeCellOutFlow(nX, nY, DIRECTION_RIGHT);
-               }
-
-               else if (nEdge == DIRECTION_BOTTOM)
-               {
-                  // Bottom edge
-                  if (m_bClosedThisEdge[EDGE_BOTTOM])
-                     // This edge is closed, so see if there is an adjacent cell in any of the non-edge directions to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
-                     TryCellOutFlow(nX, nY);
-                  else
-                     // This edge is not closed, so see if we can do some off-edge flow. If so, move the water and maybe do some erosion or deposition
-                     TryEdgeCellOutFlow(nX, nY, DIRECTION_BOTTOM);
-               }
-
-               else if (nEdge == DIRECTION_LEFT)
-               {
-                  // Left edge
-                  if (m_bClosedThisEdge[EDGE_LEFT])
-                     // This edge is closed, so see if there is an adjacent cell in any of the non-edge directions to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
-                     TryCellOutFlow(nX, nY);
-                  else
-                     // This edge is not closed, so see if we can do some off-edge flow. If so, move the water and maybe do some erosion or deposition
-                     TryEdgeCellOutFlow(nX, nY, DIRECTION_LEFT);
-               }
-            }
-            else
-               // It isn't an edge cell. See if there is an adjacent cell to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
-               TryCellOutFlow(nX, nY);
-         }
+         int n = m_pGrid->nGetWetActive(i);
+         DoCellOutFlow(m_pGrid->nGetXFromIndex(n), m_pGrid->nGetYFromIndex(n));
       }
    }
 
+   // Routing only recorded the outflow from each cell, so now do the sediment calculations (transport capacity, then flow erosion or deposition) for every recorded outflow. These only read values which routing does not change, and write to the temporary fields
+   if (m_bFlowErosion || m_bSplash || m_bSlumping)
+      DoAllSedimentFlow();
+
    // DEBUG_SEDLOAD("in flow routing 2");
 
-   // And finally copy from the temporary values to the surface water and (if considering flow erosion) sediment load values for each cell
-   for (int nX = 0; nX < m_nXGridMax; nX++)
+   // And finally copy from the temporary values to the surface water and (if considering flow erosion) sediment load values for each cell. Again, this only touches each cell's own fields
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static) if (m_bTwoPhaseFlowRouting)
+#endif
+   for (int i = 0; i < nWetActive; i++)
+   {
+      int
+         n = m_pGrid->nGetWetActive(i),
+         nX = m_pGrid->nGetXFromIndex(n),
+         nY = m_pGrid->nGetYFromIndex(n);
+
+      m_Cell[nX][nY].pGetSoil()->FinishTmpLayerThicknesses();
+      m_Cell[nX][nY].pGetSurfaceWater()->FinishTmpSurfaceWater();
+
+      if (! m_pGrid->bIsWet(n))
+         m_Cell[nX][nY].pGetSurfaceWater()->ZeroAllFlowVelocity();
+   }
+
+   // Some cells may now have become wet, and some may have dried, so update the wet-cell activity list
+   m_pGrid->UpdateWetActive();
+
+   // DEBUG_SEDLOAD("in flow routing 3");
+}
+
+//=========================================================================================================================================
+//! Routes flow in two phases. In the first phase, each cell calculates its outflow and writes it to its own slot in the grid store; the only cell object which is changed is the cell itself. In the second phase, each cell gathers the inflows from its eight neighbours, taking them in a fixed order. Neither phase writes to another cell, so each may be run in parallel without locks, and the results do not depend on the number of threads
+//=========================================================================================================================================
+void CSimulation::DoTwoPhaseFlowRouting(void)
+{
+   int nWetActive = m_pGrid->nGetNumWetActive();
+
+   // Phase one: calculate the outflow from each wet cell
+#if defined _OPENMP
+   #pragma omp parallel for schedule(dynamic, ACTIVE_LIST_CHUNK)
+#endif
+   for (int i = 0; i < nWetActive; i++)
+   {
+      int n = m_pGrid->nGetWetActive(i);
+      m_pGrid->ClearOutFlow(n);
+      DoCellOutFlow(m_pGrid->nGetXFromIndex(n), m_pGrid->nGetYFromIndex(n));
+   }
+
+   // Now a serial pass, in the same cell order as single-phase routing. Re-initialize flow velocities which need it (with sequential random numbers this must always be done in the same order; with counter-based random numbers it has already been done in phase one) and add to the this-iteration head and flow speed values
+   for (int i = 0; i < nWetActive; i++)
+   {
+      int n = m_pGrid->nGetWetActive(i);
+
+      if (m_pGrid->bGetOutFlowInitVelocity(n))
+         m_Cell[m_pGrid->nGetXFromIndex(n)][m_pGrid->nGetYFromIndex(n)].pGetSurfaceWater()->InitializeAllFlowVelocity(RAND_STREAM_FLOW_VELOCITY);
+
+      double dHead = m_pGrid->dGetOutFlowHead(n);
+      if (dHead >= 0)
+      {
+         m_dEndOfIterTotHead += dHead;
+         m_ulNumHead++;
+      }
+
+      m_dPossMaxSpeedNextIter = tMax(m_pGrid->dGetOutFlowSpeed(n), m_dPossMaxSpeedNextIter);
+   }
+
+   // Phase two: each cell gathers the inflows from its neighbours. Any neighbour which is not in the list has a cleared outflow slot
+#if defined _OPENMP
+   #pragma omp parallel for schedule(dynamic, ACTIVE_LIST_CHUNK)
+#endif
+   for (int i = 0; i < nWetActive; i++)
+   {
+      int n = m_pGrid->nGetWetActive(i);
+      GatherCellInFlow(m_pGrid->nGetXFromIndex(n), m_pGrid->nGetYFromIndex(n));
+   }
+}
+
+//=========================================================================================================================================
+//! Calculates the outflow from a single cell, if it is wet. For edge cells, this may be flow off the edge of the grid
+//=========================================================================================================================================
+void CSimulation::DoCellOutFlow(int const nX, int const nY)
+{
+   if (! m_pGrid->bIsWet(m_pGrid->nGetIndex(nX, nY)))
+      return;
+
+   // This is a wet cell, is an edge cell?
+   if (m_Cell[nX][nY].bIsEdgeCell())
    {
-      for (int nY = 0; nY < m_nYGridMax; nY++)
+      // It is an edge cell, which edge?
+      int nEdge = m_Cell[nX][nY].nGetEdge();
+
+      if (nEdge == DIRECTION_TOP)
+      {
+         // Top edge
+         if (m_bClosedThisEdge[EDGE_TOP])
+            // This edge is closed, so see if there is an adjacent cell in any of the non-edge directions to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
+            TryCellOutFlow(nX, nY);
+         else
+            // This edge is not closed, so see if we can do some off-edge flow. If so, move the water and maybe do some erosion or deposition
+            TryEdgeCellOutFlow(nX, nY, DIRECTION_TOP);
+      }
+
+      else if (nEdge == DIRECTION_RIGHT)
       {
-         m_Cell[nX][nY].pGetSoil()->FinishTmpLayerThicknesses();
-         m_Cell[nX][nY].pGetSurfaceWater()->FinishTmpSurfaceWater();
+         // Right edge
+         if (m_bClosedThisEdge[EDGE_RIGHT])
+            // This edge is closed, so see if there is an adjacent cell in any of the non-edge directions to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
+            TryCellOutFlow(nX, nY);
+         else
+            // This edge is not closed, so see if we can do some off-edge flow. If so, move the water and maybe do some erosion or deposition
+            TryEdgeCellOutFlow(nX, nY, DIRECTION_RIGHT);
+      }
+
+      else if (nEdge == DIRECTION_BOTTOM)
+      {
+         // Bottom edge
+         if (m_bClosedThisEdge[EDGE_BOTTOM])
+            // This edge is closed, so see if there is an adjacent cell in any of the non-edge directions to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
+            TryCellOutFlow(nX, nY);
+         else
+            // This edge is not closed, so see if we can do some off-edge flow. If so, move the water and maybe do some erosion or deposition
+            TryEdgeCellOutFlow(nX, nY, DIRECTION_BOTTOM);
+      }
 
-         if (! m_Cell[nX][nY].pGetSurfaceWater()->bIsWet())
-            m_Cell[nX][nY].pGetSurfaceWater()->ZeroAllFlowVelocity();
+      else if (nEdge == DIRECTION_LEFT)
+      {
+         // Left edge
+         if (m_bClosedThisEdge[EDGE_LEFT])
+            // This edge is closed, so see if there is an adjacent cell in any of the non-edge directions to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
+            TryCellOutFlow(nX, nY);
+         else
+            // This edge is not closed, so see if we can do some off-edge flow. If so, move the water and maybe do some erosion or deposition
+            TryEdgeCellOutFlow(nX, nY, DIRECTION_LEFT);
       }
    }
+   else
+      // It isn't an edge cell. See if there is an adjacent cell to which some or all of its water can flow. If there is, move the water and maybe do some erosion or deposition
+      TryCellOutFlow(nX, nY);
+}
 
-   // DEBUG_SEDLOAD("in flow routing 3");
+//=========================================================================================================================================
+//! Two-phase flow routing: gathers the inflows of water and sediment from the eight neighbours of a single cell. The neighbours are always taken in the same order
+//=========================================================================================================================================
+void CSimulation::GatherCellInFlow(int const nX, int const nY)
+{
+   int nThis = m_pGrid->nGetIndex(nX, nY);
+
+   for (int nDir = DIRECTION_TOP; nDir <= DIRECTION_TOP_LEFT; nDir++)
+   {
+      // A neighbour in the halo never has an outflow, so needs no bounds check
+      int nFrom = m_pGrid->nGetNeighbour(nThis, nDir);
+      if (m_pGrid->nGetOutFlowTo(nFrom) != nThis)
+         continue;
+
+      // This neighbour flows into this cell, so add the water to this cell's temporary field
+      m_Cell[nX][nY].pGetSurfaceWater()->AddTmpSurfaceWater(m_pGrid->dGetOutFlowWater(nFrom));
+
+      // And add any sediment which moved with it
+      double dClaySed = m_pGrid->dGetOutFlowClaySed(nFrom);
+      if (dClaySed > 0)
+         m_Cell[nX][nY].pGetSedLoad()->AddToClayFlowSedLoad(dClaySed);
+
+      double dSiltSed = m_pGrid->dGetOutFlowSiltSed(nFrom);
+      if (dSiltSed > 0)
+         m_Cell[nX][nY].pGetSedLoad()->AddToSiltFlowSedLoad(dSiltSed);
+
+      double dSandSed = m_pGrid->dGetOutFlowSandSed(nFrom);
+      if (dSandSed > 0)
+         m_Cell[nX][nY].pGetSedLoad()->AddToSandFlowSedLoad(dSandSed);
+   }
 }
 
 //=========================================================================================================================================
-//! This routine moves water downhill, out from a single cell, if possible. If water is moved then (if we are considering flow erosion) the transport capacity routine is called, which in turn may call the erosion or deposition routines. Results are written, additively, to the temporary fields of the cell array
+//! Two-phase flow routing: after the sediment calculations, gathers the flow erosion on a single cell which was caused by the outflows of its eight neighbours. The neighbours are always taken in the same order
 //=========================================================================================================================================
-void CSimulation::TryCellOutFlow(int const nX, int const nY)
+void CSimulation::GatherCellFlowDetach(int const nX, int const nY)
 {
-   int
-      nLowX = 0,
-      nLowY = 0;
+   int nThis = m_pGrid->nGetIndex(nX, nY);
 
-   double
-      dHead = 0,
-      dTopSlope = 0,
-      dHLen = 0;
+   for (int nDir = DIRECTION_TOP; nDir <= DIRECTION_TOP_LEFT; nDir++)
+   {
+      // A neighbour in the halo never has an outflow, so needs no bounds check
+      int nFrom = m_pGrid->nGetNeighbour(nThis, nDir);
+      if (m_pGrid->nGetOutFlowTo(nFrom) != nThis)
+         continue;
+
+      // This neighbour flows into this cell, its outflow may have been erosive on this cell
+      double dDetach = m_pGrid->dGetOutFlowDetach(nFrom);
+      if (dDetach > 0)
+         m_Cell[nX][nY].pGetSoil()->DoFlowDetach(dDetach, false);
+   }
+}
 
-   // Look at the cell array and find the adjacent cell with the steepest energy slope i.e. the steepest downhill top-surface gradient from the water surface of this wet cell to the top surface (which could be either water or soil) of an adjacent cell. This elevation difference is the head
-   int nDir = nFindSteepestEnergySlope(nX, nY, m_Cell[nX][nY].dGetTopElevation(), nLowX, nLowY, dHead, dTopSlope, dHLen);
+//=========================================================================================================================================
+//! Initializes the flow velocity of a single cell. This uses the random number generator, so with two-phase flow routing and sequential random numbers the cell is just flagged, and the initialization is done later in a serial pass. Counter-based random numbers do not depend on the order of cells, so then the initialization is done straight away
+//=========================================================================================================================================
+void CSimulation::InitCellFlowVelocity(int const nX, int const nY)
+{
+   if (m_bTwoPhaseFlowRouting && (! m_bCounterBasedRand))
+      m_pGrid->SetOutFlowInitVelocity(m_pGrid->nGetIndex(nX, nY));
+   else
+      m_Cell[nX][nY].pGetSurfaceWater()->InitializeAllFlowVelocity(RAND_STREAM_FLOW_VELOCITY);
+}
+
+//=========================================================================================================================================
+//! This routine moves water downhill, out from a single cell, if possible. If water is moved then (if we are considering flow erosion) the outflow is recorded, so that after routing its transport capacity can be calculated, and erosion or deposition done. Results are written, additively, to the temporary fields of the cell array
+//=========================================================================================================================================
+void CSimulation::TryCellOutFlow(int const nX, int const nY)
+{
+   // Get the adjacent cell with the steepest energy slope i.e. the steepest downhill top-surface gradient from the water surface of this wet cell to the top surface (which could be either water or soil) of an adjacent cell. This was found for every listed cell before routing began. The elevation difference is the head
+   int
+      nThis = m_pGrid->nGetIndex(nX, nY),
+      nDir = m_pGrid->nGetSteepestDirection(nThis);
    m_Cell[nX][nY].pGetSurfaceWater()->SetFlowDirection(nDir);
    if (nDir == DIRECTION_NONE)
    {
       // No adjacent cells have a downhill top surface, so no outflow here. Initialize flow velocity and depth-weighted flow velocity and return
-      m_Cell[nX][nY].pGetSurfaceWater()->InitializeAllFlowVelocity();
+      InitCellFlowVelocity(nX, nY);
       return;
    }
 
+   int
+      nLow = m_pGrid->nGetNeighbour(nThis, nDir),
+      nLowX = m_pGrid->nGetXFromIndex(nLow),
+      nLowY = m_pGrid->nGetYFromIndex(nLow);
+
+   double
+      dHead = m_pGrid->dGetSteepestTopDiff(nThis),
+      dTopSlope = m_pGrid->dGetSteepestTopSlope(nThis),
+      dHLen = m_pGrid->dGetSteepestHLen(nThis);
+
    // The top surface of an adjacent cell is lower, so water could flow from this cell to the lower cell: to equalize water surfaces, we need to move half the head
    dHead /= 2;
 
-   double dThisDepth = m_Cell[nX][nY].pGetSurfaceWater()->dGetSurfaceWaterDepth();
+   double dThisDepth = m_pGrid->dGetSurfaceWaterDepth(m_pGrid->nGetIndex(nX, nY));
    if (dThisDepth <= dHead)
    {
       // There isn't enough water on this cell to level both water surfaces: so just move (at most) what is there
       dHead = dThisDepth;
    }
 
-   // Add this head to the this-iteration total, and increment the count of this-iteration heads (this is used in off-edge flow calcs)
-   m_dEndOfIterTotHead += dHead;
-   m_ulNumHead++;
+   // Add this head to the this-iteration total, and increment the count of this-iteration heads (this is used in off-edge flow calcs). With two-phase flow routing, just save the head: it is added to the total later
+   if (m_bTwoPhaseFlowRouting)
+      m_pGrid->SetOutFlowHead(m_pGrid->nGetIndex(nX, nY), dHead);
+   else
+   {
+      m_dEndOfIterTotHead += dHead;
+      m_ulNumHead++;
+   }
 
    // Now use either a Manning-type equation, or the Darcy-Weisbach equation, to calculate flow speed (which may be subsequently constrained) and hence the time taken for water to flow from the centroid of this cell to the centroid of the next cell
    double dFlowSpeed = 0;                                   // Value to be calculated in dTimeToCrossCell, is in mm/sec
@@ -165,7 +330,7 @@ void CSimulation::TryCellOutFlow(int const nX, int const nY)
    if (bFpEQ(dOutFlowTime, FOREVER, TOLERANCE))
    {
       // Flow speed is effectively zero, because the depth is nearly zero, so no outflow. Initialize flow velocity and depth-weighted flow velocity and return
-      m_Cell[nX][nY].pGetSurfaceWater()->InitializeAllFlowVelocity();
+      InitCellFlowVelocity(nX, nY);
       return;
    }
 
@@ -181,7 +346,7 @@ void CSimulation::TryCellOutFlow(int const nX, int const nY)
    if (dDepthToMove < WATER_TOLERANCE)
    {
       // Flow speed is effectively zero, because the depth is nearly zero, so no outflow. Initialize flow velocity and depth-weighted flow velocity and return
-      m_Cell[nX][nY].pGetSurfaceWater()->InitializeAllFlowVelocity();
+      InitCellFlowVelocity(nX, nY);
       return;
    }
 
@@ -195,8 +360,8 @@ void CSimulation::TryCellOutFlow(int const nX, int const nY)
    CellMoveWaterAndSediment(nX, nY, nLowX, nLowY, dThisDepth, dDepthToMove);
 
    if (m_bFlowErosion || m_bSplash || m_bSlumping)
-      // This outflow may or may not be erosive: it depends on whether or not it has exceeded its transport capacity. So check transport capacity for this cell, and either erode it or deposit some sediment here
-      CalcTransportCapacity(nX, nY, nLowX, nLowY, nDir, dThisDepth, dHead, dTopSlope, dHLen, dFlowSpeed, dDepthToMove);
+      // This outflow may or may not be erosive: it depends on whether or not it has exceeded its transport capacity. So record it: after routing, transport capacity is checked for this cell, and it is either eroded or some sediment is deposited here
+      m_pGrid->SetSedFlow(nThis, nLow, nDir, dThisDepth, dHead, dTopSlope, dHLen, dFlowSpeed, dDepthToMove, m_Cell[nX][nY].pGetSoil()->dGetBulkDensityOfTopNonZeroLayer());
 }
 
 //=========================================================================================================================================
@@ -206,7 +371,7 @@ void CSimulation::TryEdgeCellOutFlow(int const nX, int const nY, int const nDir)
 {
    // We need a value for off-edge head: use the average on-grid head during the previous iteration, multiplied by a constant: m_dOffEdgeParamA * (m_dGradient**m_dOffEdgeParamB) with m_dGradient is in %
    double dHead = m_dLastIterAvgHead * m_dOffEdgeHeadConst;
-   double dThisDepth = m_Cell[nX][nY].pGetSurfaceWater()->dGetSurfaceWaterDepth();
+   double dThisDepth = m_pGrid->dGetSurfaceWaterDepth(m_pGrid->nGetIndex(nX, nY));
 
    // Can we move dHead depth off the grid?
   if (dThisDepth < dHead)
@@ -222,7 +387,7 @@ void CSimulation::TryEdgeCellOutFlow(int const nX, int const nY, int const nDir)
    if (bFpEQ(dOutFlowTime, FOREVER, TOLERANCE))
    {
       // Flow speed is effectively zero, because the depth is nearly zero, so no flow off the grid. Initialize flow velocity and depth-weighted flow velocity and return
-      m_Cell[nX][nY].pGetSurfaceWater()->InitializeAllFlowVelocity();
+      InitCellFlowVelocity(nX, nY);
       m_Cell[nX][nY].pGetSurfaceWater()->SetFlowDirection(DIRECTION_NONE);
       return;
    }
@@ -239,7 +404,7 @@ void CSimulation::TryEdgeCellOutFlow(int const nX, int const nY, int const nDir)
    if (dDepthToMove < WATER_TOLERANCE)
    {
       // Flow speed is effectively zero, because the depth is nearly zero, so no outflow. Initialize flow velocity and depth-weighted flow velocity and return
-      m_Cell[nX][nY].pGetSurfaceWater()->InitializeAllFlowVelocity();
+      InitCellFlowVelocity(nX, nY);
       return;
    }
 
@@ -257,9 +422,10 @@ void CSimulation::TryEdgeCellOutFlow(int const nX, int const nY, int const nDir)
    if (m_bFlowErosion || m_bSplash || m_bSlumping)
    {
       // Now deal with the sediment: move the sediment that was being transported in this depth of water off the edge of the grid. We assume here that all transported sediments is well mixed in the water column
-      double dClaySedToRemove = m_Cell[nX][nY].pGetSedLoad()->dGetLastIterClaySedLoad() * dFractionToMove;
-      double dSiltSedToRemove = m_Cell[nX][nY].pGetSedLoad()->dGetLastIterSiltSedLoad() * dFractionToMove;
-      double dSandSedToRemove = m_Cell[nX][nY].pGetSedLoad()->dGetLastIterSandSedLoad() * dFractionToMove;
+      int n = m_pGrid->nGetIndex(nX, nY);
+      double dClaySedToRemove = m_pGrid->dGetClaySedLoad(n) * dFractionToMove;
+      double dSiltSedToRemove = m_pGrid->dGetSiltSedLoad(n) * dFractionToMove;
+      double dSandSedToRemove = m_pGrid->dGetSandSedLoad(n) * dFractionToMove;
 
       if (dClaySedToRemove > 0)
       {
@@ -288,8 +454,8 @@ void CSimulation::TryEdgeCellOutFlow(int const nX, int const nY, int const nDir)
          m_Cell[nX][nY].pGetSedLoad()->AddToSandSedOffEdge(dSandSedToRemove);
       }
 
-      // Finally, the off-edge outflow from this edge cell may also be capable of eroding the edge cell, or deposition may have occurred on the edge cell. So check transport capacity for this cell, and either erode it or deposit some sediment. Note that we use the original (i.e. pre-outflow) values here
-      CalcTransportCapacity(nX, nY, -1, -1, nDir, dThisDepth, dHead, dTopSlope, m_dCellSide, dFlowSpeed, dDepthToMove);
+      // Finally, the off-edge outflow from this edge cell may also be capable of eroding the edge cell, or deposition may have occurred on the edge cell. So record it: after routing, transport capacity is checked for this cell, and it is either eroded or some sediment is deposited. Note that we use the original (i.e. pre-outflow) values here
+      m_pGrid->SetSedFlow(n, -1, nDir, dThisDepth, dHead, dTopSlope, m_dCellSide, dFlowSpeed, dDepthToMove, m_Cell[nX][nY].pGetSoil()->dGetBulkDensityOfTopNonZeroLayer());
    }
 }
 
@@ -308,8 +474,11 @@ double CSimulation::dTimeToCrossCell(int const nX, int const nY, int const nDir,
    if (dFlowSpeed <= 0)
       return FOREVER;
 
-   // If this flow speed is high enough, save it in m_dPossMaxSpeedNextIter and later use this to set the value of m_dTimeStep for the next iteration
-   m_dPossMaxSpeedNextIter = tMax(dFlowSpeed, m_dPossMaxSpeedNextIter);
+   // If this flow speed is high enough, save it in m_dPossMaxSpeedNextIter and later use this to set the value of m_dTimeStep for the next iteration. With two-phase flow routing, just save the speed: the maximum is found later
+   if (m_bTwoPhaseFlowRouting)
+      m_pGrid->SetOutFlowSpeed(m_pGrid->nGetIndex(nX, nY), dFlowSpeed);
+   else
+      m_dPossMaxSpeedNextIter = tMax(dFlowSpeed, m_dPossMaxSpeedNextIter);
 
    // Must now apply this scalar flow speed in the correct flow direction i.e. must create a flow velocity vector (note that the origin is at top left here). Note also that diagonal flow is faster than orthogonal flow: this is incorrect from a strict vector perspective, but is a necessary artefact of using an eight-way flow: to keep flow equally probable in each of the eight directions (all else being equal), flow must be faster on the longer diagonals. Unpleasant but apparently unavoidable unless e.g. a hexagonal grid is used
    switch (nDir)
@@ -372,75 +541,24 @@ double CSimulation::dTimeToCrossCell(int const nX, int const nY, int const nDir,
 }
 
 //=========================================================================================================================================
-//! Calculates a cell's hydraulic radius (in mm).
+//! Calculates a cell's hydraulic radius (in mm), for flow in this direction. During flow routing the cached value found by CalcAllHydraulicState() is used instead: this cell-by-cell version is kept to check it
 //=========================================================================================================================================
-double CSimulation::dCalcHydraulicRadius(int const nX, int const nY)
+double CSimulation::dCalcHydraulicRadius(int const nX, int const nY, int const nDir)
 {
    int
-      nN = 0,
-      nDir = m_Cell[nX][nY].pGetSurfaceWater()->nGetFlowDirection();
+      n = m_pGrid->nGetIndex(nX, nY),
+      nN = 0;
    double
-      dDepth = m_Cell[nX][nY].pGetSurfaceWater()->dGetSurfaceWaterDepth();
+      dDepth = m_pGrid->dGetSurfaceWaterDepth(n);
 
-   // Check the two cells which are orthogonal to the direction of flow
-   int nXAdj, nYAdj;
-   switch (nDir)
+   // Check the two cells which are orthogonal to the direction of flow, i.e. two steps either side of it. Neighbours in the halo are never wet, so need no bounds check
+   if (nDir != DIRECTION_NONE)
    {
-   case DIRECTION_BOTTOM:
-   case DIRECTION_TOP:
-      nXAdj = nX-1;
-      nYAdj = nY;
-      if ((nXAdj >= 0) && m_Cell[nXAdj][nYAdj].pGetSurfaceWater()->bIsWet())
-         nN++;
-
-      nXAdj = nX+1;
-      nYAdj = nY;
-      if ((nXAdj < m_nXGridMax) && m_Cell[nXAdj][nYAdj].pGetSurfaceWater()->bIsWet())
-         nN++;
-
-      break;
-
-   case DIRECTION_BOTTOM_RIGHT:
-   case DIRECTION_TOP_LEFT:
-      nXAdj = nX+1;
-      nYAdj = nY-1;
-      if ((nXAdj < m_nXGridMax) && (nYAdj > 0) && m_Cell[nXAdj][nYAdj].pGetSurfaceWater()->bIsWet())
-         nN++;
-
-      nXAdj = nX-1;
-      nYAdj = nY+1;
-      if ((nXAdj >= 0) && (nYAdj < m_nYGridMax) && m_Cell[nXAdj][nYAdj].pGetSurfaceWater()->bIsWet())
-         nN++;
-
-      break;
-
-   case DIRECTION_BOTTOM_LEFT:
-   case DIRECTION_TOP_RIGHT:
-      nXAdj = nX-1;
-      nYAdj = nY-1;
-      if ((nXAdj >= 0) && (nYAdj >= 0) && m_Cell[nXAdj][nYAdj].pGetSurfaceWater()->bIsWet())
+      if (m_pGrid->bIsWet(m_pGrid->nGetNeighbour(n, (nDir + 2) % 8)))
          nN++;
 
-      nXAdj = nX+1;
-      nYAdj = nY+1;
-      if ((nXAdj < m_nXGridMax) && (nYAdj < m_nYGridMax) && m_Cell[nXAdj][nYAdj].pGetSurfaceWater()->bIsWet())
+      if (m_pGrid->bIsWet(m_pGrid->nGetNeighbour(n, (nDir + 6) % 8)))
          nN++;
-
-      break;
-
-   case DIRECTION_LEFT:
-   case DIRECTION_RIGHT:
-      nXAdj = nX;
-      nYAdj = nY-1;
-      if ((nYAdj >= 0) && m_Cell[nXAdj][nYAdj].pGetSurfaceWater()->bIsWet())
-         nN++;
-
-      nXAdj = nX;
-      nYAdj = nY+1;
-      if ((nYAdj < m_nYGridMax) && m_Cell[nXAdj][nYAdj].pGetSurfaceWater()->bIsWet())
-         nN++;
-
-      break;
    }
 
    if (nN == 2)
@@ -471,9 +589,7 @@ double CSimulation::dCalcLawrenceFrictionFactor(int const nX, int const nY, doub
 
    double const
       SHALLOW_FLOW_CONST = 8,
-      MARGINAL_FLOW_CONST = 10,
-      DEEP_FLOW_CONST_A = 1.64,
-      DEEP_FLOW_CONST_B = 0.803;
+      MARGINAL_FLOW_CONST = 10;
 
    double dF;
    if (dLambda <= LAMBDA_SHALLOW_FLOW_THRESHOLD)
@@ -494,8 +610,8 @@ double CSimulation::dCalcLawrenceFrictionFactor(int const nX, int const nY, doub
    }
    else
    {
-      // Well-inundated flow, equation 12 in Lawrence (1997)
-      dF = pow(DEEP_FLOW_CONST_A + (DEEP_FLOW_CONST_B * log(dLambda)), 2);
+      // Well-inundated flow, equation 12 in Lawrence (1997). This is interpolated from a lookup table if the user wants, otherwise the exact formula is used
+      dF = m_pFFTable->dGetLawrenceDeepFrictionFactor(dLambda);
 
       if (! bJustCheckEquation)
          m_Cell[nX][nY].pGetSurfaceWater()->SetInundation(DEEP_FLOW);
@@ -505,128 +621,72 @@ double CSimulation::dCalcLawrenceFrictionFactor(int const nX, int const nY, doub
 }
 
 //=========================================================================================================================================
-//! Identifies the adjacent cell which has the steepest downhill energy slope (i.e. top-surface gradient)
+//! Makes lookup tables for the Cheng and Lawrence friction factors, if the user has specified a maximum relative error for interpolated values. The measured maximum relative error is written to the log file. If there is no maximum relative error, or it cannot be achieved, the exact formulas are used
+//=========================================================================================================================================
+void CSimulation::InitFrictionFactorTables(void)
+{
+   m_pFFTable = new CFrictionFactorTable;
+
+   if ((! m_bDarcyWeisbachFlowSpeedEqn) || (m_dFFTableMaxRelErr <= 0))
+      return;
+
+   if (m_bFrictionFactorCheng)
+   {
+      // The tables cover hydraulic radii up to FF_TABLE_MAX_DEPTH, and flow speeds up to the maximum (for each of the x and y components)
+      double
+         dReMax = (1e-6 * sqrt(2.0) * m_dMaxFlowSpeed * FF_TABLE_MAX_DEPTH) / m_dNu,
+         dRelRoughMax = (4 * FF_TABLE_MAX_DEPTH) / m_dChengRoughnessHeight;
+
+      if (m_pFFTable->bInitCheng(dReMax, dRelRoughMax, m_dFFTableMaxRelErr))
+         m_ofsLog << "Cheng friction factor lookup table: " << m_pFFTable->nGetChengNodesPerOctave() << " nodes per octave, " << m_pFFTable->nGetChengTableSize() << " nodes, measured maximum relative error " << m_pFFTable->dGetChengMeasuredErr() << endl;
+      else
+         m_ofsLog << "Cheng friction factor lookup table: maximum relative error of " << m_dFFTableMaxRelErr << " needs more than " << FF_TABLE_MAX_NODES << " nodes, so the exact formula is used" << endl;
+   }
+
+   if (m_bFrictionFactorLawrence)
+   {
+      double dLambdaMax = FF_TABLE_MAX_DEPTH / m_dFFLawrenceEpsilon;
+
+      if (m_pFFTable->bInitLawrence(dLambdaMax, m_dFFTableMaxRelErr))
+         m_ofsLog << "Lawrence friction factor lookup table: " << m_pFFTable->nGetLawrenceNodesPerOctave() << " nodes per octave, " << m_pFFTable->nGetLawrenceTableSize() << " nodes, measured maximum relative error " << m_pFFTable->dGetLawrenceMeasuredErr() << endl;
+      else
+         m_ofsLog << "Lawrence friction factor lookup table: maximum relative error of " << m_dFFTableMaxRelErr << " needs more than " << FF_TABLE_MAX_NODES << " nodes, so the exact formula is used" << endl;
+   }
+}
+
+//=========================================================================================================================================
+//! Identifies the adjacent cell which has the steepest downhill energy slope (i.e. top-surface gradient). Flow routing uses the values found for all cells together by CGridStore::CalcAllSteepestTopSlopes(), so this is now only used to check them
 //=========================================================================================================================================
 int CSimulation::nFindSteepestEnergySlope(int const nX, int const nY, double const dThisTop, int& nLowX, int& nLowY, double& dTopDiff, double& dTopSlope, double& dHLen)
 {
    int
-      nXTmp,
-      nYTmp,
+      nThis = m_pGrid->nGetIndex(nX, nY),
       nDir = DIRECTION_NONE;
-   double
-      dTmpDiff,
-      dTanX;
-
-   // Planview bottom
-   nXTmp = nX;
-   nYTmp = nY+1;
-   if ((nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dTmpDiff = dThisTop - m_Cell[nXTmp][nYTmp].dGetTopElevation()) > 0))
-   {
-      // It's downhill, and being the first one checked it must be the steepest so far
-      dTopSlope = dTmpDiff * m_dInvCellSide;                                                       // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dTopDiff = dTmpDiff;
-      dHLen = m_dCellSide;
-      nDir = DIRECTION_BOTTOM;
-   }
-
-   // Planview bottom right
-   nXTmp = nX+1;
-   nYTmp = nY+1;
-   if ((nXTmp < m_nXGridMax) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dTmpDiff = dThisTop - m_Cell[nXTmp][nYTmp].dGetTopElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellDiag) > dTopSlope))
-   {
-      // It's the steepest so far
-      dTopSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dTopDiff = dTmpDiff;
-      dHLen = m_dCellDiag;
-      nDir = DIRECTION_BOTTOM_RIGHT;
-   }
-
-   // Planview bottom left
-   nXTmp = nX-1;
-   nYTmp = nY+1;
-   if ((nXTmp >= 0) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dTmpDiff = dThisTop - m_Cell[nXTmp][nYTmp].dGetTopElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellDiag) > dTopSlope))
-   {
-      // It's the steepest so far
-      dTopSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dTopDiff = dTmpDiff;
-      dHLen = m_dCellDiag;
-      nDir = DIRECTION_BOTTOM_LEFT;
-   }
-
-   // Planview right
-   nXTmp = nX+1;
-   nYTmp = nY;
-   if ((nXTmp < m_nXGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dTmpDiff = dThisTop - m_Cell[nXTmp][nYTmp].dGetTopElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellSide) > dTopSlope))
-   {
-      // It's the steepest so far
-      dTopSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dTopDiff = dTmpDiff;
-      dHLen = m_dCellSide;
-      nDir = DIRECTION_RIGHT;
-   }
-
-   // Planview left
-   nXTmp = nX-1;
-   nYTmp = nY;
-   if ((nXTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dTmpDiff = dThisTop - m_Cell[nXTmp][nYTmp].dGetTopElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellSide) > dTopSlope))
-   {
-      // It's the steepest so far
-      dTopSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dTopDiff = dTmpDiff;
-      dHLen = m_dCellSide;
-      nDir = DIRECTION_LEFT;
-   }
-
-   // Planview top right
-   nXTmp = nX+1;
-   nYTmp = nY-1;
-   if ((nXTmp < m_nXGridMax) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue())  && ((dTmpDiff = dThisTop - m_Cell[nXTmp][nYTmp].dGetTopElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellDiag) > dTopSlope))
-   {
-      // It's the steepest so far
-      dTopSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dTopDiff = dTmpDiff;
-      dHLen = m_dCellDiag;
-      nDir = DIRECTION_TOP_RIGHT;
-   }
-
-   // Planview top left
-   nXTmp = nX-1;
-   nYTmp = nY-1;
-   if ((nXTmp >= 0) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dTmpDiff = dThisTop - m_Cell[nXTmp][nYTmp].dGetTopElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellDiag) > dTopSlope))
-   {
-      // It's the steepest so far
-      dTopSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dTopDiff = dTmpDiff;
-      dHLen = m_dCellDiag;
-      nDir = DIRECTION_TOP_LEFT;
-   }
-
-   // Planview top
-   nXTmp = nX;
-   nYTmp = nY-1;
-   if ((nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dTmpDiff = dThisTop - m_Cell[nXTmp][nYTmp].dGetTopElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellSide) > dTopSlope))
-   {
-      // It's the steepest so far
-      dTopSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dTopDiff = dTmpDiff;
-      dHLen = m_dCellSide;
-      nDir = DIRECTION_TOP;
+
+   // Neighbours in the halo are missing values, so need no bounds check
+   for (int i = 0; i < 8; i++)
+   {
+      int
+         nDirTmp = NEIGHBOUR_SEARCH_ORDER[i],
+         nTmp = m_pGrid->nGetNeighbour(nThis, nDirTmp);
+
+      if (m_pGrid->bIsMissing(nTmp))
+         continue;
+
+      double
+         dTmpDiff = dThisTop - m_pGrid->dGetTopElevation(nTmp),
+         dTanX = dTmpDiff * m_dInvDirHLen[nDirTmp];
+
+      // Is it downhill? The first neighbour checked (planview bottom) must then be the steepest so far, any other neighbour must also be strictly steeper
+      if ((dTmpDiff > 0) && ((i == 0) || (dTanX > dTopSlope)))
+      {
+         dTopSlope = dTanX;                                                                        // is tan(top slope)
+         nLowX = m_pGrid->nGetXFromIndex(nTmp);
+         nLowY = m_pGrid->nGetYFromIndex(nTmp);
+         dTopDiff = dTmpDiff;
+         dHLen = m_dDirHLen[nDirTmp];
+         nDir = nDirTmp;
+      }
    }
 
    return (nDir);
@@ -640,19 +700,23 @@ void CSimulation::CellMoveWaterAndSediment(int const nXFrom, int const nYFrom, i
    // First remove the water from the temporary field of the source cell
    m_Cell[nXFrom][nYFrom].pGetSurfaceWater()->RemoveTmpSurfaceWater(dDepthToMove);
 
-   // Then add the water to the temporary field of the destination cell
-   m_Cell[nXTo][nYTo].pGetSurfaceWater()->AddTmpSurfaceWater(dDepthToMove);
+   // Then add the water to the temporary field of the destination cell. With two-phase flow routing, just save it in the source cell's outflow slot: the destination cell gathers it later
+   int nFrom = m_pGrid->nGetIndex(nXFrom, nYFrom);
+   if (m_bTwoPhaseFlowRouting)
+      m_pGrid->SetOutFlowWater(nFrom, m_pGrid->nGetIndex(nXTo, nYTo), dDepthToMove);
+   else
+      m_Cell[nXTo][nYTo].pGetSurfaceWater()->AddTmpSurfaceWater(dDepthToMove);
 
    if (m_bFlowErosion || m_bSplash || m_bSlumping)
    {
       // Is there any sediment load on the source cell?
-      if (m_Cell[nXFrom][nYFrom].pGetSedLoad()->dGetLastIterAllSizeSedLoad() > 0)
+      if (m_pGrid->dGetAllSizeSedLoad(nFrom) > 0)
       {
          // There is, so calculate how much sediment to move
          double dFrac = dDepthToMove / dThisDepth;
-         double dClaySedToMove = m_Cell[nXFrom][nYFrom].pGetSedLoad()->dGetLastIterClaySedLoad() * dFrac;
-         double dSiltSedToMove = m_Cell[nXFrom][nYFrom].pGetSedLoad()->dGetLastIterSiltSedLoad() * dFrac;
-         double dSandSedToMove = m_Cell[nXFrom][nYFrom].pGetSedLoad()->dGetLastIterSandSedLoad() * dFrac;
+         double dClaySedToMove = m_pGrid->dGetClaySedLoad(nFrom) * dFrac;
+         double dSiltSedToMove = m_pGrid->dGetSiltSedLoad(nFrom) * dFrac;
+         double dSandSedToMove = m_pGrid->dGetSandSedLoad(nFrom) * dFrac;
 
          if (dClaySedToMove > 0)
          {
@@ -660,7 +724,10 @@ void CSimulation::CellMoveWaterAndSediment(int const nXFrom, int const nYFrom, i
             m_Cell[nXFrom][nYFrom].pGetSedLoad()->AddToClaySedLoadRemoved(dClaySedToMove);
 
             // And add this depth to the sediment load of the destination cell
-            m_Cell[nXTo][nYTo].pGetSedLoad()->AddToClayFlowSedLoad(dClaySedToMove);
+            if (m_bTwoPhaseFlowRouting)
+               m_pGrid->SetOutFlowClaySed(nFrom, dClaySedToMove);
+            else
+               m_Cell[nXTo][nYTo].pGetSedLoad()->AddToClayFlowSedLoad(dClaySedToMove);
          }
 
          if (dSiltSedToMove > 0)
@@ -669,7 +736,10 @@ void CSimulation::CellMoveWaterAndSediment(int const nXFrom, int const nYFrom, i
             m_Cell[nXFrom][nYFrom].pGetSedLoad()->AddToSiltSedLoadRemoved(dSiltSedToMove);
 
             // And add this depth to the sediment load of the destination cell
-            m_Cell[nXTo][nYTo].pGetSedLoad()->AddToSiltFlowSedLoad(dSiltSedToMove);
+            if (m_bTwoPhaseFlowRouting)
+               m_pGrid->SetOutFlowSiltSed(nFrom, dSiltSedToMove);
+            else
+               m_Cell[nXTo][nYTo].pGetSedLoad()->AddToSiltFlowSedLoad(dSiltSedToMove);
          }
 
          if (dSandSedToMove > 0)
@@ -678,25 +748,74 @@ void CSimulation::CellMoveWaterAndSediment(int const nXFrom, int const nYFrom, i
             m_Cell[nXFrom][nYFrom].pGetSedLoad()->AddToSandSedLoadRemoved(dSandSedToMove);
 
             // And add this depth to the sediment load of the destination cell
-            m_Cell[nXTo][nYTo].pGetSedLoad()->AddToSandFlowSedLoad(dSandSedToMove);
+            if (m_bTwoPhaseFlowRouting)
+               m_pGrid->SetOutFlowSandSed(nFrom, dSandSedToMove);
+            else
+               m_Cell[nXTo][nYTo].pGetSedLoad()->AddToSandFlowSedLoad(dSandSedToMove);
          }
       }
    }
 }
 
 //=========================================================================================================================================
-//! Calculates the Reynolds number for flow in a cell
+//! Returns true if a wet cell's outflow would be off the edge of the grid, i.e. it is on an edge which is not closed
 //=========================================================================================================================================
-double CSimulation::dGetReynolds(int const nX, int const nY)
+bool CSimulation::bFlowsOffEdge(int const nX, int const nY) const
 {
-   double
-      dFlowSpeed = m_Cell[nX][nY].pGetSurfaceWater()->dGetFlowSpd(),
-      dR = dCalcHydraulicRadius(nX, nY);
+   if (! m_Cell[nX][nY].bIsEdgeCell())
+      return false;
+
+   int nEdge = m_Cell[nX][nY].nGetEdge();
+
+   if (nEdge == DIRECTION_TOP)
+      return (! m_bClosedThisEdge[EDGE_TOP]);
+
+   if (nEdge == DIRECTION_RIGHT)
+      return (! m_bClosedThisEdge[EDGE_RIGHT]);
+
+   if (nEdge == DIRECTION_BOTTOM)
+      return (! m_bClosedThisEdge[EDGE_BOTTOM]);
+
+   if (nEdge == DIRECTION_LEFT)
+      return (! m_bClosedThisEdge[EDGE_LEFT]);
+
+   return false;
+}
 
-   // Must divide by 1e6 because velocity and hydraulic radius are in mm/sec and mm, the equation has them in m/sec and m
-   double dRe = (1e-6 * dFlowSpeed * dR) / m_dNu;
+//=========================================================================================================================================
+//! Before flow routing, calculates the hydraulic radius and Reynolds number of every cell in the wet-cell activity list, so that they are each calculated once per iteration. Flow from a cell usually follows its steepest top-surface gradient, but flow off the edge of the grid uses the cell's direction of flow from the previous iteration, so the hydraulic radius of these cells is calculated separately
+//=========================================================================================================================================
+void CSimulation::CalcAllHydraulicState(void)
+{
+   m_pGrid->CalcAllHydraulicRadii(m_dCellSide);
+
+   int nWetActive = m_pGrid->nGetNumWetActive();
+
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int i = 0; i < nWetActive; i++)
+   {
+      int
+         n = m_pGrid->nGetWetActive(i),
+         nX = m_pGrid->nGetXFromIndex(n),
+         nY = m_pGrid->nGetYFromIndex(n);
 
-   return dRe;
+      if (m_pGrid->bIsWet(n) && bFlowsOffEdge(nX, nY))
+         m_pGrid->CalcHydraulicRadius(n, m_pGrid->nGetFlowDirection(n), m_dCellSide);
+
+      // Note that the Reynolds' number uses the previous iteration's flow speed. Must divide by 1e6 because velocity and hydraulic radius are in mm/sec and mm, the equation has them in m/sec and m
+      double dFlowSpeed = m_Cell[nX][nY].pGetSurfaceWater()->dGetFlowSpd();
+      m_pGrid->SetReynolds(n, (1e-6 * dFlowSpeed * m_pGrid->dGetHydraulicRadius(n)) / m_dNu);
+   }
+}
+
+//=========================================================================================================================================
+//! Returns the Reynolds number for flow in a cell, as calculated before the most recent flow routing
+//=========================================================================================================================================
+double CSimulation::dGetReynolds(int const nX, int const nY)
+{
+   return m_pGrid->dGetReynolds(m_pGrid->nGetIndex(nX, nY));
 }
 
 //=========================================================================================================================================
@@ -713,8 +832,11 @@ void CSimulation::CalcFlowSpeedManning(double& dFlowSpeed)
 //=========================================================================================================================================
 void CSimulation::CalcFlowSpeedDarcyWeisbach(int const nX, int const nY, double const dTopSlope, double const dThisDepth, double& dFlowSpeed)
 {
-   // Note that the Reynolds' number is calculated using the previous iteration's flow speed
-   double dRe = dGetReynolds(nX, nY);
+   // The hydraulic radius and the Reynolds' number were calculated before flow routing began. Note that the Reynolds' number is calculated using the previous iteration's flow speed
+   int n = m_pGrid->nGetIndex(nX, nY);
+   double
+      dR = m_pGrid->dGetHydraulicRadius(n),
+      dRe = m_pGrid->dGetReynolds(n);
 
    // Safety check
    if (bFpEQ(dRe, 0.0, TOLERANCE))
@@ -747,33 +869,13 @@ void CSimulation::CalcFlowSpeedDarcyWeisbach(int const nX, int const nY, double
 
    if (m_bFrictionFactorCheng)
    {
-      // From Cheng, Nian-Sheng (September 2008). "Formulas for Friction Factor in Transitional Regimes". Journal of Hydraulic Engineering. 134 (9): 1357–1362. doi:10.1061/(asce)0733-9429(2008)134:9(1357). hdl:10220/7647. ISSN 0733-9429.
-
-      // See also https://en.wikipedia.org/wiki/Talk%3ADarcy_friction_factor_formulae " I feel like it's overstating that the equation from Bellos et al., 2018 is the only one formula, among others in this wiki article, works for open-channel flow. The most naive way to work with open-channel flow is to use the hydraulic diameter of an open channel in formulas of closed pipe flows. As no validation (i.e., against experimental data) is available, no one can really say the most naive approach is not working, In this sense, it may be too much to say Bellos et al., 2018 is the only one working with open channels."
-
+      // From Cheng, Nian-Sheng (September 2008). "Formulas for Friction Factor in Transitional Regimes". Journal of Hydraulic Engineering. 134 (9): 1357–1362. doi:10.1061/(asce)0733-9429(2008)134:9(1357). hdl:10220/7647. ISSN 0733-9429. This is interpolated from a lookup table if the user wants, otherwise the exact formula is used
       double dEps = m_dChengRoughnessHeight / 1000;      // Effective roughness height in mm, convert to m
 
-      double dD = 4 * dCalcHydraulicRadius(nX, nY);      // Hydraulic diameter in mm. See https://en.wikipedia.org/wiki/Hydraulic_diameter
+      double dD = 4 * dR;                                // Hydraulic diameter in mm. See https://en.wikipedia.org/wiki/Hydraulic_diameter
       dD /= 1000;                                        // Convert to m
 
-      double dParamA = 1 / (1 + pow((dRe / 2720), 9));
-      double dParamB = 1 / (1 + pow((dRe / (160 * (dD / dEps) )  ), 2));
-
-      double dTerm1 = pow((dRe / 64), dParamA);
-      double dTerm2 = pow((1.8 * log(dRe / 6.8)), (2 * (1 - dParamA) * dParamB));
-      double dTerm3 = pow((2.0 * log((3.7 * dD) / dEps)), (2 * (1 - dParamA) * (1 - dParamB)));
-
-      // double dTmp1 = (2.0 * log((3.7 * dD) / dEps));
-      // double dTmp2 = (2 * (1 - dParamA) * (1 - dParamB));
-
-      // Safety check
-      if (isnan(dTerm3))
-      {
-         // This is the most common value of dTerm3 TODO improve this
-         dTerm3 = 1;
-      }
-
-      dFF = 1 / (dTerm1 * dTerm2 * dTerm3);
+      dFF = m_pFFTable->dGetChengFrictionFactor(dRe, dD, dEps);
    }
 
    // Safety check
@@ -786,7 +888,7 @@ void CSimulation::CalcFlowSpeedDarcyWeisbach(int const nX, int const nY, double
    // OK, we have the friction factor, so use the Darcy-Weisbach equation: flow speed = sqrt((8 G R S) / ff) in SI units. Note that hydraulic radius should be in m, but we calculate it in mm so need to divide R by 1000. Thus the D-W constant 8 becomes 0.008. Also flow speed is calculated by D-W in m/sec, but we need it in mm/sec, so need to multiply flow speed by 1000
    double const DARCY_WEISBACH_CONST = 0.008;
    double const FLOW_SPEED_CONVERSION_CONST = 1000;
-   dFlowSpeed = FLOW_SPEED_CONVERSION_CONST * sqrt((DARCY_WEISBACH_CONST * m_dG * dCalcHydraulicRadius(nX, nY) * dTopSlope) / dFF);
+   dFlowSpeed = FLOW_SPEED_CONVERSION_CONST * sqrt((DARCY_WEISBACH_CONST * m_dG * dR * dTopSlope) / dFF);
 
    // Safety check: have to constrain flow speed if it gets too high. Unpleasant but practically necessary. Note that this is the maximum only of the x and y components of flow speed: resultant flow speed can he higher i.e. sqrt(2 * m_dMaxFlowSpeed^2)
    if (dFlowSpeed > m_dMaxFlowSpeed)
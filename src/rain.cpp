@@ -13,9 +13,17 @@ This program is distributed in the hope that it will be useful, but WITHOUT ANY
 You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 =========================================================================================================================================*/
+#include <algorithm>
+using std::sort;
+
+#include <set>
+using std::set;
+
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
+#include "rand_stream.h"
 
 //=========================================================================================================================================
 //! Simulates run-on from a single edge of the grid
@@ -37,8 +45,15 @@ void CSimulation::DoRunOnFromOneEdge(int const nEdge)
    // Now calculate the standard deviation of number of raindrops falling on the run-on area during a timestep of this duration
    double dRunOnStdNDrops = m_dTimeStep * m_dStdRainInt * m_dRunOnLen * m_dCellSide * dEdgeLen / (3600 * m_dMeanCellWaterVol);
 
-   // Using ulGetRand0(), calculate the number of raindrops reaching the lower edge of the run-on area (i.e. the top edge of the soil area). The number of drops reaching the lower edge of the run-on area will depend on how much time has elapsed, but only while insufficient time has elapsed for water to have flowed from the top edge of the run-on area. Here, calculate number of drops (can be zero, need not be a whole number)
-   double dDrops = dGetRand0GaussPos(tMin(dRunOnAvgNDrops, (dRunOnAvgNDrops * m_dRunOnSpd * m_dSimulatedTimeElapsed) / m_dRunOnLen), dRunOnStdNDrops);
+   // Using ulGetRand0() (or this edge's counter-based stream), calculate the number of raindrops reaching the lower edge of the run-on area (i.e. the top edge of the soil area). The number of drops reaching the lower edge of the run-on area will depend on how much time has elapsed, but only while insufficient time has elapsed for water to have flowed from the top edge of the run-on area. Here, calculate number of drops (can be zero, need not be a whole number)
+   double
+      dRunOnMeanNDrops = tMin(dRunOnAvgNDrops, (dRunOnAvgNDrops * m_dRunOnSpd * m_dSimulatedTimeElapsed) / m_dRunOnLen),
+      dDrops = 0;
+
+   if (m_bCounterBasedRand)
+      dDrops = RandStream(RAND_STREAM_RUNON, nEdge).dGetRandGaussPos(dRunOnMeanNDrops, dRunOnStdNDrops);
+   else
+      dDrops = dGetRand0GaussPos(dRunOnMeanNDrops, dRunOnStdNDrops);
 
    if (dDrops > 0)
    {
@@ -60,8 +75,9 @@ void CSimulation::DoRunOnFromOneEdge(int const nEdge)
             {
                if (m_Cell[nX][nY].bIsEdgeCell())
                {
-                  // Add the run-on to this edge cell of the cell array
+                  // Add the run-on to this edge cell of the cell array, it may now be wet
                   m_Cell[nX][nY].pGetRainAndRunon()->AddRunOn(dRunOnDepth);
+                  m_pGrid->AddWetCandidate(m_pGrid->nGetIndex(nX, nY));
                   break;
                }
             }
@@ -77,8 +93,9 @@ void CSimulation::DoRunOnFromOneEdge(int const nEdge)
             {
                if (m_Cell[nX][nY].bIsEdgeCell())
                {
-                  // Add the run-on to this edge cell of the cell array
+                  // Add the run-on to this edge cell of the cell array, it may now be wet
                   m_Cell[nX][nY].pGetRainAndRunon()->AddRunOn(dRunOnDepth);
+                  m_pGrid->AddWetCandidate(m_pGrid->nGetIndex(nX, nY));
                   break;
                }
             }
@@ -94,8 +111,9 @@ void CSimulation::DoRunOnFromOneEdge(int const nEdge)
             {
                if (m_Cell[nX][nY].bIsEdgeCell())
                {
-                  // Add the run-on to this edge cell of the cell array
+                  // Add the run-on to this edge cell of the cell array, it may now be wet
                   m_Cell[nX][nY].pGetRainAndRunon()->AddRunOn(dRunOnDepth);
+                  m_pGrid->AddWetCandidate(m_pGrid->nGetIndex(nX, nY));
                   break;
                }
             }
@@ -111,8 +129,9 @@ void CSimulation::DoRunOnFromOneEdge(int const nEdge)
             {
                if (m_Cell[nX][nY].bIsEdgeCell())
                {
-                  // Add the run-on to this edge cell of the cell array
+                  // Add the run-on to this edge cell of the cell array, it may now be wet
                   m_Cell[nX][nY].pGetRainAndRunon()->AddRunOn(dRunOnDepth);
+                  m_pGrid->AddWetCandidate(m_pGrid->nGetIndex(nX, nY));
                   break;
                }
             }
@@ -132,8 +151,12 @@ void CSimulation::DoAllRain(void)
    // Now calculate standard deviation of number of raindrops during a timestep of this duration
    double dStdNDrops = m_dTimeStep * m_dStdRainInt * static_cast<double>(m_ulNActiveCells) * m_dCellSquare / (3600 * m_dMeanCellWaterVol);
 
-   // Using ulGetRand0(), calculate the integer number of new raindrops which will fall during this timestep
-   int nDrops = static_cast<int>(lround(dGetRand0GaussPos(dAvgNDrops, dStdNDrops)));
+   // Using ulGetRand0() (or a counter-based stream), calculate the integer number of new raindrops which will fall during this timestep
+   int nDrops = 0;
+   if (m_bCounterBasedRand)
+      nDrops = static_cast<int>(lround(RandStream(RAND_STREAM_RAIN_DROPS, 0).dGetRandGaussPos(dAvgNDrops, dStdNDrops)));
+   else
+      nDrops = static_cast<int>(lround(dGetRand0GaussPos(dAvgNDrops, dStdNDrops)));
    m_ldGTotDrops += nDrops;
 
    // If not doing time-varying rain, do the rainfall intensity correction routine, for low intensities only (arbitrarily, less than 10 drops per timestep), corrects for too few drops or too many drops falling per timestep
@@ -163,24 +186,301 @@ void CSimulation::DoAllRain(void)
    // Needed for tiny grids
    nDrops = tMax(nDrops, 1);
 
-   // Actually drop each raindrop
-   for (int n = 1; n <= nDrops; n++)
+   // If many drops are expected, then find how many fall on each cell instead of dropping them one by one
+   if ((m_dAggregateRainThreshold > 0) && (dAvgNDrops > m_dAggregateRainThreshold * static_cast<double>(m_ulNActiveCells)))
+      DoAllRainAggregated(nDrops);
+   else if (m_bCounterBasedRand)
+      DoAllRainDropsCounterBased(nDrops);
+   else
+   {
+      // Actually drop each raindrop
+      for (int n = 1; n <= nDrops; n++)
+      {
+         // Using ulGetRand0(), first decide where raindrop will fall
+         int nX, nY;
+         do
+         {
+            nX = nGetRand0To(m_nXGridMax);
+            nY = nGetRand0To(m_nYGridMax);
+         }
+         while (m_Cell[nX][nY].bIsMissingValue());
+
+         // And then use ulGetRand0() to calculate its depth, correcting for spatial variation in rainfall
+         double dRainDepth = dGetRand0GaussPos(m_dMeanCellWaterVol, m_dStdCellWaterVol) * m_dInvCellSquare * m_Cell[nX][nY].pGetRainAndRunon()->dGetRainVarM();
+
+         AddRainDrop(nX, nY, dRainDepth);
+      }
+   }
+
+   // Put the rain-hit list in the same order as the spans of active cells
+   m_pGrid->SortRainHit();
+}
+
+//=========================================================================================================================================
+//! Drops nDrops raindrops using counter-based random numbers. Each drop uses the first block of four numbers from its own stream: the first number picks a cell directly from the list of active cells (so missing-value cells never need to be rejected), the next two give the drop's volume by the Ziggurat method. The blocks, and then a buffer of Gaussian deviates, are generated in vectorised batches, then the drops are bucketed by cell so that they are added to the cell array in memory order. More than one drop may fall on the same cell: these are added in drop order
+//=========================================================================================================================================
+void CSimulation::DoAllRainDropsCounterBased(int const nDrops)
+{
+   int nActive = m_pGrid->nGetNumActiveCells();
+   if (nActive == 0)
+      return;
+
+   vector<uint32_t>
+      Vu0(nDrops),
+      Vu1(nDrops),
+      Vu2(nDrops),
+      Vu3(nDrops);
+   vector<unsigned long long> VullDropKey(nDrops);
+   vector<double> VdDropVol(nDrops);
+
+   int nBatches = (nDrops + RAIN_DROP_BATCH - 1) / RAIN_DROP_BATCH;
+
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int nBatch = 0; nBatch < nBatches; nBatch++)
    {
-      // Using ulGetRand0(), first decide where raindrop will fall
-      int nX, nY;
-      do
+      int
+         nFirst = nBatch * RAIN_DROP_BATCH,
+         nNum = tMin(RAIN_DROP_BATCH, nDrops - nFirst);
+
+      // Get the random numbers for this batch of drops, and fill the buffer with a unit Gaussian deviate for each drop
+      CRandStream::GetFirstBlocks(m_ulRandSeed[0], RAND_STREAM_RAIN, m_ulIter, nFirst, nNum, &Vu0[nFirst], &Vu1[nFirst], &Vu2[nFirst], &Vu3[nFirst]);
+      CRandStream::GetZigguratGaussians(m_ulRandSeed[0], RAND_STREAM_RAIN, m_ulIter, nFirst, nNum, &Vu1[nFirst], &Vu2[nFirst], &VdDropVol[nFirst]);
+
+      for (int n = nFirst; n < nFirst + nNum; n++)
       {
-         nX = nGetRand0To(m_nXGridMax);
-         nY = nGetRand0To(m_nYGridMax);
+         // Pick an active cell, the drop's key has the cell's store index in the high 32 bits and the drop number in the low 32 bits
+         int nCell = m_pGrid->nGetActiveCell(static_cast<int>((static_cast<unsigned long long>(Vu0[n]) * static_cast<unsigned long long>(nActive)) >> 32));
+         VullDropKey[n] = (static_cast<unsigned long long>(nCell) << 32) | static_cast<unsigned long long>(n);
+
+         // And the drop's volume
+         VdDropVol[n] = tMax(m_dMeanCellWaterVol + (m_dStdCellWaterVol * VdDropVol[n]), 0.0);
       }
-      while (m_Cell[nX][nY].bIsMissingValue());
+   }
+
+   // Bucket the drops by cell, drops on the same cell stay in drop order
+   sort(VullDropKey.begin(), VullDropKey.end());
+
+   // Now add the drops to the cell array, correcting each for spatial variation in rainfall
+   for (int i = 0; i < nDrops; i++)
+   {
+      int
+         nCell = static_cast<int>(VullDropKey[i] >> 32),
+         n = static_cast<int>(VullDropKey[i] & MASK),
+         nX = m_pGrid->nGetXFromIndex(nCell),
+         nY = m_pGrid->nGetYFromIndex(nCell);
+
+      AddRainDrop(nX, nY, VdDropVol[n] * m_dInvCellSquare * m_Cell[nX][nY].pGetRainAndRunon()->dGetRainVarM());
+   }
+}
+
+//=========================================================================================================================================
+//! Builds the alias table (Vose's method) used to choose active cells in proportion to their rainfall variation multipliers. Each entry has a probability of keeping that cell, and an alternative cell to use otherwise. Also stores the probability that a drop falls on each active cell. The multipliers do not change during a simulation, so this is only done once
+//=========================================================================================================================================
+void CSimulation::InitRainAlias(void)
+{
+   int nActive = m_pGrid->nGetNumActiveCells();
+   m_VdRainAliasProb.assign(nActive, 1);
+   m_VnRainAlias.assign(nActive, 0);
+   m_VdRainCellProb.assign(nActive, 0);
+
+   double dTotRainVarM = 0;
+   vector<double> VdScaled(nActive);
+   for (int i = 0; i < nActive; i++)
+   {
+      int n = m_pGrid->nGetActiveCell(i);
+      VdScaled[i] = tMax(m_Cell[m_pGrid->nGetXFromIndex(n)][m_pGrid->nGetYFromIndex(n)].pGetRainAndRunon()->dGetRainVarM(), 0.0);
+      dTotRainVarM += VdScaled[i];
+   }
+
+   m_dRainAliasMeanRainVarM = dTotRainVarM / nActive;
+   if (dTotRainVarM <= 0)
+      return;
+
+   // Scale so that the average is one, then sort the entries into those below average and those above
+   vector<int> VnSmall, VnLarge;
+   for (int i = 0; i < nActive; i++)
+   {
+      m_VdRainCellProb[i] = VdScaled[i] / dTotRainVarM;
 
-      // And then use ulGetRand0() to calculate its depth, correcting for spatial variation in rainfall
-      double dRainDepth = dGetRand0GaussPos(m_dMeanCellWaterVol, m_dStdCellWaterVol) * m_dInvCellSquare * m_Cell[nX][nY].pGetRainAndRunon()->dGetRainVarM();
+      VdScaled[i] /= m_dRainAliasMeanRainVarM;
+      if (VdScaled[i] < 1)
+         VnSmall.push_back(i);
+      else
+         VnLarge.push_back(i);
+   }
+
+   // Each below-average entry is topped up from an above-average entry
+   while ((! VnSmall.empty()) && (! VnLarge.empty()))
+   {
+      int
+         nSmall = VnSmall.back(),
+         nLarge = VnLarge.back();
+      VnSmall.pop_back();
+
+      m_VdRainAliasProb[nSmall] = VdScaled[nSmall];
+      m_VnRainAlias[nSmall] = nLarge;
 
-      // Add to rainfall amount and water depth for this cell on the cell array
-      m_Cell[nX][nY].pGetRainAndRunon()->AddRain(dRainDepth);
+      VdScaled[nLarge] -= (1 - VdScaled[nSmall]);
+      if (VdScaled[nLarge] < 1)
+      {
+         VnLarge.pop_back();
+         VnSmall.push_back(nLarge);
+      }
    }
+
+   // Anything left over is (apart from rounding error) exactly average, so is always kept
+   for (unsigned int i = 0; i < VnSmall.size(); i++)
+      m_VdRainAliasProb[VnSmall[i]] = 1;
+   for (unsigned int i = 0; i < VnLarge.size(); i++)
+      m_VdRainAliasProb[VnLarge[i]] = 1;
+}
+
+//=========================================================================================================================================
+//! Drops nDrops raindrops without dealing with each drop separately. The number of drops falling on each active cell is a multinomial draw, with each cell's probability proportional to its rainfall variation multiplier. This is found directly for each active cell: first each cell's number of drops is drawn from a Poisson distribution with mean nDrops times the cell's probability, then the total is made exactly nDrops, by adding the shortfall as drops on cells chosen from the alias table, or by removing the excess as drops chosen uniformly from all those which have fallen. Either way the result has the multinomial distribution. With counter-based random numbers, each cell's Poisson draw uses that cell's own stream so is done in parallel; otherwise a single stream, whose seed comes from the Tausworthe generator, is used for all cells in turn. Then, in a single pass over the active cells, the summed volume of the drops on each cell is drawn from a Gaussian distribution with the mean and variance of the sum (the sum is truncated at zero, rather than each drop). Each drop's volume is multiplied by the mean rainfall variation multiplier, so that the expected depth on each cell is the same as when rain is dropped drop by drop
+//=========================================================================================================================================
+void CSimulation::DoAllRainAggregated(int const nDrops)
+{
+   if (m_VdRainAliasProb.empty())
+      InitRainAlias();
+
+   int nActive = m_pGrid->nGetNumActiveCells();
+   if ((nActive == 0) || (m_dRainAliasMeanRainVarM <= 0))
+      return;
+
+   // This stream is used for everything which is not done cell by cell
+   CRandStream Rand = (m_bCounterBasedRand ? RandStream(RAND_STREAM_RAIN_COUNT, static_cast<unsigned long>(nActive)) : CRandStream(ulGetRand0(), RAND_STREAM_RAIN_COUNT, m_ulIter, 0));
+
+   // First get the number of drops on each cell
+   vector<int> VnCount(nActive);
+   double dNDrops = nDrops;
+   if (m_bCounterBasedRand)
+   {
+#if defined _OPENMP
+      #pragma omp parallel for schedule(static)
+#endif
+      for (int i = 0; i < nActive; i++)
+         VnCount[i] = RandStream(RAND_STREAM_RAIN_COUNT, static_cast<unsigned long>(i)).nGetRandPoisson(dNDrops * m_VdRainCellProb[i]);
+   }
+   else
+   {
+      for (int i = 0; i < nActive; i++)
+         VnCount[i] = Rand.nGetRandPoisson(dNDrops * m_VdRainCellProb[i]);
+   }
+
+   int nTotCount = 0;
+   for (int i = 0; i < nActive; i++)
+      nTotCount += VnCount[i];
+
+   if (nTotCount < nDrops)
+   {
+      // Too few drops, so add the shortfall one by one
+      for (int n = nTotCount; n < nDrops; n++)
+      {
+         int i = Rand.nGetRandTo(nActive);
+         if (Rand.dGetRand0d1() >= m_VdRainAliasProb[i])
+            i = m_VnRainAlias[i];
+
+         VnCount[i]++;
+      }
+   }
+   else if (nTotCount > nDrops)
+   {
+      // Too many drops, so choose which of the drops (numbered in cell order) to remove, using Floyd's method to get distinct drop numbers
+      set<int> SnRemove;
+      for (int n = nDrops; n < nTotCount; n++)
+      {
+         int nDrop = Rand.nGetRandTo(n + 1);
+         if (! SnRemove.insert(nDrop).second)
+            SnRemove.insert(n);
+      }
+
+      // Then find the cell on which each of these drops fell, in the same order
+      int
+         i = 0,
+         nCellLastDrop = VnCount[0];
+      for (set<int>::const_iterator it = SnRemove.begin(); it != SnRemove.end(); it++)
+      {
+         while (*it >= nCellLastDrop)
+            nCellLastDrop += VnCount[++i];
+
+         VnCount[i]--;
+      }
+   }
+
+   // Now a single pass over the active cells, in memory order, to get the summed volume on each cell which has been hit
+   double dDepthPerVol = m_dInvCellSquare * m_dRainAliasMeanRainVarM;
+   if (m_bCounterBasedRand)
+   {
+      vector<double> VdVol(nActive);
+      int nBatches = (nActive + RAIN_DROP_BATCH - 1) / RAIN_DROP_BATCH;
+
+#if defined _OPENMP
+      #pragma omp parallel for schedule(static)
+#endif
+      for (int nBatch = 0; nBatch < nBatches; nBatch++)
+      {
+         int
+            nFirst = nBatch * RAIN_DROP_BATCH,
+            nNum = tMin(RAIN_DROP_BATCH, nActive - nFirst);
+
+         // Fill the buffer with a unit Gaussian deviate for each cell in this batch
+         vector<uint32_t>
+            Vu0(nNum),
+            Vu1(nNum),
+            Vu2(nNum),
+            Vu3(nNum);
+         CRandStream::GetFirstBlocks(m_ulRandSeed[0], RAND_STREAM_RAIN_CELL, m_ulIter, nFirst, nNum, &Vu0[0], &Vu1[0], &Vu2[0], &Vu3[0]);
+         CRandStream::GetZigguratGaussians(m_ulRandSeed[0], RAND_STREAM_RAIN_CELL, m_ulIter, nFirst, nNum, &Vu0[0], &Vu1[0], &VdVol[nFirst]);
+
+         for (int i = nFirst; i < nFirst + nNum; i++)
+         {
+            double dCount = VnCount[i];
+            VdVol[i] = tMax((dCount * m_dMeanCellWaterVol) + (sqrt(dCount) * m_dStdCellWaterVol * VdVol[i]), 0.0);
+         }
+      }
+
+      for (int i = 0; i < nActive; i++)
+      {
+         if (VnCount[i] > 0)
+         {
+            int nCell = m_pGrid->nGetActiveCell(i);
+            AddRainDrop(m_pGrid->nGetXFromIndex(nCell), m_pGrid->nGetYFromIndex(nCell), VdVol[i] * dDepthPerVol);
+         }
+      }
+   }
+   else
+   {
+      for (int i = 0; i < nActive; i++)
+      {
+         if (VnCount[i] > 0)
+         {
+            double dCount = VnCount[i];
+            double dVol = tMax((dCount * m_dMeanCellWaterVol) + (sqrt(dCount) * m_dStdCellWaterVol * dGetRand0Gaussian()), 0.0);
+
+            int nCell = m_pGrid->nGetActiveCell(i);
+            AddRainDrop(m_pGrid->nGetXFromIndex(nCell), m_pGrid->nGetYFromIndex(nCell), dVol * dDepthPerVol);
+         }
+      }
+   }
+}
+
+//=========================================================================================================================================
+//! Adds a single raindrop of the given depth to a cell
+//=========================================================================================================================================
+void CSimulation::AddRainDrop(int const nX, int const nY, double const dRainDepth)
+{
+   // If this is the first rain on this cell during this iteration, then the cell is added to the rain-hit list. The cell may also now be wet
+   if (dRainDepth > 0)
+   {
+      int nThis = m_pGrid->nGetIndex(nX, nY);
+      if (m_pGrid->bAddRainHit(nThis))
+         m_pGrid->AddWetCandidate(nThis);
+   }
+
+   // Add to rainfall amount and water depth for this cell on the cell array
+   m_Cell[nX][nY].pGetRainAndRunon()->AddRain(dRainDepth);
 }
 
 //=========================================================================================================================================
@@ -0,0 +1,363 @@
+/*=========================================================================================================================================
+
+This is rand_stream.cpp: implementations of the RillGrow class which provides a counter-based (Philox4x32-10) stream of random numbers
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <cmath>
+
+#include "rg.h"
+#include "rand_stream.h"
+
+/*=========================================================================================================================================
+
+Philox4x32-10 is a counter-based random number generator: each block of four 32-bit random numbers is a keyed bijection (ten rounds of multiply and exclusive-or) of a 128-bit counter. There is no state to carry from one number to the next, so any number in the sequence can be found directly. Here the key is made from the user-supplied seed, and the counter from the process, the iteration, the cell or drop index, and the position within the stream. So the numbers used for a given cell or drop do not depend on the order in which cells or drops are dealt with, or on the number of threads.
+
+From: J.K. Salmon, M.A. Moraes, R.O. Dror and D.E. Shaw (2011). Parallel random numbers: as easy as 1, 2, 3. Proceedings of 2011 International Conference for High Performance Computing, Networking, Storage and Analysis (SC11), ACM, New York. The known-answer values from the Random123 library are reproduced, e.g. a zero key and zero counter give 0x6627e8d5 0xe169c58d 0xbc57ac4c 0x9b00dbd8
+
+Gaussian deviates use the Ziggurat method of Marsaglia and Tsang (2000), with 128 layers. Nearly all (about 99%) of deviates need only a multiply and a compare, with no log, sqrt or rejection loop, so many can be calculated at once using SIMD. Separate random numbers are used for the value and for the layer, which avoids the correlation between the two in the original method (see Doornik, J.A. (2005). An improved Ziggurat method to generate normal random samples. University of Oxford)
+
+=========================================================================================================================================*/
+static uint32_t const PHILOX_M0 = 0xD2511F53u;
+static uint32_t const PHILOX_M1 = 0xCD9E8D57u;
+static uint32_t const PHILOX_W0 = 0x9E3779B9u;                 // Golden ratio
+static uint32_t const PHILOX_W1 = 0xBB67AE85u;                 // sqrt(3) - 1
+
+int const ZIGGURAT_LAYERS = 128;                                 // Must be a power of two
+double const ZIGGURAT_R = 3.442619855899;                       // Start of the tail
+double const ZIGGURAT_V = 9.91256303526217e-3;                  // Area of each layer
+
+double const POISSON_INVERSION_MAX_MEAN = 10;                   // Poisson deviates with a smaller mean than this are found by inversion, otherwise by transformed rejection
+
+//! The tables for the Ziggurat method for a unit Gaussian distribution. For each layer: the (scaled) integer limit of the rectangle, the multiplier from a signed 32-bit integer to a deviate, and the value of the density function at the top of the layer. These are calculated once, and do not change
+static struct ZigguratTables
+{
+   uint32_t uK[ZIGGURAT_LAYERS];
+   double dW[ZIGGURAT_LAYERS];
+   double dF[ZIGGURAT_LAYERS];
+
+   ZigguratTables(void)
+   {
+      double const dM = 2147483648.0;                           // 2**31
+      double
+         dD = ZIGGURAT_R,
+         dT = dD,
+         dQ = ZIGGURAT_V / exp(-0.5 * dD * dD);
+
+      uK[0] = static_cast<uint32_t>((dD / dQ) * dM);
+      uK[1] = 0;
+      dW[0] = dQ / dM;
+      dW[ZIGGURAT_LAYERS-1] = dD / dM;
+      dF[0] = 1;
+      dF[ZIGGURAT_LAYERS-1] = exp(-0.5 * dD * dD);
+
+      for (int i = ZIGGURAT_LAYERS-2; i >= 1; i--)
+      {
+         dD = sqrt(-2 * log((ZIGGURAT_V / dD) + exp(-0.5 * dD * dD)));
+         uK[i+1] = static_cast<uint32_t>((dD / dT) * dM);
+         dT = dD;
+         dF[i] = exp(-0.5 * dD * dD);
+         dW[i] = dD / dM;
+      }
+   }
+} const Ziggurat;
+
+//! Returns the absolute value of a signed 32-bit integer, as an unsigned 32-bit integer (so that the most negative value is not a problem)
+static inline uint32_t uZigguratAbs(int32_t const nValue)
+{
+   return ((nValue < 0) ? (0u - static_cast<uint32_t>(nValue)) : static_cast<uint32_t>(nValue));
+}
+
+//! Constructs a stream of random numbers for a process, an iteration, and a cell or drop index
+CRandStream::CRandStream(unsigned long const ulSeed, int const nProcess, unsigned long const ulIter, unsigned long const ulIndex)
+:
+   m_nNext(0)
+{
+   m_uKey[0] = static_cast<uint32_t>(ulSeed & MASK);
+   m_uKey[1] = static_cast<uint32_t>((static_cast<unsigned long long>(ulSeed) >> 32) & MASK);
+
+   m_uCounter[0] = 0;
+   m_uCounter[1] = static_cast<uint32_t>(ulIndex & MASK);
+   m_uCounter[2] = static_cast<uint32_t>(ulIter & MASK);
+   m_uCounter[3] = static_cast<uint32_t>(nProcess);
+
+   GenerateBlock();
+}
+
+//! The ten Philox rounds: on entry uC0 to uC3 hold the counter, on exit they hold the block of four random numbers
+static inline void Philox4x32x10(uint32_t uK0, uint32_t uK1, uint32_t& uC0, uint32_t& uC1, uint32_t& uC2, uint32_t& uC3)
+{
+   for (int nRound = 0; nRound < 10; nRound++)
+   {
+      uint64_t
+         ulProd0 = static_cast<uint64_t>(PHILOX_M0) * uC0,
+         ulProd1 = static_cast<uint64_t>(PHILOX_M1) * uC2;
+
+      uint32_t
+         uHi0 = static_cast<uint32_t>(ulProd0 >> 32),
+         uLo0 = static_cast<uint32_t>(ulProd0),
+         uHi1 = static_cast<uint32_t>(ulProd1 >> 32),
+         uLo1 = static_cast<uint32_t>(ulProd1);
+
+      uC0 = uHi1 ^ uC1 ^ uK0;
+      uC1 = uLo1;
+      uC2 = uHi0 ^ uC3 ^ uK1;
+      uC3 = uLo0;
+
+      // Bump the key for the next round
+      uK0 += PHILOX_W0;
+      uK1 += PHILOX_W1;
+   }
+}
+
+//! Calculates the block of four random numbers for the current value of the counter
+void CRandStream::GenerateBlock(void)
+{
+   uint32_t
+      uC0 = m_uCounter[0],
+      uC1 = m_uCounter[1],
+      uC2 = m_uCounter[2],
+      uC3 = m_uCounter[3];
+
+   Philox4x32x10(m_uKey[0], m_uKey[1], uC0, uC1, uC2, uC3);
+
+   m_uBlock[0] = uC0;
+   m_uBlock[1] = uC1;
+   m_uBlock[2] = uC2;
+   m_uBlock[3] = uC3;
+}
+
+//! Calculates the first block of four random numbers of each of nNum consecutive streams (for indices ulFirstIndex onwards) of a process during an iteration, i.e. the same numbers as the first four uGetRand() calls of each stream. The blocks are written to four arrays, one per word. Each block is independent of the others, so this is vectorised
+void CRandStream::GetFirstBlocks(unsigned long const ulSeed, int const nProcess, unsigned long const ulIter, unsigned long const ulFirstIndex, int const nNum, uint32_t* const pu0, uint32_t* const pu1, uint32_t* const pu2, uint32_t* const pu3)
+{
+   uint32_t
+      uK0 = static_cast<uint32_t>(ulSeed & MASK),
+      uK1 = static_cast<uint32_t>((static_cast<unsigned long long>(ulSeed) >> 32) & MASK),
+      uIter = static_cast<uint32_t>(ulIter & MASK),
+      uProcess = static_cast<uint32_t>(nProcess),
+      uFirstIndex = static_cast<uint32_t>(ulFirstIndex & MASK);
+
+#if defined _OPENMP
+   #pragma omp simd
+#endif
+   for (int n = 0; n < nNum; n++)
+   {
+      uint32_t
+         uC0 = 0,
+         uC1 = uFirstIndex + static_cast<uint32_t>(n),
+         uC2 = uIter,
+         uC3 = uProcess;
+
+      Philox4x32x10(uK0, uK1, uC0, uC1, uC2, uC3);
+
+      pu0[n] = uC0;
+      pu1[n] = uC1;
+      pu2[n] = uC2;
+      pu3[n] = uC3;
+   }
+}
+
+//! Jumps ahead by ulNum random numbers, without calculating the numbers in between
+void CRandStream::Skip(unsigned long const ulNum)
+{
+   unsigned long ulPos = m_nNext + ulNum;
+
+   if (ulPos < 4)
+   {
+      m_nNext = static_cast<int>(ulPos);
+      return;
+   }
+
+   m_uCounter[0] += static_cast<uint32_t>((ulPos / 4) & MASK);
+   m_nNext = static_cast<int>(ulPos % 4);
+   GenerateBlock();
+}
+
+//! Returns the next 32-bit random number from the stream
+uint32_t CRandStream::uGetRand(void)
+{
+   if (m_nNext == 4)
+   {
+      // All of this block has been used, so calculate the next one
+      m_uCounter[0]++;
+      GenerateBlock();
+      m_nNext = 0;
+   }
+
+   return m_uBlock[m_nNext++];
+}
+
+//! Returns a double precision floating point number uniformly distributed in the range [0, 1) i.e. includes 0.0 but excludes 1.0. This uses two 32-bit random numbers, so has the full 53 bits of precision
+double CRandStream::dGetRand0d1(void)
+{
+   uint32_t
+      uHi = uGetRand() >> 5,
+      uLo = uGetRand() >> 6;
+
+   return ((uHi * 67108864.0) + uLo) / 9007199254740992.0;
+}
+
+//! Returns a random integer uniformly distributed in the range [0, nBound) i.e. includes 0 but excludes nBound
+int CRandStream::nGetRandTo(int const nBound)
+{
+   int nRtn;
+   uint32_t uScale = 4294967295u / static_cast<uint32_t>(nBound);
+
+   do
+   {
+      nRtn = static_cast<int>(uGetRand() / uScale);
+   }
+   while (nRtn >= nBound);
+
+   return (nRtn);
+}
+
+//! Randomly samples from a unit Gaussian (normal) distribution, using the Ziggurat method. Each try uses two random numbers: one for the value and one for the layer
+double CRandStream::dGetRandGaussian(void)
+{
+   int32_t nValue = static_cast<int32_t>(uGetRand());
+   int nLayer = static_cast<int>(uGetRand() & (ZIGGURAT_LAYERS-1));
+
+   if (uZigguratAbs(nValue) < Ziggurat.uK[nLayer])
+      // Inside the rectangle, which is nearly always so
+      return nValue * Ziggurat.dW[nLayer];
+
+   return dGetZigguratSlow(nValue, nLayer);
+}
+
+//! The slow part of the Ziggurat method, for a value which was not inside its layer's rectangle. The value is either in the wedge beyond the rectangle, or (for the base layer) in the tail beyond ZIGGURAT_R; if not, the stream's next random numbers are used to try again. From Marsaglia, G. and Tsang, W.W. (2000). The Ziggurat method for generating random variables. Journal of Statistical Software 5(8), 1-7
+double CRandStream::dGetZigguratSlow(int32_t nValue, int nLayer)
+{
+   while (true)
+   {
+      double dX = nValue * Ziggurat.dW[nLayer];
+
+      if (nLayer == 0)
+      {
+         // The tail
+         double dY;
+         do
+         {
+            // Note that 1 - dGetRand0d1() is in (0, 1], so its log is finite
+            dX = -log(1 - dGetRand0d1()) / ZIGGURAT_R;
+            dY = -log(1 - dGetRand0d1());
+         }
+         while (dY + dY < dX * dX);
+
+         return ((nValue > 0) ? ZIGGURAT_R + dX : -ZIGGURAT_R - dX);
+      }
+
+      // The wedge
+      if (Ziggurat.dF[nLayer] + (dGetRand0d1() * (Ziggurat.dF[nLayer-1] - Ziggurat.dF[nLayer])) < exp(-0.5 * dX * dX))
+         return dX;
+
+      // Not accepted, so try again
+      nValue = static_cast<int32_t>(uGetRand());
+      nLayer = static_cast<int>(uGetRand() & (ZIGGURAT_LAYERS-1));
+
+      if (uZigguratAbs(nValue) < Ziggurat.uK[nLayer])
+         return nValue * Ziggurat.dW[nLayer];
+   }
+}
+
+//! Calculates nNum unit Gaussian deviates using the Ziggurat method, one for each of the streams (for indices ulFirstIndex onwards) of a process during an iteration. For each stream, puValue and puLayer hold two of the numbers from its first block (see GetFirstBlocks()). The rectangle test is branch-free, so is vectorised; the few values which fail it are then dealt with one by one, using the numbers which come after the first block of that stream
+void CRandStream::GetZigguratGaussians(unsigned long const ulSeed, int const nProcess, unsigned long const ulIter, unsigned long const ulFirstIndex, int const nNum, uint32_t const* const puValue, uint32_t const* const puLayer, double* const pdGaussian)
+{
+   int nSlow = 0;
+
+#if defined _OPENMP
+   #pragma omp simd reduction(+:nSlow)
+#endif
+   for (int n = 0; n < nNum; n++)
+   {
+      int32_t nValue = static_cast<int32_t>(puValue[n]);
+      int nLayer = static_cast<int>(puLayer[n] & (ZIGGURAT_LAYERS-1));
+
+      pdGaussian[n] = nValue * Ziggurat.dW[nLayer];
+      nSlow += (uZigguratAbs(nValue) < Ziggurat.uK[nLayer] ? 0 : 1);
+   }
+
+   if (nSlow == 0)
+      return;
+
+   for (int n = 0; n < nNum; n++)
+   {
+      int32_t nValue = static_cast<int32_t>(puValue[n]);
+      int nLayer = static_cast<int>(puLayer[n] & (ZIGGURAT_LAYERS-1));
+
+      if (uZigguratAbs(nValue) >= Ziggurat.uK[nLayer])
+      {
+         CRandStream Rand(ulSeed, nProcess, ulIter, ulFirstIndex + n);
+         Rand.Skip(4);
+         pdGaussian[n] = Rand.dGetZigguratSlow(nValue, nLayer);
+      }
+   }
+}
+
+//! Returns a random double drawn from a Gaussian distribution with the given mean and standard deviation, truncated at zero
+double CRandStream::dGetRandGaussPos(double const dMean, double const dStd)
+{
+   return (tMax((dGetRandGaussian() * dStd) + dMean, 0.0));
+}
+
+//! Randomly samples from a Poisson distribution with mean dMean. For a small mean this is by inversion, i.e. by summing the probabilities of 0, 1, 2... until they pass a single uniform deviate. For a larger mean the transformed rejection method (PTRS) is used, this accepts about 90% of tries with two uniform deviates each. From Hormann, W. (1993). The transformed rejection method for generating Poisson random variables. Insurance: Mathematics and Economics 12(1), 39-45
+int CRandStream::nGetRandPoisson(double const dMean)
+{
+   if (dMean <= 0)
+      return 0;
+
+   if (dMean < POISSON_INVERSION_MAX_MEAN)
+   {
+      int nRtn = 0;
+      double
+         dU = dGetRand0d1(),
+         dP = exp(-dMean),
+         dF = dP;
+
+      // Stop if the probabilities underflow, since rounding may leave their sum a little less than one
+      while ((dU > dF) && (dP > 0))
+      {
+         nRtn++;
+         dP *= dMean / nRtn;
+         dF += dP;
+      }
+
+      return nRtn;
+   }
+
+   double
+      dSqrtMean = sqrt(dMean),
+      dLogMean = log(dMean),
+      dB = 0.931 + (2.53 * dSqrtMean),
+      dA = -0.059 + (0.02483 * dB),
+      dInvAlpha = 1.1239 + (1.1328 / (dB - 3.4)),
+      dVR = 0.9277 - (3.6224 / (dB - 2));
+
+   while (true)
+   {
+      double
+         dU = dGetRand0d1() - 0.5,
+         dV = dGetRand0d1(),
+         dUS = 0.5 - fabs(dU),
+         dK = floor((((2 * dA / dUS) + dB) * dU) + dMean + 0.43);
+
+      // Nearly always, the try is inside the region where it can be accepted without further checks
+      if ((dUS >= 0.07) && (dV <= dVR))
+         return static_cast<int>(dK);
+
+      if ((dK < 0) || ((dUS < 0.013) && (dV > dUS)))
+         continue;
+
+      if ((log(dV) + log(dInvAlpha) - log((dA / (dUS * dUS)) + dB)) <= (-dMean + (dK * dLogMean) - lgamma(dK + 1)))
+         return static_cast<int>(dK);
+   }
+}
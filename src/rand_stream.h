@@ -0,0 +1,52 @@
+#ifndef __RAND_STREAM_H__
+   #define __RAND_STREAM_H__
+/*=========================================================================================================================================
+
+This is rand_stream.h: declaration for the RillGrow class which provides a counter-based (Philox4x32-10) stream of random numbers
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <stdint.h>
+
+class CRandStream
+{
+private:
+   //! The Philox key, made from the random number seed
+   uint32_t m_uKey[2];
+
+   //! The Philox counter. Word 0 is the number of the current block within this stream, word 1 is the cell or drop index, word 2 is the iteration, word 3 identifies the process which is using the stream
+   uint32_t m_uCounter[4];
+
+   //! The current block of four random numbers
+   uint32_t m_uBlock[4];
+
+   //! The position in the current block of the next unused random number, if this is 4 then the block has all been used
+   int m_nNext;
+
+   void GenerateBlock(void);
+   double dGetZigguratSlow(int32_t, int);
+
+public:
+   CRandStream(unsigned long const, int const, unsigned long const, unsigned long const);
+
+   static void GetFirstBlocks(unsigned long const, int const, unsigned long const, unsigned long const, int const, uint32_t* const, uint32_t* const, uint32_t* const, uint32_t* const);
+   static void GetZigguratGaussians(unsigned long const, int const, unsigned long const, unsigned long const, int const, uint32_t const* const, uint32_t const* const, double* const);
+
+   void Skip(unsigned long const);
+   uint32_t uGetRand(void);
+   double dGetRand0d1(void);
+   int nGetRandTo(int const);
+   double dGetRandGaussian(void);
+   double dGetRandGaussPos(double const, double const);
+   int nGetRandPoisson(double const);
+};
+#endif         // __RAND_STREAM_H__
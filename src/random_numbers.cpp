@@ -17,6 +17,7 @@ You should have received a copy of the GNU General Public License along with thi
 
 #include "rg.h"
 #include "simulation.h"
+#include "rand_stream.h"
 
 /*=========================================================================================================================================
 
@@ -55,6 +56,8 @@ Update: November 2002
 
 There was a bug in the correction to the seeding procedure for s2. It affected the following seeds 254679140 1264751179 1519430319 2274823218 2529502358 3284895257 3539574397 (s2 < 8).
 
+The Tausworthe generators are sequential, so every random number depends on all those drawn before it. If m_bCounterBasedRand is set, then rainfall, run-on and flow velocity initialization instead use counter-based streams (see rand_stream.cpp) keyed by the seed, the process, the iteration, and the cell or drop index. These can be used in parallel, and give the same results whatever the number of threads. The Tausworthe generators are the default, and reproduce the sequences of earlier versions of RillGrow.
+
 =========================================================================================================================================*/
 //=========================================================================================================================================
 //! Returns a random number generated by the maximally equidistributed combined Tausworthe algorithm. This random number generator is used for rainfall
@@ -225,11 +228,9 @@ unsigned long CSimulation::ulGetLCG(const unsigned long ulN)
 //=========================================================================================================================================
 double CSimulation::dGetRand0Gaussian(void)
 {
-   static int snSet = 0;
-   static double sdGset;
    double dRet;
 
-   if (0 == snSet)                              // We don't have an extra deviate handy, so
+   if (! m_bHaveRand0GaussianSpare)             // We don't have an extra deviate handy, so
    {
       double dFac, dRsq, dV1, dV2;
 
@@ -245,19 +246,45 @@ double CSimulation::dGetRand0Gaussian(void)
       dFac = sqrt(-2 * log(dRsq)/dRsq);
 
       // Now make the Box-Muller transformation to get two normal deviates, return one and save the other for next time
-      sdGset = dV1 * dFac;
-      snSet = 1;                                // Set flag
+      m_dRand0GaussianSpare = dV1 * dFac;
+      m_bHaveRand0GaussianSpare = true;         // Set flag
       dRet = dV2 * dFac;
    }
    else
    {
-      snSet = 0;                                // We have an extra deviate handy so unset the flag and return it
-      dRet = sdGset;
+      m_bHaveRand0GaussianSpare = false;        // We have an extra deviate handy so unset the flag and return it
+      dRet = m_dRand0GaussianSpare;
    }
 
    return (dRet);
 }
 
+//=========================================================================================================================================
+//! Returns the counter-based random number stream for a process (one of the RAND_STREAM constants) during this iteration, and for a cell or drop index
+//=========================================================================================================================================
+CRandStream CSimulation::RandStream(int const nProcess, unsigned long const ulIndex) const
+{
+   return CRandStream(m_ulRandSeed[0], nProcess, m_ulIter, ulIndex);
+}
+
+//=========================================================================================================================================
+//! Returns two random doubles drawn from a unit Gaussian distribution, needed for cell surface water initialisation. With counter-based random numbers these depend only on the process (one of the RAND_STREAM constants), the iteration and the cell, so this may be called in parallel; otherwise the Tausworthe generator used for rainfall is used
+//=========================================================================================================================================
+void CSimulation::GetRandGaussianPair(int const nProcess, int const nCell, double& dFirst, double& dSecond)
+{
+   if (m_bCounterBasedRand)
+   {
+      CRandStream Rand = RandStream(nProcess, static_cast<unsigned long>(nCell));
+      dFirst = Rand.dGetRandGaussian();
+      dSecond = Rand.dGetRandGaussian();
+   }
+   else
+   {
+      dFirst = dGetRand0Gaussian();
+      dSecond = dGetRand0Gaussian();
+   }
+}
+
 
 #if defined RANDCHECK
 //=========================================================================================================================================
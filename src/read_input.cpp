@@ -1898,6 +1898,97 @@ bool CSimulation::bReadRunData(void)
          if (m_dG <= 0)
             strErr = "gravitational acceleration";
          break;
+
+         // ------------------------------------------------------------ Performance -----------------------------------------------------
+      case 77:
+         // Two-phase flow routing? This is optional
+         strRH = strToLower(&strRH);
+         if (strRH.find('y') != string::npos)
+            m_bTwoPhaseFlowRouting = true;
+         else if (strRH.find('n') != string::npos)
+            m_bTwoPhaseFlowRouting = false;
+         else
+            strErr = "two-phase flow routing switch";
+         break;
+
+      case 78:
+         // Number of threads, zero means let OpenMP decide. This is optional
+         m_nThreads = stoi(strRH);
+         if (m_nThreads < 0)
+            strErr = "number of threads must not be negative";
+         break;
+
+      case 79:
+         // Random number generator: 't' for the sequential Tausworthe generators (the default, reproduces earlier versions) or 'p' for counter-based Philox streams, which can be used in parallel. This is optional
+         strRH = strToLower(&strRH);
+         if (strRH.find('p') != string::npos)
+            m_bCounterBasedRand = true;
+         else if (strRH.find('t') != string::npos)
+            m_bCounterBasedRand = false;
+         else
+            strErr = "random number generator";
+         break;
+
+      case 80:
+         // Expected number of raindrops per active cell per iteration above which rain is aggregated per cell, zero means never. This is optional
+         m_dAggregateRainThreshold = stod(strRH);
+         if (m_dAggregateRainThreshold < 0)
+            strErr = "threshold for aggregated rain must not be negative";
+         break;
+
+      case 81:
+         // Maximum relative error of friction factors interpolated from lookup tables, zero means always use the exact formulas. This is optional
+         m_dFFTableMaxRelErr = stod(strRH);
+         if ((m_dFFTableMaxRelErr < 0) || (m_dFFTableMaxRelErr >= 1))
+            strErr = "maximum relative error of friction factor lookup tables must be zero or more, and less than one";
+         break;
+
+      case 82:
+         // Fast (vectorizable) approximations to exp(), log() and the cumulative Gaussian distribution in the sediment calculations? This is optional
+         strRH = strToLower(&strRH);
+         if (strRH.find('y') != string::npos)
+            m_bFastSedimentMath = true;
+         else if (strRH.find('n') != string::npos)
+            m_bFastSedimentMath = false;
+         else
+            strErr = "fast approximations for sediment calculations switch";
+         break;
+
+      case 83:
+         // Number of threads which write GIS files in the background, zero means the simulation waits while each GIS file is written. This is optional
+         m_nGISWriteThreads = stoi(strRH);
+         if (m_nGISWriteThreads < 0)
+            strErr = "number of background GIS writer threads must not be negative";
+         break;
+
+      case 84:
+         // GIS output layout: 's' for one file per data item per save (the default), 'b' for one multi-band file per save, or 't' for all saves stacked in one ENVI-format file. This is optional
+         strRH = strToLower(&strRH);
+         if (strRH.find('s') != string::npos)
+            m_nGISOutputLayout = GIS_LAYOUT_SEPARATE;
+         else if (strRH.find('b') != string::npos)
+            m_nGISOutputLayout = GIS_LAYOUT_MULTIBAND;
+         else if (strRH.find('t') != string::npos)
+            m_nGISOutputLayout = GIS_LAYOUT_TIME_STACK;
+         else
+            strErr = "GIS output layout";
+         break;
+
+      case 85:
+         // GDAL creation options for GIS output files, space separated, each NAME=VALUE (e.g. TILED=YES COMPRESS=ZSTD PREDICTOR=3 NUM_THREADS=ALL_CPUS for GeoTIFF). Blank means use the driver's defaults. These are checked against the options which the driver accepts, when the GIS output format is checked. This is optional
+         m_VstrGISCreationOptions = VstrSplit(&strRH, SPACE);
+         break;
+
+      case 86:
+         // Benchmark GIS output? If so, the sizes of files written with different creation options, and the time taken to write them, are compared. This is optional
+         strRH = strToLower(&strRH);
+         if (strRH.find('y') != string::npos)
+            m_bGISBenchmark = true;
+         else if (strRH.find('n') != string::npos)
+            m_bGISBenchmark = false;
+         else
+            strErr = "GIS benchmark switch";
+         break;
       }
 
       // Did an error occur?
@@ -71,6 +71,10 @@ using std::to_string;
 #include <gdal_priv.h>
 #include <cpl_string.h>
 
+#if defined _OPENMP
+   #include <omp.h>
+#endif
+
 #ifdef _DEBUG
    #define DEBUG_SEDLOAD(x) DEBUGShowSedLoad(x);
 #else
@@ -219,12 +223,37 @@ int const      CALC_SLUMP_INTERVAL                          = 10;
 int const      CALC_HEADCUT_RETREAT_INTERVAL                = 7;                 // Number of iterations between headcut retreat calculations
 int const      OUTPUT_WIDTH                                 = 90;                // Width of rh bit of .out file, wrap after this
 int const      MAX_RECURSION_DEPTH                          = 100;               // Is a safety device, to prevent extreme recursion devouring all memory
+int const      GRID_STORE_ALIGNMENT                         = 64;                // Alignment (in bytes) of each per-field array in the grid store, is one cache line
+int const      ACTIVE_LIST_CHUNK                            = 256;               // Number of consecutive cells from an activity list which are dealt with together, when the list is shared between threads
+
+// Processes which use counter-based random number streams: each has a separate stream per iteration and per cell or drop
+int const      RAND_STREAM_RAIN_DROPS                       = 1;                 // Number of raindrops
+int const      RAND_STREAM_RAIN                             = 2;                 // Position and depth of a raindrop
+int const      RAND_STREAM_RUNON                            = 3;                 // Run-on from an edge
+int const      RAND_STREAM_WETTING_VELOCITY                 = 4;                 // Flow velocity of a cell which has just become wet
+int const      RAND_STREAM_FLOW_VELOCITY                    = 5;                 // Flow velocity of a cell which has no outflow
+int const      RAND_STREAM_RAIN_CELL                        = 6;                 // Summed volume of the raindrops on a cell, for aggregated rain
+int const      RAND_STREAM_RAIN_COUNT                       = 7;                 // Number of raindrops on a cell, for aggregated rain
+int const      RAIN_DROP_BATCH                              = 4096;              // Number of raindrops whose random numbers are generated together
+int const      FF_TABLE_MIN_NODES_PER_OCTAVE                = 4;                 // Number of nodes per octave with which friction factor lookup tables are first tried, must be a power of two
+int const      FF_TABLE_MAX_NODES                           = 4194304;           // Maximum total number of nodes in a friction factor lookup table
+int const      SPLASH_EFF_TABLE_INTERVALS                   = 4096;              // Number of equal water depth intervals in the splash efficiency lookup table, which goes from zero to the largest depth in the splash attenuation file
+int const      SSS_KERNEL_MAX_JACOBI_SWEEPS                 = 100;               // Maximum number of sweeps when finding the eigenvectors of the soil shear stress spreading kernel
+int const      SPLASH_EFF_CHECK_SAMPLES                     = 16;                // Number of depths per splash efficiency table interval at which the table is compared with the cubic spline, in check mode
+int const      GIS_WRITE_QUEUE_MAX                          = 8;                 // Number of pooled GIS buffers, in addition to one per data item in a save. When all are filled and waiting for a background writer thread, the simulation waits
 
 // TODO does this still work on 64-bit platforms?
 const unsigned long  MASK                                   = 0xfffffffful;
 
 double const   NODATA                                       = -9999;
 double const   PI                                           = 3.141592653589793238462643;
+double const   RAND_UINT32_SCALE                            = 2.3283064365386963e-10;  // 1 / 2**32
+double const   SENTINEL_TOP_ELEV                            = DBL_MAX;           // Top elevation of halo and missing-value cells in the sentinel copy of the top elevation, so they are never downhill
+double const   FF_TABLE_CHENG_RE_MIN                        = 1;                 // Smallest Reynolds' number in the Cheng friction factor table, must be a power of two
+double const   FF_TABLE_CHENG_REL_ROUGHNESS_MIN             = 1;                 // Smallest relative roughness (hydraulic diameter / roughness height) in the Cheng table, must be a power of two. The formula has a singularity at 1 / 3.7
+double const   FF_TABLE_LAWRENCE_LAMBDA_MIN                 = 8;                 // Smallest lambda in the Lawrence friction factor table, must be a power of two. Only well-inundated flow (lambda > 10) uses the table
+double const   FF_TABLE_MAX_DEPTH                           = 1000;              // In mm. Largest water depth (and hydraulic radius) covered by the friction factor tables, outside them the exact formulas are used
+double const   SSS_KERNEL_MAX_ERR                           = 1e-3;              // Largest error (relative to the central weight) of any weight in the separable approximation to the soil shear stress spreading kernel
 double const   INIT_MAX_SPEED_GUESS                         = 10;                // mm/sec
 double const   COURANT_ALPHA                                = 0.95;              // i.e. 5% margin
 double const   TOLERANCE                                    = 1e-10;              // In mm. If too small (e.g. 1e-10), get spurious "rounding" errors
@@ -287,11 +316,46 @@ int const      DIRECTION_BOTTOM_LEFT                        = 5;
 int const      DIRECTION_LEFT                               = 6;
 int const      DIRECTION_TOP_LEFT                           = 7;
 
+// The order in which the eight neighbours of a cell are searched, e.g. for the steepest downhill gradient. Since only a strictly steeper neighbour replaces the steepest so far, this order decides ties
+int const      NEIGHBOUR_SEARCH_ORDER[8]                    = {DIRECTION_BOTTOM, DIRECTION_BOTTOM_RIGHT, DIRECTION_BOTTOM_LEFT, DIRECTION_RIGHT, DIRECTION_LEFT, DIRECTION_TOP_RIGHT, DIRECTION_TOP_LEFT, DIRECTION_TOP};
+
 int const      Z_UNIT_NONE                                  = -1;
 int const      Z_UNIT_MM                                    = 0;
 int const      Z_UNIT_CM                                    = 1;
 int const      Z_UNIT_M                                     = 2;
 
+int const      GIS_LAYOUT_SEPARATE                          = 0;                 // One GIS file per data item per save
+int const      GIS_LAYOUT_MULTIBAND                         = 1;                 // One multi-band GIS file per save
+int const      GIS_LAYOUT_TIME_STACK                        = 2;                 // All saves in one ENVI-format file
+
+// Slots for the per-cell values which are summed into the whole-grid end-of-iteration totals
+int const      EOI_RAIN                                     = 0;
+int const      EOI_RUNON                                    = 1;
+int const      EOI_SOIL_WATER                               = 2;
+int const      EOI_INFILT                                   = 3;
+int const      EOI_EXFILT                                   = 4;
+int const      EOI_SURFACE_WATER_OFF_EDGE                   = 5;
+int const      EOI_SURFACE_WATER                            = 6;
+int const      EOI_CLAY_SED_LOAD                            = 7;                 // Clay, silt and sand are always consecutive
+int const      EOI_SILT_SED_LOAD                            = 8;
+int const      EOI_SAND_SED_LOAD                            = 9;
+int const      EOI_ELEV                                     = 10;
+int const      EOI_CLAY_FLOW_DETACH                         = 11;
+int const      EOI_CLAY_SPLASH_DETACH                       = 14;
+int const      EOI_CLAY_SLUMP_DETACH                        = 17;
+int const      EOI_CLAY_TOPPLE_DETACH                       = 20;
+int const      EOI_CLAY_FLOW_DEPOSIT                        = 23;
+int const      EOI_CLAY_SPLASH_DEPOSIT                      = 26;
+int const      EOI_CLAY_SLUMP_DEPOSIT                       = 29;
+int const      EOI_CLAY_TOPPLE_DEPOSIT                      = 32;
+int const      EOI_CLAY_INFILT_DEPOSIT                      = 35;
+int const      EOI_CLAY_SED_OFF_EDGE                        = 38;
+int const      EOI_CLAY_SPLASH_OFF_EDGE                     = 41;
+int const      EOI_CLAY_NET_DETACH                          = 44;
+int const      EOI_NUM_TOTALS                               = 47;
+int const      EOI_SILT                                     = 1;                 // Offset from the clay slot
+int const      EOI_SAND                                     = 2;
+
 string const   FRICTION_FACTOR_CHECK                        = "friction_factor_check";
 string const   SPLASH_ATTENUATION_CHECK                      = "splash_efficiency_check";
 
@@ -407,6 +471,15 @@ string const   GIS_CUMUL_ALL_PROC_SURF_LOWER_CODE           = "c_lowerall";
 
 string const   GIS_CUMUL_BINARY_HEADCUT_RETREAT_FILENAME    = "headcut_retreat";
 
+string const   GIS_MULTIBAND_FILENAME                       = "all_items";
+string const   GIS_TIME_STACK_FILENAME                      = "time_stack";
+string const   GIS_TIME_STACK_DATA_EXT                      = ".bsq";
+string const   GIS_TIME_STACK_HEADER_EXT                    = ".hdr";
+string const   GIS_TIME_STACK_INDEX_SUFFIX                  = "_index.csv";
+string const   GIS_SAVE_INDEX_FILENAME                      = "gis_save_index.csv";
+string const   GIS_BENCHMARK_FILENAME                       = "gis_benchmark";
+string const   GIS_BENCHMARK_CREATION_OPTIONS               = "COMPRESS=LZW PREDICTOR=3;COMPRESS=DEFLATE PREDICTOR=3;COMPRESS=ZSTD PREDICTOR=3;TILED=YES COMPRESS=ZSTD PREDICTOR=3;TILED=YES COMPRESS=ZSTD PREDICTOR=3 NUM_THREADS=ALL_CPUS";     // Sets of GDAL creation options, separated by semicolons, which are compared in benchmark mode if the output driver accepts them
+
 int const     GIS_ELEVATION                                 = 1;
 string const  GIS_ELEVATION_TITLE                           = "Elevation";
 int const     GIS_DETREND_ELEVATION                         = 2;
@@ -634,6 +707,15 @@ bool bFpEQ(const T d1, const T d2, const T dEpsilon)
 #pragma GCC diagnostic pop
 }
 
+//==============================================================================================================================
+// For checking that two floating-point numbers are bit-for-bit identical, e.g. when two ways of calculating a value must give exactly the same result
+//==============================================================================================================================
+template <class T>
+bool bFpBitEQ(const T d1, const T d2)
+{
+   return (memcmp(&d1, &d2, sizeof(T)) == 0);
+}
+
 //==============================================================================================================================
 // For greater-than comparison of two floating-point numbers, with a specified accuracy. This is "definitelyGreaterThan" from https://stackoverflow.com/questions/17333/how-do-you-compare-float-and-double-while-accounting-for-precision-loss, which is derived from Knuth, D. E. The Art of Computer Programming. Volume 2. Seminumerical Algorithms (Third Edition). Reading MA: Addison-Wesley Longman, 1997.
 //==============================================================================================================================
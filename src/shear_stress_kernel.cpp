@@ -0,0 +1,335 @@
+/*=========================================================================================================================================
+
+This is shear_stress_kernel.cpp: implementations of the RillGrow class which spreads soil shear stress over a patch of cells, for slumping
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <cmath>
+
+#include "rg.h"
+#include "shear_stress_kernel.h"
+
+/*=========================================================================================================================================
+
+When slumping is simulated, the shear stress of flow on each cell is spread over a patch of surrounding cells, using weights which decrease linearly with distance from the cell. This is the same as convolving the (unspread) shear stress field with a kernel of these weights. The shear stress is accumulated during flow routing, and the convolution is done once per slump interval for the whole grid, rather than the patch being added once per eroding cell.
+
+The kernel is radially symmetric, so is not separable. However, it is a symmetric matrix, so it may be written as the sum of terms of the form (eigenvalue * v * transpose(v)), where v is an eigenvector. Each term is separable, i.e. may be applied as a convolution along columns then a convolution along rows. Terms with small eigenvalues contribute little, so they are dropped: terms are added in order of decreasing eigenvalue magnitude until no weight differs from that of the kernel by more than the maximum error (relative to the central weight) asked for. For a kernel of width w, direct convolution takes one multiply-add per cell for each non-zero weight (about 0.8 * w * w), while n separable terms take 2 * n * w. If the separable approximation would not be cheaper, the kernel is applied directly, without error.
+
+=========================================================================================================================================*/
+
+//! This file-local function finds the eigenvalues and eigenvectors of the symmetric nSize x nSize matrix in VdA, using the cyclic Jacobi method. VdA is overwritten. On return, VdEigenvalue holds the eigenvalues, and column i of VdEigenvector (i.e. elements [i * nSize] to [(i * nSize) + nSize - 1]) holds the eigenvector of eigenvalue i
+static void FindEigenvectors(vector<double>& VdA, int const nSize, vector<double>& VdEigenvalue, vector<double>& VdEigenvector)
+{
+   VdEigenvector.assign(nSize * nSize, 0);
+   for (int i = 0; i < nSize; i++)
+      VdEigenvector[(i * nSize) + i] = 1;
+
+   for (int nSweep = 0; nSweep < SSS_KERNEL_MAX_JACOBI_SWEEPS; nSweep++)
+   {
+      // Stop when the off-diagonal elements are negligible compared with the diagonal elements
+      double
+         dOff = 0,
+         dDiag = 0;
+      for (int i = 0; i < nSize; i++)
+      {
+         dDiag += VdA[(i * nSize) + i] * VdA[(i * nSize) + i];
+         for (int j = i+1; j < nSize; j++)
+            dOff += VdA[(i * nSize) + j] * VdA[(i * nSize) + j];
+      }
+
+      if (dOff <= (1e-30 * dDiag))
+         break;
+
+      for (int p = 0; p < nSize-1; p++)
+      {
+         for (int q = p+1; q < nSize; q++)
+         {
+            double dApq = VdA[(p * nSize) + q];
+            if (bFpEQ(dApq, 0.0, TOLERANCE))
+               continue;
+
+            // Find the rotation which zeroes A[p][q]
+            double
+               dTheta = (VdA[(q * nSize) + q] - VdA[(p * nSize) + p]) / (2 * dApq),
+               dT = 1 / (fabs(dTheta) + sqrt((dTheta * dTheta) + 1));
+
+            if (dTheta < 0)
+               dT = -dT;
+
+            double
+               dC = 1 / sqrt((dT * dT) + 1),
+               dS = dT * dC;
+
+            // Apply the rotation to the columns, then the rows, of A, and to the columns of the eigenvector matrix
+            for (int k = 0; k < nSize; k++)
+            {
+               double
+                  dAkp = VdA[(k * nSize) + p],
+                  dAkq = VdA[(k * nSize) + q];
+
+               VdA[(k * nSize) + p] = (dC * dAkp) - (dS * dAkq);
+               VdA[(k * nSize) + q] = (dS * dAkp) + (dC * dAkq);
+            }
+
+            for (int k = 0; k < nSize; k++)
+            {
+               double
+                  dApk = VdA[(p * nSize) + k],
+                  dAqk = VdA[(q * nSize) + k];
+
+               VdA[(p * nSize) + k] = (dC * dApk) - (dS * dAqk);
+               VdA[(q * nSize) + k] = (dS * dApk) + (dC * dAqk);
+            }
+
+            for (int k = 0; k < nSize; k++)
+            {
+               double
+                  dVkp = VdEigenvector[(p * nSize) + k],
+                  dVkq = VdEigenvector[(q * nSize) + k];
+
+               VdEigenvector[(p * nSize) + k] = (dC * dVkp) - (dS * dVkq);
+               VdEigenvector[(q * nSize) + k] = (dS * dVkp) + (dC * dVkq);
+            }
+         }
+      }
+   }
+
+   VdEigenvalue.resize(nSize);
+   for (int i = 0; i < nSize; i++)
+      VdEigenvalue[i] = VdA[(i * nSize) + i];
+}
+
+//! Constructor
+CShearStressKernel::CShearStressKernel(void)
+:
+   m_nWidth(0),
+   m_nTerms(0),
+   m_nXGridMax(0),
+   m_nYGridMax(0),
+   m_dMeasuredErr(0)
+{
+}
+
+//! Adds dWeight times the column pdFrom, shifted down by nShift rows (i.e. row nY of pdTo gets row nY - nShift of pdFrom), to the column pdTo. Both columns have nLen rows, rows which are shifted out of the column are ignored
+void CShearStressKernel::AddShiftedColumn(double* pdTo, double const* pdFrom, int const nLen, int const nShift, double const dWeight)
+{
+   int
+      nFirst = tMax(0, nShift),
+      nLast = tMin(nLen, nLen + nShift);
+
+#if defined _OPENMP
+   #pragma omp simd
+#endif
+   for (int nY = nFirst; nY < nLast; nY++)
+      pdTo[nY] += dWeight * pdFrom[nY - nShift];
+}
+
+//! Makes the kernel from one quadrant of the weights (ppdQuadrant[m][n] is the weight of the cell m columns and n rows from the central cell, for m >= 1 and n >= 0, the other three quadrants are rotations of this one), then finds its separable approximation, for a grid of nXMax x nYMax cells
+void CShearStressKernel::Init(double const* const* ppdQuadrant, int const nQuadrantSize, int const nXMax, int const nYMax, double const dMaxErr)
+{
+   m_nXGridMax = nXMax;
+   m_nYGridMax = nYMax;
+   m_nWidth = (2 * nQuadrantSize) - 1;
+
+   int nCentre = nQuadrantSize - 1;
+
+   m_VdKernel.assign(m_nWidth * m_nWidth, 0);
+   m_VdKernel[(nCentre * m_nWidth) + nCentre] = ppdQuadrant[0][0];
+
+   for (int m = 1; m < nQuadrantSize; m++)
+   {
+      for (int n = 0; n < nQuadrantSize; n++)
+      {
+         double dWeight = ppdQuadrant[m][n];
+
+         m_VdKernel[((nCentre + m) * m_nWidth) + nCentre + n] =
+         m_VdKernel[((nCentre - m) * m_nWidth) + nCentre - n] =
+         m_VdKernel[((nCentre + n) * m_nWidth) + nCentre - m] =
+         m_VdKernel[((nCentre - n) * m_nWidth) + nCentre + m] = dWeight;
+      }
+   }
+
+   m_VdSpread.assign(nXMax * nYMax, 0);
+
+   // Now find the separable approximation. Sort the eigenvalues by decreasing magnitude
+   vector<double> VdA = m_VdKernel;
+   vector<double> VdEigenvalue, VdEigenvector;
+   FindEigenvectors(VdA, m_nWidth, VdEigenvalue, VdEigenvector);
+
+   vector<int> VnOrder(m_nWidth);
+   for (int i = 0; i < m_nWidth; i++)
+      VnOrder[i] = i;
+
+   for (int i = 1; i < m_nWidth; i++)
+   {
+      for (int j = i; (j > 0) && (fabs(VdEigenvalue[VnOrder[j]]) > fabs(VdEigenvalue[VnOrder[j-1]])); j--)
+      {
+         int nTmp = VnOrder[j];
+         VnOrder[j] = VnOrder[j-1];
+         VnOrder[j-1] = nTmp;
+      }
+   }
+
+   // Add terms until the approximation is close enough, or until it would be no cheaper than direct convolution (which uses only the non-zero weights)
+   m_VnNonZeroTap.clear();
+   for (int i = 0; i < m_nWidth * m_nWidth; i++)
+   {
+      if (! bFpEQ(m_VdKernel[i], 0.0, TOLERANCE))
+         m_VnNonZeroTap.push_back(i);
+   }
+
+   int nNonZero = static_cast<int>(m_VnNonZeroTap.size());
+
+   double dMaxAbsErr = dMaxErr * m_VdKernel[(nCentre * m_nWidth) + nCentre];
+   vector<double> VdApprox(m_nWidth * m_nWidth, 0);
+
+   m_nTerms = 0;
+   m_VdTermWeight.clear();
+   m_VdTermVector.clear();
+
+   for (int nTerm = 0; (2 * (nTerm + 1) * m_nWidth) < nNonZero; nTerm++)
+   {
+      int nEigen = VnOrder[nTerm];
+      double dEigenvalue = VdEigenvalue[nEigen];
+      double const* pdVector = &VdEigenvector[nEigen * m_nWidth];
+
+      m_VdTermWeight.push_back(dEigenvalue);
+      m_VdTermVector.insert(m_VdTermVector.end(), pdVector, pdVector + m_nWidth);
+
+      double dErr = 0;
+      for (int i = 0; i < m_nWidth; i++)
+      {
+         for (int j = 0; j < m_nWidth; j++)
+         {
+            VdApprox[(i * m_nWidth) + j] += dEigenvalue * pdVector[i] * pdVector[j];
+            dErr = tMax(dErr, fabs(VdApprox[(i * m_nWidth) + j] - m_VdKernel[(i * m_nWidth) + j]));
+         }
+      }
+
+      if (dErr <= dMaxAbsErr)
+      {
+         m_nTerms = nTerm + 1;
+         m_dMeasuredErr = dErr / m_VdKernel[(nCentre * m_nWidth) + nCentre];
+         break;
+      }
+   }
+
+   if (m_nTerms > 0)
+   {
+      m_VdTermWeight.resize(m_nTerms);
+      m_VdTermVector.resize(m_nTerms * m_nWidth);
+      m_VdWork.assign(nXMax * nYMax, 0);
+   }
+   else
+   {
+      // Direct convolution is no more expensive, and is exact
+      m_VdTermWeight.clear();
+      m_VdTermVector.clear();
+      m_dMeasuredErr = 0;
+   }
+}
+
+//! Spreads the shear stress field pdIn over the grid, i.e. convolves it with the kernel. Column nX of pdIn starts at pdIn + (nX * nInStride), and its rows are contiguous. The result can then be read using dGetSpread(). Cells outside the grid contribute nothing, and contributions to cells outside the grid are lost
+void CShearStressKernel::Spread(double const* pdIn, int const nInStride)
+{
+   int
+      nCentre = m_nWidth / 2,
+      nXMax = m_nXGridMax,
+      nYMax = m_nYGridMax;
+
+   m_VdSpread.assign(nXMax * nYMax, 0);
+
+   if (m_nTerms == 0)
+   {
+      // Direct convolution, with only the non-zero weights. Each column of the result depends only on the input, so columns are done in parallel
+      int nTaps = static_cast<int>(m_VnNonZeroTap.size());
+
+#if defined _OPENMP
+      #pragma omp parallel for schedule(static)
+#endif
+      for (int nX = 0; nX < nXMax; nX++)
+      {
+         double* pdOut = &m_VdSpread[nX * nYMax];
+
+         for (int k = 0; k < nTaps; k++)
+         {
+            int
+               nTap = m_VnNonZeroTap[k],
+               i = nTap / m_nWidth,
+               j = nTap % m_nWidth,
+               nXFrom = nX - (i - nCentre);
+
+            if ((nXFrom >= 0) && (nXFrom < nXMax))
+               AddShiftedColumn(pdOut, pdIn + (nXFrom * nInStride), nYMax, j - nCentre, m_VdKernel[nTap]);
+         }
+      }
+
+      return;
+   }
+
+   // Separable convolution, one term at a time
+   for (int nTerm = 0; nTerm < m_nTerms; nTerm++)
+   {
+      double const* pdVector = &m_VdTermVector[nTerm * m_nWidth];
+      double dEigenvalue = m_VdTermWeight[nTerm];
+
+      // First convolve each column with the eigenvector
+#if defined _OPENMP
+      #pragma omp parallel for schedule(static)
+#endif
+      for (int nX = 0; nX < nXMax; nX++)
+      {
+         double* pdWork = &m_VdWork[nX * nYMax];
+         double const* pdFrom = pdIn + (nX * nInStride);
+
+         for (int nY = 0; nY < nYMax; nY++)
+            pdWork[nY] = 0;
+
+         for (int j = 0; j < m_nWidth; j++)
+            AddShiftedColumn(pdWork, pdFrom, nYMax, j - nCentre, pdVector[j]);
+      }
+
+      // Then convolve each row of this with the eigenvector, weighted by the eigenvalue, and add to the result
+#if defined _OPENMP
+      #pragma omp parallel for schedule(static)
+#endif
+      for (int nX = 0; nX < nXMax; nX++)
+      {
+         double* pdOut = &m_VdSpread[nX * nYMax];
+
+         for (int i = 0; i < m_nWidth; i++)
+         {
+            int nXFrom = nX - (i - nCentre);
+            if ((nXFrom >= 0) && (nXFrom < nXMax))
+               AddShiftedColumn(pdOut, &m_VdWork[nXFrom * nYMax], nYMax, 0, dEigenvalue * pdVector[i]);
+         }
+      }
+   }
+}
+
+//! Returns the number of cells in each row and column of the kernel
+int CShearStressKernel::nGetWidth(void) const
+{
+   return m_nWidth;
+}
+
+//! Returns the number of separable terms used to approximate the kernel, or zero if the kernel is applied directly
+int CShearStressKernel::nGetNumTerms(void) const
+{
+   return m_nTerms;
+}
+
+//! Returns the maximum error of the separable approximation, relative to the central weight of the kernel
+double CShearStressKernel::dGetMeasuredErr(void) const
+{
+   return m_dMeasuredErr;
+}
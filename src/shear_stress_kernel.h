@@ -0,0 +1,75 @@
+#ifndef __SHEAR_STRESS_KERNEL_H__
+   #define __SHEAR_STRESS_KERNEL_H__
+/*=========================================================================================================================================
+
+This is shear_stress_kernel.h: declaration for the RillGrow class which spreads soil shear stress over a patch of cells, for slumping
+
+Copyright (C) 2025 David Favis-Mortlock
+
+==========================================================================================================================================
+
+This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation; either version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+=========================================================================================================================================*/
+#include <vector>
+using std::vector;
+
+class CShearStressKernel
+{
+private:
+   //! The number of cells in each row and column of the kernel, is always odd
+   int m_nWidth;
+
+   //! The number of separable terms used to approximate the kernel, or zero if the kernel is applied directly
+   int m_nTerms;
+
+   //! The number of columns in the grid
+   int m_nXGridMax;
+
+   //! The number of rows in the grid
+   int m_nYGridMax;
+
+   //! The maximum difference between the weights of the separable approximation and those of the kernel, relative to the central weight, as measured when the approximation was made
+   double m_dMeasuredErr;
+
+   //! The weight of each cell in the kernel. This is column-major, i.e. all rows of the leftmost column, then all rows of the next column, etc.
+   vector<double> m_VdKernel;
+
+   //! The position in m_VdKernel of each non-zero weight, in the same order
+   vector<int> m_VnNonZeroTap;
+
+   //! The eigenvalue of each separable term
+   vector<double> m_VdTermWeight;
+
+   //! The eigenvector of each separable term, i.e. all m_nWidth values for the first term, then all values for the next term, etc.
+   vector<double> m_VdTermVector;
+
+   //! The spread shear stress of each cell in the grid, as calculated by Spread(). This is column-major, with no halo
+   vector<double> m_VdSpread;
+
+   //! Workspace for Spread(), with the same layout as m_VdSpread
+   vector<double> m_VdWork;
+
+   static void AddShiftedColumn(double*, double const*, int const, int const, double const);
+
+public:
+   CShearStressKernel(void);
+
+   void Init(double const* const*, int const, int const, int const, double const);
+   void Spread(double const*, int const);
+
+   int nGetWidth(void) const;
+   int nGetNumTerms(void) const;
+   double dGetMeasuredErr(void) const;
+
+   //! Returns the spread shear stress of the cell at nX, nY, as last calculated by Spread()
+   inline double dGetSpread(int const nX, int const nY) const
+   {
+      return m_VdSpread[(nX * m_nYGridMax) + nY];
+   }
+};
+#endif         // __SHEAR_STRESS_KERNEL_H__
@@ -17,6 +17,10 @@ You should have received a copy of the GNU General Public License along with thi
 #include "simulation.h"
 #include "2d_vec.h"
 #include "cell.h"
+#include "grid_store.h"
+#include "friction_factor_table.h"
+#include "shear_stress_kernel.h"
+#include "gis_writer.h"
 
 //=========================================================================================================================================
 //! The CSimulation constructor
@@ -94,6 +98,7 @@ CSimulation::CSimulation(void)
    m_bDoSedLoadDepositTS      = false;
    m_bSoilWaterTS             = false;
    m_bSaveGISThisIter         = false;
+   m_bCellsReadyForIter       = false;
    m_bThisIterRainChange      = false;
    m_bHaveBaseLevel           = false;
    m_bOutDEMsUsingInputZUnits = false;
@@ -104,10 +109,14 @@ CSimulation::CSimulation(void)
    m_bFrictionFactorLawrence  = false;
    m_bFrictionFactorCheng     = false;
    m_bLostSave                = false;
-   m_bSplashForward           = false;
    m_bSettlingEqnCheng        = false;
    m_bSettlingEqnFergusonChurch = false;
    m_bSettlingEqnStokesBudryckRittinger = false;
+   m_bTwoPhaseFlowRouting     = false;
+   m_bCounterBasedRand        = false;
+   m_bFastSedimentMath        = false;
+   m_bGISBenchmark            = false;
+   m_bHaveRand0GaussianSpare  = false;
 
    for (int n = 0; n < 4; n++)
    {
@@ -128,6 +137,9 @@ CSimulation::CSimulation(void)
    m_nInfiltCount             = 0;
    m_nSlumpCount              = 0;
    m_nHeadcutRetreatCount     = 0;
+   m_nThreads                 = 0;
+   m_nGISWriteThreads         = 1;
+   m_nGISOutputLayout         = GIS_LAYOUT_SEPARATE;
    m_nZUnits                  = Z_UNIT_NONE;
 
    m_ulIter                   = 0;
@@ -167,6 +179,9 @@ CSimulation::CSimulation(void)
    m_dPartKE                        = 0;
    m_dSplashConstant                = 0;
    m_dSplashConstantNormalized      = 0;
+   m_dSplashEffTableDepthMax        = 0;
+   m_dSplashEffTableInvSpacing      = 0;
+   m_dSplashEffDry                  = 0;
    m_dPoesenSplashConstant          = 0;
    m_dPlanchonCellSizeKC            = 0;
    m_dMeanCellWaterVol              = 0;
@@ -178,6 +193,11 @@ CSimulation::CSimulation(void)
    m_dCellSquare                    = 0;
    m_dInvCellSquare                 = 0;
    m_dInvXGridMax                   = 0;
+
+   for (int n = 0; n < 8; n++)
+      m_dDirHLen[n] =
+      m_dInvDirHLen[n] = 0;
+
    m_dRho                           = 0;
    m_dG                             = 0;
    m_dNu                            = 0;
@@ -205,11 +225,8 @@ CSimulation::CSimulation(void)
    m_dToppleAngleOfRestDiffDiag     = 0;
    m_dEndOfIterTotSurfaceWater      = 0;
    m_dEndOfIterClaySedLoad          = 0;
-   m_dEndOfIterClaySedLoadKahanCorrection = 0;
    m_dEndOfIterSiltSedLoad          = 0;
-   m_dEndOfIterSiltSedLoadKahanCorrection = 0;
    m_dEndOfIterSandSedLoad          = 0;
-   m_dEndOfIterSandSedLoadKahanCorrection = 0;
    m_dEndOfIterRain                 = 0;
    m_dEndOfIterRunOn                = 0;
    m_dEndOfIterKE                   = 0;
@@ -353,6 +370,10 @@ CSimulation::CSimulation(void)
    m_dRunOnRainVarM                 =
    m_dRainVarMFileMean              = 1;
 
+   m_dAggregateRainThreshold        =
+   m_dRainAliasMeanRainVarM         =
+   m_dFFTableMaxRelErr              = 0;
+
    m_dMissingValue                  = NODATA;
 
    m_ldGTotDrops                    =
@@ -388,11 +409,17 @@ CSimulation::CSimulation(void)
       m_ulRState[i].s3 = 0;
    }
 
+   m_dRand0GaussianSpare = 0;
+
    m_tSysStartTime =
    m_tSysEndTime   = 0;
 
    m_Cell = NULL;
+   m_pGrid = NULL;
+   m_pFFTable = NULL;
    m_SSSWeightQuadrant= NULL;
+   m_pSSSKernel = NULL;
+   m_pGISWriter = NULL;
 }
 
 //=========================================================================================================================================
@@ -471,18 +498,32 @@ CSimulation::~CSimulation(void)
       delete [] m_Cell;
    }
 
+   if (m_pGrid)
+      delete m_pGrid;
+
+   if (m_pFFTable)
+      delete m_pFFTable;
+
    if (m_SSSWeightQuadrant)
    {
       for (int nX = 0; nX < m_nSSSQuadrantSize; nX++)
          delete [] m_SSSWeightQuadrant[nX];
       delete [] m_SSSWeightQuadrant;
    }
+
+   if (m_pSSSKernel)
+      delete m_pSSSKernel;
+
+   // This waits for any GIS files which are still being written
+   if (m_pGISWriter)
+      delete m_pGISWriter;
 }
 
 //=========================================================================================================================================
 //! Within-file static member variable initialisations
 //=========================================================================================================================================
 CSimulation* CCell::m_pSim = NULL;                          // Initialize m_pSim, the static member of CCell
+CGridStore* CCell::m_pGrid = NULL;                          // Initialize m_pGrid, the other static member of CCell
 CSimulation* CCellSoil::m_pSim = NULL;                      // Ditto for the CCellSoil class
 CSimulation* CCellRainAndRunon::m_pSim = NULL;              // Ditto for the CCellRainAndRunon class
 CSimulation* CCellSurfaceWater::m_pSim = NULL;              // Ditto for the CCellSurfaceWater class
@@ -523,6 +564,12 @@ int CSimulation::nDoSetUpRun(int nArg, char* pcArgv[])
    if (! bReadRunData())
       return (RTN_ERR_RUNDATA);
 
+#if defined _OPENMP
+   // If the number of threads was specified, use it; otherwise let OpenMP decide
+   if (m_nThreads > 0)
+      omp_set_num_threads(m_nThreads);
+#endif
+
    // Open log file
    if (! bOpenLogFile())
       return (RTN_ERR_LOGFILE);
@@ -553,7 +600,13 @@ int CSimulation::nDoSetUpRun(int nArg, char* pcArgv[])
    // Mark edge cells
    MarkEdgeCells();
 
-   // Create soil layers
+   // Create the grid store's per-layer arrays, then create the soil layers
+   if (! m_pGrid->bAllocateLayers(m_nNumSoilLayers))
+   {
+      // Error, can't allocate memory
+      cerr << ERR << "cannot allocate memory for " << m_nNumSoilLayers << " soil layers in grid store" << endl;
+      return (RTN_ERR_MEMALLOC);
+   }
    CreateSoilLayers();
 
    // If we are simulating infiltration, then create the this-operation and time series soil water variables
@@ -592,6 +645,15 @@ int CSimulation::nDoSetUpRun(int nArg, char* pcArgv[])
    m_dInvCellSquare = 1 / m_dCellSquare;                           // mm-2
    m_dCellDiag      = sqrt(2 * m_dCellSquare);                     // mm
    m_dInvCellDiag   = 1 / m_dCellDiag;                             // mm-1
+
+   for (int nDir = DIRECTION_TOP; nDir <= DIRECTION_TOP_LEFT; nDir++)
+   {
+      // The odd-numbered directions are the diagonals
+      bool bDiag = ((nDir % 2) == 1);
+      m_dDirHLen[nDir] = (bDiag ? m_dCellDiag : m_dCellSide);
+      m_dInvDirHLen[nDir] = (bDiag ? m_dInvCellDiag : m_dInvCellSide);
+   }
+
    m_dInvCos45      = 1 / cos(PI/4);
    m_dInvXGridMax   = 1 / static_cast<double>(m_nXGridMax);
 
@@ -621,6 +683,9 @@ int CSimulation::nDoSetUpRun(int nArg, char* pcArgv[])
 
    CalcSettlingSpeed();
 
+   // Make lookup tables of friction factors, if the user wants them
+   InitFrictionFactorTables();
+
    // If desired, output friction factor for checking
    if (m_bFFCheck)
       CheckLawrenceFF();
@@ -687,6 +752,49 @@ int CSimulation::nDoSetUpRun(int nArg, char* pcArgv[])
    // Write run details to Out and Log files
    WriteRunDetails();
 
+   // Create the object which writes GIS files, and start its writer threads (if any). There is a pooled buffer for each data item in a save, so all can be copied from the cell array in one pass, plus some more so the next save need not wait for every file to be written
+   vector<int> VnDataItem;
+   vector<string const*> VpstrTitle;
+   GetGISSaveItems(VnDataItem, VpstrTitle);
+   int nMaxItems = static_cast<int>(VnDataItem.size());
+
+   VnDataItem.clear();
+   VpstrTitle.clear();
+   GetGISEndItems(VnDataItem, VpstrTitle);
+   nMaxItems = tMax(nMaxItems, static_cast<int>(VnDataItem.size()));
+
+   m_pGISWriter = new CGISWriter;
+   m_pGISWriter->SetCreationOptions(m_VstrGISCreationOptions);
+   m_pGISWriter->Start(m_strGISOutFormat, m_strGDALDEMProjection, m_dGeoTransform, m_nXGridMax, m_nYGridMax, m_dMissingValue, m_nGISWriteThreads, nMaxItems + GIS_WRITE_QUEUE_MAX);
+
+   // If all saves are to be stacked in one file, create it now. Also create the index file, which lists every band written with its statistics
+   string strIndex = m_strOutputPath;
+   if (GIS_LAYOUT_TIME_STACK == m_nGISOutputLayout)
+   {
+      string strStack = m_strOutputPath;
+      strStack.append(GIS_TIME_STACK_FILENAME);
+
+      if (! m_pGISWriter->bOpenTimeStack(strStack + GIS_TIME_STACK_DATA_EXT, strStack + GIS_TIME_STACK_HEADER_EXT))
+      {
+         cerr << ERR << "cannot create GIS time stack " << strStack << GIS_TIME_STACK_DATA_EXT << endl;
+         return (RTN_ERR_GISFILEWRITE);
+      }
+
+      strIndex = strStack + GIS_TIME_STACK_INDEX_SUFFIX;
+   }
+   else
+      strIndex.append(GIS_SAVE_INDEX_FILENAME);
+
+   if (! m_pGISWriter->bOpenIndex(strIndex))
+   {
+      cerr << ERR << "cannot create GIS index file " << strIndex << endl;
+      return (RTN_ERR_GISFILEWRITE);
+   }
+
+   // In benchmark mode, compare the size and speed of GIS files written with different creation options
+   if (m_bGISBenchmark)
+      BenchmarkGISFormats();
+
    // ========================================================= Run simulation ===========================================================
    // Tell the user what is happening
    AnnounceIsRunning();
@@ -706,6 +814,10 @@ int CSimulation::nDoSetUpRun(int nArg, char* pcArgv[])
 #ifndef RANDCHECK
    // Calculate length of run, write in file
    CalcTime(m_dSimulationDuration);
+
+   // In benchmark mode, also report on the GIS output
+   if (m_bGISBenchmark)
+      WriteGISWriteStats();
 #endif
 
    // Calculate statistics re. memory usage etc.
@@ -729,12 +841,25 @@ int CSimulation::nDoSimulation(void)
    return (RTN_OK);
 #endif
 
+   vector<int> VnDataItem;
+   vector<string const*> VpstrTitle;
+
    // If requested, write an initial microtopography file (not detrended)
-   if (m_bInitElevSave && (! bWriteGISFileFloat(GIS_ELEVATION, &GIS_ELEVATION_TITLE)))
-      return (RTN_ERR_GISFILEWRITE);
+   if (m_bInitElevSave)
+   {
+      VnDataItem.push_back(GIS_ELEVATION);
+      VpstrTitle.push_back(&GIS_ELEVATION_TITLE);
+   }
 
    // If requested, write out the rainfall variation multiplier file
-   if ((m_bRainVarMSave) && (! bWriteGISFileFloat(GIS_RAIN_SPATIAL_VARIATION, &GIS_RAIN_SPATIAL_VARIATION_TITLE)))
+   if (m_bRainVarMSave)
+   {
+      VnDataItem.push_back(GIS_RAIN_SPATIAL_VARIATION);
+      VpstrTitle.push_back(&GIS_RAIN_SPATIAL_VARIATION_TITLE);
+   }
+
+   // These are written together, so that they are in the same file if saves are written as multi-band files
+   if ((! VnDataItem.empty()) && (! bWriteGISFiles(VnDataItem, VpstrTitle)))
       return (RTN_ERR_GISFILEWRITE);
 
    // ========================================================== The main loop ===========================================================
@@ -806,18 +931,22 @@ int CSimulation::nDoSimulation(void)
       m_dEndOfIterSiltSplashOffEdge    =
       m_dEndOfIterSandSplashOffEdge    = 0;
 
-      // Initialize all cells ready for this iteration
-      for (int nX = 0; nX < m_nXGridMax; nX++)
+      // Initialize all cells ready for this iteration, unless this was already done during the end-of-iteration pass of the previous iteration
+      if (! m_bCellsReadyForIter)
       {
-         for (int nY = 0; nY < m_nYGridMax; nY++)
+#if defined _OPENMP
+         #pragma omp parallel for schedule(static)
+#endif
+         for (int nX = 0; nX < m_nXGridMax; nX++)
          {
-            m_Cell[nX][nY].pGetRainAndRunon()->InitializeRainAndRunon();
-            m_Cell[nX][nY].pGetSurfaceWater()->InitializeFlow();
-            m_Cell[nX][nY].pGetSoilWater()->InitializeInfiltration();
-            m_Cell[nX][nY].pGetSoil()->InitializeDetachAndDeposit(m_bSlumpThisIter);
-            m_Cell[nX][nY].pGetSedLoad()->ResetSedLoad();
+            for (int nY = 0; nY < m_nYGridMax; nY++)
+               m_Cell[nX][nY].InitializeThisIter(m_bSlumpThisIter);
          }
       }
+      m_bCellsReadyForIter = false;
+
+      // No cell has had any rain yet during this iteration
+      m_pGrid->ClearRainHit();
 
       // If we are simulating infiltration then initialize for each soil layer
       if (m_bDoInfiltration)
@@ -918,6 +1047,9 @@ int CSimulation::nDoSimulation(void)
          // Yup, simulate slumping and toppling
          m_nSlumpCount = 0;
          m_bSlumpThisIter = true;
+
+         // First spread the shear stress of flow since the last slump calculation over the surrounding patches of cells
+         SpreadAllShearStress();
          DoAllSlump();
 
          // Reset for next time
@@ -960,26 +1092,26 @@ int CSimulation::nDoSimulation(void)
       m_dEndOfIterRunOn =
       m_dEndOfIterSurfaceWaterOffEdge = 0;
 
-      for (int nX = 0; nX < m_nXGridMax; nX++)
-      {
-         for (int nY = 0; nY < m_nYGridMax; nY++)
-         {
-            if (m_Cell[nX][nY].bIsMissingValue())
-               continue;
+#if defined _DEBUG
+      // Check that the stored soil surface and top surface elevations are still in step with the soil layers and surface water
+      DEBUGCheckSurfaceElevations();
+#endif
 
-            m_Cell[nX][nY].GetEndOfIterValues();
-         }
-      }
+      // See if we need to save the GIS files this iteration
+      m_bSaveGISThisIter = ((m_bSaveRegular && (m_dSimulatedTimeElapsed >= m_dRSaveTime) && (m_dSimulatedTimeElapsed < m_dSimulationDuration)) || (! m_bSaveRegular && (m_dSimulatedTimeElapsed >= m_VdSaveTime[m_nThisSave])));
 
-      // Now save results and do per-iteration book-keeping. First see if we need to save the GIS files now
-      m_bSaveGISThisIter = false;
-      if ((m_bSaveRegular && (m_dSimulatedTimeElapsed >= m_dRSaveTime) && (m_dSimulatedTimeElapsed < m_dSimulationDuration)) || (! m_bSaveRegular && (m_dSimulatedTimeElapsed >= m_VdSaveTime[m_nThisSave])))
-      {
-         // Yes, save the values from the cell array into GIS files
-         m_bSaveGISThisIter = true;
-         if (! bSaveGISFiles())
-            return (RTN_ERR_GISFILEWRITE);
-      }
+      // The this-iteration cell values are not needed again after the end-of-iteration totals have been calculated, unless they are to be saved as GIS files now, or this is the final iteration (the end-of-simulation GIS files are written from them). If neither, initialize the cells for the next iteration in the same pass which calculates the totals
+      m_bCellsReadyForIter = ((! m_bSaveGISThisIter) && (m_dSimulatedTimeElapsed + dCalcNextTimestep() < m_dSimulationDuration));
+
+      CalcEndOfIterTotals(m_bCellsReadyForIter);
+
+      // Now save results and do per-iteration book-keeping. First save the values from the cell array into GIS files, if needed
+      if (m_bSaveGISThisIter && (! bSaveGISFiles()))
+         return (RTN_ERR_GISFILEWRITE);
+
+      // Pass on any errors from GIS files which have been written in the background since the last iteration
+      if (! bCheckGISWrites(false))
+         return (RTN_ERR_GISFILEWRITE);
 
       // Calculate and check this-iteration hydrology and sediment balance
       CheckMassBalance();
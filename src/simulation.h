@@ -19,6 +19,11 @@ You should have received a copy of the GNU General Public License along with thi
 class CCell;            // Forward declarations
 class C2DVec;
 class CCellSoilLayer;
+class CGridStore;
+class CRandStream;
+class CFrictionFactorTable;
+class CShearStressKernel;
+class CGISWriter;
 
 class CSimulation
 {
@@ -96,6 +101,7 @@ private:
    bool m_bSplashKETS;
    bool m_bSoilWaterTS;
    bool m_bSaveGISThisIter;
+   bool m_bCellsReadyForIter;
    bool m_bThisIterRainChange;
    bool m_bHaveBaseLevel;
    bool m_bOutDEMsUsingInputZUnits;
@@ -108,10 +114,14 @@ private:
    bool m_bFrictionFactorLawrence;
    bool m_bFrictionFactorCheng;
    bool m_bLostSave;
-   bool m_bSplashForward;
    bool m_bSettlingEqnCheng;
    bool m_bSettlingEqnFergusonChurch;
    bool m_bSettlingEqnStokesBudryckRittinger;
+   bool m_bTwoPhaseFlowRouting;
+   bool m_bCounterBasedRand;
+   bool m_bFastSedimentMath;
+   bool m_bGISBenchmark;
+   bool m_bHaveRand0GaussianSpare;
 
    int m_nGISSave;
    int m_nUSave;
@@ -127,6 +137,9 @@ private:
    int m_nInfiltCount;
    int m_nSlumpCount;
    int m_nHeadcutRetreatCount;
+   int m_nThreads;
+   int m_nGISWriteThreads;
+   int m_nGISOutputLayout;
 
    unsigned long m_ulIter;
    unsigned long m_ulTotIter;
@@ -155,6 +168,9 @@ private:
    double m_dInvCos45;
    double m_dYInc;
    double m_dRunOnRainVarM;
+   double m_dAggregateRainThreshold;
+   double m_dFFTableMaxRelErr;
+   double m_dRainAliasMeanRainVarM;
    double m_dRainIntensity;
    double m_dSpecifiedRainIntensity;
    double m_dRainVarMFileMean;
@@ -165,6 +181,9 @@ private:
    double m_dPartKE;
    double m_dSplashConstant;
    double m_dSplashConstantNormalized;
+   double m_dSplashEffTableDepthMax;
+   double m_dSplashEffTableInvSpacing;
+   double m_dSplashEffDry;
    double m_dPoesenSplashConstant;
    double m_dPlanchonCellSizeKC;
    double m_dMeanCellWaterVol;
@@ -175,6 +194,11 @@ private:
    double m_dCellDiag;
    double m_dInvCellSide;
    double m_dInvCellDiag;
+
+   //! Horizontal distance (mm) from the centroid of a cell to the centroid of its neighbour in each planview direction, and its inverse, indexed by the DIRECTION constants
+   double m_dDirHLen[8];
+   double m_dInvDirHLen[8];
+
    double m_dCellSquare;
    double m_dInvCellSquare;
    double m_dInvXGridMax;
@@ -275,11 +299,8 @@ private:
    double m_dStartOfIterTotSiltSedLoad;
    double m_dStartOfIterTotSandSedLoad;
    double m_dEndOfIterClaySedLoad;
-   double m_dEndOfIterClaySedLoadKahanCorrection;
    double m_dEndOfIterSiltSedLoad;
-   double m_dEndOfIterSiltSedLoadKahanCorrection;
    double m_dEndOfIterSandSedLoad;
-   double m_dEndOfIterSandSedLoadKahanCorrection;
 
    //! Duration of simulation, in secs
    double m_dSimulationDuration;
@@ -423,6 +444,7 @@ private:
    vector<double> m_VdSplashDepth;
    vector<double> m_VdSplashEff;
    vector<double> m_VdSplashEffCoeff;
+   vector<double> m_VdSplashEffTable;
    vector<double> m_VdRainChangeTime;
    vector<double> m_VdRainChangeIntensity;
    vector<double> m_VdInputSoilLayerThickness;
@@ -449,13 +471,30 @@ private:
    vector<double> m_VdThisIterSoilWater;
    vector<double> m_VdSinceLastTSSoilWater;
 
+   //! Alias table for choosing active cells in proportion to their rainfall variation multiplier: the probability of keeping each cell, and the alternative cell
+   vector<double> m_VdRainAliasProb;
+   vector<int> m_VnRainAlias;
+
+   //! The probability that a raindrop falls on each active cell, this is proportional to the cell's rainfall variation multiplier
+   vector<double> m_VdRainCellProb;
+
    vector<string> m_VstrInputSoilLayerName;
 
+   //! The GDAL creation options for GIS output files, each NAME=VALUE
+   vector<string> m_VstrGISCreationOptions;
+
+   //! In benchmark mode, the sets of GDAL creation options which were compared, and the bytes written and time taken (in sec) for each
+   vector<string> m_VstrGISBenchmarkOptions;
+   vector<long long> m_VllGISBenchmarkBytes;
+   vector<double> m_VdGISBenchmarkSeconds;
+
    struct RandState
    {
       unsigned long s1, s2, s3;
    } m_ulRState[NUMBER_OF_RNGS];
 
+   double m_dRand0GaussianSpare;
+
    time_t m_tSysStartTime;
    time_t m_tSysEndTime;
 
@@ -485,9 +524,23 @@ private:
    //! Pointer to 2D array of soil cell objects
    CCell** m_Cell;
 
+   //! Pointer to the grid store, which holds the frequently-accessed per-cell fields as one contiguous array per field
+   CGridStore* m_pGrid;
+   CFrictionFactorTable* m_pFFTable;
+
    //! Pointer to 2D array for weights for soil shear stress spatial distribution, used for slumping
    double** m_SSSWeightQuadrant;
 
+   //! Pointer to the kernel which spreads soil shear stress over a patch of cells, used for slumping
+   CShearStressKernel* m_pSSSKernel;
+
+   //! Pointer to the object which writes GIS files, in the background if there are GIS writer threads
+   CGISWriter* m_pGISWriter;
+
+   //! A function which copies the values of one GIS data item from a row of the cell array
+   typedef void (CSimulation::*GISFloatRowExtractor)(int const, float*);
+   typedef void (CSimulation::*GISIntRowExtractor)(int const, int*);
+
 private:
    // Initialization
    static void AnnounceStart(void);
@@ -502,6 +555,7 @@ private:
    static void AnnounceAllocateMemory(void);
    void AnnounceReadRainVar(void) const;
    void WriteRunDetails(void);
+   void WriteGISWriteStats(void);
    static void AnnounceIsRunning(void);
    void CalcGradient(void);
    void InitSoilWater(void);
@@ -511,13 +565,25 @@ private:
    // Input and output
    int nHandleCommandLineParams(int, char*[]);
    bool bCheckGISOutputFormat(void);
+   static bool bCheckGISCreationOptions(GDALDriver*, vector<string> const&, bool const);
    int nReadMicrotopographyDEMData(void);
    int nReadRainVarData(void);
    bool bReadSplashAttenuationData(void);
    bool bReadRainfallTimeSeries(void);
    bool bSaveGISFiles(void);
-   bool bWriteGISFileFloat(int const, string const*);
-   bool bWriteGISFileInt(int const, string const*);
+   void GetGISSaveItems(vector<int>&, vector<string const*>&) const;
+   void GetGISEndItems(vector<int>&, vector<string const*>&) const;
+   static string strGetGISItemName(int const);
+   string strGetGISFileName(string const&) const;
+   static string strGetGISUnits(int const);
+   static bool bIsIntGISItem(int const);
+   template <int N> void ExtractGISFloatRow(int const, float*);
+   template <int N> void ExtractGISIntRow(int const, int*);
+   static GISFloatRowExtractor pGetGISFloatRowExtractor(int const);
+   static GISIntRowExtractor pGetGISIntRowExtractor(int const);
+   bool bWriteGISFiles(vector<int> const&, vector<string const*> const&);
+   bool bCheckGISWrites(bool const);
+   void BenchmarkGISFormats(void);
    bool bWritePerIterationResults(void);
    bool bWriteTSFiles(bool const);
    int nWriteFilesAtEnd(void);
@@ -529,37 +595,56 @@ private:
    // Simulation routines
    int nDoSimulation(void);
    void CalcTimestep(void);
+   double dCalcNextTimestep(void) const;
    void MarkEdgeCells(void);
    void DoRunOnFromOneEdge(int const);
    void DoAllRain(void);
+   void DoAllRainDropsCounterBased(int const);
+   void InitRainAlias(void);
+   void DoAllRainAggregated(int const);
+   void AddRainDrop(int const, int const, double const);
    void DoAllFlowRouting(void);
    void DoAllInfiltration(void);
    void DoAllSplash(void);
    void DoAllSlump(void);
+   void DoSlumpCell(int const);
    void DoAllHeadcutRetreat(void);
 
    // Lower-level simulation routines
+   void DoTwoPhaseFlowRouting(void);
+   void DoCellOutFlow(int const, int const);
+   void GatherCellInFlow(int const, int const);
+   void GatherCellFlowDetach(int const, int const);
+   void InitCellFlowVelocity(int const, int const);
    void TryCellOutFlow(int const, int const);
    void TryEdgeCellOutFlow(int const, int const, int const);
+   bool bFlowsOffEdge(int const, int const) const;
+   void CalcAllHydraulicState(void);
    int nFindSteepestEnergySlope(int const, int const, double const, int&, int&, double&, double&, double&);
    void CellMoveWaterAndSediment(int const, int const, int const, int const, double const&, double&);
    double dTimeToCrossCell(int const, int const, int const, double const, double, double const, C2DVec&, double&);
-   double dCalcHydraulicRadius(int const, int const);
+   double dCalcHydraulicRadius(int const, int const, int const);
    static void CalcFlowSpeedManning(double&);
    void CalcFlowSpeedDarcyWeisbach(int const, int const, double const, double const, double&);
    double dCalcLawrenceFrictionFactor(int const, int const, double const, bool const);
-   void CalcTransportCapacity(int const, int const, int const, int const, int const, double const, double const, double const, double const, double const, double const);
-   void DoCellFlowErosion(int const, int const, int const, int const, int const, double const, double const, double const, double const, double const);
+   void InitFrictionFactorTables(void);
+   void DoAllSedimentFlow(void);
+   void CalcAllTransportCapacity(void);
+   template <bool bFAST> void CalcRunTransportCapacity(int const, int const);
+   void DoCellSedimentFlow(int const, int const);
+   void DoCellFlowErosion(int const, int const, int const, int const, int const, double const, double const, double const, double);
    void DoCellSedLoadDeposition(int const, int const, double const, double const, double const);
    double dCalcSplashCubicSpline(double) const;
-   double dCalcLaplacian(int const, int const);
+   double dCalcSplashCubicSplineSegment(double const) const;
+   double dLookUpSplashEfficiency(double const) const;
    int nFindSteepestSoilSurface(int const, int const, double const, int&, int&, double&, bool&);
    void TryToppleCellsAbove(int const, int const, int);
    void DoToppleCells(int const, int const, int const, int const, double, bool const);
-   void DoCellInfiltration(int const, int const, int const, CCellSoilLayer*, double const);
-   void DoCellExfiltration(int const, int const, int const, CCellSoilLayer*, double const);
+   void CalcPotentialInfiltration(int const, int const, int const, double*) const;
+   void DoCellInfiltration(int const, int const, int const, double const, double const, double&, double&, double&);
+   void DoCellExfiltration(int const, int const, int const, double const);
    void DoHeadcutRetreatMoveSoil(int const, int const, int const, int const, int const, double const);
-   void DoDistributeShearStress(int const, int const, double const);
+   void SpreadAllShearStress(void);
    double dGetReynolds(int const, int const);
    void CalcSettlingSpeed(void);
 
@@ -579,15 +664,19 @@ private:
    static char const* pszGetErrorText(int const);
    void WrapLongString(string*);
    void CheckLawrenceFF(void);
-   void CheckSplashAttenuation(void) const;
+   void CheckSplashAttenuation(void);
    void InitSplashAttenuation(void);
    void CalcProcessStats(void);
    void CalcEndOfSimDEMChange(void);
+   void CalcEndOfIterTotals(bool const);
 #if defined RANDCHECK
    void CheckRand(void) const;
 #endif
 #if defined _DEBUG
    void DEBUGShowSedLoad(string const);
+   void DEBUGCheckSurfaceElevations(void);
+   void DEBUGCheckSteepestTopSlopes(void);
+   void DEBUGCheckHydraulicState(void);
 #endif
 
    // Output formatting
@@ -619,6 +708,7 @@ private:
    int nGetRand1To(int const);
    double dGetRand0GaussPos(double const, double const);
    double dGetRand0Gaussian(void);
+   CRandStream RandStream(int const, unsigned long const) const;
    static double dGetCGaussianPDF(double const);
 
 public:
@@ -633,62 +723,8 @@ public:
    // double dGetCellSide(void) const;
    // double dGetCellSideDiag(void) const;
    void GetPreSimulationValues(double const, double const);
-   void AddToEndOfIterRain(double const);
-   void AddToEndOfIterRunon(double const);
-   void AddToEndOfIterStoredSoilWater(double const);
-   void AddToEndOfIterInfiltration(double const);
-   void AddToEndOfIterExfiltration(double const);
-   void IncrNumWetCells(void);
-   void AddToEndOfIterStoredSurfaceWater(double const);
-   void AddToEndOfIterSurfaceWaterLost(double const);
-
-   void AddToEndOfIterSedimentOffEdge(double const, double const, double const);
-   void AddToEndOfIterClayFlowDetach(double const);
-   void AddToEndOfIterSiltFlowDetach(double const);
-   void AddToEndOfIterSandFlowDetach(double const);
-   void AddToEndOfIterClayFlowDeposit(double const);
-   void AddToEndOfIterSiltFlowDeposit(double const);
-   void AddToEndOfIterSandFlowDeposit(double const);
-
-   void AddToEndOfIterClaySplashDetach(double const);
-   void AddToEndOfIterSiltSplashDetach(double const);
-   void AddToEndOfIterSandSplashDetach(double const);
-   void AddToEndOfIterClaySplashDeposit(double const);
-   void AddToEndOfIterSiltSplashDeposit(double const);
-   void AddToEndOfIterSandSplashDeposit(double const);
-   void AddToEndOfIterClaySplashOffEdge(double const);
-   void AddToEndOfIterSiltSplashOffEdge(double const);
-   void AddToEndOfIterSandSplashOffEdge(double const);
-
-   void AddToEndOfIterClaySlumpDetach(double const);
-   void AddToEndOfIterSiltSlumpDetach(double const);
-   void AddToEndOfIterSandSlumpDetach(double const);
-   void AddToEndOfIterClaySlumpDeposit(double const);
-   void AddToEndOfIterSiltSlumpDeposit(double const);
-   void AddToEndOfIterSandSlumpDeposit(double const);
-
-   void AddToEndOfIterClayToppleDetach(double const);
-   void AddToEndOfIterSiltToppleDetach(double const);
-   void AddToEndOfIterSandToppleDetach(double const);
-   void AddToEndOfIterClayToppleDeposit(double const);
-   void AddToEndOfIterSiltToppleDeposit(double const);
-   void AddToEndOfIterSandToppleDeposit(double const);
-
-   void AddToEndOfIterClayInfiltDeposit(double const);
-   void AddToEndOfIterSiltInfiltDeposit(double const);
-   void AddToEndOfIterSandInfiltDeposit(double const);
-
-   void AddToEndOfIterClaySedLoad(double const);
-   void AddToEndOfIterSiltSedLoad(double const);
-   void AddToEndOfIterSandSedLoad(double const);
-
-   void AddToEndOfIterTotalElev(double const);
-
-   void AddToEndOfIterNetClayDetach(double const);
-   void AddToEndOfIterNetSiltDetach(double const);
-   void AddToEndOfIterNetSandDetach(double const);
-
-   double dGetRandGaussian(void);
+
+   void GetRandGaussianPair(int const, int const, double&, double&);
 };
 
 #endif                  // __SIMULATION_H__
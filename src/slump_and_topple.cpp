@@ -16,6 +16,8 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
+#include "shear_stress_kernel.h"
 
 //=========================================================================================================================================
 //! This file-local function calculates the 'distance' between a given cell of the soil sear stress weigh quadrant, and the corner of the quadrant
@@ -120,57 +122,50 @@ int CSimulation::nInitSlumping(void)
 //    }
 //    m_ofsLog << endl << endl;
 
+   // Now make the kernel which spreads shear stress using these weights
+   m_pSSSKernel = new CShearStressKernel;
+   if (NULL == m_pSSSKernel)
+   {
+      // Error, can't allocate memory
+      cerr << ERR << "cannot allocate memory for soil shear stress kernel" << endl;
+      return (RTN_ERR_MEMALLOC);
+   }
+
+   m_pSSSKernel->Init(m_SSSWeightQuadrant, m_nSSSQuadrantSize, m_nXGridMax, m_nYGridMax, SSS_KERNEL_MAX_ERR);
+
+   if (m_pSSSKernel->nGetNumTerms() > 0)
+      m_ofsLog << "Soil shear stress kernel: " << m_pSSSKernel->nGetWidth() << " x " << m_pSSSKernel->nGetWidth() << " cells, approximated by " << m_pSSSKernel->nGetNumTerms() << " separable terms, measured maximum relative error " << m_pSSSKernel->dGetMeasuredErr() << endl;
+   else
+      m_ofsLog << "Soil shear stress kernel: " << m_pSSSKernel->nGetWidth() << " x " << m_pSSSKernel->nGetWidth() << " cells, applied directly" << endl;
+
    return RTN_OK;
 }
 
 //=========================================================================================================================================
-//! This member function of CSimulation distributes shear stress in a patch around a target cell
+//! This member function of CSimulation spreads the shear stress of flow on each cell since this was last done, over a patch of cells around that cell. This is done for all cells at once, as a convolution with the kernel of soil shear stress weights. Patch cells which are outside the grid or are missing values get no shear stress
 //=========================================================================================================================================
-void CSimulation::DoDistributeShearStress(int const nX, int const nY, double const dTau)
+void CSimulation::SpreadAllShearStress(void)
 {
-   m_Cell[nX][nY].pGetSoil()->IncShearStress(dTau * m_SSSWeightQuadrant[0][0]);
-//    cerr << "[" << nX << "][" << nY << "] " << m_SSSWeightQuadrant[0][0] << endl << endl;
+   int nStride = m_pGrid->nGetIndex(1, 0) - m_pGrid->nGetIndex(0, 0);
+   m_pSSSKernel->Spread(m_pGrid->pdGetRawShearStress(m_pGrid->nGetIndex(0, 0)), nStride);
 
-   for (int m = 1; m < m_nSSSQuadrantSize; m++)
+   // Now add the spread shear stress to each cell. Each cell is changed only by itself, so columns are done in parallel
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int nX = 0; nX < m_nXGridMax; nX++)
    {
-      for (int n = 0; n < m_nSSSQuadrantSize; n++)
+      for (int nY = 0; nY < m_nYGridMax; nY++)
       {
-         double dThisTau = dTau * m_SSSWeightQuadrant[m][n];
+         int n = m_pGrid->nGetIndex(nX, nY);
+         m_pGrid->ClearRawShearStress(n);
 
-         int nXTmp = nX + m;
-         int nYTmp = nY + n;
-         if ((nXTmp < m_nXGridMax) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()))
-         {
-            m_Cell[nX][nY].pGetSoil()->IncShearStress(dThisTau);
-//             cerr << "[" << nXTmp << "][" << nYTmp << "] " << m_SSSWeightQuadrant[m][n] << endl;
-         }
-
-         nXTmp = nX - m;
-         nYTmp = nY - n;
-         if ((nXTmp >= 0) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()))
-         {
-            m_Cell[nX][nY].pGetSoil()->IncShearStress(dThisTau);
-//             cerr << "[" << nXTmp << "][" << nYTmp << "] " << m_SSSWeightQuadrant[m][n] << endl;
-         }
-
-         nXTmp = nX + n;
-         nYTmp = nY - m;
-         if ((nXTmp < m_nXGridMax) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()))
-         {
-            m_Cell[nX][nY].pGetSoil()->IncShearStress(dThisTau);
-//             cerr << "[" << nXTmp << "][" << nYTmp << "] " << m_SSSWeightQuadrant[m][n] << endl;
-         }
-
-         nXTmp = nX - n;
-         nYTmp = nY + m;
-         if ((nXTmp >= 0) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()))
-         {
-            m_Cell[nX][nY].pGetSoil()->IncShearStress(dThisTau);
-//             cerr << "[" << nXTmp << "][" << nYTmp << "] " << m_SSSWeightQuadrant[m][n] << endl << endl;
-         }
+         // The separable approximation to the kernel may give a tiny negative value where the exact value is zero, so ignore these
+         double dShearStress = m_pSSSKernel->dGetSpread(nX, nY);
+         if ((! m_pGrid->bIsMissing(n)) && (dShearStress > 0))
+            m_Cell[nX][nY].pGetSoil()->IncShearStress(dShearStress);
       }
    }
-//    cerr << "-------------------------------------" << endl;
 }
 
 //=========================================================================================================================================
@@ -178,188 +173,126 @@ void CSimulation::DoDistributeShearStress(int const nX, int const nY, double con
 //=========================================================================================================================================
 void CSimulation::DoAllSlump(void)
 {
-   for (int nX = 0; nX < m_nXGridMax; nX++)
-   {
-      for (int nY = 0; nY < m_nYGridMax; nY++)
-      {
-         if (m_Cell[nX][nY].bIsMissingValue())
-            continue;
-
-         // Set the this-operation (actually they are kept for several iterations) values for slumping and toppling
-         m_Cell[nX][nY].pGetSoil()->ZeroThisOperationSlump();
-
-         // Now total up the shear stress in this and adjacent cells
-         int nXTmp, nYTmp, nCount = 0;;
-         double dThisStress = m_Cell[nX][nY].pGetSoil()->dGetShearStress();
+   // Slumping can only happen on a cell which is adjacent to a wet cell, so only the cells in the wet-cell activity list need to be considered. This list is in the same order as the spans of active cells, so the cells are dealt with in the same order as before. The this-operation slumping and toppling values need not be zeroed here, since they were zeroed at the start of the iteration after the last slump operation
+   for (int i = 0; i < m_pGrid->nGetNumWetActive(); i++)
+      DoSlumpCell(m_pGrid->nGetWetActive(i));
+}
 
-         // Planview bottom
-         nXTmp = nX;
-         nYTmp = nY+1;
-         if ((nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && (m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet()))
-         {
-            dThisStress += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetShearStress();
-            nCount++;
-         }
+//=========================================================================================================================================
+//! Simulates slumping for a single cell, given by its store index
+//=========================================================================================================================================
+void CSimulation::DoSlumpCell(int const nThis)
+{
+   int
+      nX = m_pGrid->nGetXFromIndex(nThis),
+      nY = m_pGrid->nGetYFromIndex(nThis);
 
-         // Planview bottom right
-         nXTmp = nX+1;
-         nYTmp = nY+1;
-         if ((nXTmp < m_nXGridMax) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && (m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet()))
-         {
-            dThisStress += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetShearStress();
-            nCount++;
-         }
+   // Now total up the shear stress in this and adjacent cells. Neighbours in the halo are missing values, so need no bounds check
+   int nXTmp, nYTmp, nCount = 0;
+   double dThisStress = m_Cell[nX][nY].pGetSoil()->dGetShearStress();
 
-         // Planview bottom left
-         nXTmp = nX-1;
-         nYTmp = nY+1;
-         if ((nXTmp >= 0) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && (m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet()))
-         {
-            dThisStress += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetShearStress();
-            nCount++;
-         }
+   for (int j = 0; j < 8; j++)
+   {
+      int nTmp = m_pGrid->nGetNeighbour(nThis, NEIGHBOUR_SEARCH_ORDER[j]);
+      if ((! m_pGrid->bIsMissing(nTmp)) && (m_pGrid->bIsWet(nTmp)))
+      {
+         dThisStress += m_Cell[m_pGrid->nGetXFromIndex(nTmp)][m_pGrid->nGetYFromIndex(nTmp)].pGetSoil()->dGetShearStress();
+         nCount++;
+      }
+   }
 
-         // Planview right
-         nXTmp = nX+1;
-         nYTmp = nY;
-         if ((nXTmp < m_nXGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && (m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet()))
-         {
-            dThisStress += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetShearStress();
-            nCount++;
-         }
+   // Any shear stress?
+   if (bFpEQ(dThisStress, 0.0, TOLERANCE))
+      return;
 
-         // Planview left
-         nXTmp = nX-1;
-         nYTmp = nY;
-         if ((nXTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && (m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet()))
-         {
-            dThisStress += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetShearStress();
-            nCount++;
-         }
+   if (nCount < 8)
+   {
+      // At least one of the surrounding eight cells could not be read, which means that we are near an edge. So compensate for this
+      double dAvgStress = dThisStress / nCount;
+      dThisStress = dAvgStress * 8;
+   }
 
-         // Planview top right
-         nXTmp = nX+1;
-         nYTmp = nY-1;
-         if ((nXTmp < m_nXGridMax) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && (m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet()))
-         {
-            dThisStress += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetShearStress();
-            nCount++;
-         }
+   // OK, we have some shear stress. Now get the water content of this cell, as a fraction. But if we aren't simulating infilt, assume the soil is saturated
+   // TODO get working for multiple soil layers
+   double dWaterFrac = 1;
+   if (m_bDoInfiltration)
+   {
+      // Get the current water content (a depth equivalent) for the top soil layer on this cell
+      int n = m_pGrid->nGetIndex(nX, nY);
+      double dTopLayerSoilWater = m_pGrid->dGetLayerSoilWater(0, n);
 
-         // Planview top left
-         nXTmp = nX-1;
-         nYTmp = nY-1;
-         if ((nXTmp >= 0) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && (m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet()))
-         {
-            dThisStress += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetShearStress();
-            nCount++;
-         }
+      // Now calculate the saturated (maximum) soil water content (a depth equivalent) for this layer
+      double
+         dTopLayerThickness = m_pGrid->dGetLayerThickness(0, n),
+         dTopLayerMaxSoilWater = m_VdInputSoilLayerInfiltSatWater[0] * dTopLayerThickness;
 
-         // Planview top
-         nXTmp = nX;
-         nYTmp = nY-1;
-         if ((nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && (m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet()))
-         {
-            dThisStress += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetShearStress();
-            nCount++;
-         }
+      // And so get the fraction saturated
+      dWaterFrac = dTopLayerSoilWater / dTopLayerMaxSoilWater;
+   }
 
-         // Any shear stress?
-         if (bFpEQ(dThisStress, 0.0, TOLERANCE))
-            continue;
+   // Assume that shear stress (and hence slumping) is linearly proportional to the water content of this cell TODO check this
+   dThisStress *= dWaterFrac;
+   dThisStress /= (m_dSimulatedTimeElapsed - m_dLastSlumpCalcTime);
 
-         if (nCount < 8)
-         {
-            // At least one of the surrounding eight cells could not be read, which means that we are near an edge. So compensate for this
-            double dAvgStress = dThisStress / nCount;
-            dThisStress = dAvgStress * 8;
-         }
+   // So we have the total shear stress in this cell, from all wet cells adjacent to this cell. Does this exceed the threshold shear stress for slumping?
+   if (dThisStress >= m_dCritSSSForSlump)
+   {
+      // Yes, it does: so do some slumping
+      bool bDiag = false;
+      double dDiff;
 
-         // OK, we have some shear stress. Now get the water content of this cell, as a fraction. But if we aren't simulating infilt, assume the soil is saturated
-         // TODO get working for multiple soil layers
-         double dWaterFrac = 1;
-         if (m_bDoInfiltration)
+      // Find the adjacent wet cell with the steepest downhill soil-surface gradient, however this must not be an edge cell
+      if ((nFindSteepestSoilSurface(nX, nY, m_pGrid->dGetSoilSurfaceElevation(m_pGrid->nGetIndex(nX, nY)), nXTmp, nYTmp, dDiff, bDiag)) != DIRECTION_NONE)
+      {
+         // Assume that soil is saturated, and flows hydrostatically (i.e. it wants to get to angle of rest) down the steepest soil-surface gradient
+         double dCrit = 0;
+         if (bDiag)
+            // Steepest downhill soil surface slope is NW-SE or SW-NE (i.e. diagonally) planview
+            dCrit = m_dSlumpAngleOfRestDiffDiag;
+         else
+            // Steepest downhill soil surface slope is N-S or W-E planview
+            dCrit = m_dSlumpAngleOfRestDiff;
+
+         if (dDiff > dCrit)
          {
-            // Calculate the saturated (maximum) soil water content (a depth equivalent) for the top soil layer on this cell
-            CCellSoilLayer const* pTopLayer = m_Cell[nX][nY].pGetSoil()->pLayerGetLayer(0);
-
-            // Get the current water content (a depth equivalent) for the top soil layer
-            double dTopLayerSoilWater = pTopLayer->dGetSoilWater();
+            dDiff -= dCrit;
+            dDiff /= 2;
 
-            // Now calculate the saturated (maximum) soil water content (a depth equivalent) for this layer
+            // Remove the soil from the higher cell, and move it to the lower cCell
             double
-               dTopLayerThickness = pTopLayer->dGetLayerThickness(),
-               dTopLayerMaxSoilWater = m_VdInputSoilLayerInfiltSatWater[0] * dTopLayerThickness;
+               dClayDetached = 0,
+               dSiltDetached = 0,
+               dSandDetached = 0;
 
-            // And so get the fraction saturated
-            dWaterFrac = dTopLayerSoilWater / dTopLayerMaxSoilWater;
-         }
+            m_Cell[nX][nY].pGetSoil()->DoSlumpDetach(dDiff, dClayDetached, dSiltDetached, dSandDetached);
 
-         // Assume that shear stress (and hence slumping) is linearly proportional to the water content of this cell TODO check this
-         dThisStress *= dWaterFrac;
-         dThisStress /= (m_dSimulatedTimeElapsed - m_dLastSlumpCalcTime);
+            // Add to 'since last' values
+            m_dEndOfIterClaySlumpDetach += dClayDetached;
+            m_dEndOfIterSiltSlumpDetach += dSiltDetached;
+            m_dEndOfIterSandSlumpDetach += dSandDetached;
 
-         // So we have the total shear stress in this cell, from all wet cells adjacent to this cell. Does this exceed the threshold shear stress for slumping?
-         if (dThisStress >= m_dCritSSSForSlump)
-         {
-            // Yes, it does: so do some slumping
-            bool bDiag = false;
-            double dDiff;
-
-            // Find the adjacent wet cell with the steepest downhill soil-surface gradient, however this must not be an edge cell
-            if ((nFindSteepestSoilSurface(nX, nY, m_Cell[nX][nY].pGetSoil()->dGetSoilSurfaceElevation(), nXTmp, nYTmp, dDiff, bDiag)) != DIRECTION_NONE)
-            {
-               // Assume that soil is saturated, and flows hydrostatically (i.e. it wants to get to angle of rest) down the steepest soil-surface gradient
-               double dCrit = 0;
-               if (bDiag)
-                  // Steepest downhill soil surface slope is NW-SE or SW-NE (i.e. diagonally) planview
-                  dCrit = m_dSlumpAngleOfRestDiffDiag;
-               else
-                  // Steepest downhill soil surface slope is N-S or W-E planview
-                  dCrit = m_dSlumpAngleOfRestDiff;
-
-               if (dDiff > dCrit)
-               {
-                  dDiff -= dCrit;
-                  dDiff /= 2;
-
-                  // Remove the soil from the higher cell, and move it to the lower cCell
-                  double
-                     dClayDetached = 0,
-                     dSiltDetached = 0,
-                     dSandDetached = 0;
-
-                  m_Cell[nX][nY].pGetSoil()->DoSlumpDetach(dDiff, dClayDetached, dSiltDetached, dSandDetached);
-
-                  // Add to 'since last' values
-                  m_dEndOfIterClaySlumpDetach += dClayDetached;
-                  m_dEndOfIterSiltSlumpDetach += dSiltDetached;
-                  m_dEndOfIterSandSlumpDetach += dSandDetached;
-
-                  // Now add the detached soil to the 'To' cell (as part of the top soil layer if dry, or to the sediment load if wet)
-                  double
-                     dClayDeposited = 0,
-                     dSiltDeposited = 0,
-                     dSandDeposited = 0,
-                     dClayToSedLoad = 0,
-                     dSiltToSedLoad = 0,
-                     dSandToSedLoad = 0;
-
-                  m_Cell[nXTmp][nYTmp].pGetSoil()->DoSlumpDepositOrToSedLoad(dClayDetached, dSiltDetached, dSandDetached, dClayDeposited, dSiltDeposited, dSandDeposited, dClayToSedLoad, dSiltToSedLoad, dSandToSedLoad);
-
-                  // Add to 'since last' values
-                  m_dEndOfIterClaySlumpDeposit += dClayDeposited;
-                  m_dEndOfIterSiltSlumpDeposit += dSiltDeposited;
-                  m_dEndOfIterSandSlumpDeposit += dSandDeposited;
-                  m_dEndOfIterClaySlumpToSedLoad += dClayToSedLoad;
-                  m_dEndOfIterSiltSlumpToSedLoad += dSiltToSedLoad;
-                  m_dEndOfIterSandSlumpToSedLoad += dSandToSedLoad;
-
-                  // Has this slumping also triggered toppling of any now-unstable upslope cells?
-                  int nRecursionDepth = MAX_RECURSION_DEPTH;
-                  TryToppleCellsAbove(nX, nY, nRecursionDepth);
-               }
-            }
+            // Now add the detached soil to the 'To' cell (as part of the top soil layer if dry, or to the sediment load if wet)
+            double
+               dClayDeposited = 0,
+               dSiltDeposited = 0,
+               dSandDeposited = 0,
+               dClayToSedLoad = 0,
+               dSiltToSedLoad = 0,
+               dSandToSedLoad = 0;
+
+            m_Cell[nXTmp][nYTmp].pGetSoil()->DoSlumpDepositOrToSedLoad(dClayDetached, dSiltDetached, dSandDetached, dClayDeposited, dSiltDeposited, dSandDeposited, dClayToSedLoad, dSiltToSedLoad, dSandToSedLoad);
+
+            // Add to 'since last' values
+            m_dEndOfIterClaySlumpDeposit += dClayDeposited;
+            m_dEndOfIterSiltSlumpDeposit += dSiltDeposited;
+            m_dEndOfIterSandSlumpDeposit += dSandDeposited;
+            m_dEndOfIterClaySlumpToSedLoad += dClayToSedLoad;
+            m_dEndOfIterSiltSlumpToSedLoad += dSiltToSedLoad;
+            m_dEndOfIterSandSlumpToSedLoad += dSandToSedLoad;
+
+            // Has this slumping also triggered toppling of any now-unstable upslope cells?
+            int nRecursionDepth = MAX_RECURSION_DEPTH;
+            TryToppleCellsAbove(nX, nY, nRecursionDepth);
          }
       }
    }
@@ -370,123 +303,35 @@ void CSimulation::DoAllSlump(void)
 //=========================================================================================================================================
 int CSimulation::nFindSteepestSoilSurface(int const nX, int const nY, double const dThisElev, int& nLowX, int& nLowY, double& dDiff, bool& bDiag)
 {
-   int nXTmp,
-      nYTmp,
+   int
+      nThis = m_pGrid->nGetIndex(nX, nY),
       nDir = DIRECTION_NONE;
-   double
-      dTmpDiff,
-      dTanX,
-      dSlope = 0;
-
-   // Planview bottom
-   nXTmp = nX;
-   nYTmp = nY+1;
-   if ((nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet() && ((dTmpDiff = dThisElev - m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation()) > 0))
-   {
-      // It's wet, it's downhill, and being the first one checked it must be the steepest so far
-      dSlope = dTmpDiff * m_dInvCellSide;                                                       // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dDiff = dTmpDiff;
-      nDir = DIRECTION_BOTTOM;
-      bDiag = false;
-   }
+   double dSlope = 0;
 
-   // Planview bottom right
-   nXTmp = nX+1;
-   nYTmp = nY+1;
-   if ((nXTmp < m_nXGridMax) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet() && ((dTmpDiff = dThisElev - m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellDiag) > dSlope))
+   // Neighbours in the halo are missing values, so need no bounds check
+   for (int i = 0; i < 8; i++)
    {
-      // It's wet and the steepest so far
-      dSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dDiff = dTmpDiff;
-      nDir = DIRECTION_BOTTOM_RIGHT;
-      bDiag = true;
-   }
+      int
+         nDirTmp = NEIGHBOUR_SEARCH_ORDER[i],
+         nTmp = m_pGrid->nGetNeighbour(nThis, nDirTmp);
 
-   // Planview bottom left
-   nXTmp = nX-1;
-   nYTmp = nY+1;
-   if ((nXTmp >= 0) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet() && ((dTmpDiff = dThisElev - m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellDiag) > dSlope))
-   {
-      // It's wet and the steepest so far
-      dSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dDiff = dTmpDiff;
-      nDir = DIRECTION_BOTTOM_LEFT;
-      bDiag = true;
-   }
+      if (m_pGrid->bIsMissing(nTmp) || (! m_pGrid->bIsWet(nTmp)))
+         continue;
 
-   // Planview right
-   nXTmp = nX+1;
-   nYTmp = nY;
-   if ((nXTmp < m_nXGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet() && ((dTmpDiff = dThisElev - m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellSide) > dSlope))
-   {
-      // It's wet and the steepest so far
-      dSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dDiff = dTmpDiff;
-      nDir = DIRECTION_RIGHT;
-      bDiag = false;
-   }
-
-   // Planview left
-   nXTmp = nX-1;
-   nYTmp = nY;
-   if ((nXTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet() && ((dTmpDiff = dThisElev - m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellSide) > dSlope))
-   {
-      // It's wet and the steepest so far
-      dSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dDiff = dTmpDiff;
-      nDir = DIRECTION_LEFT;
-      bDiag = false;
-   }
-
-   // Planview top right
-   nXTmp = nX+1;
-   nYTmp = nY-1;
-   if ((nXTmp < m_nXGridMax) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet() && ((dTmpDiff = dThisElev - m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellDiag) > dSlope))
-   {
-      // It's wet and the steepest so far
-      dSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dDiff = dTmpDiff;
-      nDir = DIRECTION_TOP_RIGHT;
-      bDiag = true;
-   }
+      double
+         dTmpDiff = dThisElev - m_pGrid->dGetSoilSurfaceElevation(nTmp),
+         dTanX = dTmpDiff * m_dInvDirHLen[nDirTmp];
 
-   // Planview top left
-   nXTmp = nX-1;
-   nYTmp = nY-1;
-   if ((nXTmp >= 0) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet() && ((dTmpDiff = dThisElev - m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation()) > 0) && ((dTanX = dTmpDiff * m_dInvCellDiag) > dSlope))
-   {
-      // It's wet and the steepest so far
-      dSlope = dTanX;                                                                           // is tan(top slope)
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dDiff = dTmpDiff;
-      nDir = DIRECTION_TOP_LEFT;
-      bDiag = true;
-   }
-
-   // Planview top
-   nXTmp = nX;
-   nYTmp = nY-1;
-   if ((nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && m_Cell[nXTmp][nYTmp].pGetSurfaceWater()->bIsWet() && ((dTmpDiff = dThisElev - m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation()) > 0) && ((dTmpDiff * m_dInvCellSide) > dSlope))
-   {
-      // It's wet and the steepest so far
-      nLowX = nXTmp;
-      nLowY = nYTmp;
-      dDiff = dTmpDiff;
-      nDir = DIRECTION_TOP;
-      bDiag = false;
+      // It's wet. Is it downhill? The first neighbour checked (planview bottom) must then be the steepest so far, any other neighbour must also be strictly steeper
+      if ((dTmpDiff > 0) && ((i == 0) || (dTanX > dSlope)))
+      {
+         dSlope = dTanX;                                                                           // is tan(top slope)
+         nLowX = m_pGrid->nGetXFromIndex(nTmp);
+         nLowY = m_pGrid->nGetYFromIndex(nTmp);
+         dDiff = dTmpDiff;
+         nDir = nDirTmp;
+         bDiag = ((nDirTmp % 2) == 1);
+      }
    }
 
    return (nDir);
@@ -502,107 +347,30 @@ void CSimulation::TryToppleCellsAbove(int const nX, int const nY, int nRecursion
 
    nRecursionDepth--;
 
-   int
-      nXTmp,
-      nYTmp;
-   double
-      dThisElev = m_Cell[nX][nY].pGetSoil()->dGetSoilSurfaceElevation(),
-      dDiff;
-
-   // The cell at planview bottom
-   nXTmp = nX;
-   nYTmp = nY+1;
-   if ((nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dDiff = m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation() - dThisElev) > m_dToppleCritDiff))
-   {
-      // It's uphill, and the slope is above the critical toppling value, so topple cells
-      DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, false);
-
-      // Now call this routine recursively
-      TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
-   }
+   int nThis = m_pGrid->nGetIndex(nX, nY);
+   double dThisElev = m_pGrid->dGetSoilSurfaceElevation(nThis);
 
-   // The cell at planview bottom right
-   nXTmp = nX+1;
-   nYTmp = nY+1;
-   if ((nXTmp < m_nXGridMax) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dDiff = m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation() - dThisElev) > m_dToppleCritDiffDiag))
+   // Neighbours in the halo are missing values, so need no bounds check
+   for (int i = 0; i < 8; i++)
    {
-      // It's uphill, and the slope is above the critical toppling value, so topple cells
-      DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, true);
-
-      // Now call this routine recursively
-      TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
-   }
-
-   // The cell at planview bottom left
-   nXTmp = nX-1;
-   nYTmp = nY+1;
-   if ((nXTmp >= 0) && (nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dDiff = m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation() - dThisElev) > m_dToppleCritDiffDiag))
-   {
-      // It's uphill, and the slope is above the critical toppling value, so topple cells
-      DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, true);
-
-      // Now call this routine recursively
-      TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
-   }
-
-   // The cell at planview right
-   nXTmp = nX+1;
-   nYTmp = nY;
-   if ((nXTmp < m_nXGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dDiff = m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation() - dThisElev) > m_dToppleCritDiff))
-   {
-      // It's uphill, and the slope is above the critical toppling value, so topple cells
-      DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, false);
-
-      // Now call this routine recursively
-      TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
-   }
+      int
+         nDir = NEIGHBOUR_SEARCH_ORDER[i],
+         nTmp = m_pGrid->nGetNeighbour(nThis, nDir);
+      bool bDiag = ((nDir % 2) == 1);
+      double dDiff;
 
-   // The cell at planview left
-   nXTmp = nX-1;
-   nYTmp = nY;
-   if ((nXTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dDiff = m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation() - dThisElev) > m_dToppleCritDiff))
-   {
-      // It's uphill, and the slope is above the critical toppling value, so topple cells
-      DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, false);
-
-      // Now call this routine recursively
-      TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
-   }
-
-   // The cell at planview top right
-   nXTmp = nX+1;
-   nYTmp = nY-1;
-   if ((nXTmp < m_nXGridMax) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dDiff = m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation() - dThisElev) > m_dToppleCritDiffDiag))
-   {
-      // It's uphill, and the slope is above the critical toppling value, so topple cells
-      DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, true);
-
-      // Now call this routine recursively
-      TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
-   }
-
-   // The cell at planview top left
-   nXTmp = nX-1;
-   nYTmp = nY-1;
-   if ((nXTmp >= 0) && (nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dDiff = m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation() - dThisElev) > m_dToppleCritDiffDiag))
-   {
-      // It's uphill, and the slope is above the critical toppling value, so topple cells
-      DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, true);
-
-      // Now call this routine recursively
-      TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
-   }
+      if ((! m_pGrid->bIsMissing(nTmp)) && ((dDiff = m_pGrid->dGetSoilSurfaceElevation(nTmp) - dThisElev) > (bDiag ? m_dToppleCritDiffDiag : m_dToppleCritDiff)))
+      {
+         int
+            nXTmp = m_pGrid->nGetXFromIndex(nTmp),
+            nYTmp = m_pGrid->nGetYFromIndex(nTmp);
 
-   // The cell at planview top
-   nXTmp = nX;
-   nYTmp = nY-1;
-   if ((nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()) && ((dDiff = m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation() - dThisElev) > m_dToppleCritDiff))
-   {
-      // It's uphill, and the slope is above the critical toppling value, so topple cells
-      DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, false);
+         // It's uphill, and the slope is above the critical toppling value, so topple cells
+         DoToppleCells(nX, nY, nXTmp, nYTmp, dDiff, bDiag);
 
-      // Now call this routine recursively
-      TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
+         // Now call this routine recursively
+         TryToppleCellsAbove(nXTmp, nYTmp, nRecursionDepth);
+      }
    }
 }
 
@@ -16,6 +16,19 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
+
+//=========================================================================================================================================
+//! Returns true if an edge cell's edge (one of the four orthogonal DIRECTION constants, or DIRECTION_NONE) faces in planview direction nDir. An edge faces a diagonal direction if it is either of the two orthogonal directions which make up the diagonal
+//=========================================================================================================================================
+static inline bool bIsEdgeInDirection(int const nEdge, int const nDir)
+{
+   if (nEdge == DIRECTION_NONE)
+      return false;
+
+   // The edge is nDir-1, nDir or nDir+1 (modulo 8)
+   return (((nEdge - nDir + 9) % 8) <= 2);
+}
 
 //=========================================================================================================================================
 //! This member function of CSimulation does splash redistribution on the whole grid at each timestep
@@ -40,416 +53,248 @@ void CSimulation::DoAllSplash(void)
       // double dTotSiltOffEdge = 0;
       // double dTotSandOffEdge = 0;
 
-      for (int nX = 0; nX < m_nXGridMax; nX++)
+      // Only cells which have had rain during this iteration can have splash detachment. The rain-hit list is in the same order as the spans of active cells, so the cells are dealt with in the same order as before
+      for (int i = 0; i < m_pGrid->nGetNumRainHit(); i++)
       {
-         for (int nY = 0; nY < m_nYGridMax; nY++)
-         {
-            if (m_Cell[nX][nY].bIsMissingValue())
-               continue;
+         int
+            nThis = m_pGrid->nGetRainHit(i),
+            nX = m_pGrid->nGetXFromIndex(nThis),
+            nY = m_pGrid->nGetYFromIndex(nThis);
 
-            // Get the depth of rain on this cell during this iteration, if any
-            double dRain = m_Cell[nX][nY].pGetRainAndRunon()->dGetRain();
+         // Get the depth of rain on this cell during this iteration
+         double dRain = m_Cell[nX][nY].pGetRainAndRunon()->dGetRain();
 
-            if (bFpEQ(dRain, 0.0, TOLERANCE))
-               continue;
+         if (bFpEQ(dRain, 0.0, TOLERANCE))
+            continue;
 
-            // OK, some rain fell on this cell. So calculate the kinetic energy of the rain = 0.5 m v**2
-            double dKE = m_dPartKE * dRain;
-            m_dEndOfIterKE += dKE;
+         // OK, some rain fell on this cell. So calculate the kinetic energy of the rain = 0.5 m v**2
+         double dKE = m_dPartKE * dRain;
+         m_dEndOfIterKE += dKE;
 
-            // Now calculate the decrease in elevation due to splash
-            double dSplashErosion = dKE * m_dSplashConstantNormalized;
+         // Now calculate the decrease in elevation due to splash
+         double dSplashErosion = dKE * m_dSplashConstantNormalized;
 
-            // We have splash detachment. Attenuate the decrease in elevation depending on the depth of surface water
-            dSplashErosion *= dCalcSplashCubicSpline(m_Cell[nX][nY].pGetSurfaceWater()->dGetSurfaceWaterDepth());
+         // We have splash detachment. Attenuate the decrease in elevation depending on the depth of surface water
+         dSplashErosion *= dLookUpSplashEfficiency(m_pGrid->dGetSurfaceWaterDepth(nThis));
 
-            // Now do the splash detachment
-            double dClayDetach = 0;
-            double dSiltDetach = 0;
-            double dSandDetach = 0;
-            m_Cell[nX][nY].pGetSoil()->DoSplashDetach(dSplashErosion, dClayDetach, dSiltDetach, dSandDetach);
+         // Now do the splash detachment
+         double dClayDetach = 0;
+         double dSiltDetach = 0;
+         double dSandDetach = 0;
+         m_Cell[nX][nY].pGetSoil()->DoSplashDetach(dSplashErosion, dClayDetach, dSiltDetach, dSandDetach);
 
-            // // And add to totals detached
-            // dTotClayDetach += dClayDetach;
-            // dTotSiltDetach += dSiltDetach;
-            // dTotSandDetach += dSandDetach;
+         // // And add to totals detached
+         // dTotClayDetach += dClayDetach;
+         // dTotSiltDetach += dSiltDetach;
+         // dTotSandDetach += dSandDetach;
 
-            // Next, distribute the detached soil onto the adjacent cells, either as deposition or (if the cell is wet) as sediment load
-            double dThisElev = m_Cell[nX][nY].pGetSoil()->dGetSoilSurfaceElevation();
+         // Next, distribute the detached soil onto the adjacent cells, either as deposition or (if the cell is wet) as sediment load
+         double dThisElev = m_pGrid->dGetSoilSurfaceElevation(nThis);
 
-            for (int nDirection = 0; nDirection < 4; nDirection++)
+         for (int nDirection = 0; nDirection < 4; nDirection++)
+         {
+            // Deal with this direction (planview top, top right, right or bottom right) and the opposite direction together
+            int
+               nDirOpposite = nDirection + 4,
+               nAdjOneSide = m_pGrid->nGetNeighbour(nThis, nDirection),
+               nAdjOtherSide = m_pGrid->nGetNeighbour(nThis, nDirOpposite),
+               nXAdjOneSide = m_pGrid->nGetXFromIndex(nAdjOneSide),
+               nYAdjOneSide = m_pGrid->nGetYFromIndex(nAdjOneSide),
+               nXAdjOtherSide = m_pGrid->nGetXFromIndex(nAdjOtherSide),
+               nYAdjOtherSide = m_pGrid->nGetYFromIndex(nAdjOtherSide),
+               nEdge = m_Cell[nX][nY].nGetEdge();
+            bool bDownSlopeThis = true;
+            bool bDownSlopeOpposite = true;
+            double dTanBetaThis = 0;
+            double dTanBetaOpposite = 0;
+
+            // Splash goes off-edge in a direction if this cell is on an edge which faces that way (for a diagonal direction, on either of the edges which make it up), or if the adjacent cell in that direction is in the halo
+            bool bOffEdgeThis = (bIsEdgeInDirection(nEdge, nDirection) || m_pGrid->bIsOffGrid(nAdjOneSide));
+            bool bOffEdgeOpposite = (bIsEdgeInDirection(nEdge, nDirOpposite) || m_pGrid->bIsOffGrid(nAdjOtherSide));
+
+            if (! bOffEdgeThis)
             {
-               int nXAdjOneSide;
-               int nYAdjOneSide;
-               int nXAdjOtherSide;
-               int nYAdjOtherSide;
-               bool bOffEdgeThis = false;
-               bool bOffEdgeOpposite = false;
-               bool bDownSlopeThis = false;
-               bool bDownSlopeOpposite = false;
-               double dTanBetaThis;
-               double dTanBetaOpposite;
-
-               if (nDirection == DIRECTION_TOP)
+               // Not on an edge in this direction. Get the elevation difference
+               double dElevDiff = dThisElev - m_pGrid->dGetSoilSurfaceElevation(nAdjOneSide);
+
+               // Is there a downslope gradient to the adjacent cell?
+               if (dElevDiff < 0)
+                  bDownSlopeThis = false;
+
+               dTanBetaThis = dElevDiff * m_dInvCellSide;
+            }
+
+            if (! bOffEdgeOpposite)
+            {
+               // Not on an edge in the opposite direction. Get the elevation difference
+               double dElevDiff = dThisElev - m_pGrid->dGetSoilSurfaceElevation(nAdjOtherSide);
+
+               // Is there a downslope gradient to the adjacent cell?
+               if (dElevDiff < 0)
+                  bDownSlopeOpposite = false;
+
+               dTanBetaOpposite = dElevDiff * m_dInvCellSide;
+            }
+
+            // Assume that splash is radially symmetrical, so allocate 1/4 of total sediment detached to the four angular directions: this is then split between 'this' and 'opposite' directions
+            double dClayToDepositBothSides = dClayDetach / 4;
+            double dSiltToDepositBothSides = dSiltDetach / 4;
+            double dSandToDepositBothSides = dSandDetach / 4;
+
+            double dClayToDepositThis;
+            double dClayToDepositOpposite;
+            double dSiltToDepositThis;
+            double dSiltToDepositOpposite;
+            double dSandToDepositThis;
+            double dSandToDepositOpposite;
+
+            if (bOffEdgeThis && bOffEdgeOpposite)
+            {
+               // Only applies to corner cells going diaginally (i.e. TL to BR or TR to BL), all goes off-edge
+               m_Cell[nX][nY].pGetSoil()->DoClaySplashOffEdge(dClayToDepositBothSides);
+               m_Cell[nX][nY].pGetSoil()->DoSiltSplashOffEdge(dSiltToDepositBothSides);
+               m_Cell[nX][nY].pGetSoil()->DoSandSplashOffEdge(dSandToDepositBothSides);
+
+               // dTotClayOffEdge += dClayToDepositBothSides;
+               // dTotSiltOffEdge += dSiltToDepositBothSides;
+               // dTotSandOffEdge += dSandToDepositBothSides;
+            }
+            else if (bOffEdgeThis)
+            {
+               // Assume that half goes off-edge on this side
+               dClayToDepositThis = dClayToDepositOpposite = dClayToDepositBothSides / 2;
+               dSiltToDepositThis = dSiltToDepositOpposite = dSiltToDepositBothSides / 2;
+               dSandToDepositThis = dSandToDepositOpposite = dSandToDepositBothSides / 2;
+
+               m_Cell[nX][nY].pGetSoil()->DoClaySplashOffEdge(dClayToDepositThis);
+               m_Cell[nX][nY].pGetSoil()->DoSiltSplashOffEdge(dSiltToDepositThis);
+               m_Cell[nX][nY].pGetSoil()->DoSandSplashOffEdge(dSandToDepositThis);
+
+               // dTotClayOffEdge += dClayToDepositThis;
+               // dTotSiltOffEdge += dSiltToDepositThis;
+               // dTotSandOffEdge += dSandToDepositThis;
+
+               // And half is either deposited or moved to sediment load on the opposite side
+               bool bToSedLoad = false;
+               m_Cell[nXAdjOtherSide][nYAdjOtherSide].pGetSoil()->DoSplashToSedLoadOrDeposit(dClayToDepositOpposite, dSiltToDepositOpposite, dSandToDepositOpposite, bToSedLoad);
+
+               // And add to totals
+               if (bToSedLoad)
                {
-                  // Planview top
-                  nXAdjOneSide = nX;
-                  nYAdjOneSide = nY-1;
-                  bOffEdgeThis = false;
-                  bDownSlopeThis = true;
-
-                  if ((m_Cell[nX][nY].nGetEdge() == DIRECTION_TOP) || (nY == 0))
-                  {
-                     // This is a cell on the planview top edge
-                     bOffEdgeThis = true;
-                  }
-                  else
-                  {
-                     // Not on planview top edge. Get the elevation difference
-                     double dElevDiff = dThisElev - m_Cell[nXAdjOneSide][nYAdjOneSide].pGetSoil()->dGetSoilSurfaceElevation();
-
-                     // Is there a downslope gradient to the adjacent cell?
-                     if (dElevDiff < 0)
-                        bDownSlopeThis = false;
-
-                     dTanBetaThis = dElevDiff * m_dInvCellSide;
-                  }
-
-                  // Now deal with the opposite direction, which is planview bottom
-                  nXAdjOtherSide = nX;
-                  nYAdjOtherSide = nY+1;
-                  bOffEdgeOpposite = false;
-                  bDownSlopeOpposite = true;
-
-                  if ((m_Cell[nX][nY].nGetEdge() == DIRECTION_BOTTOM) || (nY == m_nYGridMax-1))
-                  {
-                     // This is a cell on the planview bottom edge
-                     bOffEdgeOpposite = true;
-                  }
-                  else
-                  {
-                     // Not on planview bottom edge. Get the elevation difference
-                     double dElevDiff = dThisElev - m_Cell[nXAdjOtherSide][nYAdjOtherSide].pGetSoil()->dGetSoilSurfaceElevation();
-
-                     // Is there a downslope gradient to the adjacent cell?
-                     if (dElevDiff < 0)
-                        bDownSlopeOpposite = false;
-
-                     dTanBetaOpposite = dElevDiff * m_dInvCellSide;
-                  }
+                  // dTotClayToSedLoad += dClayToDepositOpposite;
+                  // dTotSiltToSedLoad += dSiltToDepositOpposite;
+                  // dTotSandToSedLoad += dSandToDepositOpposite;
                }
-
-               else if (nDirection == DIRECTION_TOP_RIGHT)
+               else
                {
-                  // Planview top right
-                  nXAdjOneSide = nX+1;
-                  nYAdjOneSide = nY-1;
-                  bOffEdgeThis = false;
-                  bDownSlopeThis = true;
-
-                  int nEdge = m_Cell[nX][nY].nGetEdge();
-                  if ((nEdge == DIRECTION_TOP) || (nEdge == DIRECTION_RIGHT) || (nY == 0) || (nX == m_nXGridMax-1))
-                  {
-                     // This is a cell on the planview top edge or the planview right edge
-                     bOffEdgeThis = true;
-                  }
-                  else
-                  {
-                     // Not on planview top edge or planview right edge. Get the elevation difference
-                     double dElevDiff = dThisElev - m_Cell[nXAdjOneSide][nYAdjOneSide].pGetSoil()->dGetSoilSurfaceElevation();
-
-                     // Is there a downslope gradient to the adjacent cell?
-                     if (dElevDiff < 0)
-                        bDownSlopeThis = false;
-
-                     dTanBetaThis = dElevDiff * m_dInvCellSide;
-                  }
-
-                  // Now deal with the opposite direction, which is planview bottom left
-                  nXAdjOtherSide = nX-1;
-                  nYAdjOtherSide = nY+1;
-                  bOffEdgeOpposite = false;
-                  bDownSlopeOpposite = true;
-
-                  nEdge = m_Cell[nX][nY].nGetEdge();
-                  if ((nEdge == DIRECTION_BOTTOM) || (nEdge == DIRECTION_LEFT) || (nY == m_nYGridMax-1) || (nX == 0))
-                  {
-                     // This is a cell on the planview bottom edge or the planview left edge
-                     bOffEdgeOpposite = true;
-                  }
-                  else
-                  {
-                     // Not on planview bottom edge or the planview left edge. Get the elevation difference
-                     double dElevDiff = dThisElev - m_Cell[nXAdjOtherSide][nYAdjOtherSide].pGetSoil()->dGetSoilSurfaceElevation();
-
-                     // Is there a downslope gradient to the adjacent cell?
-                     if (dElevDiff < 0)
-                        bDownSlopeOpposite = false;
-
-                     dTanBetaOpposite = dElevDiff * m_dInvCellSide;
-                  }
+                  // dTotClayDeposit += dClayToDepositOpposite;
+                  // dTotSiltDeposit += dSiltToDepositOpposite;
+                  // dTotSandDeposit += dSandToDepositOpposite;
                }
+            }
+            else if (bOffEdgeOpposite)
+            {
+               // Assume that half goes off-edge on the opposite side
+               dClayToDepositThis = dClayToDepositOpposite = dClayToDepositBothSides / 2;
+               dSiltToDepositThis = dSiltToDepositOpposite = dSiltToDepositBothSides / 2;
+               dSandToDepositThis = dSandToDepositOpposite = dSandToDepositBothSides / 2;
+
+               m_Cell[nX][nY].pGetSoil()->DoClaySplashOffEdge(dClayToDepositOpposite);
+               m_Cell[nX][nY].pGetSoil()->DoSiltSplashOffEdge(dSiltToDepositOpposite);
+               m_Cell[nX][nY].pGetSoil()->DoSandSplashOffEdge(dSandToDepositOpposite);
 
-               else if (nDirection == DIRECTION_RIGHT)
+               // dTotClayOffEdge += dClayToDepositOpposite;
+               // dTotSiltOffEdge += dSiltToDepositOpposite;
+               // dTotSandOffEdge += dSandToDepositOpposite;
+
+               // And half is either deposited or moved to sediment load on this side
+               bool bToSedLoad = false;
+               m_Cell[nXAdjOneSide][nYAdjOneSide].pGetSoil()->DoSplashToSedLoadOrDeposit(dClayToDepositThis, dSiltToDepositThis, dSandToDepositThis, bToSedLoad);
+
+               // And add to totals
+               if (bToSedLoad)
+               {
+                  // dTotClayToSedLoad += dClayToDepositThis;
+                  // dTotSiltToSedLoad += dSiltToDepositThis;
+                  // dTotSandToSedLoad += dSandToDepositThis;
+               }
+               else
                {
-                  // Planview right
-                  nXAdjOneSide = nX+1;
-                  nYAdjOneSide = nY;
-                  bOffEdgeThis = false;
-                  bDownSlopeThis = true;
-
-                  if ((m_Cell[nX][nY].nGetEdge() == DIRECTION_RIGHT) || (nX == m_nXGridMax-1))
-                  {
-                     // This is a cell on the planview right edge
-                     bOffEdgeThis = true;
-                  }
-                  else
-                  {
-                     // Not on planview right edge. Get the elevation difference
-                     double dElevDiff = dThisElev - m_Cell[nXAdjOneSide][nYAdjOneSide].pGetSoil()->dGetSoilSurfaceElevation();
-
-                     // Is there a downslope gradient to the adjacent cell?
-                     if (dElevDiff < 0)
-                        bDownSlopeThis = false;
-
-                     dTanBetaThis = dElevDiff * m_dInvCellSide;
-                  }
-
-                  // Now deal with the opposite direction, which is planview left
-                  nXAdjOtherSide = nX-1;
-                  nYAdjOtherSide = nY;
-                  bOffEdgeOpposite = false;
-                  bDownSlopeOpposite = true;
-
-                  if ((m_Cell[nX][nY].nGetEdge() == DIRECTION_LEFT) || (nX == 0))
-                  {
-                     // This is a cell on the planview left edge
-                     bOffEdgeOpposite = true;
-                  }
-                  else
-                  {
-                     // Not on planview left edge. Get the elevation difference
-                     double dElevDiff = dThisElev - m_Cell[nXAdjOtherSide][nYAdjOtherSide].pGetSoil()->dGetSoilSurfaceElevation();
-
-                     // Is there a downslope gradient to the adjacent cell?
-                     if (dElevDiff < 0)
-                        bDownSlopeOpposite = false;
-
-                     dTanBetaOpposite = dElevDiff * m_dInvCellSide;
-                  }
+                  // dTotClayDeposit += dClayToDepositThis;
+                  // dTotSiltDeposit += dSiltToDepositThis;
+                  // dTotSandDeposit += dSandToDepositThis;
                }
+            }
+            else
+            {
+               // This is not an edge cell. Sort out this and opposite downslope and upslope gradients. Poesen (1985) found the downslope share of splashed sediment to be 1 - 0.5 * e ^ (-2.2 * tan(beta)), where beta is slope angle
+               double dShareThis = 0;
+               double dShareOpposite = 0;
 
-               else if (nDirection == DIRECTION_BOTTOM_RIGHT)
+               if (bDownSlopeThis && bDownSlopeOpposite)
+               {
+                  // On a peak, downslope on both this and opposite sides. Just assume that half goes to each side
+                  dShareThis = 0.5;
+                  dShareOpposite = 0.5;
+               }
+               else if (bDownSlopeThis && (! bDownSlopeOpposite))
+               {
+                  // Downslope only on this side, upslope (or offedge) on opposite side
+                  dShareThis = exp(m_dPoesenSplashConstant * dTanBetaThis);
+                  dShareOpposite = 1 - dShareThis;
+               }
+               else if ((! bDownSlopeThis) && bDownSlopeOpposite)
+               {
+                  // Downslope only on opposite side, upslope (or offedge) on this side
+                  dShareOpposite = exp(m_dPoesenSplashConstant * dTanBetaOpposite);
+                  dShareThis = 1 - dShareOpposite;
+               }
+               else if ((! bDownSlopeThis) && (! bDownSlopeOpposite))
                {
-                  // Planview bottom right
-                  nXAdjOneSide = nX+1;
-                  nYAdjOneSide = nY+1;
-                  bOffEdgeThis = false;
-                  bDownSlopeThis = true;
-
-                  int nEdge = m_Cell[nX][nY].nGetEdge();
-                  if ((nEdge == DIRECTION_BOTTOM) || (nEdge == DIRECTION_RIGHT) || (nY == m_nYGridMax-1) || (nX == m_nXGridMax-1))
-                  {
-                     // This is a cell on the planview bottom edge or the planview right edge
-                     bOffEdgeThis = true;
-                  }
-                  else
-                  {
-                     // Not on planview bottom edge or planview right edge. Get the elevation difference
-                     double dElevDiff = dThisElev - m_Cell[nXAdjOneSide][nYAdjOneSide].pGetSoil()->dGetSoilSurfaceElevation();
-
-                     // Is there a downslope gradient to the adjacent cell?
-                     if (dElevDiff < 0)
-                        bDownSlopeThis = false;
-
-                     dTanBetaThis = dElevDiff * m_dInvCellSide;
-                  }
-
-                  // Now deal with the opposite direction, which is planview top left
-                  nXAdjOtherSide = nX-1;
-                  nYAdjOtherSide = nY-1;
-                  bOffEdgeOpposite = false;
-                  bDownSlopeOpposite = true;
-
-                  nEdge = m_Cell[nX][nY].nGetEdge();
-                  if ((nEdge == DIRECTION_TOP) || (nEdge == DIRECTION_LEFT) || (nX == 0) || (nY == 0))
-                  {
-                     // This is a cell on the planview top edge or the planview left edge
-                     bOffEdgeOpposite = true;
-                  }
-                  else
-                  {
-                     // Not on planview top edge or the planview left edge. Get the elevation difference
-                     double dElevDiff = dThisElev - m_Cell[nXAdjOtherSide][nYAdjOtherSide].pGetSoil()->dGetSoilSurfaceElevation();
-
-                     // Is there a downslope gradient to the adjacent cell?
-                     if (dElevDiff < 0)
-                        bDownSlopeOpposite = false;
-
-                     dTanBetaOpposite = dElevDiff * m_dInvCellSide;
-                  }
+                  // In a hollow, upslope on both this and opposite sides. Just assume that half goes to each side
+                  dShareThis = 0.5;
+                  dShareOpposite = 0.5;
                }
 
-               // Assume that splash is radially symmetrical, so allocate 1/4 of total sediment detached to the four angular directions: this is then split between 'this' and 'opposite' directions
-               double dClayToDepositBothSides = dClayDetach / 4;
-               double dSiltToDepositBothSides = dSiltDetach / 4;
-               double dSandToDepositBothSides = dSandDetach / 4;
+               dClayToDepositThis = dClayToDepositBothSides * dShareThis;
+               dClayToDepositOpposite = dClayToDepositBothSides * dShareOpposite;
+               dSiltToDepositThis = dSiltToDepositBothSides * dShareThis;
+               dSiltToDepositOpposite = dSiltToDepositBothSides * dShareOpposite;
+               dSandToDepositThis = dSandToDepositBothSides * dShareThis;
+               dSandToDepositOpposite = dSandToDepositBothSides * dShareOpposite;
 
-               double dClayToDepositThis;
-               double dClayToDepositOpposite;
-               double dSiltToDepositThis;
-               double dSiltToDepositOpposite;
-               double dSandToDepositThis;
-               double dSandToDepositOpposite;
+               bool bToSedLoad = false;
+               m_Cell[nXAdjOneSide][nYAdjOneSide].pGetSoil()->DoSplashToSedLoadOrDeposit(dClayToDepositThis, dSiltToDepositThis, dSandToDepositThis, bToSedLoad);
 
-               if (bOffEdgeThis && bOffEdgeOpposite)
+               // And add to totals
+               if (bToSedLoad)
                {
-                  // Only applies to corner cells going diaginally (i.e. TL to BR or TR to BL), all goes off-edge
-                  m_Cell[nX][nY].pGetSoil()->DoClaySplashOffEdge(dClayToDepositBothSides);
-                  m_Cell[nX][nY].pGetSoil()->DoSiltSplashOffEdge(dSiltToDepositBothSides);
-                  m_Cell[nX][nY].pGetSoil()->DoSandSplashOffEdge(dSandToDepositBothSides);
-
-                  // dTotClayOffEdge += dClayToDepositBothSides;
-                  // dTotSiltOffEdge += dSiltToDepositBothSides;
-                  // dTotSandOffEdge += dSandToDepositBothSides;
+                  // dTotClayToSedLoad += dClayToDepositThis;
+                  // dTotSiltToSedLoad += dSiltToDepositThis;
+                  // dTotSandToSedLoad += dSandToDepositThis;
                }
-               else if (bOffEdgeThis)
+               else
                {
-                  // Assume that half goes off-edge on this side
-                  dClayToDepositThis = dClayToDepositOpposite = dClayToDepositBothSides / 2;
-                  dSiltToDepositThis = dSiltToDepositOpposite = dSiltToDepositBothSides / 2;
-                  dSandToDepositThis = dSandToDepositOpposite = dSandToDepositBothSides / 2;
-
-                  m_Cell[nX][nY].pGetSoil()->DoClaySplashOffEdge(dClayToDepositThis);
-                  m_Cell[nX][nY].pGetSoil()->DoSiltSplashOffEdge(dSiltToDepositThis);
-                  m_Cell[nX][nY].pGetSoil()->DoSandSplashOffEdge(dSandToDepositThis);
-
-                  // dTotClayOffEdge += dClayToDepositThis;
-                  // dTotSiltOffEdge += dSiltToDepositThis;
-                  // dTotSandOffEdge += dSandToDepositThis;
-
-                  // And half is either deposited or moved to sediment load on the opposite side
-                  bool bToSedLoad = false;
-                  m_Cell[nXAdjOtherSide][nYAdjOtherSide].pGetSoil()->DoSplashToSedLoadOrDeposit(dClayToDepositOpposite, dSiltToDepositOpposite, dSandToDepositOpposite, bToSedLoad);
-
-                  // And add to totals
-                  if (bToSedLoad)
-                  {
-                     // dTotClayToSedLoad += dClayToDepositOpposite;
-                     // dTotSiltToSedLoad += dSiltToDepositOpposite;
-                     // dTotSandToSedLoad += dSandToDepositOpposite;
-                  }
-                  else
-                  {
-                     // dTotClayDeposit += dClayToDepositOpposite;
-                     // dTotSiltDeposit += dSiltToDepositOpposite;
-                     // dTotSandDeposit += dSandToDepositOpposite;
-                  }
+                  // dTotClayDeposit += dClayToDepositThis;
+                  // dTotSiltDeposit += dSiltToDepositThis;
+                  // dTotSandDeposit += dSandToDepositThis;
                }
-               else if (bOffEdgeOpposite)
+
+               bToSedLoad = false;
+               m_Cell[nXAdjOtherSide][nYAdjOtherSide].pGetSoil()->DoSplashToSedLoadOrDeposit(dClayToDepositOpposite, dSiltToDepositOpposite, dSandToDepositOpposite, bToSedLoad);
+
+               // And add to totals
+               if (bToSedLoad)
                {
-                  // Assume that half goes off-edge on the opposite side
-                  dClayToDepositThis = dClayToDepositOpposite = dClayToDepositBothSides / 2;
-                  dSiltToDepositThis = dSiltToDepositOpposite = dSiltToDepositBothSides / 2;
-                  dSandToDepositThis = dSandToDepositOpposite = dSandToDepositBothSides / 2;
-
-                  m_Cell[nX][nY].pGetSoil()->DoClaySplashOffEdge(dClayToDepositOpposite);
-                  m_Cell[nX][nY].pGetSoil()->DoSiltSplashOffEdge(dSiltToDepositOpposite);
-                  m_Cell[nX][nY].pGetSoil()->DoSandSplashOffEdge(dSandToDepositOpposite);
-
-                  // dTotClayOffEdge += dClayToDepositOpposite;
-                  // dTotSiltOffEdge += dSiltToDepositOpposite;
-                  // dTotSandOffEdge += dSandToDepositOpposite;
-
-                  // And half is either deposited or moved to sediment load on this side
-                  bool bToSedLoad = false;
-                  m_Cell[nXAdjOneSide][nYAdjOneSide].pGetSoil()->DoSplashToSedLoadOrDeposit(dClayToDepositThis, dSiltToDepositThis, dSandToDepositThis, bToSedLoad);
-
-                  // And add to totals
-                  if (bToSedLoad)
-                  {
-                     // dTotClayToSedLoad += dClayToDepositThis;
-                     // dTotSiltToSedLoad += dSiltToDepositThis;
-                     // dTotSandToSedLoad += dSandToDepositThis;
-                  }
-                  else
-                  {
-                     // dTotClayDeposit += dClayToDepositThis;
-                     // dTotSiltDeposit += dSiltToDepositThis;
-                     // dTotSandDeposit += dSandToDepositThis;
-                  }
+                  // dTotClayToSedLoad += dClayToDepositOpposite;
+                  // dTotSiltToSedLoad += dSiltToDepositOpposite;
+                  // dTotSandToSedLoad += dSandToDepositOpposite;
                }
                else
                {
-                  // This is not an edge cell. Sort out this and opposite downslope and upslope gradients. Poesen (1985) found the downslope share of splashed sediment to be 1 - 0.5 * e ^ (-2.2 * tan(beta)), where beta is slope angle
-                  double dShareThis = 0;
-                  double dShareOpposite = 0;
-
-                  if (bDownSlopeThis && bDownSlopeOpposite)
-                  {
-                     // On a peak, downslope on both this and opposite sides. Just assume that half goes to each side
-                     dShareThis = 0.5;
-                     dShareOpposite = 0.5;
-                  }
-                  else if (bDownSlopeThis && (! bDownSlopeOpposite))
-                  {
-                     // Downslope only on this side, upslope (or offedge) on opposite side
-                     dShareThis = exp(m_dPoesenSplashConstant * dTanBetaThis);
-                     dShareOpposite = 1 - dShareThis;
-                  }
-                  else if ((! bDownSlopeThis) && bDownSlopeOpposite)
-                  {
-                     // Downslope only on opposite side, upslope (or offedge) on this side
-                     dShareOpposite = exp(m_dPoesenSplashConstant * dTanBetaOpposite);
-                     dShareThis = 1 - dShareOpposite;
-                  }
-                  else if ((! bDownSlopeThis) && (! bDownSlopeOpposite))
-                  {
-                     // In a hollow, upslope on both this and opposite sides. Just assume that half goes to each side
-                     dShareThis = 0.5;
-                     dShareOpposite = 0.5;
-                  }
-
-                  dClayToDepositThis = dClayToDepositBothSides * dShareThis;
-                  dClayToDepositOpposite = dClayToDepositBothSides * dShareOpposite;
-                  dSiltToDepositThis = dSiltToDepositBothSides * dShareThis;
-                  dSiltToDepositOpposite = dSiltToDepositBothSides * dShareOpposite;
-                  dSandToDepositThis = dSandToDepositBothSides * dShareThis;
-                  dSandToDepositOpposite = dSandToDepositBothSides * dShareOpposite;
-
-                  bool bToSedLoad = false;
-                  m_Cell[nXAdjOneSide][nYAdjOneSide].pGetSoil()->DoSplashToSedLoadOrDeposit(dClayToDepositThis, dSiltToDepositThis, dSandToDepositThis, bToSedLoad);
-
-                  // And add to totals
-                  if (bToSedLoad)
-                  {
-                     // dTotClayToSedLoad += dClayToDepositThis;
-                     // dTotSiltToSedLoad += dSiltToDepositThis;
-                     // dTotSandToSedLoad += dSandToDepositThis;
-                  }
-                  else
-                  {
-                     // dTotClayDeposit += dClayToDepositThis;
-                     // dTotSiltDeposit += dSiltToDepositThis;
-                     // dTotSandDeposit += dSandToDepositThis;
-                  }
-
-                  bToSedLoad = false;
-                  m_Cell[nXAdjOtherSide][nYAdjOtherSide].pGetSoil()->DoSplashToSedLoadOrDeposit(dClayToDepositOpposite, dSiltToDepositOpposite, dSandToDepositOpposite, bToSedLoad);
-
-                  // And add to totals
-                  if (bToSedLoad)
-                  {
-                     // dTotClayToSedLoad += dClayToDepositOpposite;
-                     // dTotSiltToSedLoad += dSiltToDepositOpposite;
-                     // dTotSandToSedLoad += dSandToDepositOpposite;
-                  }
-                  else
-                  {
-                     // dTotClayDeposit += dClayToDepositOpposite;
-                     // dTotSiltDeposit += dSiltToDepositOpposite;
-                     // dTotSandDeposit += dSandToDepositOpposite;
-                  }
+                  // dTotClayDeposit += dClayToDepositOpposite;
+                  // dTotSiltDeposit += dSiltToDepositOpposite;
+                  // dTotSandDeposit += dSandToDepositOpposite;
                }
             }
          }
@@ -466,96 +311,98 @@ void CSimulation::DoAllSplash(void)
 
    if (m_bPlanchonSplashEqn)
    {
-      // Using the Planchon et al. approach: modified from Planchon O., Esteves M., Silvera N. and Lapetite J.M. (2000). Raindrop erosion of tillage induced microrelief. Possible use of the diffusion equation. Soil and Tillage Research 56(3-4), 131-144. First calculate the Laplacian for all cells in the grid, also zero each cell's temporary splash deposition value
-      if (m_bSplashForward)
+      // Using the Planchon et al. approach: modified from Planchon O., Esteves M., Silvera N. and Lapetite J.M. (2000). Raindrop erosion of tillage induced microrelief. Possible use of the diffusion equation. Soil and Tillage Research 56(3-4), 131-144. First calculate the Laplacian for all cells in the grid. This only reads soil surface elevations, which do not change during the calculation, so the order in which cells are visited does not matter
+      m_pGrid->CalcAllLaplacian(m_dPlanchonCellSizeKC);
+
+      // DEBUG_SEDLOAD("just before splash");
+
+      // Now calculate the splash detachment for cells which have just received some rain (these are the cells in the rain-hit list). change in elevation due to splash redistribution for each cell. A problem with this approach is that the totals for detached and deposited sediment are not identical i.e. mass is not conserved. So this has to be corrected. Each cell's detachment only changes that cell, so this is done in parallel; however the list is split into fixed-size chunks, and the totals are first summed for each chunk, then the chunk totals are summed in chunk order, so that the totals do not depend on the number of threads
+      int
+         nRainCell = m_pGrid->nGetNumRainHit(),
+         nChunks = (nRainCell + ACTIVE_LIST_CHUNK - 1) / ACTIVE_LIST_CHUNK;
+      vector<double> VdChunkKE(nChunks, 0);
+      vector<double> VdChunkClayDetach(nChunks, 0);
+      vector<double> VdChunkSiltDetach(nChunks, 0);
+      vector<double> VdChunkSandDetach(nChunks, 0);
+      vector<double> VdChunkAllDeposit(nChunks, 0);
+
+#if defined _OPENMP
+      #pragma omp parallel for schedule(dynamic)
+#endif
+      for (int nChunk = 0; nChunk < nChunks; nChunk++)
       {
-         for (int nX = 0; nX < m_nXGridMax; nX++)
+         int
+            nFirst = nChunk * ACTIVE_LIST_CHUNK,
+            nLast = tMin((nChunk + 1) * ACTIVE_LIST_CHUNK, nRainCell);
+
+         // First look up the splash efficiency (which depends on the depth of surface water) for every cell in the chunk, this is only needed for cells with splash detachment but is cheap and vectorizes
+         double dChunkEff[ACTIVE_LIST_CHUNK];
+#if defined _OPENMP
+         #pragma omp simd
+#endif
+         for (int i = nFirst; i < nLast; i++)
+            dChunkEff[i - nFirst] = dLookUpSplashEfficiency(m_pGrid->dGetSurfaceWaterDepth(m_pGrid->nGetRainHit(i)));
+
+         for (int i = nFirst; i < nLast; i++)
          {
-            for (int nY = 0; nY < m_nYGridMax; nY++)
+            int
+               n = m_pGrid->nGetRainHit(i),
+               nX = m_pGrid->nGetXFromIndex(n),
+               nY = m_pGrid->nGetYFromIndex(n);
+
+            // Get the depth of rain which fell during this iteration, this is always non-zero for cells in the rain-hit list. TODO CHECK Note that this assumes that splash calcs are run EVERY iteration when there is rain
+            double dRain = m_Cell[nX][nY].pGetRainAndRunon()->dGetRain();
+
+            // Calculate the kinetic energy of the rain = 0.5 m v**2
+            double dKE = m_dPartKE * dRain;
+            VdChunkKE[nChunk] += dKE;
+
+            // Now calculate the amount of splash detachment or deposition resulting from this KE
+            double dL = m_pGrid->dGetLaplacian(n);
+            double dToChange = dKE * m_dSplashConstantNormalized * dL;
+            // if (bFpEQ(dToChange, 0.0, TOLERANCE))
+            //    continue;
+            // else if (dToChange > 0)
+            if (dToChange > 0)
             {
-               if (m_Cell[nX][nY].bIsMissingValue())
-                  continue;
+               // We have splash deposition: save the dToChange value for this cell for the moment, to be corrected later
+               m_Cell[nX][nY].pGetSoil()->SetSplashDepositTemp(dToChange);
 
-               m_Cell[nX][nY].pGetSoil()->SetLaplacian(dCalcLaplacian(nX, nY));
+               VdChunkAllDeposit[nChunk] += dToChange;
             }
-         }
-      }
-      else
-      {
-         for (int nX = m_nXGridMax-1; nX >= 0; nX--)
-         {
-            for (int nY = m_nYGridMax-1; nY >= 0; nY--)
+            else
             {
-               if (m_Cell[nX][nY].bIsMissingValue())
-                  continue;
+               // We have splash detachment. First attenuate the dToChange depending on the depth of surface water
+               dToChange *= dChunkEff[i - nFirst];
 
-               m_Cell[nX][nY].pGetSoil()->SetLaplacian(dCalcLaplacian(nX, nY));
+               // Now do the detachment
+               double dClayDetach = 0;
+               double dSiltDetach = 0;
+               double dSandDetach = 0;
+
+               m_Cell[nX][nY].pGetSoil()->DoSplashDetach(-dToChange, dClayDetach, dSiltDetach, dSandDetach);
+
+               // And add to this chunk's totals detached
+               VdChunkClayDetach[nChunk] += dClayDetach;
+               VdChunkSiltDetach[nChunk] += dSiltDetach;
+               VdChunkSandDetach[nChunk] += dSandDetach;
             }
          }
       }
 
-      // DEBUG_SEDLOAD("just before splash");
-
-      // Change directon for next time
-      m_bSplashForward = ! m_bSplashForward;
-
-      // Now calculate the splash detachment for cells which have just received some rain. change in elevation due to splash redistribution for each cell. A problem with this approach is that the totals for detached and deposited sediment are not identical i.e. mass is not conserved. So this has to be corrected
-      int nRainCell = 0;
+      // Sum the chunk totals, always in the same order
       double dTotClayDetach = 0;
       double dTotSiltDetach = 0;
       double dTotSandDetach = 0;
       double dTmpSplashTotAllDeposit = 0;
 
-      for (int nX = 0; nX < m_nXGridMax; nX++)
+      for (int nChunk = 0; nChunk < nChunks; nChunk++)
       {
-         for (int nY = 0; nY < m_nYGridMax; nY++)
-         {
-            if (m_Cell[nX][nY].bIsMissingValue())
-               continue;
-
-            // Get the depth of rain which fell during this iteration. TODO CHECK Note that this assumes that splash calcs are run EVERY iteration when there is rain
-            double dRain = m_Cell[nX][nY].pGetRainAndRunon()->dGetRain();
-            if (dRain > 0)
-            {
-               // Some rain has fallen on this cell
-               nRainCell++;
-
-               // Calculate the kinetic energy of the rain = 0.5 m v**2
-               double dKE = m_dPartKE * dRain;
-               m_dEndOfIterKE += dKE;
-
-               // Now calculate the amount of splash detachment or deposition resulting from this KE
-               double dL = m_Cell[nX][nY].pGetSoil()->dGetLaplacian();
-               double dToChange = dKE * m_dSplashConstantNormalized * dL;
-               // if (bFpEQ(dToChange, 0.0, TOLERANCE))
-               //    continue;
-               // else if (dToChange > 0)
-               if (dToChange > 0)
-               {
-                  // We have splash deposition: save the dToChange value for this cell for the moment, to be corrected later
-                  m_Cell[nX][nY].pGetSoil()->SetSplashDepositTemp(dToChange);
-
-                  dTmpSplashTotAllDeposit += dToChange;
-               }
-               else
-               {
-                  // We have splash detachment. First attenuate the dToChange depending on the depth of surface water
-                  dToChange *= dCalcSplashCubicSpline(m_Cell[nX][nY].pGetSurfaceWater()->dGetSurfaceWaterDepth());
-
-                  // Now do the detachment
-                  double dClayDetach = 0;
-                  double dSiltDetach = 0;
-                  double dSandDetach = 0;
-
-                  m_Cell[nX][nY].pGetSoil()->DoSplashDetach(-dToChange, dClayDetach, dSiltDetach, dSandDetach);
-
-                  // And add to totals detached
-                  dTotClayDetach += dClayDetach;
-                  dTotSiltDetach += dSiltDetach;
-                  dTotSandDetach += dSandDetach;
-               }
-            }
-         }
+         m_dEndOfIterKE += VdChunkKE[nChunk];
+         dTotClayDetach += VdChunkClayDetach[nChunk];
+         dTotSiltDetach += VdChunkSiltDetach[nChunk];
+         dTotSandDetach += VdChunkSandDetach[nChunk];
+         dTmpSplashTotAllDeposit += VdChunkAllDeposit[nChunk];
       }
 
       // DEBUG_SEDLOAD("middle splash");
@@ -580,51 +427,49 @@ void CSimulation::DoAllSplash(void)
       // double dCHECKSplashSedLoadSilt = 0;
       // double dCHECKSplashSedLoadSand = 0;
 
-      // Now go through all cells again, to correct for mass conservation
+      // Now go through the rain-hit cells again, to correct for mass conservation. Again, each cell only changes itself
       if (dTmpSplashTotAllDeposit > 0)
       {
-         for (int nX = 0; nX < m_nXGridMax; nX++)
+#if defined _OPENMP
+         #pragma omp parallel for schedule(dynamic, ACTIVE_LIST_CHUNK)
+#endif
+         for (int i = 0; i < nRainCell; i++)
          {
-            for (int nY = 0; nY < m_nYGridMax; nY++)
-            {
-               if (m_Cell[nX][nY].bIsMissingValue())
-                  continue;
-
-               // First get the temporary (incorrect) value for splash deposition on this cell
-               double dTmpSplashDeposit = m_Cell[nX][nY].pGetSoil()->dGetSplashDepositTemp();
-
-               double dRain = m_Cell[nX][nY].pGetRainAndRunon()->dGetRain();
-               if (dRain > 0)
-               {
-                  // nCHECKcells++;
-                  // Now correct the value for splash deposition
-                  double dThisCellAllTot = dTmpSplashDeposit + dTotCorrectionPerCell;
-                  // assert(dThisCellAllTot > 0);
-
-                  // And partition it into the three size classes
-                  double dThisCellClayDeposit = dThisCellAllTot * dFracClay;
-                  double dThisCellSiltDeposit = dThisCellAllTot * dFracSilt;
-                  double dThisCellSandDeposit = dThisCellAllTot * dFracSand;
-
-                  bool bToSedLoad;
-                  m_Cell[nX][nY].pGetSoil()->DoSplashToSedLoadOrDeposit(dThisCellClayDeposit, dThisCellSiltDeposit, dThisCellSandDeposit, bToSedLoad);
-
-                  // if (bToSedLoad)
-                  // {
-                  //    // CHECK
-                  //    dCHECKSplashSedLoadClay += dThisCellClayDeposit;
-                  //    dCHECKSplashSedLoadSilt += dThisCellSiltDeposit;
-                  //    dCHECKSplashSedLoadSand += dThisCellSandDeposit;
-                  // }
-                  // else
-                  // {
-                  //    // CHECK
-                  //    dCHECKSplashDepositClay += dThisCellClayDeposit;
-                  //    dCHECKSplashDepositSilt += dThisCellSiltDeposit;
-                  //    dCHECKSplashDepositSand += dThisCellSandDeposit;
-                  // }
-               }
-            }
+            int
+               n = m_pGrid->nGetRainHit(i),
+               nX = m_pGrid->nGetXFromIndex(n),
+               nY = m_pGrid->nGetYFromIndex(n);
+
+            // First get the temporary (incorrect) value for splash deposition on this cell
+            double dTmpSplashDeposit = m_Cell[nX][nY].pGetSoil()->dGetSplashDepositTemp();
+
+            // nCHECKcells++;
+            // Now correct the value for splash deposition
+            double dThisCellAllTot = dTmpSplashDeposit + dTotCorrectionPerCell;
+            // assert(dThisCellAllTot > 0);
+
+            // And partition it into the three size classes
+            double dThisCellClayDeposit = dThisCellAllTot * dFracClay;
+            double dThisCellSiltDeposit = dThisCellAllTot * dFracSilt;
+            double dThisCellSandDeposit = dThisCellAllTot * dFracSand;
+
+            bool bToSedLoad;
+            m_Cell[nX][nY].pGetSoil()->DoSplashToSedLoadOrDeposit(dThisCellClayDeposit, dThisCellSiltDeposit, dThisCellSandDeposit, bToSedLoad);
+
+            // if (bToSedLoad)
+            // {
+            //    // CHECK
+            //    dCHECKSplashSedLoadClay += dThisCellClayDeposit;
+            //    dCHECKSplashSedLoadSilt += dThisCellSiltDeposit;
+            //    dCHECKSplashSedLoadSand += dThisCellSandDeposit;
+            // }
+            // else
+            // {
+            //    // CHECK
+            //    dCHECKSplashDepositClay += dThisCellClayDeposit;
+            //    dCHECKSplashDepositSilt += dThisCellSiltDeposit;
+            //    dCHECKSplashDepositSand += dThisCellSandDeposit;
+            // }
          }
       }
 
@@ -646,7 +491,7 @@ void CSimulation::DoAllSplash(void)
       {
          for (int nY = 0; nY < m_nYGridMax; nY++)
          {
-            if (m_Cell[nX][nY].bIsMissingValue())
+            if (m_pGrid->bIsMissing(m_pGrid->nGetIndex(nX, nY)))
                continue;
 
             dTmpSplashDepositTotClay += m_Cell[nX][nY].pGetSoil()->dGetClaySplashDeposit();
@@ -725,6 +570,20 @@ void CSimulation::InitSplashAttenuation(void)
    // Finally recalculate values of m_VdSplashEffCoeff[nLen-2] to m_VdSplashEffCoeff[0]
    for (int j = nLen-2; j >= 0; j--)
       m_VdSplashEffCoeff[j] = m_VdSplashEffCoeff[j] * m_VdSplashEffCoeff[j+1] + VdU[j];
+
+   // Now resample the spline onto a table of SPLASH_EFF_TABLE_INTERVALS equal depth intervals, from zero to the largest depth in the file (which bReadSplashAttenuationData() has checked is greater than zero), so that splash efficiency can be found by linear interpolation rather than by searching for the spline segment. The last node is repeated, so that a depth which is exactly at the end of the table can be interpolated without a special case
+   m_dSplashEffTableDepthMax = m_VdSplashDepth[nLen-1];
+   m_dSplashEffTableInvSpacing = SPLASH_EFF_TABLE_INTERVALS / m_dSplashEffTableDepthMax;
+
+   // The spline gives a special value where there is no surface water. The table is only used for depths above zero, so store this value separately and make the first node the value of the spline segment at zero depth
+   m_dSplashEffDry = dCalcSplashCubicSpline(0);
+
+   m_VdSplashEffTable.resize(SPLASH_EFF_TABLE_INTERVALS + 2);
+   m_VdSplashEffTable[0] = dCalcSplashCubicSplineSegment(0);
+   for (int i = 1; i < SPLASH_EFF_TABLE_INTERVALS; i++)
+      m_VdSplashEffTable[i] = dCalcSplashCubicSpline((i * m_dSplashEffTableDepthMax) / SPLASH_EFF_TABLE_INTERVALS);
+
+   m_VdSplashEffTable[SPLASH_EFF_TABLE_INTERVALS] = m_VdSplashEffTable[SPLASH_EFF_TABLE_INTERVALS + 1] = dCalcSplashCubicSpline(m_dSplashEffTableDepthMax);
 }
 
 //=========================================================================================================================================
@@ -742,6 +601,16 @@ double CSimulation::dCalcSplashCubicSpline(double dDepth) const
    if (dDepth > m_VdSplashDepth[nLen-1])
       return (0);
 
+   return dCalcSplashCubicSplineSegment(dDepth);
+}
+
+//=========================================================================================================================================
+//! This member function of CSimulation evaluates the splash efficiency cubic spline at a water depth, without the special cases for zero depth and for depths beyond the end of the spline
+//=========================================================================================================================================
+double CSimulation::dCalcSplashCubicSplineSegment(double const dDepth) const
+{
+   int nLen = static_cast<int>(m_VdSplashDepth.size());
+
    // OK start to calculate the cubic spline value
    int
       nLo = 0,
@@ -772,65 +641,27 @@ double CSimulation::dCalcSplashCubicSpline(double dDepth) const
 }
 
 //=========================================================================================================================================
-//! This member function of CSimulation calculates the Laplacian for 4 cells with a centred scheme and ordinary axes (x-x, y-y). It is Eq (20) in the paper. The original was written by Olivier Planchon, 2 May 2001
+//! This member function of CSimulation returns splash efficiency by linear interpolation in the table made by InitSplashAttenuation(). It has no branches, so a loop which calls it can be vectorized. Beyond the end of the table the cubic spline gives zero, so zero is returned there; where there is no surface water, the spline's value at zero depth is returned
 //=========================================================================================================================================
-double CSimulation::dCalcLaplacian(int const nX, int const nY)
+double CSimulation::dLookUpSplashEfficiency(double const dDepth) const
 {
-/*
-   // This is the original code
-   double dThisElev = m_Cell[nX][nY].dGetSoilSurfaceElevation();
-   return (m_dPlanchonCellSizeKC * (Deriv2(m_Cell[nX-1][nY].dGetSoilSurfaceElevation(), dThisElev, m_Cell[nX+1][nY].dGetSoilSurfaceElevation(), m_dCellSquare) + Deriv2(m_Cell[nX][nY-1].dGetSoilSurfaceElevation(), dThisElev, m_Cell[nX][nY+1].dGetSoilSurfaceElevation(), m_dCellSquare)));
-
-   // This is mathematically equivalent to the code above
-   return (m_dPlanchonCellSizeKC * (m_Cell[nX-1][nY].dGetSoilSurfaceElevation() + m_Cell[nX+1][nY].dGetSoilSurfaceElevation() + m_Cell[nX][nY-1].dGetSoilSurfaceElevation() + m_Cell[nX][nY+1].dGetSoilSurfaceElevation() - (4 * m_Cell[nX][nY].dGetSoilSurfaceElevation())));
-*/
-   // Modification of the code above to also work with edge cells (which have less than 4 adjacent cells)
-   int nAdj = 0;
-   int nXTmp, nYTmp;
-   double dLaplacian = 0;
-
-   nXTmp = nX-1;
-   nYTmp = nY;
-   if ((nXTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()))
-   {
-      nAdj++;
-      dLaplacian += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation();
-   }
-
-   nXTmp = nX+1;
-   nYTmp = nY;
-   if ((nXTmp < m_nXGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()))
-   {
-      nAdj++;
-      dLaplacian += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation();
-   }
+   // Clamp the depth (not the position in the table, since the compiler may then turn the clamp into a branch) to the table. Rounding may put the end of the table just beyond SPLASH_EFF_TABLE_INTERVALS, but not beyond the repeated last node
+   double dPos = tMin(tMax(dDepth, 0.0), m_dSplashEffTableDepthMax) * m_dSplashEffTableInvSpacing;
+   int n = static_cast<int>(dPos);
+   double dFrac = dPos - n;
 
-   nXTmp = nX;
-   nYTmp = nY-1;
-   if ((nYTmp >= 0) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()))
-   {
-      nAdj++;
-      dLaplacian += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation();
-   }
-
-   nXTmp = nX;
-   nYTmp = nY+1;
-   if ((nYTmp < m_nYGridMax) && (! m_Cell[nXTmp][nYTmp].bIsMissingValue()))
-   {
-      nAdj++;
-      dLaplacian += m_Cell[nXTmp][nYTmp].pGetSoil()->dGetSoilSurfaceElevation();
-   }
-
-   dLaplacian -= (nAdj * m_Cell[nX][nY].pGetSoil()->dGetSoilSurfaceElevation());
-   dLaplacian *= m_dPlanchonCellSizeKC;
+   double dEff = m_VdSplashEffTable[n] + dFrac * (m_VdSplashEffTable[n+1] - m_VdSplashEffTable[n]);
+   double dInTable = ((dDepth > m_dSplashEffTableDepthMax) ? 0 : 1);
+   dEff *= dInTable;
 
-   return (dLaplacian);
+   // The table covers depths which are greater than zero and no more than the end of the table, so select the stored value for zero depth otherwise
+   return ((dDepth > 0) ? dEff : m_dSplashEffDry);
 }
 
 //=========================================================================================================================================
-//! This member function of CSimulation outputs splash efficiency (1 - attenuation) calculated as a constrained cubic spline, for checking purposes
+//! This member function of CSimulation outputs splash efficiency (1 - attenuation) calculated as a constrained cubic spline and from the lookup table, for checking purposes. It also writes the maximum difference between the two to the log file
 //=========================================================================================================================================
-void CSimulation::CheckSplashAttenuation(void) const
+void CSimulation::CheckSplashAttenuation(void)
 {
    // Put together file name for CSV splash attenuation check file
    string strFilePathName = m_strOutputPath;
@@ -854,10 +685,27 @@ void CSimulation::CheckSplashAttenuation(void) const
 //   SplashAttenuationStream << "Depth\t,\tEfficiency\t,\tAttenuation" << endl;
    double const dDelta = 0.1;
    for (double d = 0; d <= (static_cast<int>(m_VdSplashDepth.size()) + 10); d += dDelta)
-      SplashAttenuationStream << d << ",\t" << dCalcSplashCubicSpline(d) << ",\t" << 1 - dCalcSplashCubicSpline(d) << endl;
+      SplashAttenuationStream << d << ",\t" << dCalcSplashCubicSpline(d) << ",\t" << 1 - dCalcSplashCubicSpline(d) << ",\t" << dLookUpSplashEfficiency(d) << ",\t" << dLookUpSplashEfficiency(d) - dCalcSplashCubicSpline(d) << endl;
 
    // Close file
    SplashAttenuationStream.close();
+
+   // Now find the maximum difference between the table and the spline, at SPLASH_EFF_CHECK_SAMPLES evenly-spaced depths in each table interval, and also just beyond the end of the table
+   int nSamples = SPLASH_EFF_TABLE_INTERVALS * SPLASH_EFF_CHECK_SAMPLES;
+   double dMaxDiff = 0;
+   double dMaxDiffDepth = 0;
+   for (int i = 0; i <= nSamples + SPLASH_EFF_CHECK_SAMPLES; i++)
+   {
+      double dDepth = (i * m_dSplashEffTableDepthMax) / nSamples;
+      double dDiff = fabs(dLookUpSplashEfficiency(dDepth) - dCalcSplashCubicSpline(dDepth));
+      if (dDiff > dMaxDiff)
+      {
+         dMaxDiff = dDiff;
+         dMaxDiffDepth = dDepth;
+      }
+   }
+
+   m_ofsLog << "Splash efficiency lookup table: " << SPLASH_EFF_TABLE_INTERVALS << " intervals of " << 1 / m_dSplashEffTableInvSpacing << " mm, maximum difference from cubic spline " << dMaxDiff << " at a water depth of " << dMaxDiffDepth << " mm" << endl;
 }
 
 //=========================================================================================================================================
@@ -976,6 +824,14 @@ bool CSimulation::bReadSplashAttenuationData(void)
 
    InStream.close();
 
+   // The lookup table made from this relationship runs from zero to the largest water depth, so this must be greater than zero
+   if (m_VdSplashDepth.empty() || (m_VdSplashDepth.back() <= 0))
+   {
+      // Error in input to splash efficiency file
+      cerr << ERR << "reading splash efficiency: largest water depth in " << strFilePathName << " must be greater than zero" << endl;
+      return (false);
+   }
+
    return (true);
 }
 
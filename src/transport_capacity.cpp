@@ -16,63 +16,209 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
+#include "fast_math.h"
 
 //=========================================================================================================================================
-//! Calculates transport capacity for a single wet cell to decide whether erosion or deposition should occur there. Uses equation (5) in Nearing, M.A., Norton, L.D., Bulgakov, D.A., Larionov, G.A., West, L.T. and Dontsova, K. (1997). Hydraulics and erosion in eroding rills. Water Resources Research 33(4), 865-876.
+//! Does the sediment calculations for every outflow which was recorded during this iteration's flow routing. Flow routing only records each cell's outflow: the transport capacity, flow erosion and deposition are all done afterwards, here. First the transport capacity and potential flow erosion of every recorded outflow are calculated in a single batched (vectorizable) pass, then the results are used to erode or deposit on each cell
 //=========================================================================================================================================
-void CSimulation::CalcTransportCapacity(int const nX, int const nY, int const nLowX, int const nLowY, int const nDirection, double const dWaterDepth, double const dTopDiff, double const dTopSlope, double const dHLen, double const dVel, double const dMoveDepth)
+void CSimulation::DoAllSedimentFlow(void)
 {
-   // Because the Nearing et al. equation uses cgs units, all variables used in this subroutine's calculations must be temporarily transformed into cgs units. First calculate unit discharge dQ in cm**2/s. Note that velocity used in this calculation is depth-dependent
-   double dQ = dMoveDepth * dVel * 0.01;                                         // div by 100 to give cm**2/sec
+   CalcAllTransportCapacity();
 
-   // Now calculate stream power dW (in g/s**3). Need to multiply by 10 since m_dG in m/s**2, and divide by 1000 since m_dRho is in kg/m**3 i.e. divide by 100
-   double dW = m_dRho * m_dG * dTopSlope * dQ * 0.01;                            // in g/s**3
+   int nWetActive = m_pGrid->nGetNumWetActive();
 
-   // This flow is potentially erosive, save stream power value for later display (save stream power in kg/s3)
-   m_Cell[nX][nY].pGetSurfaceWater()->SetStreamPower(dW * 0.001);
+   // With single-phase flow routing, the cells are taken in the same order as in routing, so that erosion of the adjacent cell is done in the same order as before. With two-phase flow routing, each cell only writes to itself and its own outflow slot, so this can be done in parallel
+#if defined _OPENMP
+   #pragma omp parallel for schedule(dynamic, ACTIVE_LIST_CHUNK) if (m_bTwoPhaseFlowRouting)
+#endif
+   for (int i = 0; i < nWetActive; i++)
+   {
+      int n = m_pGrid->nGetWetActive(i);
+      DoCellSedimentFlow(m_pGrid->nGetXFromIndex(n), m_pGrid->nGetYFromIndex(n));
+   }
 
-   // Calculate potential unit sediment load dQs (cgs units) using the Nearing et al. equation
-   double
-      dTmp1 = exp(m_dGamma + (m_dDelta * log(dW))),
-      dTmp2 = dTmp1 + 1,
-      dQs = exp(((m_dAlpha * dTmp2) + (m_dBeta * dTmp1)) / dTmp2);
+   if (m_bTwoPhaseFlowRouting)
+   {
+      // Each cell now gathers the flow erosion caused by its neighbours' outflows, taking them in a fixed order
+#if defined _OPENMP
+      #pragma omp parallel for schedule(dynamic, ACTIVE_LIST_CHUNK)
+#endif
+      for (int i = 0; i < nWetActive; i++)
+      {
+         int n = m_pGrid->nGetWetActive(i);
+         GatherCellFlowDetach(m_pGrid->nGetXFromIndex(n), m_pGrid->nGetYFromIndex(n));
+      }
+   }
+}
+
+//=========================================================================================================================================
+//! Calculates transport capacity, and potential flow erosion, for the recorded outflow of every cell in the wet-cell activity list. As in CGridStore::CalcAllSteepestTopSlopes(), each run of consecutive listed cells within a chunk is dealt with together
+//=========================================================================================================================================
+void CSimulation::CalcAllTransportCapacity(void)
+{
+   int nWetActive = m_pGrid->nGetNumWetActive();
+   int nChunks = (nWetActive + ACTIVE_LIST_CHUNK - 1) / ACTIVE_LIST_CHUNK;
+
+#if defined _OPENMP
+   #pragma omp parallel for schedule(static)
+#endif
+   for (int nChunk = 0; nChunk < nChunks; nChunk++)
+   {
+      int
+         nLast = tMin((nChunk+1) * ACTIVE_LIST_CHUNK, nWetActive),
+         i = nChunk * ACTIVE_LIST_CHUNK;
+
+      while (i < nLast)
+      {
+         int
+            nFirst = m_pGrid->nGetWetActive(i),
+            nLen = 1;
+
+         while ((i + nLen < nLast) && (m_pGrid->nGetWetActive(i + nLen) == nFirst + nLen))
+            nLen++;
+
+         // The choice of exp(), log() and cumulative Gaussian distribution is made here, once per run, rather than for every cell
+         if (m_bFastSedimentMath)
+            CalcRunTransportCapacity<true>(nFirst, nLen);
+         else
+            CalcRunTransportCapacity<false>(nFirst, nLen);
+
+         i += nLen;
+      }
+   }
+}
+
+//=========================================================================================================================================
+//! Calculates transport capacity, and potential flow erosion, for the recorded outflows of a run of nLen cells with consecutive store indices, starting at nFirst. Transport capacity uses equation (5) in Nearing, M.A., Norton, L.D., Bulgakov, D.A., Larionov, G.A., West, L.T. and Dontsova, K. (1997). Hydraulics and erosion in eroding rills. Water Resources Research 33(4), 865-876. Flow erosion uses equation (10) in Nearing, M.A. (1991). A probabilistic model of soil detachment by shallow turbulent flow. Transactions of the American Society of Agricultural Engineers 34(1), 81-85: see DoCellFlowErosion() for details. Every cell in the run is calculated, whether or not it has a recorded outflow, so that there are no branches; the results for cells without a recorded outflow are not used. If bFAST is true, exp(), log() and the cumulative Gaussian distribution are replaced by the versions in fast_math.h, and the loop vectorizes
+//=========================================================================================================================================
+template <bool bFAST> void CSimulation::CalcRunTransportCapacity(int const nFirst, int const nLen)
+{
+   double const TAUB_CONST = 150;
+
+   // Copy these to local variables, so that the compiler knows that they do not change during the loop
+   double const
+      dRho = m_dRho,
+      dG = m_dG,
+      dAlpha = m_dAlpha,
+      dBeta = m_dBeta,
+      dGamma = m_dGamma,
+      dDelta = m_dDelta,
+      dCellSide = m_dCellSide,
+      dInvCellSquare = m_dInvCellSquare,
+      dK = m_dK,
+      dT = m_dT,
+      dST2 = m_dST2,
+      dCVTaub = m_dCVTaub;
+   CGridStore* pGrid = m_pGrid;
+
+   // Each cell only writes its own results, so the loop may be vectorized
+#if defined _OPENMP
+   #pragma omp simd
+#endif
+   for (int n = nFirst; n < nFirst + nLen; n++)
+   {
+      double
+         dTopDiff = pGrid->dGetSedFlowHead(n),
+         dS = pGrid->dGetSedFlowTopSlope(n),
+         dHLen = pGrid->dGetSedFlowHLen(n),
+         dVel = pGrid->dGetSedFlowSpeed(n),
+         dMoveDepth = pGrid->dGetSedFlowMoveDepth(n),
+         dBulkDensity = pGrid->dGetSedFlowBulkDensity(n);
+
+      // Because the Nearing et al. (1997) equation uses cgs units, all variables used in this calculation must be temporarily transformed into cgs units. First calculate unit discharge dQ in cm**2/s. Note that velocity used in this calculation is depth-dependent
+      double dQ = dMoveDepth * dVel * 0.01;                               // div by 100 to give cm**2/sec
+
+      // Now calculate stream power dW (in g/s**3). Need to multiply by 10 since m_dG in m/s**2, and divide by 1000 since m_dRho is in kg/m**3 i.e. divide by 100
+      double dW = dRho * dG * dS * dQ * 0.01;                            // in g/s**3
+
+      // Calculate potential unit sediment load dQs (cgs units) using the Nearing et al. (1997) equation
+      double dLogW = (bFAST ? dFastLog(dW) : log(dW));
+      double dTmp1 = dGamma + (dDelta * dLogW);
+      dTmp1 = (bFAST ? dFastExp(dTmp1) : exp(dTmp1));
+      double
+         dTmp2 = dTmp1 + 1,
+         dQs = ((dAlpha * dTmp2) + (dBeta * dTmp1)) / dTmp2;
+      dQs = (bFAST ? dFastExp(dQs) : exp(dQs));
+
+      // OK, dQS is for unit (cm) width, so calculate total for full width of cell. Need to divide by 10 since m_dCellSide is in mm
+      double dTmp3 = dQs * dCellSide * 0.1;                              // in g/s
+
+      // Now calculate the amount which could be transported while travelling across cell
+      dTmp3 *= sqrt((dHLen * dHLen) + (dTopDiff * dTopDiff)) / dVel;      // in g
+
+      // Convert the amount which could be transported while travelling across cell (in g) to a volumetric measure in cm**3: vol = mass / density then multiply by 1000 to convert cm**3 to mm**3. Divide bulk density by 1000 to convert from kg/m**3 to t/m**3 (same as g/cm**3). NOTE this needs improvement, since bulk density of transported material probably isn't the same as bulk density of its parent soil
+      double dTmp4 = 1000 * dTmp3 / (dBulkDensity * 0.001);               // in mm**3
+
+      // Now convert to a depth measure: this is the transport capacity expressed as a depth equivalent
+      double dTransportCapacity = dTmp4 * dInvCellSquare;                 // in mm depth
+
+      // Pre-existing sediment load (for all sediment size classes, as a depth equivalent) produces a linear decrease in detachment i.e dE(actual) = dE * (1 - (dSedimentLoad/dTransportCapacity)) following equation 11 in Lei et al. (1998). Ensure that this is never -ve
+      double dSedimentLoadWt = tMax(1.0 - (pGrid->dGetAllSizeSedLoad(n) / dTransportCapacity), 0.0);
+
+      // Now the potential flow erosion. For dTau, must divide by 1000 to convert dMoveDepth to m, and divide by 1000 as m_dRho is in t/m3
+      double
+         dTau = dRho * dG * dMoveDepth * dS * 1e-6,
+         dTaub = TAUB_CONST * dTau,
+         dSTaub = dCVTaub * dTaub,
+         dZ = (dTaub - dT) / sqrt(dST2 + (dSTaub * dSTaub)),
+         dP = (bFAST ? dFastCGaussianPDF(dZ) : dGetCGaussianPDF(dZ));
+
+      // Detachment rate per unit area of soil surface in kg/(sec m2), weighted by the sediment load. Note must divide by 1000, since dVel in mm/sec
+      double dE = dK * dVel * dP * dS * 0.001;
+      dE *= dSedimentLoadWt;
+
+      // Convert to the total thickness of soil lost per sec: this is later split between 'this' and 'next' cells
+      double dThickLost = 1000 * dE / dBulkDensity;                       // mm/sec
+
+      pGrid->SetSedFlowResults(n, dW, dTransportCapacity, dSedimentLoadWt, dThickLost);
+   }
+}
 
-   // OK, dQS is for unit (cm) width, so calculate total for full width of cell. Need to divide by 10 since m_dCellSide is in mm
-   double dTmp3 = dQs * m_dCellSide * 0.1;                                     // in g/s
+//=========================================================================================================================================
+//! Uses the transport capacity of a single cell's recorded outflow to decide whether erosion or deposition should occur there, then does it
+//=========================================================================================================================================
+void CSimulation::DoCellSedimentFlow(int const nX, int const nY)
+{
+   int n = m_pGrid->nGetIndex(nX, nY);
+   if (! m_pGrid->bIsSedFlow(n))
+      return;
 
-   // Now calculate the amount which could be transported while travelling across cell
-   dTmp3 *= sqrt((dHLen * dHLen) + (dTopDiff * dTopDiff)) / dVel;             // in g
+   // This flow is potentially erosive, save stream power value for later display (save stream power in kg/s3)
+   m_Cell[nX][nY].pGetSurfaceWater()->SetStreamPower(m_pGrid->dGetSedFlowStreamPower(n) * 0.001);
 
-   // Get the bulk density of the topmost non-zero soil layer: divide by 1000 to convert from kg/m**3 to t/m**3 (same as g/cm**3). NOTE this needs improvement, since bulk density of transported material probably isn't the same as bulk density of its parent soil
-   double dBulkDensity = m_Cell[nX][nY].pGetSoil()->dGetBulkDensityOfTopNonZeroLayer() * 0.001;    // in g/cm**3
-   if (dBulkDensity < 0)
+   if (m_pGrid->dGetSedFlowBulkDensity(n) < 0)
    {
       // We are down to unerodible basement, so no sediment to be transported
       return;
    }
 
-   // Convert the amount which could be transported while travelling across cell (in g) to a volumetric measure in cm**3: vol = mass / density then multiply by 1000 to convert cm**3 to mm**3
-   double dTmp4 = 1000 * dTmp3 / dBulkDensity;     // in mm**3
-
-   // Now convert to a depth measure: this is the transport capacity expressed as a depth equivalent
-   double dTransportCapacity = dTmp4 * m_dInvCellSquare;                                      // in mm depth
-
    // Save transport capacity (mm depth)
+   double dTransportCapacity = m_pGrid->dGetSedFlowTransportCapacity(n);
    m_Cell[nX][nY].pGetSurfaceWater()->SetTransportCapacity(dTransportCapacity);
 
    // Get the total sediment load (for all sediment size classes) as a depth equivalent
    double dSedimentLoad = m_Cell[nX][nY].pGetSedLoad()->dGetLastIterAllSizeSedLoad();
 
+   int
+      nLow = m_pGrid->nGetSedFlowTo(n),
+      nDirection = m_pGrid->nGetSedFlowDirection(n);
+   double
+      dS = m_pGrid->dGetSedFlowTopSlope(n),
+      dHLen = m_pGrid->dGetSedFlowHLen(n),
+      dMoveDepth = m_pGrid->dGetSedFlowMoveDepth(n),
+      dSedimentLoadWt = m_pGrid->dGetSedFlowLoadWt(n),
+      dThickLost = m_pGrid->dGetSedFlowThickLost(n);
+
    // Are we at the edge of the grid?
-   if (nLowX == -1)
+   if (nLow == -1)
    {
       // Cannot have deposition at grid edge, but might have erosion
-      double dSedimentLoadWt = tMax(1.0 - (dSedimentLoad / dTransportCapacity), 0.0);
-      if (bFpEQ(dSedimentLoadWt, 0.0, TOLERANCE))      // Ensure that dSedimentLoadWt is never -ve
+      if (bFpEQ(dSedimentLoadWt, 0.0, TOLERANCE))
          return;
 
       // OK, do some erosion
-      DoCellFlowErosion(nX, nY, nLowX, nLowY, nDirection, dTopSlope, dHLen, dVel, dSedimentLoadWt, dMoveDepth);
+      DoCellFlowErosion(nX, nY, -1, -1, nDirection, dS, dHLen, dMoveDepth, dThickLost);
       return;
    }
 
@@ -80,20 +226,18 @@ void CSimulation::CalcTransportCapacity(int const nX, int const nY, int const nL
    if (dSedimentLoad > dTransportCapacity)
    {
       // Sediment load is more than transport capacity, so do some deposition
-      DoCellSedLoadDeposition(nX, nY, dWaterDepth, dSedimentLoad, dTransportCapacity);
+      DoCellSedLoadDeposition(nX, nY, m_pGrid->dGetSedFlowWaterDepth(n), dSedimentLoad, dTransportCapacity);
    }
    else
    {
       if (m_bFlowErosion)
       {
-         // Sediment load is less than transport capacity and the adjacent cell is downhill from this one. First do a safety check to ensure that dSedimentLoadWt is never -ve
-         double dSedimentLoadWt = tMax(1.0 - (dSedimentLoad / dTransportCapacity), 0.0);
+         // Sediment load is less than transport capacity and the adjacent cell is downhill from this one
          if (bFpEQ(dSedimentLoadWt, 0.0, TOLERANCE))
             return;
 
          // OK, do some erosion
-         DoCellFlowErosion(nX, nY, nLowX, nLowY, nDirection, dTopSlope, dHLen, dVel, dSedimentLoadWt, dMoveDepth);
+         DoCellFlowErosion(nX, nY, m_pGrid->nGetXFromIndex(nLow), m_pGrid->nGetYFromIndex(nLow), nDirection, dS, dHLen, dMoveDepth, dThickLost);
       }
    }
 }
-
@@ -22,6 +22,7 @@ using std::transform;
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "grid_store.h"
 
 //=========================================================================================================================================
 //! Handles command-line parameters
@@ -482,14 +483,6 @@ double CSimulation::dGetTimeStep(void) const
    return m_dTimeStep;
 }
 
-//=========================================================================================================================================
-//! Wrapper around dGetRand0Gaussian(), needed for cell surface water initialisation
-//=========================================================================================================================================
-double CSimulation::dGetRandGaussian(void)
-{
-   return dGetRand0Gaussian();
-}
-
 //=========================================================================================================================================
 //! Displays information regarding the progress of the simulation
 //=========================================================================================================================================
@@ -582,394 +575,149 @@ double CSimulation::dGetCGaussianPDF(double const dZ)
 }
 
 //=========================================================================================================================================
-//! Adds to the whole-grid this-iteration rain value
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterRain(double const dRain)
-{
-   m_dEndOfIterRain += dRain;
-}
-
-//=========================================================================================================================================
-//! Adds to the whole-grid this-iteration run-on value
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterRunon(double const dRunon)
-{
-   m_dEndOfIterRunOn += dRunon;
-}
-
-//=========================================================================================================================================
-//! Adds to the whole-grid stored subsurface water, for all cell layers, value
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterStoredSoilWater(double const dSoilWater)
-{
-   m_dEndOfIterTotSoilWater += dSoilWater;
-}
-
-//=========================================================================================================================================
-//! Increments the whole-grid count of wet cells
-//=========================================================================================================================================
-void CSimulation::IncrNumWetCells(void)
-{
-   m_ulNWet++;
-}
-
-//=========================================================================================================================================
-//! Adds to the whole-grid this-iteration stored surface water value
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterStoredSurfaceWater(double const dStoredWater)
-{
-   m_dEndOfIterTotSurfaceWater += dStoredWater;
-}
-
-//=========================================================================================================================================
-//! Adds to the whole-grid this-iteration value for surface water lost from the grid
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSurfaceWaterLost(double const dLostWater)
-{
-   m_dEndOfIterSurfaceWaterOffEdge += dLostWater;
-}
-
-//=========================================================================================================================================
-//! Adds to the whole-grid this-iteration value for infiltration during this iteration
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterInfiltration(double const dInfiltWater)
-{
-   m_dEndOfIterInfiltration += dInfiltWater;
-}
-
-//=========================================================================================================================================
-//! Adds to the whole-grid this-iteration value for exfiltration during this iteration
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterExfiltration(double const dExfiltWater)
-{
-   m_dEndOfIterExfiltration += dExfiltWater;
-}
-
-//=========================================================================================================================================
-//! This member function of CSimulation adds to the end-of-iteration sediment lost from grid values for clay, silt, and sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSedimentOffEdge(double const dClaySedOffEdge, double const dSiltSedOffEdge, double const dSandSedOffEdge)
-{
-   m_dEndOfIterClaySedLoadOffEdge += dClaySedOffEdge;
-   m_dEndOfIterSiltSedLoadOffEdge += dSiltSedOffEdge;
-   m_dEndOfIterSandSedLoadOffEdge += dSandSedOffEdge;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration flow detachment load value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClayFlowDetach(double const dClayDiff)
-{
-   m_dEndOfIterClayFlowDetach += dClayDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration flow detachment value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltFlowDetach(double const dSiltDiff)
-{
-   m_dEndOfIterSiltFlowDetach += dSiltDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration flow detachment value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandFlowDetach(double const dSandDiff)
-{
-   m_dEndOfIterSandFlowDetach += dSandDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration flow deposition load value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClayFlowDeposit(double const dClayDiff)
-{
-   m_dEndOfIterClayFlowDeposit += dClayDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration flow deposition value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltFlowDeposit(double const dSiltDiff)
-{
-   m_dEndOfIterSiltFlowDeposit += dSiltDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration flow deposition value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandFlowDeposit(double const dSandDiff)
-{
-   m_dEndOfIterSandFlowDeposit += dSandDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash detachment load value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClaySplashDetach(double const dClayDiff)
-{
-   m_dEndOfIterClaySplashDetach += dClayDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash detachment value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltSplashDetach(double const dSiltDiff)
-{
-   m_dEndOfIterSiltSplashDetach += dSiltDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash detachment value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandSplashDetach(double const dSandDiff)
-{
-   m_dEndOfIterSandSplashDetach += dSandDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash deposition load value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClaySplashDeposit(double const dClayDiff)
-{
-   m_dEndOfIterClaySplashDeposit += dClayDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash deposition value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltSplashDeposit(double const dSiltDiff)
-{
-   m_dEndOfIterSiltSplashDeposit += dSiltDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash deposition value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandSplashDeposit(double const dSandDiff)
-{
-   m_dEndOfIterSandSplashDeposit += dSandDiff;
-}
-
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash off-edge value for clay
+//! Calculates the whole-grid end-of-iteration totals in a single pass over all active cells. Each span of cells is summed (in parallel) with a compensated (two-sum) accumulation of every total at once, then the per-span partial sums are combined in a fixed pairwise tree. The result does not depend on the number of threads, and is at least as accurate as Kahan summation. If bInitializeCells is true, each cell is also initialized for the next iteration, once its values have been read
 //=========================================================================================================================================
-void CSimulation::AddToEndOfIterClaySplashOffEdge(double const dClayDiff)
+void CSimulation::CalcEndOfIterTotals(bool const bInitializeCells)
 {
-   m_dEndOfIterClaySplashOffEdge += dClayDiff;
-}
+   int nSpans = m_pGrid->nGetNumActiveSpans();
+   if (nSpans == 0)
+      return;
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash off-edge value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltSplashOffEdge(double const dClayDiff)
-{
-   m_dEndOfIterSiltSplashOffEdge += dClayDiff;
-}
+   vector<double>
+      VdSpanSum(nSpans * EOI_NUM_TOTALS, 0),
+      VdSpanCorrection(nSpans * EOI_NUM_TOTALS, 0);
+   vector<unsigned long> VulSpanNWet(nSpans, 0);
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration splash off-edge value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandSplashOffEdge(double const dClayDiff)
-{
-   m_dEndOfIterSandSplashOffEdge += dClayDiff;
-}
+#if defined _OPENMP
+   #pragma omp parallel for schedule(dynamic)
+#endif
+   for (int nSpan = 0; nSpan < nSpans; nSpan++)
+   {
+      double
+         dValue[EOI_NUM_TOTALS],
+         * pdSum = &VdSpanSum[nSpan * EOI_NUM_TOTALS],
+         * pdCorrection = &VdSpanCorrection[nSpan * EOI_NUM_TOTALS];
+      unsigned long ulNWet = 0;
+
+      int nX = m_pGrid->nGetActiveSpanX(nSpan);
+      for (int nY = m_pGrid->nGetActiveSpanFirstY(nSpan); nY <= m_pGrid->nGetActiveSpanLastY(nSpan); nY++)
+      {
+         if (m_Cell[nX][nY].bGetEndOfIterValues(dValue))
+            ulNWet++;
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration slump detachment value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClaySlumpDetach(double const dClay)
-{
-   m_dEndOfIterClaySlumpDetach += dClay;
-}
+         if (bInitializeCells)
+            m_Cell[nX][nY].InitializeThisIter(m_bSlumpThisIter);
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration slump detachment value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltSlumpDetach(double const dSilt)
-{
-   m_dEndOfIterSiltSlumpDetach += dSilt;
-}
+         // Add this cell's values to the span's sums, keeping the rounding error of each addition. This is branch-free so is vectorised
+#if defined _OPENMP
+         #pragma omp simd
+#endif
+         for (int i = 0; i < EOI_NUM_TOTALS; i++)
+         {
+            double
+               dNewSum = pdSum[i] + dValue[i],
+               dBack = dNewSum - pdSum[i];
+            pdCorrection[i] += (pdSum[i] - (dNewSum - dBack)) + (dValue[i] - dBack);
+            pdSum[i] = dNewSum;
+         }
+      }
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration slump detachment value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandSlumpDetach(double const dSand)
-{
-   m_dEndOfIterSandSlumpDetach += dSand;
-}
+      VulSpanNWet[nSpan] = ulNWet;
+   }
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration slump deposition value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClaySlumpDeposit(double const dClay)
-{
-   m_dEndOfIterClaySlumpDeposit += dClay;
-}
+   // Now combine the per-span sums in pairs, doubling the stride each time, so the order of combination is always the same
+   for (int nStride = 1; nStride < nSpans; nStride *= 2)
+   {
+      for (int nSpan = 0; nSpan + nStride < nSpans; nSpan += 2 * nStride)
+      {
+         double
+            * pdSum = &VdSpanSum[nSpan * EOI_NUM_TOTALS],
+            * pdCorrection = &VdSpanCorrection[nSpan * EOI_NUM_TOTALS];
+         double const
+            * pdOtherSum = &VdSpanSum[(nSpan + nStride) * EOI_NUM_TOTALS],
+            * pdOtherCorrection = &VdSpanCorrection[(nSpan + nStride) * EOI_NUM_TOTALS];
+
+         for (int i = 0; i < EOI_NUM_TOTALS; i++)
+         {
+            double
+               dNewSum = pdSum[i] + pdOtherSum[i],
+               dBack = dNewSum - pdSum[i];
+            pdCorrection[i] += pdOtherCorrection[i] + (pdSum[i] - (dNewSum - dBack)) + (pdOtherSum[i] - dBack);
+            pdSum[i] = dNewSum;
+         }
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration slump deposition value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltSlumpDeposit(double const dSilt)
-{
-   m_dEndOfIterSiltSlumpDeposit += dSilt;
-}
+         VulSpanNWet[nSpan] += VulSpanNWet[nSpan + nStride];
+      }
+   }
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration slump deposition value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandSlumpDeposit(double const dSand)
-{
-   m_dEndOfIterSandSlumpDeposit += dSand;
-}
+   // The grand totals are in the first span's slots
+   double dTot[EOI_NUM_TOTALS];
+   for (int i = 0; i < EOI_NUM_TOTALS; i++)
+      dTot[i] = VdSpanSum[i] + VdSpanCorrection[i];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration topple detachment value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClayToppleDetach(double const dClay)
-{
-   m_dEndOfIterClayToppleDetach += dClay;
-}
+   m_ulNWet += VulSpanNWet[0];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration topple detachment value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltToppleDetach(double const dSilt)
-{
-   m_dEndOfIterSiltToppleDetach += dSilt;
-}
+   m_dEndOfIterRain                 += dTot[EOI_RAIN];
+   m_dEndOfIterRunOn                += dTot[EOI_RUNON];
+   m_dEndOfIterTotSoilWater         += dTot[EOI_SOIL_WATER];
+   m_dEndOfIterInfiltration         += dTot[EOI_INFILT];
+   m_dEndOfIterExfiltration         += dTot[EOI_EXFILT];
+   m_dEndOfIterSurfaceWaterOffEdge  += dTot[EOI_SURFACE_WATER_OFF_EDGE];
+   m_dEndOfIterTotSurfaceWater      += dTot[EOI_SURFACE_WATER];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration topple detachment value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandToppleDetach(double const dSand)
-{
-   m_dEndOfIterSandToppleDetach += dSand;
-}
+   m_dEndOfIterClaySedLoad          += dTot[EOI_CLAY_SED_LOAD];
+   m_dEndOfIterSiltSedLoad          += dTot[EOI_SILT_SED_LOAD];
+   m_dEndOfIterSandSedLoad          += dTot[EOI_SAND_SED_LOAD];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration topple deposition value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClayToppleDeposit(double const dClay)
-{
-   m_dEndOfIterClayToppleDeposit += dClay;
-}
+   m_dEndOfIterTotElev              += dTot[EOI_ELEV];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration topple deposition value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltToppleDeposit(double const dSilt)
-{
-   m_dEndOfIterSiltToppleDeposit += dSilt;
-}
+   m_dEndOfIterClayFlowDetach       += dTot[EOI_CLAY_FLOW_DETACH];
+   m_dEndOfIterSiltFlowDetach       += dTot[EOI_CLAY_FLOW_DETACH + EOI_SILT];
+   m_dEndOfIterSandFlowDetach       += dTot[EOI_CLAY_FLOW_DETACH + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration topple deposition value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandToppleDeposit(double const dSand)
-{
-   m_dEndOfIterSandToppleDeposit += dSand;
-}
+   m_dEndOfIterClaySplashDetach     += dTot[EOI_CLAY_SPLASH_DETACH];
+   m_dEndOfIterSiltSplashDetach     += dTot[EOI_CLAY_SPLASH_DETACH + EOI_SILT];
+   m_dEndOfIterSandSplashDetach     += dTot[EOI_CLAY_SPLASH_DETACH + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration infiltration deposition value for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClayInfiltDeposit(double const dClay)
-{
-   m_dEndOfIterClayInfiltDeposit += dClay;
-}
+   m_dEndOfIterClaySlumpDetach      += dTot[EOI_CLAY_SLUMP_DETACH];
+   m_dEndOfIterSiltSlumpDetach      += dTot[EOI_CLAY_SLUMP_DETACH + EOI_SILT];
+   m_dEndOfIterSandSlumpDetach      += dTot[EOI_CLAY_SLUMP_DETACH + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration infiltration deposition value for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltInfiltDeposit(double const dSilt)
-{
-   m_dEndOfIterSiltInfiltDeposit += dSilt;
-}
+   m_dEndOfIterClayToppleDetach     += dTot[EOI_CLAY_TOPPLE_DETACH];
+   m_dEndOfIterSiltToppleDetach     += dTot[EOI_CLAY_TOPPLE_DETACH + EOI_SILT];
+   m_dEndOfIterSandToppleDetach     += dTot[EOI_CLAY_TOPPLE_DETACH + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration infiltration deposition value for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandInfiltDeposit(double const dSand)
-{
-   m_dEndOfIterSandInfiltDeposit += dSand;
-}
+   m_dEndOfIterClayFlowDeposit      += dTot[EOI_CLAY_FLOW_DEPOSIT];
+   m_dEndOfIterSiltFlowDeposit      += dTot[EOI_CLAY_FLOW_DEPOSIT + EOI_SILT];
+   m_dEndOfIterSandFlowDeposit      += dTot[EOI_CLAY_FLOW_DEPOSIT + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration net (i.e. all-process detachment - all-process deposition) clay detachment
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterNetClayDetach(double const dClay)
-{
-   m_dEndOfIterNetClayDetachment += dClay;
-}
+   m_dEndOfIterClaySplashDeposit    += dTot[EOI_CLAY_SPLASH_DEPOSIT];
+   m_dEndOfIterSiltSplashDeposit    += dTot[EOI_CLAY_SPLASH_DEPOSIT + EOI_SILT];
+   m_dEndOfIterSandSplashDeposit    += dTot[EOI_CLAY_SPLASH_DEPOSIT + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration net (i.e. all-process detachment - all-process deposition) silt detachment
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterNetSiltDetach(double const dSilt)
-{
-   m_dEndOfIterNetSiltDetachment += dSilt;
-}
+   m_dEndOfIterClaySlumpDeposit     += dTot[EOI_CLAY_SLUMP_DEPOSIT];
+   m_dEndOfIterSiltSlumpDeposit     += dTot[EOI_CLAY_SLUMP_DEPOSIT + EOI_SILT];
+   m_dEndOfIterSandSlumpDeposit     += dTot[EOI_CLAY_SLUMP_DEPOSIT + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration net (i.e. all-process detachment - all-process deposition) sand detachment
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterNetSandDetach(double const dSand)
-{
-   m_dEndOfIterNetSandDetachment += dSand;
-}
+   m_dEndOfIterClayToppleDeposit    += dTot[EOI_CLAY_TOPPLE_DEPOSIT];
+   m_dEndOfIterSiltToppleDeposit    += dTot[EOI_CLAY_TOPPLE_DEPOSIT + EOI_SILT];
+   m_dEndOfIterSandToppleDeposit    += dTot[EOI_CLAY_TOPPLE_DEPOSIT + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration sediment load for clay
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterClaySedLoad(double const dClay)
-{
-   // TEST Kahan summation
-   double y = dClay - m_dEndOfIterClaySedLoadKahanCorrection;
-   volatile double t = m_dEndOfIterClaySedLoad + y;
-   volatile double z = t - m_dEndOfIterClaySedLoad;
-   m_dEndOfIterClaySedLoadKahanCorrection = z - y;
-   m_dEndOfIterClaySedLoad = t;
-
-   //m_dEndOfIterClaySedLoad += dClay;
-}
+   m_dEndOfIterClayInfiltDeposit    += dTot[EOI_CLAY_INFILT_DEPOSIT];
+   m_dEndOfIterSiltInfiltDeposit    += dTot[EOI_CLAY_INFILT_DEPOSIT + EOI_SILT];
+   m_dEndOfIterSandInfiltDeposit    += dTot[EOI_CLAY_INFILT_DEPOSIT + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration sediment load for silt
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSiltSedLoad(double const dSilt)
-{
-   // TEST Kahan summation
-   double y = dSilt - m_dEndOfIterSiltSedLoadKahanCorrection;
-   volatile double t = m_dEndOfIterSiltSedLoad + y;
-   volatile double z = t - m_dEndOfIterSiltSedLoad;
-   m_dEndOfIterSiltSedLoadKahanCorrection = z - y;
-   m_dEndOfIterSiltSedLoad = t;
-
-   //m_dEndOfIterSiltSedLoad += dSilt;
-}
+   m_dEndOfIterClaySedLoadOffEdge   += dTot[EOI_CLAY_SED_OFF_EDGE];
+   m_dEndOfIterSiltSedLoadOffEdge   += dTot[EOI_CLAY_SED_OFF_EDGE + EOI_SILT];
+   m_dEndOfIterSandSedLoadOffEdge   += dTot[EOI_CLAY_SED_OFF_EDGE + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration sediment load for sand
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterSandSedLoad(double const dSand)
-{
-   // TEST Kahan summation
-   double y = dSand - m_dEndOfIterSandSedLoadKahanCorrection;
-   volatile double t = m_dEndOfIterSandSedLoad + y;
-   volatile double z = t - m_dEndOfIterSandSedLoad;
-   m_dEndOfIterSandSedLoadKahanCorrection = z - y;
-   m_dEndOfIterSandSedLoad = t;
-
-   //m_dEndOfIterSandSedLoad += dSand;
-}
+   m_dEndOfIterClaySplashOffEdge    += dTot[EOI_CLAY_SPLASH_OFF_EDGE];
+   m_dEndOfIterSiltSplashOffEdge    += dTot[EOI_CLAY_SPLASH_OFF_EDGE + EOI_SILT];
+   m_dEndOfIterSandSplashOffEdge    += dTot[EOI_CLAY_SPLASH_OFF_EDGE + EOI_SAND];
 
-//=========================================================================================================================================
-//! Adds to the end-of-iteration total elevation
-//=========================================================================================================================================
-void CSimulation::AddToEndOfIterTotalElev(double const dElev)
-{
-   m_dEndOfIterTotElev += dElev;
+   m_dEndOfIterNetClayDetachment    += dTot[EOI_CLAY_NET_DETACH];
+   m_dEndOfIterNetSiltDetachment    += dTot[EOI_CLAY_NET_DETACH + EOI_SILT];
+   m_dEndOfIterNetSandDetachment    += dTot[EOI_CLAY_NET_DETACH + EOI_SAND];
 }
 
 //========================================================================================================================================
@@ -1661,55 +1409,56 @@ void CSimulation::CreateSoilLayers(void)
 //! Calculates the timestep for the next iteration
 //=========================================================================================================================================
 void CSimulation::CalcTimestep(void)
+{
+   m_dTimeStep = dCalcNextTimestep();
+
+   // If some flow occurred, reset for the coming interation
+   if (! bFpEQ(m_dPossMaxSpeedNextIter, 0.0, TOLERANCE))
+      m_dPossMaxSpeedNextIter = 0;
+}
+
+//=========================================================================================================================================
+//! Returns the timestep for the next iteration, calculated from the maximum flow speed of this iteration. This does not change any values, so can also be used to find out in advance whether there will be a next iteration
+//=========================================================================================================================================
+double CSimulation::dCalcNextTimestep(void) const
 {
    if (bFpEQ(m_dPossMaxSpeedNextIter, 0.0, TOLERANCE))
    {
       // No flow occurred, so set the timestep for the next iteration based on a guessed-in value for flow speed
-      m_dTimeStep = m_dCellSide / INIT_MAX_SPEED_GUESS;                             // In sec
+      return m_dCellSide / INIT_MAX_SPEED_GUESS;                                    // In sec
    }
-   else
-   {
-      // Some flow occurred: calculate the possible next timestep. Start by constraining the max possible flow speed
-      m_dPossMaxSpeedNextIter = tMin(m_dPossMaxSpeedNextIter, m_dMaxFlowSpeed);
 
-      // OK now calculate the possible timestep
-      double dPossNextTimeStep = m_dCellSide / m_dPossMaxSpeedNextIter;             // In sec
+   // Some flow occurred: calculate the possible next timestep. Start by constraining the max possible flow speed
+   double dPossMaxSpeed = tMin(m_dPossMaxSpeedNextIter, m_dMaxFlowSpeed);
 
-      // Is the timestep increasing or decreasing?
-      if (dPossNextTimeStep > m_dTimeStep)
-      {
-         // Timestep is increasing i.e. flow is slowing down
-         double dTmp = m_dTimeStep / dPossNextTimeStep;
-         if (dTmp > COURANT_ALPHA)
-         {
-            // The change in timestep is small
-            m_dTimeStep = dPossNextTimeStep;
-         }
-         else
-         {
-            // The change in timestep is large, so we need to make a smaller change. This is equivalent to the 'Courant–Friedrichs–Lewy condition' i.e. the time needed for flow to cross a cell at the maximum speed during the last iteration, plus an arbitrary safety margin. COURANT_ALPHA = delta_time / delta_distance See e.g. http://en.wikipedia.org/wiki/Courant%E2%80%93Friedrichs%E2%80%93Lewy_condition
-            m_dTimeStep = m_dTimeStep / COURANT_ALPHA;
-         }
-      }
-      else
+   // OK now calculate the possible timestep
+   double dPossNextTimeStep = m_dCellSide / dPossMaxSpeed;                          // In sec
+
+   // Is the timestep increasing or decreasing?
+   if (dPossNextTimeStep > m_dTimeStep)
+   {
+      // Timestep is increasing i.e. flow is slowing down
+      double dTmp = m_dTimeStep / dPossNextTimeStep;
+      if (dTmp > COURANT_ALPHA)
       {
-         // Timestep is decreasing i.e. flow is speeding up
-         double dTmp = dPossNextTimeStep / m_dTimeStep;
-         if (dTmp > COURANT_ALPHA)
-         {
-            // The change in timestep is small
-            m_dTimeStep = dPossNextTimeStep;
-         }
-         else
-         {
-            // The change in timestep is large, so we need to make a smaller change. This is equivalent to the 'Courant–Friedrichs–Lewy condition' i.e. the time needed for flow to cross a cell at the maximum speed during the last iteration, plus an arbitrary safety margin. COURANT_ALPHA = delta_time / delta_distance See e.g. http://en.wikipedia.org/wiki/Courant%E2%80%93Friedrichs%E2%80%93Lewy_condition
-            m_dTimeStep = m_dTimeStep * COURANT_ALPHA;
-         }
+         // The change in timestep is small
+         return dPossNextTimeStep;
       }
 
-      // Reset for the coming interation
-      m_dPossMaxSpeedNextIter = 0;
+      // The change in timestep is large, so we need to make a smaller change. This is equivalent to the 'Courant–Friedrichs–Lewy condition' i.e. the time needed for flow to cross a cell at the maximum speed during the last iteration, plus an arbitrary safety margin. COURANT_ALPHA = delta_time / delta_distance See e.g. http://en.wikipedia.org/wiki/Courant%E2%80%93Friedrichs%E2%80%93Lewy_condition
+      return m_dTimeStep / COURANT_ALPHA;
    }
+
+   // Timestep is decreasing i.e. flow is speeding up
+   double dTmp = dPossNextTimeStep / m_dTimeStep;
+   if (dTmp > COURANT_ALPHA)
+   {
+      // The change in timestep is small
+      return dPossNextTimeStep;
+   }
+
+   // The change in timestep is large, so we need to make a smaller change. This is equivalent to the 'Courant–Friedrichs–Lewy condition' i.e. the time needed for flow to cross a cell at the maximum speed during the last iteration, plus an arbitrary safety margin. COURANT_ALPHA = delta_time / delta_distance See e.g. http://en.wikipedia.org/wiki/Courant%E2%80%93Friedrichs%E2%80%93Lewy_condition
+   return m_dTimeStep * COURANT_ALPHA;
 }
 
 //=========================================================================================================================================
@@ -1815,13 +1564,11 @@ void CSimulation::DEBUGShowSedLoad(string const strIn)
    double dChangeInSiltSedLoad = 0;
    double dChangeInSandSedLoad = 0;
 
-   for (int nX = 0; nX < m_nXGridMax; nX++)
+   for (int nSpan = 0; nSpan < m_pGrid->nGetNumActiveSpans(); nSpan++)
    {
-      for (int nY = 0; nY < m_nYGridMax; nY++)
+      int nX = m_pGrid->nGetActiveSpanX(nSpan);
+      for (int nY = m_pGrid->nGetActiveSpanFirstY(nSpan); nY <= m_pGrid->nGetActiveSpanLastY(nSpan); nY++)
       {
-         if (m_Cell[nX][nY].bIsMissingValue())
-            continue;
-
          dClaySedLoad += (m_Cell[nX][nY].pGetSedLoad()->dGetLastIterClaySedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClaySplashSedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClayFlowSedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClaySlumpSedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClayToppleSedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClayHeadcutRetreatSedLoad());
 
          dChangeInClaySedLoad += (m_Cell[nX][nY].pGetSedLoad()->dGetClaySplashSedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClayFlowSedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClaySlumpSedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClayToppleSedLoad() + m_Cell[nX][nY].pGetSedLoad()->dGetClayHeadcutRetreatSedLoad());
@@ -1845,4 +1592,105 @@ void CSimulation::DEBUGShowSedLoad(string const strIn)
    m_ofsLog << "dClaySedLoad = " << dClaySedLoad * m_dCellSquare << " dSiltSedLoad = " << dSiltSedLoad * m_dCellSquare << " dSandSedLoad = " << dSandSedLoad * m_dCellSquare << endl;
    m_ofsLog << "dChangeInClaySedLoad = " << dChangeInClaySedLoad * m_dCellSquare << " dChangeInSiltSedLoad = " << dChangeInSiltSedLoad * m_dCellSquare << " dChangeInSandSedLoad = " << dChangeInSandSedLoad * m_dCellSquare << endl << endl;
 }
+
+//! Compares every cell's stored soil surface and top surface elevations with the values obtained by summing the soil layer thicknesses, also compares the stored thickness of each soil layer with the layer's own value, and logs any mismatches
+void CSimulation::DEBUGCheckSurfaceElevations(void)
+{
+   int nMismatch = 0;
+
+   for (int nSpan = 0; nSpan < m_pGrid->nGetNumActiveSpans(); nSpan++)
+   {
+      int nX = m_pGrid->nGetActiveSpanX(nSpan);
+      for (int nY = m_pGrid->nGetActiveSpanFirstY(nSpan); nY <= m_pGrid->nGetActiveSpanLastY(nSpan); nY++)
+      {
+         int n = m_pGrid->nGetIndex(nX, nY);
+         double dSoilElev = m_Cell[nX][nY].pGetSoil()->dCalcSoilSurfaceElevation();
+         double dTopElev = dSoilElev + m_pGrid->dGetSurfaceWaterDepth(n);
+
+         if ((! bFpEQ(m_pGrid->dGetSoilSurfaceElevation(n), dSoilElev, TOLERANCE)) || (! bFpEQ(m_pGrid->dGetTopElevation(n), dTopElev, TOLERANCE)))
+         {
+            nMismatch++;
+            m_ofsLog << std::fixed << setprecision(10) << m_ulIter << ": [" << nX << "][" << nY << "] stored soil surface elevation = " << m_pGrid->dGetSoilSurfaceElevation(n) << " summed = " << dSoilElev << ", stored top elevation = " << m_pGrid->dGetTopElevation(n) << " summed = " << dTopElev << endl;
+         }
+
+         for (int nLayer = 0; nLayer < m_nNumSoilLayers; nLayer++)
+         {
+            double dLayerThickness = m_Cell[nX][nY].pGetSoil()->pLayerGetLayer(nLayer)->dGetLayerThickness();
+            if (! bFpEQ(m_pGrid->dGetLayerThickness(nLayer, n), dLayerThickness, TOLERANCE))
+            {
+               nMismatch++;
+               m_ofsLog << std::fixed << setprecision(10) << m_ulIter << ": [" << nX << "][" << nY << "] stored thickness of layer " << nLayer << " = " << m_pGrid->dGetLayerThickness(nLayer, n) << " summed = " << dLayerThickness << endl;
+            }
+         }
+      }
+   }
+
+   if (nMismatch > 0)
+      cerr << WARN << "iteration " << m_ulIter << ": " << nMismatch << " out-of-date stored surface elevations or layer thicknesses" << endl;
+}
+
+//! Compares the steepest top-surface gradient found for every wet cell in the wet-cell activity list by CGridStore::CalcAllSteepestTopSlopes() with the value found by nFindSteepestEnergySlope(), and logs any mismatches. These must be bit-for-bit identical
+void CSimulation::DEBUGCheckSteepestTopSlopes(void)
+{
+   int nMismatch = 0;
+
+   for (int i = 0; i < m_pGrid->nGetNumWetActive(); i++)
+   {
+      int n = m_pGrid->nGetWetActive(i);
+      if (! m_pGrid->bIsWet(n))
+         continue;
+
+      int
+         nX = m_pGrid->nGetXFromIndex(n),
+         nY = m_pGrid->nGetYFromIndex(n),
+         nLowX = 0,
+         nLowY = 0;
+      double
+         dTopDiff = 0,
+         dTopSlope = 0,
+         dHLen = 0;
+
+      int nDir = nFindSteepestEnergySlope(nX, nY, m_pGrid->dGetTopElevation(n), nLowX, nLowY, dTopDiff, dTopSlope, dHLen);
+
+      if ((nDir != m_pGrid->nGetSteepestDirection(n)) || (! bFpBitEQ(dTopDiff, m_pGrid->dGetSteepestTopDiff(n))) || (! bFpBitEQ(dTopSlope, m_pGrid->dGetSteepestTopSlope(n))) || (! bFpBitEQ(dHLen, m_pGrid->dGetSteepestHLen(n))))
+      {
+         nMismatch++;
+         m_ofsLog << std::fixed << setprecision(10) << m_ulIter << ": [" << nX << "][" << nY << "] steepest direction = " << m_pGrid->nGetSteepestDirection(n) << " slope = " << m_pGrid->dGetSteepestTopSlope(n) << ", cell-by-cell direction = " << nDir << " slope = " << dTopSlope << endl;
+      }
+   }
+
+   if (nMismatch > 0)
+      cerr << WARN << "iteration " << m_ulIter << ": " << nMismatch << " mismatched steepest top-surface gradients" << endl;
+}
+
+//! Compares the hydraulic radius and Reynolds number found for every wet cell in the wet-cell activity list by CalcAllHydraulicState() with the values found by dCalcHydraulicRadius(), and logs any mismatches. These must be bit-for-bit identical
+void CSimulation::DEBUGCheckHydraulicState(void)
+{
+   int nMismatch = 0;
+
+   for (int i = 0; i < m_pGrid->nGetNumWetActive(); i++)
+   {
+      int n = m_pGrid->nGetWetActive(i);
+      if (! m_pGrid->bIsWet(n))
+         continue;
+
+      int
+         nX = m_pGrid->nGetXFromIndex(n),
+         nY = m_pGrid->nGetYFromIndex(n),
+         nDir = (bFlowsOffEdge(nX, nY) ? m_pGrid->nGetFlowDirection(n) : m_pGrid->nGetSteepestDirection(n));
+
+      double
+         dR = dCalcHydraulicRadius(nX, nY, nDir),
+         dRe = (1e-6 * m_Cell[nX][nY].pGetSurfaceWater()->dGetFlowSpd() * dR) / m_dNu;
+
+      if ((! bFpBitEQ(dR, m_pGrid->dGetHydraulicRadius(n))) || (! bFpBitEQ(dRe, m_pGrid->dGetReynolds(n))))
+      {
+         nMismatch++;
+         m_ofsLog << std::fixed << setprecision(10) << m_ulIter << ": [" << nX << "][" << nY << "] hydraulic radius = " << m_pGrid->dGetHydraulicRadius(n) << " Reynolds = " << m_pGrid->dGetReynolds(n) << ", cell-by-cell hydraulic radius = " << dR << " Reynolds = " << dRe << endl;
+      }
+   }
+
+   if (nMismatch > 0)
+      cerr << WARN << "iteration " << m_ulIter << ": " << nMismatch << " mismatched hydraulic radii or Reynolds numbers" << endl;
+}
 #endif
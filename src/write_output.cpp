@@ -16,6 +16,7 @@ You should have received a copy of the GNU General Public License along with thi
 #include "rg.h"
 #include "simulation.h"
 #include "cell.h"
+#include "gis_writer.h"
 
 //=========================================================================================================================================
 //! Writes run details to Out and Log files
@@ -84,6 +85,24 @@ void CSimulation::WriteRunDetails(void)
    m_ofsOut << "*First random numbers generated                         \t: " << ulGetRand0() << '\t' << ulGetRand1() << endl;
 
    m_ofsOut << " GIS output format                                      \t: " << m_strGDALOutputDriverLongname << endl;
+   m_ofsOut << " GIS output layout                                      \t: ";
+   if (GIS_LAYOUT_MULTIBAND == m_nGISOutputLayout)
+      m_ofsOut << "one multi-band file per save" << endl;
+   else if (GIS_LAYOUT_TIME_STACK == m_nGISOutputLayout)
+      m_ofsOut << "all saves stacked in one ENVI-format file" << endl;
+   else
+      m_ofsOut << "one file per data item per save" << endl;
+   m_ofsOut << " GIS creation options                                   \t: ";
+   if (GIS_LAYOUT_TIME_STACK == m_nGISOutputLayout)
+      m_ofsOut << "not used" << endl;
+   else if (m_VstrGISCreationOptions.empty())
+      m_ofsOut << "driver defaults" << endl;
+   else
+   {
+      for (unsigned int n = 0; n < m_VstrGISCreationOptions.size(); n++)
+         m_ofsOut << m_VstrGISCreationOptions[n] << " ";
+      m_ofsOut << endl;
+   }
    m_ofsOut << " Optional GIS files saved                               \t: ";
 
    string strTmp;
@@ -858,6 +877,33 @@ if (! m_strRainVarMFile.empty())
    m_ofsOut << " Gravitational acceleration                             \t: " << m_dG << " m/sec**2" << endl;
    m_ofsOut << endl;
 
+   m_ofsOut << "PERFORMANCE" << endl;
+   m_ofsOut << " Two-phase flow routing?                                \t: " << (m_bTwoPhaseFlowRouting ? "y" : "n") << endl;
+   m_ofsOut << " Random number generator                                \t: " << (m_bCounterBasedRand ? "counter-based (Philox4x32-10)" : "sequential (Tausworthe)") << endl;
+   m_ofsOut << " Aggregate rain above (drops per cell per iteration)    \t: ";
+   if (m_dAggregateRainThreshold > 0)
+      m_ofsOut << m_dAggregateRainThreshold << endl;
+   else
+      m_ofsOut << "never" << endl;
+   m_ofsOut << " Friction factor lookup tables (max relative error)     \t: ";
+   if (m_dFFTableMaxRelErr > 0)
+      m_ofsOut << std::scientific << m_dFFTableMaxRelErr << std::fixed << endl;
+   else
+      m_ofsOut << "no, exact formulas" << endl;
+   m_ofsOut << " Fast approximations for sediment calculations?         \t: " << (m_bFastSedimentMath ? "y" : "n") << endl;
+   m_ofsOut << " Background GIS writer threads                          \t: ";
+   if (m_nGISWriteThreads > 0)
+      m_ofsOut << m_nGISWriteThreads << endl;
+   else
+      m_ofsOut << "none, GIS files written by the simulation thread" << endl;
+   m_ofsOut << " Benchmark GIS output?                                  \t: " << (m_bGISBenchmark ? "y" : "n") << endl;
+#if defined _OPENMP
+   m_ofsOut << " Number of threads                                      \t: " << omp_get_max_threads() << (m_nThreads > 0 ? "" : " (OpenMP default)") << endl;
+#else
+   m_ofsOut << " Number of threads                                      \t: 1 (not compiled with OpenMP)" << endl;
+#endif
+   m_ofsOut << endl;
+
    m_ofsOut << "*=calculated value" << endl;
    m_ofsOut << endl;
 
@@ -877,165 +923,284 @@ if (! m_strRainVarMFile.empty())
 //=========================================================================================================================================
 int CSimulation::nWriteFilesAtEnd(void)
 {
-   // Write files which are always written
-   if (! bWriteGISFileFloat(GIS_CUMUL_ALL_SIZE_FLOW_DETACH, &GIS_CUMUL_ALL_SIZE_FLOW_DETACH_TITLE))   // also increments filename count
-      return (RTN_ERR_GISFILEWRITE);
+   // Shear stress is only spread over the surrounding patches of cells when slumping is calculated, so spread any shear stress since then before saving
+   if (m_bSlumping && (m_bShearStressSave || m_bCumulAvgShearStressSave))
+      SpreadAllShearStress();
 
-   if (! bWriteGISFileFloat(GIS_CUMUL_RAIN, &GIS_CUMUL_RAIN_TITLE))
-      return (RTN_ERR_GISFILEWRITE);
+   // Make a list of the data items to save, then copy them all from the cell array in one pass
+   vector<int> VnDataItem;
+   vector<string const*> VpstrTitle;
+   GetGISEndItems(VnDataItem, VpstrTitle);
 
-   if (! bWriteGISFileFloat(GIS_CUMUL_SPLASH, &GIS_CUMUL_SPLASH_TITLE))
+   if (! bWriteGISFiles(VnDataItem, VpstrTitle))
       return (RTN_ERR_GISFILEWRITE);
 
-   if (! bWriteGISFileFloat(GIS_SURFACE_WATER_DEPTH, &GIS_SURFACE_WATER_DEPTH_TITLE))
+   // Wait for all GIS files to be written, then pass on any errors
+   if (! bCheckGISWrites(true))
       return (RTN_ERR_GISFILEWRITE);
 
-   if (! bWriteGISFileFloat(GIS_SURFACE_WATER_DW_SPEED, &GIS_SURFACE_WATER_DW_SPEED_TITLE))
-      return (RTN_ERR_GISFILEWRITE);
+   return RTN_OK;
+}
 
-   if (! bWriteGISFileFloat(GIS_SURFACE_WATER_SPEED, &GIS_SURFACE_WATER_SPEED_TITLE))
-      return (RTN_ERR_GISFILEWRITE);
+//=========================================================================================================================================
+//! Makes a list of the data items which are saved as GIS files at the end of the simulation, with their titles
+//=========================================================================================================================================
+void CSimulation::GetGISEndItems(vector<int>& VnDataItem, vector<string const*>& VpstrTitle) const
+{
+   // Files which are always written
+   VnDataItem.push_back(GIS_CUMUL_ALL_SIZE_FLOW_DETACH);   // also increments filename count
+   VpstrTitle.push_back(&GIS_CUMUL_ALL_SIZE_FLOW_DETACH_TITLE);
 
-   // Maybe write optional files
+   VnDataItem.push_back(GIS_CUMUL_RAIN);
+   VpstrTitle.push_back(&GIS_CUMUL_RAIN_TITLE);
+
+   VnDataItem.push_back(GIS_CUMUL_SPLASH);
+   VpstrTitle.push_back(&GIS_CUMUL_SPLASH_TITLE);
+
+   VnDataItem.push_back(GIS_SURFACE_WATER_DEPTH);
+   VpstrTitle.push_back(&GIS_SURFACE_WATER_DEPTH_TITLE);
+
+   VnDataItem.push_back(GIS_SURFACE_WATER_DW_SPEED);
+   VpstrTitle.push_back(&GIS_SURFACE_WATER_DW_SPEED_TITLE);
+
+   VnDataItem.push_back(GIS_SURFACE_WATER_SPEED);
+   VpstrTitle.push_back(&GIS_SURFACE_WATER_SPEED_TITLE);
+
+   // Maybe optional files
    if (m_bElevSave)
-      if (! bWriteGISFileFloat(GIS_ELEVATION, &GIS_ELEVATION_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_ELEVATION);
+      VpstrTitle.push_back(&GIS_ELEVATION_TITLE);
+   }
 
    if (m_bDetrendElevSave)
-      if (! bWriteGISFileFloat(GIS_DETREND_ELEVATION, &GIS_DETREND_ELEVATION_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_DETREND_ELEVATION);
+      VpstrTitle.push_back(&GIS_DETREND_ELEVATION_TITLE);
+   }
 
    if (m_bCumulRunOnSave)
-      if (! bWriteGISFileFloat(GIS_CUMUL_RUNON, &GIS_CUMUL_RUNON_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_CUMUL_RUNON);
+      VpstrTitle.push_back(&GIS_CUMUL_RUNON_TITLE);
+   }
 
    if (m_bSplashSave)
-      if (! bWriteGISFileFloat(GIS_SPLASH, &GIS_SPLASH_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_SPLASH);
+      VpstrTitle.push_back(&GIS_SPLASH_TITLE);
+   }
 
    if (m_bFlowDetachSave)
-      if (! bWriteGISFileFloat(GIS_ALL_SIZE_FLOW_DETACH, &GIS_CUMUL_ALL_SIZE_FLOW_DETACH_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_ALL_SIZE_FLOW_DETACH);
+      VpstrTitle.push_back(&GIS_CUMUL_ALL_SIZE_FLOW_DETACH_TITLE);
+   }
 
    if (m_bInundationSave)
-      if (! bWriteGISFileInt(GIS_INUNDATION_REGIME, &GIS_INUNDATION_REGIME_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_INUNDATION_REGIME);
+      VpstrTitle.push_back(&GIS_INUNDATION_REGIME_TITLE);
+   }
 
    if (m_bFlowDirSave)
-      if (! bWriteGISFileInt(GIS_SURFACE_WATER_DIRECTION, &GIS_SURFACE_WATER_DIRECTION_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_SURFACE_WATER_DIRECTION);
+      VpstrTitle.push_back(&GIS_SURFACE_WATER_DIRECTION_TITLE);
+   }
 
    if (m_bInfiltSave)
-      if (! bWriteGISFileFloat(GIS_INFILT, &GIS_INFILT_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_INFILT);
+      VpstrTitle.push_back(&GIS_INFILT_TITLE);
+   }
 
    if (m_bCumulInfiltSave)
-      if (! bWriteGISFileFloat(GIS_CUMUL_INFILT, &GIS_CUMUL_INFILT_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_CUMUL_INFILT);
+      VpstrTitle.push_back(&GIS_CUMUL_INFILT_TITLE);
+   }
 
    if (m_bSoilWaterSave)
-      if (! bWriteGISFileFloat(GIS_SOIL_WATER, &GIS_SOIL_WATER_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_SOIL_WATER);
+      VpstrTitle.push_back(&GIS_SOIL_WATER_TITLE);
+   }
 
    if (m_bInfiltDepositSave)
-      if (! bWriteGISFileFloat(GIS_INFILT_DEPOSIT, &GIS_INFILT_DEPOSIT_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_INFILT_DEPOSIT);
+      VpstrTitle.push_back(&GIS_INFILT_DEPOSIT_TITLE);
+   }
 
    if (m_bCumulInfiltDepositSave)
-      if (! bWriteGISFileFloat(GIS_CUMUL_INFILT_DEPOSIT, &GIS_CUMUL_INFILT_DEPOSIT_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_CUMUL_INFILT_DEPOSIT);
+      VpstrTitle.push_back(&GIS_CUMUL_INFILT_DEPOSIT_TITLE);
+   }
 
    if (m_bTopSurfaceSave)
-      if (! bWriteGISFileFloat(GIS_TOP_SURFACE_DETREND, &GIS_TOP_SURFACE_DETREND_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_TOP_SURFACE_DETREND);
+      VpstrTitle.push_back(&GIS_TOP_SURFACE_DETREND_TITLE);
+   }
 
    if (m_bLostSave)
-      if (! bWriteGISFileFloat(GIS_AVG_SURFACE_WATER_FROM_EDGES, &GIS_AVG_SURFACE_WATER_FROM_EDGES_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_AVG_SURFACE_WATER_FROM_EDGES);
+      VpstrTitle.push_back(&GIS_AVG_SURFACE_WATER_FROM_EDGES_TITLE);
+   }
 
    if (m_bStreamPowerSave)
-      if (! bWriteGISFileFloat(GIS_STREAMPOWER, &GIS_STREAMPOWER_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_STREAMPOWER);
+      VpstrTitle.push_back(&GIS_STREAMPOWER_TITLE);
+   }
 
    if (m_bShearStressSave)
-      if (! bWriteGISFileFloat(GIS_SHEAR_STRESS, &GIS_SHEAR_STRESS_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_SHEAR_STRESS);
+      VpstrTitle.push_back(&GIS_SHEAR_STRESS_TITLE);
+   }
 
    if (m_bFrictionFactorSave)
-      if (! bWriteGISFileFloat(GIS_FRICTION_FACTOR, &GIS_FRICTION_FACTOR_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_FRICTION_FACTOR);
+      VpstrTitle.push_back(&GIS_FRICTION_FACTOR_TITLE);
+   }
 
    if (m_bCumulAvgShearStressSave)
-      if (! bWriteGISFileFloat(GIS_AVG_SHEAR_STRESS, &GIS_AVG_SHEAR_STRESS_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_AVG_SHEAR_STRESS);
+      VpstrTitle.push_back(&GIS_AVG_SHEAR_STRESS_TITLE);
+   }
 
    if (m_bReynoldsSave)
-      if (! bWriteGISFileFloat(GIS_REYNOLDS_NUMBER, &GIS_REYNOLDS_NUMBER_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_REYNOLDS_NUMBER);
+      VpstrTitle.push_back(&GIS_REYNOLDS_NUMBER_TITLE);
+   }
 
    if (m_bFroudeSave)
-      if (! bWriteGISFileFloat(GIS_FROUDE_NUMBER, &GIS_FROUDE_NUMBER_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_FROUDE_NUMBER);
+      VpstrTitle.push_back(&GIS_FROUDE_NUMBER_TITLE);
+   }
 
    if (m_bTCSave)
-      if (! bWriteGISFileFloat(GIS_TRANSPORT_CAPACITY, &GIS_TRANSPORT_CAPACITY_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_TRANSPORT_CAPACITY);
+      VpstrTitle.push_back(&GIS_TRANSPORT_CAPACITY_TITLE);
+   }
 
    if (m_bCumulAvgDepthSave)
-      if (! bWriteGISFileFloat(GIS_AVG_SURFACE_WATER_DEPTH, &GIS_AVG_SURFACE_WATER_DEPTH_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_AVG_SURFACE_WATER_DEPTH);
+      VpstrTitle.push_back(&GIS_AVG_SURFACE_WATER_DEPTH_TITLE);
+   }
 
    if (m_bCumulAvgDWSpdSave)
-      if (! bWriteGISFileFloat(GIS_AVG_SURFACE_WATER_DW_SPEED, &GIS_AVG_SURFACE_WATER_DW_SPEED_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_AVG_SURFACE_WATER_DW_SPEED);
+      VpstrTitle.push_back(&GIS_AVG_SURFACE_WATER_DW_SPEED_TITLE);
+   }
 
    if (m_bCumulAvgSpdSave)
-      if (! bWriteGISFileFloat(GIS_AVG_SURFACE_WATER_SPEED, &GIS_AVG_SURFACE_WATER_SPEED_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_AVG_SURFACE_WATER_SPEED);
+      VpstrTitle.push_back(&GIS_AVG_SURFACE_WATER_SPEED_TITLE);
+   }
 
    if (m_bSedConcSave)
-      if (! bWriteGISFileFloat(GIS_SEDIMENT_CONCENTRATION, &GIS_SEDIMENT_CONCENTRATION_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_SEDIMENT_CONCENTRATION);
+      VpstrTitle.push_back(&GIS_SEDIMENT_CONCENTRATION_TITLE);
+   }
 
    if (m_bSedLoadSave)
-      if (! bWriteGISFileFloat(GIS_SEDIMENT_LOAD, &GIS_SEDIMENT_LOAD_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_SEDIMENT_LOAD);
+      VpstrTitle.push_back(&GIS_SEDIMENT_LOAD_TITLE);
+   }
 
    if (m_bAvgSedLoadSave)
-      if (! bWriteGISFileFloat(GIS_AVG_SEDIMENT_LOAD, &GIS_AVG_SEDIMENT_LOAD_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_AVG_SEDIMENT_LOAD);
+      VpstrTitle.push_back(&GIS_AVG_SEDIMENT_LOAD_TITLE);
+   }
 
    if (m_bSlumpSave)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_SLUMP_DETACH, &GIS_CUMUL_SLUMP_DETACH_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+      VnDataItem.push_back(GIS_CUMUL_SLUMP_DETACH);
+      VpstrTitle.push_back(&GIS_CUMUL_SLUMP_DETACH_TITLE);
 
-      if (! bWriteGISFileFloat(GIS_CUMUL_SLUMP_DEPOSIT, &GIS_CUMUL_SLUMP_DEPOSIT_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+      VnDataItem.push_back(GIS_CUMUL_SLUMP_DEPOSIT);
+      VpstrTitle.push_back(&GIS_CUMUL_SLUMP_DEPOSIT_TITLE);
    }
 
    if (m_bToppleSave)
    {
-      if (! bWriteGISFileFloat(GIS_CUMUL_TOPPLE_DETACH, &GIS_CUMUL_TOPPLE_DETACH_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+      VnDataItem.push_back(GIS_CUMUL_TOPPLE_DETACH);
+      VpstrTitle.push_back(&GIS_CUMUL_TOPPLE_DETACH_TITLE);
 
-      if (! bWriteGISFileFloat(GIS_CUMUL_TOPPLE_DEPOSIT, &GIS_CUMUL_TOPPLE_DEPOSIT_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+      VnDataItem.push_back(GIS_CUMUL_TOPPLE_DEPOSIT);
+      VpstrTitle.push_back(&GIS_CUMUL_TOPPLE_DEPOSIT_TITLE);
    }
 
    if (m_bCumulFlowDepositSave)
-      if (! bWriteGISFileFloat(GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT, &GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT);
+      VpstrTitle.push_back(&GIS_CUMUL_ALL_SIZE_FLOW_DEPOSIT_TITLE);
+   }
 
    if (m_bCumulLoweringSave)
-      if (! bWriteGISFileFloat(GIS_CUMUL_ALL_PROC_SURF_LOWER, &GIS_CUMUL_ALL_PROC_SURF_LOWER_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_CUMUL_ALL_PROC_SURF_LOWER);
+      VpstrTitle.push_back(&GIS_CUMUL_ALL_PROC_SURF_LOWER_TITLE);
+   }
 
    if (m_bHeadcutRetreat)
-      if (! bWriteGISFileInt(GIS_CUMUL_BINARY_HEADCUT_RETREAT, &GIS_CUMUL_BINARY_HEADCUT_RETREAT_TITLE))
-         return (RTN_ERR_GISFILEWRITE);
+   {
+      VnDataItem.push_back(GIS_CUMUL_BINARY_HEADCUT_RETREAT);
+      VpstrTitle.push_back(&GIS_CUMUL_BINARY_HEADCUT_RETREAT_TITLE);
+   }
+}
 
-   return RTN_OK;
+//=========================================================================================================================================
+//! In benchmark mode, writes the number of GIS files written, the bytes written and the time taken, then the results of comparing different GDAL creation options
+//=========================================================================================================================================
+void CSimulation::WriteGISWriteStats(void)
+{
+   int nFiles;
+   long long llBytes;
+   double dSeconds;
+   m_pGISWriter->GetWriteTotals(nFiles, llBytes, dSeconds);
+
+   double dMB = static_cast<double>(llBytes) / (1024 * 1024);
+
+   ostringstream ss;
+   ss << std::fixed << setprecision(2);
+   ss << "GIS output: " << nFiles << " files written, " << dMB << " MB in " << dSeconds << " sec of GIS writer time";
+   if (dSeconds > 0)
+      ss << " (" << dMB / dSeconds << " MB/sec)";
+   ss << endl;
+
+   if (! m_VstrGISBenchmarkOptions.empty())
+   {
+      ss << "GIS creation options compared by writing the elevation grid as " << m_strGDALOutputDriverLongname << ":" << endl;
+      ss << "        MB         sec   Options" << endl;
+      for (unsigned int n = 0; n < m_VstrGISBenchmarkOptions.size(); n++)
+      {
+         if (m_VllGISBenchmarkBytes[n] < 0)
+            ss << "    failed      failed";
+         else
+            ss << setw(10) << static_cast<double>(m_VllGISBenchmarkBytes[n]) / (1024 * 1024) << setw(12) << setprecision(4) << m_VdGISBenchmarkSeconds[n] << setprecision(2);
+         ss << "   " << m_VstrGISBenchmarkOptions[n] << endl;
+      }
+   }
+
+   m_ofsOut << ss.str();
+   m_ofsLog << ss.str();
 }
 
 //=========================================================================================================================================